@@ -7,20 +7,130 @@
  *   - sparse:       weights close to W (few items fit; many DP rejects)
  *   - too_heavy:    every item heavier than W (DP rejects everything)
  *   - exact_fit:    weights divide W cleanly (forces full reconstruction)
+ *   - wide:         few items with weights spread over W (small Pareto
+ *                   frontier, so the automatic engine choice goes sparse)
+ *   - correlated, strongly_correlated, subset_sum:
+ *                   Pisinger's classes -- weights in [1, R] with R set so
+ *                   that about half the items fit, values the weight plus
+ *                   up to R/10 of noise, exactly R/10, or nothing -- which
+ *                   are hard for bound-based and frontier-based engines
  *
  * The solver is run inside the timed loop; allocation/free are part of the
- * measured cost (which is realistic for one-shot use).
+ * measured cost (which is realistic for one-shot use). The *Warm variants
+ * solve through a knapsack_workspace_t reserved before the loop, so only the
+ * result array is allocated per iteration (the steady state of a service).
+ * BM_DenseWarmKernel repeats the warm Dense case once per DP kernel.
+ * BM_ParseItems measures the CLI's items-line parser (cli_parse_buffer) on
+ * a line of range(0) tokens already in memory; BM_LoadBinary decodes the
+ * same instances from the binary columnar format.
+ * BM_WriteResultJson renders a result with range(0) selected indices into
+ * a growable knapsack_writer_t that is emptied every iteration.
+ * BM_DenseHirschberg solves through knapsack_solve_opts with the
+ * memory-bounded reconstruction, including sizes above the default limits;
+ * BM_DenseValueOnly does the same with KNAPSACK_RECONSTRUCT_NONE (no
+ * decision bitset, no reconstruction).
+ * BM_DenseTiled and BM_DenseTiledValueOnly run KNAPSACK_ENGINE_TILED on the
+ * Dense items with range(2) capacity cells per block (0: the size picked
+ * from the L2 cache, as knapsack_tile_cells reports it), and
+ * KNAPSACK_ENGINE_DENSE for a range(2) of -1, the untiled reference.
+ * BM_Wide lets knapsack_solve_status pick the engine; BM_WideDense forces
+ * the dense DP on the same inputs for comparison.
+ * BM_DenseStats and BM_WideStats repeat BM_Dense and BM_Wide with a
+ * knapsack_stats_t requested on every solve (compare their times for the
+ * cost of collecting it). They report the solver's own per-solve cell
+ * counts, arena size and phase timings, labelled with engine/kernel.
+ * BM_SparseDenseStats does the same with the dense DP forced on the Sparse
+ * items, whose decision rows are trimmed to the cells at or above each
+ * item's weight (its arena_bytes shows how little of the bitset is kept).
+ * The *BranchBound variants run KNAPSACK_ENGINE_BRANCH_BOUND on the Dense,
+ * Sparse and ExactFit inputs, at the plain fixtures' sizes (compare against
+ * BM_Dense etc.) and at capacities the DP's limits do not admit.
+ * The *Parallel variants add a thread-count dimension (third argument): the
+ * DP rows are split across a knapsack_thread_pool_t created before the loop
+ * (1 = the serial path, for reference).
+ * BM_SessionWhatIf answers "what if item k is added" on a session holding
+ * the Dense items; BM_ResolveWhatIf re-solves from scratch instead.
+ * BM_SessionAppend grows a session one item at a time, reading the result
+ * after every append; BM_ResolveAppend re-solves after every append.
+ * BM_DenseDeadline solves the Dense items in anytime mode with a
+ * steady_clock deadline of range(2) microseconds per solve (0: none, which
+ * measures the polling overhead against BM_Dense); the "exact" counter is
+ * the fraction of solves that finished before their deadline.
+ * BM_Batch solves the service workload -- thousands of small instances --
+ * through knapsack_solve_batch across a pool of range(1) workers;
+ * BM_BatchLoop is the same set solved one knapsack_solve_status call at a
+ * time. BM_BatchGpu hands range(0) such instances to the GPU backend; its
+ * label says whether a device ran them or the batch fell back to the CPU.
+ * BM_Executor submits the same instances one by one to a
+ * knapsack_executor_t with range(1) workers and sleeps until every completion
+ * callback has run; the difference against BM_Batch is the cost of queueing
+ * each instance as a job of its own.
+ * BM_Bounded solves range(0) item types of up to 100 copies each through
+ * knapsack_solve_bounded (binary splitting); BM_BoundedExpanded solves the
+ * same instance with every usable copy as a 0/1 item of its own. Both are
+ * value-only, so neither pays for a decision bitset of its row count.
+ * BM_DenseTopK asks knapsack_solve_top_k for the range(2) best selections
+ * of the Dense items; BM_DenseTopKResolve gets range(2) selections the old
+ * way, one extra solve per item of the best selection, with that item left
+ * out.
+ * BM_Dense64 solves the Dense items through knapsack_solve64 with every
+ * value shifted left 32 bits, past what the int solver accepts (compare
+ * against BM_Dense for the cost of the wider rows).
+ * BM_Multi2D solves range(0) items against a weight capacity range(1) and a
+ * volume capacity range(2) through knapsack_solve_multi; volumes follow the
+ * weights loosely, as they do for real parcels. BM_Multi3D adds a third
+ * dimension of range(1) to the same shape. Both report how many items
+ * preprocessing pruned.
+ * BM_CacheHit re-solves the Dense items through a knapsack_cache_t that
+ * already holds them (compare against BM_Dense); BM_CacheMiss cycles
+ * through 65 instances with a 64-entry cache, so every solve misses and
+ * evicts -- the cache's overhead on top of the solver.
+ * BM_Correlated, BM_StronglyCorrelated and BM_SubsetSum run the Pisinger
+ * classes cold, with *Warm and *ValueOnly variants like the Dense ones.
+ * BM_DensePeakMemory and BM_WidePeakMemory solve through a counting
+ * allocator in the reconstruction mode range(2) (0 bitset, 1 Hirschberg,
+ * 2 value only) and report peak_bytes, the most memory a solve held at
+ * once, and allocations per solve.
+ * BM_ParseItemsFile parses BM_ParseItems' input from a temporary file,
+ * opened and mapped with cli_input_open every iteration.
+ *
+ * bench/compare_baseline.py checks a run against bench/baseline.json (the
+ * bench_compare target) and prints the thread-scaling curves of the
+ * *Parallel, Batch and Executor fixtures.
  */
 
 #include "knapsack/knapsack.h"
 
+extern "C" {
+#include "cli_internal.h"
+}
+
+#include <atomic>
 #include <benchmark/benchmark.h>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
 #include <random>
+#include <string>
+#include <unistd.h>
 #include <vector>
 
 namespace {
 
-enum class Pattern { Dense, Sparse, TooHeavy, ExactFit };
+enum class Pattern {
+  Dense,
+  Sparse,
+  TooHeavy,
+  ExactFit,
+  Wide,
+  Correlated,
+  StronglyCorrelated,
+  SubsetSum
+};
 
 std::vector<knapsack_item_t> MakeItems(size_t count, int capacity, Pattern pattern, unsigned seed) {
   std::mt19937 rng(seed);
@@ -62,10 +172,49 @@ std::vector<knapsack_item_t> MakeItems(size_t count, int capacity, Pattern patte
     }
     break;
   }
+  case Pattern::Wide: {
+    std::uniform_int_distribution<int> w(1, std::max(1, capacity / 4));
+    std::uniform_int_distribution<int> v(1, 1000);
+    for (size_t i = 0; i < count; ++i) {
+      items.push_back({w(rng), v(rng)});
+    }
+    break;
+  }
+  case Pattern::Correlated:
+  case Pattern::StronglyCorrelated:
+  case Pattern::SubsetSum: {
+    // Pisinger's classes: weights in [1, range], with range set so that the
+    // items weigh about twice the capacity, and values tied to the weights.
+    const long long spread = 4LL * capacity / static_cast<long long>(count);
+    const int range = static_cast<int>(std::max(10LL, spread));
+    std::uniform_int_distribution<int> w(1, range);
+    std::uniform_int_distribution<int> noise(-range / 10, range / 10);
+    for (size_t i = 0; i < count; ++i) {
+      const int weight = w(rng);
+      int value = weight;
+      if (pattern == Pattern::Correlated) {
+        value = std::max(1, weight + noise(rng));
+      } else if (pattern == Pattern::StronglyCorrelated) {
+        value = weight + range / 10;
+      }
+      items.push_back({weight, value});
+    }
+    break;
+  }
   }
   return items;
 }
 
+void ReportCounters(benchmark::State &state, size_t count, int capacity, size_t solve_failures) {
+  state.counters["solve_failures"] = static_cast<double>(solve_failures);
+  state.counters["dp_cells"] =
+      benchmark::Counter(static_cast<double>(count) * (static_cast<double>(capacity) + 1.0),
+                         benchmark::Counter::kAvgIterations);
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(count));
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(count) *
+                          static_cast<int64_t>(sizeof(knapsack_item_t)));
+}
+
 void RunSolveLoop(benchmark::State &state, Pattern pattern) {
   const auto count = static_cast<size_t>(state.range(0));
   const int capacity = static_cast<int>(state.range(1));
@@ -83,19 +232,1027 @@ void RunSolveLoop(benchmark::State &state, Pattern pattern) {
       ++solve_failures;
     }
   }
+  ReportCounters(state, count, capacity, solve_failures);
+}
+
+void RunWarmSolveLoop(benchmark::State &state, Pattern pattern) {
+  const auto count = static_cast<size_t>(state.range(0));
+  const int capacity = static_cast<int>(state.range(1));
+  const auto items = MakeItems(count, capacity, pattern, 1234U);
+
+  knapsack_workspace_t *ws = knapsack_workspace_create(nullptr);
+  if (ws == nullptr || knapsack_workspace_reserve(ws, count, capacity) != KNAPSACK_OK) {
+    knapsack_workspace_destroy(ws);
+    state.SkipWithError("workspace reservation failed");
+    return;
+  }
+
+  size_t solve_failures = 0;
+  for (auto _ : state) {
+    knapsack_result_t result;
+    const knapsack_status_t status =
+        knapsack_workspace_solve(ws, items.data(), items.size(), capacity, &result);
+    benchmark::DoNotOptimize(result.optimal_value);
+    if (status == KNAPSACK_OK) {
+      knapsack_result_free(&result);
+    } else {
+      ++solve_failures;
+    }
+  }
+  knapsack_workspace_destroy(ws);
+  ReportCounters(state, count, capacity, solve_failures);
+}
+
+void RunOptionsSolveLoop(benchmark::State &state, Pattern pattern, knapsack_reconstruct_t mode,
+                         knapsack_engine_t engine = KNAPSACK_ENGINE_AUTO) {
+  const auto count = static_cast<size_t>(state.range(0));
+  const int capacity = static_cast<int>(state.range(1));
+  const auto items = MakeItems(count, capacity, pattern, 1234U);
+
+  knapsack_options_t options;
+  knapsack_options_init(&options);
+  options.reconstruct = mode;
+  options.engine = engine;
+  options.limits.max_items = count;
+  options.limits.max_capacity = capacity;
+
+  size_t solve_failures = 0;
+  for (auto _ : state) {
+    knapsack_result_t result;
+    const knapsack_status_t status =
+        knapsack_solve_opts(items.data(), items.size(), capacity, &options, &result);
+    benchmark::DoNotOptimize(result.optimal_value);
+    if (status == KNAPSACK_OK) {
+      knapsack_result_free(&result);
+    } else {
+      ++solve_failures;
+    }
+  }
+  ReportCounters(state, count, capacity, solve_failures);
+}
+
+// RunOptionsSolveLoop on KNAPSACK_ENGINE_TILED with range(2) capacity cells
+// per block (0: knapsack_tile_cells()), or on KNAPSACK_ENGINE_DENSE for a
+// range(2) of -1; the label gives the block used.
+void RunTiledSolveLoop(benchmark::State &state, Pattern pattern, knapsack_reconstruct_t mode) {
+  const auto count = static_cast<size_t>(state.range(0));
+  const int capacity = static_cast<int>(state.range(1));
+  const auto items = MakeItems(count, capacity, pattern, 1234U);
+  const bool untiled = state.range(2) < 0;
+
+  knapsack_options_t options;
+  knapsack_options_init(&options);
+  options.reconstruct = mode;
+  options.engine = untiled ? KNAPSACK_ENGINE_DENSE : KNAPSACK_ENGINE_TILED;
+  options.tile_cells = untiled ? 0U : static_cast<size_t>(state.range(2));
+  options.limits.max_items = count;
+  options.limits.max_capacity = capacity;
+
+  size_t solve_failures = 0;
+  for (auto _ : state) {
+    knapsack_result_t result;
+    const knapsack_status_t status =
+        knapsack_solve_opts(items.data(), items.size(), capacity, &options, &result);
+    benchmark::DoNotOptimize(result.optimal_value);
+    if (status == KNAPSACK_OK) {
+      knapsack_result_free(&result);
+    } else {
+      ++solve_failures;
+    }
+  }
+  ReportCounters(state, count, capacity, solve_failures);
+  const size_t block = options.tile_cells != 0U ? options.tile_cells : knapsack_tile_cells();
+  state.SetLabel(untiled ? "untiled" : "tile=" + std::to_string(block));
+}
+
+// RunSolveLoop with a knapsack_stats_t requested on every solve. The
+// counters average what the solver reported; the label names the engine and
+// kernel of the last solve.
+void RunStatsSolveLoop(benchmark::State &state, Pattern pattern,
+                       knapsack_engine_t engine = KNAPSACK_ENGINE_AUTO) {
+  const auto count = static_cast<size_t>(state.range(0));
+  const int capacity = static_cast<int>(state.range(1));
+  const auto items = MakeItems(count, capacity, pattern, 1234U);
+
+  knapsack_stats_t stats{};
+  knapsack_options_t options;
+  knapsack_options_init(&options);
+  options.stats = &stats;
+  options.engine = engine;
+
+  size_t solve_failures = 0;
+  double cells = 0.0;
+  double cells_taken = 0.0;
+  double validate_ns = 0.0;
+  double dp_ns = 0.0;
+  double select_ns = 0.0;
+  double reconstruct_ns = 0.0;
+  for (auto _ : state) {
+    knapsack_result_t result;
+    const knapsack_status_t status =
+        knapsack_solve_opts(items.data(), items.size(), capacity, &options, &result);
+    benchmark::DoNotOptimize(result.optimal_value);
+    if (status == KNAPSACK_OK) {
+      knapsack_result_free(&result);
+    } else {
+      ++solve_failures;
+    }
+    cells += static_cast<double>(stats.cells);
+    cells_taken += static_cast<double>(stats.cells_taken);
+    validate_ns += static_cast<double>(stats.validate_ns);
+    dp_ns += static_cast<double>(stats.dp_ns);
+    select_ns += static_cast<double>(stats.select_ns);
+    reconstruct_ns += static_cast<double>(stats.reconstruct_ns);
+  }
+  ReportCounters(state, count, capacity, solve_failures);
+  const auto per_solve = [](double total) {
+    return benchmark::Counter(total, benchmark::Counter::kAvgIterations);
+  };
+  state.counters["cells"] = per_solve(cells);
+  state.counters["cells_taken"] = per_solve(cells_taken);
+  state.counters["arena_bytes"] = static_cast<double>(stats.arena_bytes);
+  state.counters["validate_ns"] = per_solve(validate_ns);
+  state.counters["dp_ns"] = per_solve(dp_ns);
+  state.counters["select_ns"] = per_solve(select_ns);
+  state.counters["reconstruct_ns"] = per_solve(reconstruct_ns);
+  state.SetLabel(std::string(knapsack_engine_name(stats.engine)) + "/" +
+                 knapsack_kernel_name(stats.kernel));
+}
+
+void RunParallelSolveLoop(benchmark::State &state, Pattern pattern) {
+  const auto count = static_cast<size_t>(state.range(0));
+  const int capacity = static_cast<int>(state.range(1));
+  const auto threads = static_cast<size_t>(state.range(2));
+  const auto items = MakeItems(count, capacity, pattern, 1234U);
+
+  knapsack_thread_pool_t *pool = knapsack_thread_pool_create(threads, nullptr);
+  if (pool == nullptr) {
+    state.SkipWithError("thread pool creation failed");
+    return;
+  }
+  knapsack_options_t options;
+  knapsack_options_init(&options);
+  options.pool = pool;
+
+  size_t solve_failures = 0;
+  for (auto _ : state) {
+    knapsack_result_t result;
+    const knapsack_status_t status =
+        knapsack_solve_opts(items.data(), items.size(), capacity, &options, &result);
+    benchmark::DoNotOptimize(result.optimal_value);
+    if (status == KNAPSACK_OK) {
+      knapsack_result_free(&result);
+    } else {
+      ++solve_failures;
+    }
+  }
+  knapsack_thread_pool_destroy(pool);
+  ReportCounters(state, count, capacity, solve_failures);
+}
+
+using Clock = std::chrono::steady_clock;
+
+bool PastDeadline(void *user_data) {
+  return Clock::now() >= *static_cast<const Clock::time_point *>(user_data);
+}
+
+void BM_DenseDeadline(benchmark::State &state) {
+  const auto count = static_cast<size_t>(state.range(0));
+  const int capacity = static_cast<int>(state.range(1));
+  const auto budget = std::chrono::microseconds(state.range(2));
+  const auto items = MakeItems(count, capacity, Pattern::Dense, 1234U);
+
+  Clock::time_point deadline;
+  knapsack_options_t options;
+  knapsack_options_init(&options);
+  options.engine = KNAPSACK_ENGINE_DENSE;
+  options.limits.max_items = count;
+  options.limits.max_capacity = capacity;
+  options.cancel = PastDeadline;
+  options.cancel_user_data = &deadline;
+  options.anytime = true;
+
+  size_t solve_failures = 0;
+  size_t exact = 0;
+  for (auto _ : state) {
+    deadline = budget.count() == 0 ? Clock::time_point::max() : Clock::now() + budget;
+    knapsack_result_t result;
+    const knapsack_status_t status =
+        knapsack_solve_opts(items.data(), items.size(), capacity, &options, &result);
+    benchmark::DoNotOptimize(result.optimal_value);
+    if (status == KNAPSACK_OK) {
+      exact += result.optimal_value == result.upper_bound ? 1U : 0U;
+      knapsack_result_free(&result);
+    } else {
+      ++solve_failures;
+    }
+  }
+  state.counters["exact"] = benchmark::Counter(static_cast<double>(exact),
+                                               benchmark::Counter::kAvgIterations);
+  ReportCounters(state, count, capacity, solve_failures);
+}
+
+// The Dense items plus one candidate per iteration, drawn from a second set.
+void BM_SessionWhatIf(benchmark::State &state) {
+  const auto count = static_cast<size_t>(state.range(0));
+  const int capacity = static_cast<int>(state.range(1));
+  const auto items = MakeItems(count - 1, capacity, Pattern::Dense, 1234U);
+  const auto candidates = MakeItems(64, capacity, Pattern::Dense, 4321U);
+  knapsack_session_t *session = knapsack_session_create(nullptr);
+  if (session == nullptr || knapsack_session_set_capacity(session, capacity) != KNAPSACK_OK) {
+    knapsack_session_destroy(session);
+    state.SkipWithError("session setup failed");
+    return;
+  }
+  for (const auto &item : items) {
+    knapsack_session_add_item(session, item);
+  }
+
+  size_t solve_failures = 0;
+  size_t next = 0;
+  for (auto _ : state) {
+    knapsack_result_t result;
+    const knapsack_status_t status =
+        knapsack_session_peek_item(session, candidates[next++ % candidates.size()], &result);
+    benchmark::DoNotOptimize(result.optimal_value);
+    if (status == KNAPSACK_OK) {
+      knapsack_result_free(&result);
+    } else {
+      ++solve_failures;
+    }
+  }
+  knapsack_session_destroy(session);
+  ReportCounters(state, count, capacity, solve_failures);
+}
+
+void BM_ResolveWhatIf(benchmark::State &state) {
+  const auto count = static_cast<size_t>(state.range(0));
+  const int capacity = static_cast<int>(state.range(1));
+  auto items = MakeItems(count - 1, capacity, Pattern::Dense, 1234U);
+  const auto candidates = MakeItems(64, capacity, Pattern::Dense, 4321U);
+  items.push_back(candidates[0]);
+
+  size_t solve_failures = 0;
+  size_t next = 0;
+  for (auto _ : state) {
+    items.back() = candidates[next++ % candidates.size()];
+    knapsack_result_t result;
+    const knapsack_status_t status =
+        knapsack_solve_status(items.data(), items.size(), capacity, &result);
+    benchmark::DoNotOptimize(result.optimal_value);
+    if (status == KNAPSACK_OK) {
+      knapsack_result_free(&result);
+    } else {
+      ++solve_failures;
+    }
+  }
+  ReportCounters(state, count, capacity, solve_failures);
+}
+
+void BM_SessionAppend(benchmark::State &state) {
+  const auto count = static_cast<size_t>(state.range(0));
+  const int capacity = static_cast<int>(state.range(1));
+  const auto items = MakeItems(count, capacity, Pattern::Dense, 1234U);
+
+  size_t solve_failures = 0;
+  for (auto _ : state) {
+    knapsack_session_t *session = knapsack_session_create(nullptr);
+    if (session == nullptr || knapsack_session_reserve(session, count, capacity) != KNAPSACK_OK ||
+        knapsack_session_set_capacity(session, capacity) != KNAPSACK_OK) {
+      ++solve_failures;
+    }
+    for (const auto &item : items) {
+      knapsack_result_t result;
+      if (knapsack_session_add_item(session, item) != KNAPSACK_OK ||
+          knapsack_session_result(session, &result) != KNAPSACK_OK) {
+        ++solve_failures;
+        continue;
+      }
+      benchmark::DoNotOptimize(result.optimal_value);
+      knapsack_result_free(&result);
+    }
+    knapsack_session_destroy(session);
+  }
+  ReportCounters(state, count, capacity, solve_failures);
+}
+
+void BM_ResolveAppend(benchmark::State &state) {
+  const auto count = static_cast<size_t>(state.range(0));
+  const int capacity = static_cast<int>(state.range(1));
+  const auto items = MakeItems(count, capacity, Pattern::Dense, 1234U);
+
+  size_t solve_failures = 0;
+  for (auto _ : state) {
+    for (size_t n = 1; n <= count; ++n) {
+      knapsack_result_t result;
+      if (knapsack_solve_status(items.data(), n, capacity, &result) != KNAPSACK_OK) {
+        ++solve_failures;
+        continue;
+      }
+      benchmark::DoNotOptimize(result.optimal_value);
+      knapsack_result_free(&result);
+    }
+  }
+  ReportCounters(state, count, capacity, solve_failures);
+}
+
+struct BatchSet {
+  std::vector<std::vector<knapsack_item_t>> item_sets;
+  std::vector<knapsack_instance_t> instances;
+};
+
+// 10-50 items, capacity <= 1000, Dense pattern.
+BatchSet MakeBatchSet(size_t instance_count) {
+  std::mt19937 rng(4321U);
+  std::uniform_int_distribution<size_t> count_dist(10, 50);
+  std::uniform_int_distribution<int> capacity_dist(100, 1000);
+  BatchSet set;
+  set.item_sets.reserve(instance_count);
+  for (size_t i = 0; i < instance_count; ++i) {
+    const int capacity = capacity_dist(rng);
+    set.item_sets.push_back(
+        MakeItems(count_dist(rng), capacity, Pattern::Dense, static_cast<unsigned>(i)));
+    set.instances.push_back({set.item_sets.back().data(), set.item_sets.back().size(), capacity});
+  }
+  return set;
+}
+
+void ReportBatchCounters(benchmark::State &state, const BatchSet &set, size_t solve_failures) {
   state.counters["solve_failures"] = static_cast<double>(solve_failures);
-  state.counters["dp_cells"] =
-      benchmark::Counter(static_cast<double>(count) * (static_cast<double>(capacity) + 1.0),
-                         benchmark::Counter::kAvgIterations);
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) *
+                          static_cast<int64_t>(set.instances.size()));
+}
+
+void BM_Batch(benchmark::State &state) {
+  const BatchSet set = MakeBatchSet(static_cast<size_t>(state.range(0)));
+  knapsack_thread_pool_t *pool =
+      knapsack_thread_pool_create(static_cast<size_t>(state.range(1)), nullptr);
+  if (pool == nullptr) {
+    state.SkipWithError("thread pool creation failed");
+    return;
+  }
+  knapsack_options_t options;
+  knapsack_options_init(&options);
+  options.pool = pool;
+  std::vector<knapsack_result_t> results(set.instances.size());
+  std::vector<knapsack_status_t> statuses(set.instances.size());
+
+  size_t solve_failures = 0;
+  for (auto _ : state) {
+    knapsack_solve_batch(set.instances.data(), set.instances.size(), &options, results.data(),
+                         statuses.data());
+    for (size_t i = 0; i < results.size(); ++i) {
+      benchmark::DoNotOptimize(results[i].optimal_value);
+      if (statuses[i] == KNAPSACK_OK) {
+        knapsack_result_free(&results[i]);
+      } else {
+        ++solve_failures;
+      }
+    }
+  }
+  knapsack_thread_pool_destroy(pool);
+  ReportBatchCounters(state, set, solve_failures);
+}
+
+void BM_BatchLoop(benchmark::State &state) {
+  const BatchSet set = MakeBatchSet(static_cast<size_t>(state.range(0)));
+  size_t solve_failures = 0;
+  for (auto _ : state) {
+    for (const knapsack_instance_t &instance : set.instances) {
+      knapsack_result_t result;
+      const knapsack_status_t status =
+          knapsack_solve_status(instance.items, instance.count, instance.capacity, &result);
+      benchmark::DoNotOptimize(result.optimal_value);
+      if (status == KNAPSACK_OK) {
+        knapsack_result_free(&result);
+      } else {
+        ++solve_failures;
+      }
+    }
+  }
+  ReportBatchCounters(state, set, solve_failures);
+}
+
+void BM_BatchGpu(benchmark::State &state) {
+  const BatchSet set = MakeBatchSet(static_cast<size_t>(state.range(0)));
+  knapsack_options_t options;
+  knapsack_options_init(&options);
+  options.device = KNAPSACK_DEVICE_GPU;
+  std::vector<knapsack_result_t> results(set.instances.size());
+  std::vector<knapsack_status_t> statuses(set.instances.size());
+
+  size_t solve_failures = 0;
+  for (auto _ : state) {
+    knapsack_solve_batch(set.instances.data(), set.instances.size(), &options, results.data(),
+                         statuses.data());
+    for (size_t i = 0; i < results.size(); ++i) {
+      benchmark::DoNotOptimize(results[i].optimal_value);
+      if (statuses[i] == KNAPSACK_OK) {
+        knapsack_result_free(&results[i]);
+      } else {
+        ++solve_failures;
+      }
+    }
+  }
+  state.SetLabel(knapsack_gpu_available() ? "gpu" : "cpu fallback");
+  ReportBatchCounters(state, set, solve_failures);
+}
+
+// Completions counted on the workers. The benchmark thread sleeps until they
+// reach the submitted count: spinning would take the CPU from the workers.
+struct ExecutorTally {
+  std::mutex lock;
+  std::condition_variable all_done;
+  size_t done = 0;
+  size_t awaited = SIZE_MAX;
+  std::atomic<size_t> failures{0};
+};
+
+void CountCompletion(knapsack_status_t status, knapsack_result_t *result, void *user_data) {
+  auto *tally = static_cast<ExecutorTally *>(user_data);
+  benchmark::DoNotOptimize(result->optimal_value);
+  knapsack_result_free(result);
+  if (status != KNAPSACK_OK) {
+    tally->failures.fetch_add(1, std::memory_order_relaxed);
+  }
+  const std::lock_guard<std::mutex> hold(tally->lock);
+  if (++tally->done == tally->awaited) {
+    tally->all_done.notify_one();
+  }
+}
+
+void BM_Executor(benchmark::State &state) {
+  const BatchSet set = MakeBatchSet(static_cast<size_t>(state.range(0)));
+  knapsack_executor_config_t config;
+  knapsack_executor_config_init(&config);
+  config.threads = static_cast<size_t>(state.range(1));
+  config.queue_capacity = set.instances.size();
+  knapsack_executor_t *executor = knapsack_executor_create(&config);
+  if (executor == nullptr) {
+    state.SkipWithError("executor creation failed");
+    return;
+  }
+
+  ExecutorTally tally;
+  size_t submitted = 0;
+  for (auto _ : state) {
+    for (const knapsack_instance_t &instance : set.instances) {
+      if (knapsack_executor_submit(executor, instance.items, instance.count, instance.capacity,
+                                   nullptr, KNAPSACK_PRIORITY_NORMAL, CountCompletion, &tally,
+                                   nullptr) == KNAPSACK_OK) {
+        ++submitted;
+      } else {
+        tally.failures.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+    std::unique_lock<std::mutex> hold(tally.lock);
+    tally.awaited = submitted;
+    tally.all_done.wait(hold, [&tally] { return tally.done == tally.awaited; });
+  }
+  knapsack_executor_destroy(executor);
+  ReportBatchCounters(state, set, tally.failures.load());
+}
+
+std::vector<knapsack_bounded_item_t> MakeBoundedItems(size_t count, int capacity, unsigned seed) {
+  std::mt19937 rng(seed);
+  std::uniform_int_distribution<int> w(1, std::max(1, capacity / 50));
+  std::uniform_int_distribution<int> v(1, 1000);
+  std::uniform_int_distribution<int> copies(1, 100);
+  std::vector<knapsack_bounded_item_t> items;
+  items.reserve(count);
+  for (size_t i = 0; i < count; ++i) {
+    items.push_back({w(rng), v(rng), copies(rng)});
+  }
+  return items;
+}
+
+void BM_Bounded(benchmark::State &state) {
+  const auto count = static_cast<size_t>(state.range(0));
+  const int capacity = static_cast<int>(state.range(1));
+  const auto items = MakeBoundedItems(count, capacity, 1234U);
+  knapsack_options_t options;
+  knapsack_options_init(&options);
+  options.reconstruct = KNAPSACK_RECONSTRUCT_NONE;
+  size_t solve_failures = 0;
+  for (auto _ : state) {
+    knapsack_bounded_result_t result;
+    const knapsack_status_t status =
+        knapsack_solve_bounded(items.data(), items.size(), capacity, &options, &result);
+    benchmark::DoNotOptimize(result.optimal_value);
+    if (status == KNAPSACK_OK) {
+      knapsack_bounded_result_free_ex(&result, nullptr);
+    } else {
+      ++solve_failures;
+    }
+  }
+  state.counters["solve_failures"] = static_cast<double>(solve_failures);
+}
+
+void BM_BoundedExpanded(benchmark::State &state) {
+  const auto count = static_cast<size_t>(state.range(0));
+  const int capacity = static_cast<int>(state.range(1));
+  std::vector<knapsack_item_t> items;
+  for (const knapsack_bounded_item_t &item : MakeBoundedItems(count, capacity, 1234U)) {
+    for (int k = 0; k < std::min(item.count, capacity / item.weight); ++k) {
+      items.push_back({item.weight, item.value});
+    }
+  }
+  knapsack_options_t options;
+  knapsack_options_init(&options);
+  options.reconstruct = KNAPSACK_RECONSTRUCT_NONE;
+  options.limits.max_items = std::max(options.limits.max_items, items.size());
+  size_t solve_failures = 0;
+  for (auto _ : state) {
+    knapsack_result_t result;
+    const knapsack_status_t status =
+        knapsack_solve_opts(items.data(), items.size(), capacity, &options, &result);
+    benchmark::DoNotOptimize(result.optimal_value);
+    if (status == KNAPSACK_OK) {
+      knapsack_result_free(&result);
+    } else {
+      ++solve_failures;
+    }
+  }
+  state.counters["solve_failures"] = static_cast<double>(solve_failures);
+  state.counters["rows"] = static_cast<double>(items.size());
+}
+
+void BM_DenseTopK(benchmark::State &state) {
+  const auto count = static_cast<size_t>(state.range(0));
+  const int capacity = static_cast<int>(state.range(1));
+  const auto k = static_cast<size_t>(state.range(2));
+  const auto items = MakeItems(count, capacity, Pattern::Dense, 1234U);
+  std::vector<knapsack_result_t> results(k);
+  size_t solve_failures = 0;
+  for (auto _ : state) {
+    size_t found = 0;
+    const knapsack_status_t status = knapsack_solve_top_k(items.data(), items.size(), capacity, k,
+                                                          nullptr, results.data(), &found);
+    benchmark::DoNotOptimize(results[0].optimal_value);
+    if (status != KNAPSACK_OK) {
+      ++solve_failures;
+    }
+    for (size_t rank = 0; rank < found; ++rank) {
+      knapsack_result_free(&results[rank]);
+    }
+  }
+  ReportCounters(state, count, capacity, solve_failures);
+}
+
+void BM_DenseTopKResolve(benchmark::State &state) {
+  const auto count = static_cast<size_t>(state.range(0));
+  const int capacity = static_cast<int>(state.range(1));
+  const auto k = static_cast<size_t>(state.range(2));
+  const auto items = MakeItems(count, capacity, Pattern::Dense, 1234U);
+  size_t solve_failures = 0;
+  for (auto _ : state) {
+    knapsack_result_t best;
+    if (knapsack_solve_status(items.data(), items.size(), capacity, &best) != KNAPSACK_OK) {
+      ++solve_failures;
+      continue;
+    }
+    for (size_t n = 0; n + 1U < k && n < best.selected_count; ++n) {
+      std::vector<knapsack_item_t> rest = items;
+      rest.erase(rest.begin() + static_cast<std::ptrdiff_t>(best.selected_indices[n]));
+      knapsack_result_t result;
+      if (knapsack_solve_status(rest.data(), rest.size(), capacity, &result) == KNAPSACK_OK) {
+        benchmark::DoNotOptimize(result.optimal_value);
+        knapsack_result_free(&result);
+      } else {
+        ++solve_failures;
+      }
+    }
+    knapsack_result_free(&best);
+  }
+  ReportCounters(state, count, capacity, solve_failures);
+}
+
+void BM_Dense64(benchmark::State &state) {
+  const auto count = static_cast<size_t>(state.range(0));
+  const int capacity = static_cast<int>(state.range(1));
+  std::vector<knapsack_item64_t> items;
+  for (const knapsack_item_t &item : MakeItems(count, capacity, Pattern::Dense, 1234U)) {
+    items.push_back({item.weight, static_cast<int64_t>(item.value) << 32});
+  }
+  size_t solve_failures = 0;
+  for (auto _ : state) {
+    knapsack_result64_t result;
+    if (knapsack_solve64(items.data(), items.size(), capacity, nullptr, &result) == KNAPSACK_OK) {
+      benchmark::DoNotOptimize(result.optimal_value);
+      knapsack_result64_free_ex(&result, nullptr);
+    } else {
+      ++solve_failures;
+    }
+  }
+  ReportCounters(state, count, capacity, solve_failures);
+}
+
+// Dense-like items with a capacity in each of dims dimensions: the first
+// dimension's weight as in Pattern::Dense, the others within +-50% of it,
+// scaled to their capacity.
+std::vector<knapsack_multi_item_t> MakeMultiItems(size_t count, const std::vector<int> &capacities,
+                                                  unsigned seed) {
+  std::mt19937 rng(seed);
+  std::uniform_int_distribution<int> w(1, std::max(1, capacities[0] / 20));
+  std::uniform_real_distribution<double> spread(0.5, 1.5);
+  std::uniform_int_distribution<int> v(1, 1000);
+  std::vector<knapsack_multi_item_t> items(count);
+  for (knapsack_multi_item_t &item : items) {
+    item = {{0, 0, 0, 0}, v(rng)};
+    item.weights[0] = w(rng);
+    for (size_t d = 1; d < capacities.size(); ++d) {
+      const double scaled = item.weights[0] * spread(rng) * capacities[d] / capacities[0];
+      item.weights[d] = std::max(1, static_cast<int>(scaled));
+    }
+  }
+  return items;
+}
+
+void RunMultiSolveLoop(benchmark::State &state, const std::vector<int> &capacities) {
+  const auto count = static_cast<size_t>(state.range(0));
+  const auto items = MakeMultiItems(count, capacities, 1234U);
+  size_t solve_failures = 0;
+  size_t pruned = 0;
+  for (auto _ : state) {
+    knapsack_multi_result_t result;
+    if (knapsack_solve_multi(items.data(), items.size(), capacities.size(), capacities.data(),
+                             nullptr, &result) == KNAPSACK_OK) {
+      benchmark::DoNotOptimize(result.optimal_value);
+      pruned = result.pruned_count;
+      knapsack_multi_result_free_ex(&result, nullptr);
+    } else {
+      ++solve_failures;
+    }
+  }
+  double cells = 1.0;
+  for (int capacity : capacities) {
+    cells *= static_cast<double>(capacity) + 1.0;
+  }
+  state.counters["solve_failures"] = static_cast<double>(solve_failures);
+  state.counters["pruned"] = static_cast<double>(pruned);
+  state.counters["dp_cells"] = static_cast<double>(count) * cells;
   state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(count));
-  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(count) *
-                          static_cast<int64_t>(sizeof(knapsack_item_t)));
+}
+
+void BM_Multi2D(benchmark::State &state) {
+  RunMultiSolveLoop(state, {static_cast<int>(state.range(1)), static_cast<int>(state.range(2))});
+}
+
+void BM_Multi3D(benchmark::State &state) {
+  const auto capacity = static_cast<int>(state.range(1));
+  RunMultiSolveLoop(state, {capacity, capacity, capacity});
+}
+
+void BM_CacheHit(benchmark::State &state) {
+  const auto count = static_cast<size_t>(state.range(0));
+  const int capacity = static_cast<int>(state.range(1));
+  const auto items = MakeItems(count, capacity, Pattern::Dense, 1234U);
+  knapsack_cache_t *cache = knapsack_cache_create(64U, nullptr);
+  size_t solve_failures = 0;
+  for (auto _ : state) {
+    knapsack_result_t result;
+    if (knapsack_cache_solve(cache, items.data(), items.size(), capacity, nullptr, &result) ==
+        KNAPSACK_OK) {
+      benchmark::DoNotOptimize(result.optimal_value);
+      knapsack_result_free(&result);
+    } else {
+      ++solve_failures;
+    }
+  }
+  knapsack_cache_stats_t stats;
+  knapsack_cache_get_stats(cache, &stats);
+  state.counters["hits"] = static_cast<double>(stats.hits);
+  knapsack_cache_destroy(cache);
+  ReportCounters(state, count, capacity, solve_failures);
+}
+
+void BM_CacheMiss(benchmark::State &state) {
+  const auto count = static_cast<size_t>(state.range(0));
+  const int capacity = static_cast<int>(state.range(1));
+  std::vector<std::vector<knapsack_item_t>> instances;
+  for (unsigned seed = 0; seed < 65U; ++seed) {
+    instances.push_back(MakeItems(count, capacity, Pattern::Dense, 1234U + seed));
+  }
+  knapsack_cache_t *cache = knapsack_cache_create(64U, nullptr);
+  size_t solve_failures = 0;
+  size_t next = 0;
+  for (auto _ : state) {
+    const auto &items = instances[next];
+    next = (next + 1U) % instances.size();
+    knapsack_result_t result;
+    if (knapsack_cache_solve(cache, items.data(), items.size(), capacity, nullptr, &result) ==
+        KNAPSACK_OK) {
+      benchmark::DoNotOptimize(result.optimal_value);
+      knapsack_result_free(&result);
+    } else {
+      ++solve_failures;
+    }
+  }
+  knapsack_cache_stats_t stats;
+  knapsack_cache_get_stats(cache, &stats);
+  state.counters["hits"] = static_cast<double>(stats.hits);
+  knapsack_cache_destroy(cache);
+  ReportCounters(state, count, capacity, solve_failures);
+}
+
+// Allocator that tracks the bytes live at once. Each block carries its size
+// in a max_align_t header, so alignment is the same as malloc's.
+struct PeakAllocator {
+  size_t live;
+  size_t peak;
+  size_t allocations;
+};
+
+constexpr size_t kPeakHeader = sizeof(std::max_align_t);
+
+void *PeakAlloc(size_t size, void *user_data) {
+  auto *peak = static_cast<PeakAllocator *>(user_data);
+  if (size > SIZE_MAX - kPeakHeader) {
+    return nullptr;
+  }
+  auto *block = static_cast<unsigned char *>(std::malloc(kPeakHeader + size));
+  if (block == nullptr) {
+    return nullptr;
+  }
+  std::memcpy(block, &size, sizeof(size));
+  peak->live += size;
+  peak->peak = std::max(peak->peak, peak->live);
+  ++peak->allocations;
+  return block + kPeakHeader;
+}
+
+void *PeakCalloc(size_t nmemb, size_t size, void *user_data) {
+  if (size != 0U && nmemb > SIZE_MAX / size) {
+    return nullptr;
+  }
+  void *ptr = PeakAlloc(nmemb * size, user_data);
+  if (ptr != nullptr) {
+    std::memset(ptr, 0, nmemb * size);
+  }
+  return ptr;
+}
+
+void PeakFree(void *ptr, void *user_data) {
+  if (ptr == nullptr) {
+    return;
+  }
+  unsigned char *block = static_cast<unsigned char *>(ptr) - kPeakHeader;
+  size_t size = 0U;
+  std::memcpy(&size, block, sizeof(size));
+  static_cast<PeakAllocator *>(user_data)->live -= size;
+  std::free(block);
+}
+
+// One-shot solves in the reconstruction mode range(2) (0 bitset, 1
+// Hirschberg, 2 value only) through a PeakAllocator: peak_bytes is the most
+// memory a solve held at once, result included.
+void RunPeakMemoryLoop(benchmark::State &state, Pattern pattern) {
+  const auto count = static_cast<size_t>(state.range(0));
+  const int capacity = static_cast<int>(state.range(1));
+  const knapsack_reconstruct_t modes[] = {KNAPSACK_RECONSTRUCT_BITSET,
+                                          KNAPSACK_RECONSTRUCT_HIRSCHBERG,
+                                          KNAPSACK_RECONSTRUCT_NONE};
+  const char *const names[] = {"bitset", "hirschberg", "value_only"};
+  const auto mode = static_cast<size_t>(state.range(2));
+  const auto items = MakeItems(count, capacity, pattern, 1234U);
+
+  PeakAllocator peak{0U, 0U, 0U};
+  knapsack_allocator_t alloc = {PeakAlloc, PeakCalloc, PeakFree, &peak};
+  knapsack_options_t options;
+  knapsack_options_init(&options);
+  options.allocator = &alloc;
+  options.reconstruct = modes[mode];
+
+  size_t solve_failures = 0;
+  for (auto _ : state) {
+    knapsack_result_t result;
+    const knapsack_status_t status =
+        knapsack_solve_opts(items.data(), items.size(), capacity, &options, &result);
+    benchmark::DoNotOptimize(result.optimal_value);
+    if (status == KNAPSACK_OK) {
+      knapsack_result_free_ex(&result, &alloc);
+    } else {
+      ++solve_failures;
+    }
+  }
+  ReportCounters(state, count, capacity, solve_failures);
+  state.counters["peak_bytes"] = static_cast<double>(peak.peak);
+  state.counters["allocations"] =
+      benchmark::Counter(static_cast<double>(peak.allocations), benchmark::Counter::kAvgIterations);
+  state.SetLabel(names[mode]);
 }
 
 void BM_Dense(benchmark::State &state) { RunSolveLoop(state, Pattern::Dense); }
 void BM_Sparse(benchmark::State &state) { RunSolveLoop(state, Pattern::Sparse); }
 void BM_TooHeavy(benchmark::State &state) { RunSolveLoop(state, Pattern::TooHeavy); }
 void BM_ExactFit(benchmark::State &state) { RunSolveLoop(state, Pattern::ExactFit); }
+void BM_DenseWarm(benchmark::State &state) { RunWarmSolveLoop(state, Pattern::Dense); }
+void BM_SparseWarm(benchmark::State &state) { RunWarmSolveLoop(state, Pattern::Sparse); }
+void BM_TooHeavyWarm(benchmark::State &state) { RunWarmSolveLoop(state, Pattern::TooHeavy); }
+void BM_ExactFitWarm(benchmark::State &state) { RunWarmSolveLoop(state, Pattern::ExactFit); }
+void BM_DenseHirschberg(benchmark::State &state) {
+  RunOptionsSolveLoop(state, Pattern::Dense, KNAPSACK_RECONSTRUCT_HIRSCHBERG);
+}
+void BM_DenseValueOnly(benchmark::State &state) {
+  RunOptionsSolveLoop(state, Pattern::Dense, KNAPSACK_RECONSTRUCT_NONE);
+}
+void BM_DenseTiled(benchmark::State &state) {
+  RunTiledSolveLoop(state, Pattern::Dense, KNAPSACK_RECONSTRUCT_BITSET);
+}
+void BM_DenseTiledValueOnly(benchmark::State &state) {
+  RunTiledSolveLoop(state, Pattern::Dense, KNAPSACK_RECONSTRUCT_NONE);
+}
+void BM_Wide(benchmark::State &state) { RunSolveLoop(state, Pattern::Wide); }
+void BM_DenseStats(benchmark::State &state) { RunStatsSolveLoop(state, Pattern::Dense); }
+void BM_WideStats(benchmark::State &state) { RunStatsSolveLoop(state, Pattern::Wide); }
+void BM_SparseDenseStats(benchmark::State &state) {
+  RunStatsSolveLoop(state, Pattern::Sparse, KNAPSACK_ENGINE_DENSE);
+}
+void BM_WideDense(benchmark::State &state) {
+  RunOptionsSolveLoop(state, Pattern::Wide, KNAPSACK_RECONSTRUCT_BITSET, KNAPSACK_ENGINE_DENSE);
+}
+void BM_DenseBranchBound(benchmark::State &state) {
+  RunOptionsSolveLoop(state, Pattern::Dense, KNAPSACK_RECONSTRUCT_BITSET,
+                      KNAPSACK_ENGINE_BRANCH_BOUND);
+}
+void BM_SparseBranchBound(benchmark::State &state) {
+  RunOptionsSolveLoop(state, Pattern::Sparse, KNAPSACK_RECONSTRUCT_BITSET,
+                      KNAPSACK_ENGINE_BRANCH_BOUND);
+}
+void BM_ExactFitBranchBound(benchmark::State &state) {
+  RunOptionsSolveLoop(state, Pattern::ExactFit, KNAPSACK_RECONSTRUCT_BITSET,
+                      KNAPSACK_ENGINE_BRANCH_BOUND);
+}
+void BM_Correlated(benchmark::State &state) { RunSolveLoop(state, Pattern::Correlated); }
+void BM_StronglyCorrelated(benchmark::State &state) {
+  RunSolveLoop(state, Pattern::StronglyCorrelated);
+}
+void BM_SubsetSum(benchmark::State &state) { RunSolveLoop(state, Pattern::SubsetSum); }
+void BM_CorrelatedWarm(benchmark::State &state) { RunWarmSolveLoop(state, Pattern::Correlated); }
+void BM_StronglyCorrelatedWarm(benchmark::State &state) {
+  RunWarmSolveLoop(state, Pattern::StronglyCorrelated);
+}
+void BM_SubsetSumWarm(benchmark::State &state) { RunWarmSolveLoop(state, Pattern::SubsetSum); }
+void BM_CorrelatedValueOnly(benchmark::State &state) {
+  RunOptionsSolveLoop(state, Pattern::Correlated, KNAPSACK_RECONSTRUCT_NONE);
+}
+void BM_StronglyCorrelatedValueOnly(benchmark::State &state) {
+  RunOptionsSolveLoop(state, Pattern::StronglyCorrelated, KNAPSACK_RECONSTRUCT_NONE);
+}
+void BM_SubsetSumValueOnly(benchmark::State &state) {
+  RunOptionsSolveLoop(state, Pattern::SubsetSum, KNAPSACK_RECONSTRUCT_NONE);
+}
+void BM_DensePeakMemory(benchmark::State &state) { RunPeakMemoryLoop(state, Pattern::Dense); }
+void BM_WidePeakMemory(benchmark::State &state) { RunPeakMemoryLoop(state, Pattern::Wide); }
+void BM_DenseParallel(benchmark::State &state) { RunParallelSolveLoop(state, Pattern::Dense); }
+void BM_ExactFitParallel(benchmark::State &state) { RunParallelSolveLoop(state, Pattern::ExactFit); }
+
+// Dense/warm with the DP kernel forced via the third argument (a
+// knapsack_kernel_t); kernels this CPU lacks are skipped.
+void BM_DenseWarmKernel(benchmark::State &state) {
+  const auto kernel = static_cast<knapsack_kernel_t>(state.range(2));
+  if (knapsack_set_kernel(kernel) != KNAPSACK_OK) {
+    state.SkipWithError("kernel not supported on this CPU");
+    return;
+  }
+  state.SetLabel(knapsack_kernel_name(kernel));
+  RunWarmSolveLoop(state, Pattern::Dense);
+  knapsack_set_kernel(KNAPSACK_KERNEL_AUTO);
+}
+
+// The CLI's items-line parser over a generated line of range(0) tokens
+// (weights up to 4 digits, values up to 6), the input already in memory.
+void BM_ParseItems(benchmark::State &state) {
+  const auto count = static_cast<size_t>(state.range(0));
+  std::mt19937 rng(11U);
+  std::uniform_int_distribution<int> weight(1, 9999);
+  std::uniform_int_distribution<int> value(0, 999999);
+  std::string input = "1000\n";
+  for (size_t i = 0; i < count; ++i) {
+    input += std::to_string(weight(rng)) + ":" + std::to_string(value(rng)) + " ";
+  }
+  input += "\n";
+  for (auto _ : state) {
+    int capacity = 0;
+    knapsack_item_t *items = nullptr;
+    size_t parsed = 0;
+    if (cli_parse_buffer(input.data(), input.size(), &capacity, &items, &parsed) != 0) {
+      state.SkipWithError("parse failed");
+      return;
+    }
+    benchmark::DoNotOptimize(items);
+    std::free(items);
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                          static_cast<int64_t>(input.size()));
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) *
+                          static_cast<int64_t>(count));
+}
+
+// BM_ParseItems' input read from a file the way the demo reads one: opened
+// (mapped) with cli_input_open and parsed in place, every iteration.
+void BM_ParseItemsFile(benchmark::State &state) {
+  const auto count = static_cast<size_t>(state.range(0));
+  std::mt19937 rng(11U);
+  std::uniform_int_distribution<int> weight(1, 9999);
+  std::uniform_int_distribution<int> value(0, 999999);
+  std::string input = "1000\n";
+  for (size_t i = 0; i < count; ++i) {
+    input += std::to_string(weight(rng)) + ":" + std::to_string(value(rng)) + " ";
+  }
+  input += "\n";
+  char path[] = "/tmp/bench_knapsack_XXXXXX";
+  const int fd = mkstemp(path);
+  if (fd < 0 || write(fd, input.data(), input.size()) != static_cast<ssize_t>(input.size())) {
+    if (fd >= 0) {
+      close(fd);
+      unlink(path);
+    }
+    state.SkipWithError("could not write the input file");
+    return;
+  }
+  close(fd);
+  for (auto _ : state) {
+    cli_input_t file{};
+    int capacity = 0;
+    knapsack_item_t *items = nullptr;
+    size_t parsed = 0;
+    if (cli_input_open(path, &file) != 0 ||
+        cli_parse_buffer(file.data, file.length, &capacity, &items, &parsed) != 0) {
+      cli_input_close(&file);
+      state.SkipWithError("parse failed");
+      break;
+    }
+    benchmark::DoNotOptimize(items);
+    std::free(items);
+    cli_input_close(&file);
+  }
+  unlink(path);
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                          static_cast<int64_t>(input.size()));
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) *
+                          static_cast<int64_t>(count));
+}
+
+// The same instances as BM_ParseItems in the binary columnar format, decoded
+// with knapsack_binary_load_instance into a preallocated array.
+void BM_LoadBinary(benchmark::State &state) {
+  const auto count = static_cast<size_t>(state.range(0));
+  std::mt19937 rng(11U);
+  std::uniform_int_distribution<int> weight(1, 9999);
+  std::uniform_int_distribution<int> value(0, 999999);
+  std::vector<knapsack_item_t> items(count);
+  for (auto &item : items) {
+    item.weight = weight(rng);
+    item.value = value(rng);
+  }
+  std::vector<unsigned char> bytes(knapsack_binary_instance_size(count));
+  if (knapsack_binary_save_instance(items.data(), count, 1000, bytes.data(), bytes.size(),
+                                    nullptr) != KNAPSACK_OK) {
+    state.SkipWithError("save failed");
+    return;
+  }
+  for (auto _ : state) {
+    if (knapsack_binary_load_instance(bytes.data(), bytes.size(), items.data(), count) !=
+        KNAPSACK_OK) {
+      state.SkipWithError("load failed");
+      return;
+    }
+    benchmark::DoNotOptimize(items.data());
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                          static_cast<int64_t>(bytes.size()));
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) *
+                          static_cast<int64_t>(count));
+}
+
+// A result whose indices spread over several digit counts, as JSON.
+void BM_WriteResultJson(benchmark::State &state) {
+  const auto count = static_cast<size_t>(state.range(0));
+  std::vector<size_t> indices(count);
+  for (size_t i = 0; i < count; ++i) {
+    indices[i] = i * 7U + 3U;
+  }
+  knapsack_result_t result{};
+  result.optimal_value = 123456789;
+  result.selected_indices = indices.data();
+  result.selected_count = count;
+  knapsack_writer_t writer;
+  knapsack_writer_init_growable(&writer, nullptr);
+  for (auto _ : state) {
+    writer.length = 0U;
+    if (knapsack_json_write_result(&writer, &result) != KNAPSACK_OK) {
+      state.SkipWithError("write failed");
+      break;
+    }
+    benchmark::DoNotOptimize(writer.data);
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                          static_cast<int64_t>(writer.length));
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) *
+                          static_cast<int64_t>(count));
+  knapsack_writer_release(&writer);
+}
 
 } // namespace
 
@@ -106,5 +1263,64 @@ BENCHMARK(BM_Dense)->KNAPSACK_BENCH_ARGS();
 BENCHMARK(BM_Sparse)->KNAPSACK_BENCH_ARGS();
 BENCHMARK(BM_TooHeavy)->KNAPSACK_BENCH_ARGS();
 BENCHMARK(BM_ExactFit)->KNAPSACK_BENCH_ARGS();
+BENCHMARK(BM_DenseWarm)->KNAPSACK_BENCH_ARGS();
+BENCHMARK(BM_SparseWarm)->KNAPSACK_BENCH_ARGS();
+BENCHMARK(BM_TooHeavyWarm)->KNAPSACK_BENCH_ARGS();
+BENCHMARK(BM_ExactFitWarm)->KNAPSACK_BENCH_ARGS();
+BENCHMARK(BM_DenseHirschberg)->KNAPSACK_BENCH_ARGS()->Args({1000, 1000000});
+BENCHMARK(BM_DenseValueOnly)->KNAPSACK_BENCH_ARGS()->Args({1000, 1000000});
+BENCHMARK(BM_DenseTiled)->ArgsProduct({{100}, {10000, 100000}, {-1, 0, 4096, 16384, 65536}});
+BENCHMARK(BM_DenseTiledValueOnly)->ArgsProduct({{100, 1000}, {1000000}, {-1, 0, 16384}});
+BENCHMARK(BM_Wide)->ArgsProduct({{10, 20, 30, 100}, {100000}});
+BENCHMARK(BM_WideDense)->ArgsProduct({{10, 20, 30, 100}, {100000}});
+BENCHMARK(BM_DenseStats)->KNAPSACK_BENCH_ARGS();
+BENCHMARK(BM_WideStats)->ArgsProduct({{10, 20, 30, 100}, {100000}});
+BENCHMARK(BM_SparseDenseStats)->KNAPSACK_BENCH_ARGS();
+BENCHMARK(BM_DenseBranchBound)->KNAPSACK_BENCH_ARGS()->Args({1000, 50000000});
+BENCHMARK(BM_SparseBranchBound)->KNAPSACK_BENCH_ARGS()->Args({1000, 50000000});
+BENCHMARK(BM_ExactFitBranchBound)->KNAPSACK_BENCH_ARGS()->Args({1000, 50000000});
+BENCHMARK(BM_Correlated)->KNAPSACK_BENCH_ARGS();
+BENCHMARK(BM_StronglyCorrelated)->KNAPSACK_BENCH_ARGS();
+BENCHMARK(BM_SubsetSum)->KNAPSACK_BENCH_ARGS();
+BENCHMARK(BM_CorrelatedWarm)->KNAPSACK_BENCH_ARGS();
+BENCHMARK(BM_StronglyCorrelatedWarm)->KNAPSACK_BENCH_ARGS();
+BENCHMARK(BM_SubsetSumWarm)->KNAPSACK_BENCH_ARGS();
+BENCHMARK(BM_CorrelatedValueOnly)->KNAPSACK_BENCH_ARGS();
+BENCHMARK(BM_StronglyCorrelatedValueOnly)->KNAPSACK_BENCH_ARGS();
+BENCHMARK(BM_SubsetSumValueOnly)->KNAPSACK_BENCH_ARGS();
+BENCHMARK(BM_DensePeakMemory)->ArgsProduct({{100}, {10000, 100000}, {0, 1, 2}});
+BENCHMARK(BM_WidePeakMemory)->ArgsProduct({{30, 100}, {100000}, {0, 1, 2}});
+BENCHMARK(BM_DenseParallel)
+    ->ArgsProduct({{100}, {100000}, {1, 2, 4, 8, 16, 32}})
+    ->UseRealTime();
+BENCHMARK(BM_ExactFitParallel)
+    ->ArgsProduct({{100}, {100000}, {1, 2, 4, 8, 16, 32}})
+    ->UseRealTime();
+BENCHMARK(BM_DenseDeadline)->ArgsProduct({{100}, {100000}, {0, 1000, 5000}});
+BENCHMARK(BM_SessionWhatIf)->Args({50, 1000})->Args({100, 10000})->Args({100, 100000});
+BENCHMARK(BM_ResolveWhatIf)->Args({50, 1000})->Args({100, 10000})->Args({100, 100000});
+BENCHMARK(BM_SessionAppend)->Args({50, 1000})->Args({100, 10000});
+BENCHMARK(BM_ResolveAppend)->Args({50, 1000})->Args({100, 10000});
+BENCHMARK(BM_Batch)->ArgsProduct({{1000}, {1, 2, 4, 8}})->UseRealTime();
+BENCHMARK(BM_BatchLoop)->Arg(1000);
+BENCHMARK(BM_BatchGpu)->Arg(1000)->Arg(10000)->UseRealTime();
+BENCHMARK(BM_Executor)->ArgsProduct({{1000}, {1, 2, 4, 8}})->UseRealTime();
+BENCHMARK(BM_Bounded)->Args({20, 10000})->Args({100, 100000});
+BENCHMARK(BM_BoundedExpanded)->Args({20, 10000})->Args({100, 100000});
+BENCHMARK(BM_DenseTopK)->ArgsProduct({{100}, {10000}, {1, 4, 16}});
+BENCHMARK(BM_DenseTopKResolve)->ArgsProduct({{100}, {10000}, {1, 4, 16}});
+BENCHMARK(BM_Dense64)->KNAPSACK_BENCH_ARGS();
+BENCHMARK(BM_Multi2D)->Args({50, 500, 500})->Args({100, 1000, 1000})->Args({100, 1000, 2000});
+BENCHMARK(BM_Multi3D)->Args({50, 60})->Args({100, 120});
+BENCHMARK(BM_CacheHit)->KNAPSACK_BENCH_ARGS();
+BENCHMARK(BM_CacheMiss)->KNAPSACK_BENCH_ARGS();
+BENCHMARK(BM_ParseItems)->Arg(100)->Arg(10000)->Arg(1000000);
+BENCHMARK(BM_ParseItemsFile)->Arg(10000)->Arg(1000000);
+BENCHMARK(BM_LoadBinary)->Arg(100)->Arg(10000)->Arg(1000000);
+BENCHMARK(BM_WriteResultJson)->Arg(10)->Arg(1000)->Arg(100000);
+BENCHMARK(BM_DenseWarmKernel)
+    ->ArgsProduct({{100}, {10000, 100000},
+                   {KNAPSACK_KERNEL_SCALAR, KNAPSACK_KERNEL_SSE41, KNAPSACK_KERNEL_AVX2,
+                    KNAPSACK_KERNEL_AVX512, KNAPSACK_KERNEL_NEON}});
 
 BENCHMARK_MAIN();
@@ -0,0 +1,158 @@
+#!/usr/bin/env python3
+"""Check a bench_knapsack run against the stored baseline.
+
+Both files are google/benchmark JSON output (--benchmark_out_format=json).
+Benchmarks are matched by run name; with --benchmark_repetitions the median
+aggregate is compared, otherwise the single run. The exit status is 1 when
+any benchmark is slower than its baseline by more than --threshold (a
+fraction: 0.10 allows 10%), 0 otherwise. Benchmarks only one file has are
+listed but never fail the check.
+
+The thread-scaling curves of the current run are printed too: for the
+fixtures in SCALING, each thread count's time relative to one thread.
+
+A missing baseline is an error (exit status 2), never recorded from the
+run being checked: record one explicitly with the bench_baseline target.
+Runs of a benchmark library built in debug mode, or of differently built
+libraries, are refused (exit status 2): their times say nothing about an
+optimized build.
+
+Only the standard library is used, so the script runs wherever CMake found
+a Python 3 interpreter.
+"""
+
+import argparse
+import json
+import os
+import sys
+
+# Fixture -> position of the thread count among its arguments.
+SCALING = {
+    "BM_DenseParallel": 2,
+    "BM_ExactFitParallel": 2,
+    "BM_Batch": 1,
+    "BM_Executor": 1,
+}
+
+TO_NS = {"ns": 1.0, "us": 1e3, "ms": 1e6, "s": 1e9}
+
+
+def load(path, metric):
+    """(context, map run name -> time in nanoseconds)."""
+    with open(path, encoding="utf-8") as f:
+        data = json.load(f)
+    times = {}
+    medians = set()
+    for entry in data.get("benchmarks", []):
+        if entry.get("error_occurred"):
+            continue
+        name = entry.get("run_name", entry["name"])
+        is_median = entry.get("run_type") == "aggregate"
+        if is_median and entry.get("aggregate_name") != "median":
+            continue
+        if name in medians and not is_median:
+            continue
+        times[name] = entry[metric] * TO_NS[entry.get("time_unit", "ns")]
+        if is_median:
+            medians.add(name)
+    return data.get("context", {}), times
+
+
+def check_contexts(baseline, current):
+    """Reason the two runs cannot be compared, or None. Warns about CPU counts."""
+    for label, context in (("baseline", baseline), ("current run", current)):
+        if context.get("library_build_type") == "debug":
+            return f"the {label} used a debug build of the benchmark library"
+    if baseline.get("library_build_type") != current.get("library_build_type"):
+        return "the runs used differently built benchmark libraries"
+    if baseline.get("num_cpus") != current.get("num_cpus"):
+        print(f"warning: baseline recorded on {baseline.get('num_cpus')} CPUs, "
+              f"this run on {current.get('num_cpus')}; thread-scaling entries will not compare\n")
+    return None
+
+
+def format_ns(ns):
+    for unit, scale in (("s", 1e9), ("ms", 1e6), ("us", 1e3)):
+        if ns >= scale:
+            return f"{ns / scale:.3f} {unit}"
+    return f"{ns:.1f} ns"
+
+
+def compare(baseline, current, threshold):
+    regressions = []
+    width = max((len(name) for name in current), default=4)
+    print(f"{'benchmark':<{width}}  {'baseline':>12}  {'current':>12}  change")
+    for name in sorted(set(baseline) | set(current)):
+        if name not in current:
+            print(f"{name:<{width}}  {format_ns(baseline[name]):>12}  {'-':>12}  (not run)")
+            continue
+        if name not in baseline:
+            print(f"{name:<{width}}  {'-':>12}  {format_ns(current[name]):>12}  (new)")
+            continue
+        change = current[name] / baseline[name] - 1.0
+        flag = ""
+        if change > threshold:
+            flag = "  REGRESSION"
+            regressions.append(name)
+        print(
+            f"{name:<{width}}  {format_ns(baseline[name]):>12}  "
+            f"{format_ns(current[name]):>12}  {change:+7.1%}{flag}"
+        )
+    return regressions
+
+
+def print_scaling(current):
+    curves = {}
+    for name, ns in current.items():
+        parts = name.split("/")
+        position = SCALING.get(parts[0])
+        args = [part for part in parts[1:] if part.isdigit()]
+        if position is None or position >= len(args):
+            continue
+        threads = int(args[position])
+        key = "/".join([parts[0]] + args[:position] + args[position + 1:])
+        curves.setdefault(key, {})[threads] = ns
+    if not curves:
+        return
+    print("\nthread scaling (speedup over 1 thread, efficiency):")
+    for key in sorted(curves):
+        curve = curves[key]
+        if 1 not in curve:
+            continue
+        points = ", ".join(
+            f"{threads}: {curve[1] / curve[threads]:.2f}x {curve[1] / curve[threads] / threads:.0%}"
+            for threads in sorted(curve)
+        )
+        print(f"  {key}  {points}")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("baseline", help="stored baseline JSON")
+    parser.add_argument("current", help="JSON of the run to check")
+    parser.add_argument("--threshold", type=float, default=0.10,
+                        help="tolerated slowdown as a fraction (default 0.10)")
+    parser.add_argument("--metric", choices=("real_time", "cpu_time"), default="real_time")
+    args = parser.parse_args()
+
+    if not os.path.exists(args.baseline):
+        print(f"no baseline at {args.baseline}: record one on this machine with "
+              "`cmake --build --preset bench --target bench_baseline`")
+        return 2
+    baseline_context, baseline = load(args.baseline, args.metric)
+    current_context, current = load(args.current, args.metric)
+    problem = check_contexts(baseline_context, current_context)
+    if problem:
+        print(f"cannot compare: {problem}; re-record the baseline with the bench preset")
+        return 2
+    regressions = compare(baseline, current, args.threshold)
+    print_scaling(current)
+    if regressions:
+        print(f"\n{len(regressions)} benchmark(s) slower than the baseline by more than "
+              f"{args.threshold:.0%}: {', '.join(regressions)}")
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
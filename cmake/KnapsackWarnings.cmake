@@ -37,7 +37,8 @@ function(knapsack_apply_sanitizers target)
     return()
   endif()
   set(_san_flags -fsanitize=address,undefined -fno-omit-frame-pointer -g -O1)
-  target_compile_options(${target} PRIVATE ${_san_flags})
+  # Host compiler flags: the CUDA sources of ENABLE_GPU are left alone.
+  target_compile_options(${target} PRIVATE "$<$<COMPILE_LANGUAGE:C,CXX>:${_san_flags}>")
   target_link_options(${target} PRIVATE ${_san_flags})
 endfunction()
 
@@ -46,7 +47,7 @@ function(knapsack_apply_coverage target)
   if(NOT ENABLE_COVERAGE)
     return()
   endif()
-  target_compile_options(${target} PRIVATE --coverage -O0 -g)
+  target_compile_options(${target} PRIVATE "$<$<COMPILE_LANGUAGE:C,CXX>:--coverage;-O0;-g>")
   target_link_options(${target} PRIVATE --coverage)
 endfunction()
 
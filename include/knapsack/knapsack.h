@@ -1,8 +1,10 @@
 #ifndef KNAPSACK_KNAPSACK_H
 #define KNAPSACK_KNAPSACK_H
 
+#include <limits.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -18,7 +20,9 @@ extern "C" {
  *  - Tie-break: among solutions with the optimal value, the one with the
  *    smallest total weight is returned. Selected indices are reported in
  *    ascending order.
- *  - Complexity: O(count * (capacity+1)) time and memory.
+ *  - Complexity: O(count * (capacity+1)) time and memory. The Hirschberg
+ *    reconstruction mode of knapsack_solve_opts needs only O(capacity + count)
+ *    memory, which lets callers raise these limits via knapsack_limits_t.
  */
 
 /** Library version. */
@@ -43,6 +47,12 @@ typedef struct {
   int optimal_value;
   size_t selected_count;
   size_t *selected_indices;
+  int total_weight; /**< total weight of the optimal selection (the tie-break key). */
+  /** Upper bound on the optimal value. Equals optimal_value for an exact
+   *  answer; may exceed it for an anytime answer to a cancelled solve (see
+   *  knapsack_options_t.anytime). Saturates at INT_MAX.
+   */
+  int upper_bound;
 } knapsack_result_t;
 
 /** Status / error codes returned by the solver.
@@ -54,12 +64,25 @@ typedef enum { /* NOLINT(performance-enum-size) -- ABI: keep int-sized. */
                KNAPSACK_ERR_NULL_RESULT,    /**< out_result was NULL. */
                KNAPSACK_ERR_INVALID_ITEMS,  /**< null pointer, zero count, zero/negative weight, or
                                                negative value. */
-               KNAPSACK_ERR_TOO_MANY_ITEMS, /**< count exceeds KNAPSACK_MAX_ITEMS. */
-               KNAPSACK_ERR_INVALID_CAPACITY,   /**< capacity negative or exceeds
-                                                   KNAPSACK_MAX_CAPACITY. */
+               KNAPSACK_ERR_TOO_MANY_ITEMS, /**< count exceeds the item limit
+                                               (KNAPSACK_MAX_ITEMS by default). */
+               KNAPSACK_ERR_INVALID_CAPACITY,   /**< capacity negative or exceeds the capacity
+                                                   limit (KNAPSACK_MAX_CAPACITY by default). */
                KNAPSACK_ERR_DIMENSION_OVERFLOW, /**< would overflow internal buffers. */
                KNAPSACK_ERR_INT_OVERFLOW,       /**< value accumulation overflows int. */
-               KNAPSACK_ERR_ALLOC               /**< allocation failed. */
+               KNAPSACK_ERR_ALLOC,              /**< allocation failed. */
+               KNAPSACK_ERR_INVALID_ARGUMENT,   /**< a required handle was NULL or an option
+                                                   was out of range. */
+               KNAPSACK_ERR_CANCELLED,          /**< the cancellation callback stopped the
+                                                   solve (see knapsack_options_t.cancel). */
+               KNAPSACK_ERR_INVALID_FORMAT,     /**< binary data is truncated, has the wrong
+                                                   magic or an unsupported version. */
+               KNAPSACK_ERR_IO,                 /**< a writer's output callback failed (see
+                                                   knapsack_writer_t). */
+               KNAPSACK_ERR_QUEUE_FULL,         /**< an executor's queue had no room for the
+                                                   job (see knapsack_executor_submit). */
+               KNAPSACK_ERR_LIMIT               /**< the solve would need more memory than
+                                                   its budget (see KNAPSACK_TOP_K_MAX_BYTES). */
 } knapsack_status_t;
 
 /** Pluggable allocator for testing and embedding.
@@ -88,6 +111,13 @@ knapsack_status_t knapsack_solve_status(const knapsack_item_t *items, size_t cou
                                         knapsack_result_t *out_result);
 
 /** Same as knapsack_solve_status but with an injectable allocator.
+ *
+ *  Like every solve entry point it uses KNAPSACK_ENGINE_AUTO: the
+ *  instance goes to the sparse engine when that engine's arena is bounded
+ *  well below the dense one. The bound comes from count, capacity and the
+ *  prefix weight sums. Otherwise the sparse engine is tried first inside the
+ *  dense arena, within a fixed state budget, and the dense DP takes over if
+ *  the frontier outgrows it. Both engines give identical results.
  *
  *  @param items     See knapsack_solve_status.
  *  @param count     See knapsack_solve_status.
@@ -113,6 +143,1196 @@ void knapsack_result_free(knapsack_result_t *result);
 /** Variant of knapsack_result_free that frees with a custom allocator. */
 void knapsack_result_free_ex(knapsack_result_t *result, const knapsack_allocator_t *allocator);
 
+/** Opaque, reusable solver workspace.
+ *
+ *  Holds the DP rows and the decision bitset between solves so that repeated
+ *  calls do not pay for a fresh allocation each time. Buffers only grow: a
+ *  solve whose dimensions fit the current reservation makes no workspace
+ *  allocator calls. A workspace is not thread-safe; use one per thread.
+ */
+typedef struct knapsack_workspace knapsack_workspace_t;
+
+/** Create an empty workspace.
+ *
+ *  @param allocator Custom allocator, or NULL to use malloc/calloc/free. The
+ *                   workspace keeps the pointer; the allocator must outlive
+ *                   it. Results produced by the workspace are owned by this
+ *                   allocator (release via knapsack_result_free_ex).
+ *  @return A new workspace, or NULL if allocation failed.
+ */
+knapsack_workspace_t *knapsack_workspace_create(const knapsack_allocator_t *allocator);
+
+/** Grow the workspace so a later solve of (count, capacity) allocates nothing.
+ *
+ *  @param workspace Workspace created by knapsack_workspace_create.
+ *  @param count     Number of items (1 .. KNAPSACK_MAX_ITEMS).
+ *  @param capacity  Knapsack capacity (0 .. KNAPSACK_MAX_CAPACITY).
+ *  @return KNAPSACK_OK on success, KNAPSACK_ERR_ALLOC if growth failed (the
+ *          workspace is then empty but still valid), KNAPSACK_ERR_INVALID_ARGUMENT
+ *          if @p workspace is NULL, or a validation error.
+ */
+knapsack_status_t knapsack_workspace_reserve(knapsack_workspace_t *workspace, size_t count,
+                                             int capacity);
+
+/** Solve using (and growing, if needed) the buffers held by @p workspace.
+ *
+ *  Parameters and result contract match knapsack_solve_status_ex, with the
+ *  workspace's allocator standing in for the allocator argument.
+ *  @return KNAPSACK_OK on success, KNAPSACK_ERR_INVALID_ARGUMENT if
+ *          @p workspace is NULL, otherwise a specific error code.
+ */
+knapsack_status_t knapsack_workspace_solve(knapsack_workspace_t *workspace,
+                                           const knapsack_item_t *items, size_t count, int capacity,
+                                           knapsack_result_t *out_result);
+
+/** Release a workspace and all buffers it holds. Safe to call with NULL. */
+void knapsack_workspace_destroy(knapsack_workspace_t *workspace);
+
+/** Bytes a caller-supplied buffer needs for knapsack_solve_with_buffer.
+ *
+ *  The size covers every DP row, the decision bitset, room for @p count
+ *  result indices and for a preprocessed copy of the items, and slack for
+ *  cache-line alignment, so any buffer of at least this size works
+ *  regardless of its own alignment.
+ *
+ *  @return The required size, or 0 if (count, capacity) is outside the
+ *          solver's limits.
+ */
+size_t knapsack_workspace_size(size_t count, int capacity);
+
+/** Solve inside a caller-supplied buffer, making no allocator calls at all.
+ *
+ *  @param items       See knapsack_solve_status.
+ *  @param count       See knapsack_solve_status.
+ *  @param capacity    See knapsack_solve_status.
+ *  @param buffer      Scratch memory of at least knapsack_workspace_size(count,
+ *                     capacity) bytes. Any alignment is accepted.
+ *  @param buffer_size Size of @p buffer in bytes.
+ *  @param out_result  Result destination. On success selected_indices points
+ *                     into @p buffer: it stays valid until the buffer is
+ *                     reused or released, and must NOT be passed to
+ *                     knapsack_result_free. On failure, it is zeroed.
+ *  @return KNAPSACK_OK on success, KNAPSACK_ERR_INVALID_ARGUMENT if @p buffer
+ *          is NULL or too small, otherwise a specific error code.
+ */
+knapsack_status_t knapsack_solve_with_buffer(const knapsack_item_t *items, size_t count,
+                                             int capacity, void *buffer, size_t buffer_size,
+                                             knapsack_result_t *out_result);
+
+/** Opaque persistent worker pool for multithreaded solves.
+ *
+ *  The threads are started once and sleep between solves, so passing the
+ *  same pool to many knapsack_solve_opts calls pays no thread start-up cost.
+ *  Solves that share a pool are serialized on it.
+ */
+typedef struct knapsack_thread_pool knapsack_thread_pool_t;
+
+/** Start a pool.
+ *
+ *  @param threads   Total worker count, including the thread that calls the
+ *                   solver; 0 uses the number of online CPUs.
+ *  @param allocator Custom allocator, or NULL to use malloc/calloc/free. Kept
+ *                   by the pool; it must outlive it.
+ *  @return A new pool, or NULL if allocation or thread creation failed.
+ */
+knapsack_thread_pool_t *knapsack_thread_pool_create(size_t threads,
+                                                    const knapsack_allocator_t *allocator);
+
+/** Worker count of @p pool (including the caller), or 0 for NULL. */
+size_t knapsack_thread_pool_size(const knapsack_thread_pool_t *pool);
+
+/** Stop and join the workers and release the pool. Safe to call with NULL. */
+void knapsack_thread_pool_destroy(knapsack_thread_pool_t *pool);
+
+/** Default knapsack_options_t.parallel_min_width: rows narrower than this are
+ *  cheaper to fill on one core than to split and synchronize per item.
+ */
+#define KNAPSACK_PARALLEL_MIN_WIDTH 32768U
+
+/** How the selected items are recovered after the DP. */
+typedef enum { /* NOLINT(performance-enum-size) -- ABI: keep int-sized. */
+               KNAPSACK_RECONSTRUCT_BITSET = 0, /**< keep a decision bitset of up to
+                                                   count*(capacity+1) bits, each item's row
+                                                   starting at its weight, and walk it back
+                                                   (fastest). */
+               KNAPSACK_RECONSTRUCT_HIRSCHBERG, /**< divide and conquer: recompute half-problems
+                                                   instead of storing decisions. O(capacity +
+                                                   count) memory, roughly twice the DP work. */
+               KNAPSACK_RECONSTRUCT_NONE        /**< value only: optimal_value and total_weight,
+                                                   no decision bitset, no reconstruction pass and
+                                                   no selected_indices. O(capacity) memory. */
+} knapsack_reconstruct_t;
+
+/** DP engine behind KNAPSACK_RECONSTRUCT_BITSET and KNAPSACK_RECONSTRUCT_NONE. */
+typedef enum { /* NOLINT(performance-enum-size) -- ABI: keep int-sized. */
+               KNAPSACK_ENGINE_AUTO = 0, /**< pick per instance (see knapsack_solve_status_ex). */
+               KNAPSACK_ENGINE_DENSE,    /**< capacity-indexed rows: O(count * capacity). */
+               KNAPSACK_ENGINE_SPARSE,   /**< Pareto frontiers of (weight, value) states; cost
+                                            grows with the number of non-dominated states, not
+                                            with the capacity. */
+               KNAPSACK_ENGINE_BRANCH_BOUND, /**< depth-first search over ratio-sorted items with
+                                                Martello-Toth bounds; O(count) memory, any
+                                                capacity, exponential time in the worst case. */
+               KNAPSACK_ENGINE_TILED /**< the dense DP over weight-sorted items, a tile of
+                                        them per cache-sized block of capacity cells (see
+                                        knapsack_options_t.tile_cells). */
+} knapsack_engine_t;
+
+/** Where knapsack_solve_batch runs its instances. */
+typedef enum { /* NOLINT(performance-enum-size) -- ABI: keep int-sized. */
+               KNAPSACK_DEVICE_CPU = 0, /**< the CPU engines (on options->pool, if set). */
+               KNAPSACK_DEVICE_GPU /**< the CUDA backend where the build has it and a device
+                                      is present (see knapsack_gpu_available), the CPU
+                                      otherwise. */
+} knapsack_device_t;
+
+/** Cancellation callback: return true to stop the solve.
+ *
+ *  Polled between units of work -- item rows of the dense DP, frontier
+ *  layers, search nodes -- roughly once per KNAPSACK_CANCEL_POLL_CELLS cells
+ *  or states, so the latency to honour a request is bounded by that much
+ *  work. Suited to deadlines: compare a clock against a budget in
+ *  @p user_data. Once it has returned true it is not called again for the
+ *  same solve.
+ */
+typedef bool (*knapsack_cancel_fn)(void *user_data);
+
+/** Work between two calls of a knapsack_cancel_fn. */
+#define KNAPSACK_CANCEL_POLL_CELLS 65536U
+
+/** Instance-size limits enforced by knapsack_solve_opts. */
+typedef struct {
+  size_t max_items; /**< largest accepted item count (>= 1). */
+  int max_capacity; /**< largest accepted capacity (>= 0). */
+} knapsack_limits_t;
+
+/** Solve statistics (defined with the kernels below). */
+typedef struct knapsack_stats knapsack_stats_t;
+
+/** Solver options. Always initialize with knapsack_options_init before
+ *  setting fields, so that fields added in later versions get their defaults.
+ */
+typedef struct {
+  const knapsack_allocator_t *allocator; /**< NULL for malloc/calloc/free. */
+  knapsack_reconstruct_t reconstruct;    /**< default KNAPSACK_RECONSTRUCT_BITSET. */
+  /** Defaults to KNAPSACK_MAX_ITEMS / KNAPSACK_MAX_CAPACITY. Lower limits are
+   *  honoured in every mode; raising them above the defaults is only
+   *  accepted with KNAPSACK_RECONSTRUCT_HIRSCHBERG, KNAPSACK_RECONSTRUCT_NONE,
+   *  KNAPSACK_ENGINE_SPARSE or KNAPSACK_ENGINE_BRANCH_BOUND, whose memory
+   *  does not grow with count * capacity.
+   */
+  knapsack_limits_t limits;
+  /** Pool to split each item's row update across (capacity-partitioned DP
+   *  with a barrier per item), or to spread instances over in
+   *  knapsack_solve_batch. NULL (the default) solves on the calling thread.
+   *  Row splitting is used by KNAPSACK_RECONSTRUCT_BITSET and
+   *  KNAPSACK_RECONSTRUCT_NONE.
+   */
+  knapsack_thread_pool_t *pool;
+  /** Smallest row width (capacity + 1) that is solved in parallel when a
+   *  pool is set; default KNAPSACK_PARALLEL_MIN_WIDTH.
+   */
+  size_t parallel_min_width;
+  /** Default KNAPSACK_ENGINE_AUTO, which never picks branch and bound or
+   *  the tiled engine. KNAPSACK_ENGINE_SPARSE, KNAPSACK_ENGINE_BRANCH_BOUND
+   *  and KNAPSACK_ENGINE_TILED cannot be combined with
+   *  KNAPSACK_RECONSTRUCT_HIRSCHBERG. The sparse engine's memory is bounded
+   *  by the frontier sizes, at most 2^i states after i items. Branch and
+   *  bound and the tiled engine return the same optimal value and total
+   *  weight as the DP; if several selections tie on both, their indices may
+   *  differ. The tiled engine runs on the calling thread (pool is not used)
+   *  and, having sorted the items by weight, completes an anytime answer in
+   *  that order.
+   */
+  knapsack_engine_t engine;
+  /** Polled during the solve; NULL (the default) never cancels. In
+   *  knapsack_solve_batch the callback is shared by every instance and, with
+   *  a pool, may run on several workers at once. Sessions do not poll it.
+   */
+  knapsack_cancel_fn cancel;
+  void *cancel_user_data; /**< passed to cancel. */
+  /** What a cancelled solve returns. false (the default): the status
+   *  KNAPSACK_ERR_CANCELLED and a zeroed result. true: KNAPSACK_OK with the
+   *  best feasible answer at hand -- the exact optimum over the items
+   *  processed so far, completed first-fit with the remaining items in index
+   *  order (branch and bound: its incumbent; Hirschberg: first-fit over all
+   *  items) -- and upper_bound set to a
+   *  bound on the full optimum. optimal_value == upper_bound then proves the
+   *  answer optimal; total_weight may not be the minimal one.
+   */
+  bool anytime;
+  /** Filled for each solve when non-NULL; NULL (the default) collects
+   *  nothing. Timings use CLOCK_MONOTONIC and cost a few clock reads per
+   *  solve; counting cells_taken is one pass over the decision bitset.
+   *  Ignored by knapsack_solve_batch, whose instances would race for it.
+   */
+  knapsack_stats_t *stats;
+  /** Default KNAPSACK_DEVICE_CPU. Only knapsack_solve_batch looks at it;
+   *  single solves always run on the CPU.
+   */
+  knapsack_device_t device;
+  /** Capacity cells per block for KNAPSACK_ENGINE_TILED and
+   *  knapsack_solve_multi; 0 (the default) uses knapsack_tile_cells(). Each
+   *  tile is a run of weight-sorted items whose weights add up to at most
+   *  this many cells; an item heavier than that updates the whole row on
+   *  its own, as the dense engine does.
+   */
+  size_t tile_cells;
+} knapsack_options_t;
+
+/** Fill @p options with the defaults (same behaviour as knapsack_solve_status). */
+void knapsack_options_init(knapsack_options_t *options);
+
+/** Solve with explicit options.
+ *
+ *  @param items      See knapsack_solve_status.
+ *  @param count      Number of items (1 .. options->limits.max_items).
+ *  @param capacity   Knapsack capacity (0 .. options->limits.max_capacity).
+ *  @param options    Options from knapsack_options_init, or NULL for defaults.
+ *  @param out_result See knapsack_solve_status_ex; memory is owned by
+ *                    options->allocator. Both reconstruction modes return
+ *                    the same optimal value and the same (minimal) total
+ *                    weight; when several selections tie on both, they may
+ *                    report different indices.
+ *  @return KNAPSACK_OK on success, KNAPSACK_ERR_INVALID_ARGUMENT if @p options
+ *          is malformed (unknown mode, zero item limit, negative capacity
+ *          limit, or limits above the defaults in bitset mode), otherwise a
+ *          specific error code.
+ */
+knapsack_status_t knapsack_solve_opts(const knapsack_item_t *items, size_t count, int capacity,
+                                      const knapsack_options_t *options,
+                                      knapsack_result_t *out_result);
+
+/** knapsack_solve_opts inside a reusable workspace.
+ *
+ *  Every option applies except the allocator: the workspace's allocator owns
+ *  its buffers and the result (release via knapsack_result_free_ex with it).
+ *  Long-running callers that solve one instance after another keep their
+ *  buffers warm this way.
+ *
+ *  @param workspace Workspace created by knapsack_workspace_create.
+ *  @param options   Options from knapsack_options_init, or NULL for defaults.
+ *  @return KNAPSACK_OK on success, KNAPSACK_ERR_NULL_RESULT if @p out_result
+ *          is NULL, KNAPSACK_ERR_INVALID_ARGUMENT if @p workspace is NULL or
+ *          @p options is malformed, otherwise a specific error code.
+ */
+knapsack_status_t knapsack_workspace_solve_opts(knapsack_workspace_t *workspace,
+                                                const knapsack_item_t *items, size_t count,
+                                                int capacity, const knapsack_options_t *options,
+                                                knapsack_result_t *out_result);
+
+/** One instance of a knapsack_solve_batch call. */
+typedef struct {
+  const knapsack_item_t *items;
+  size_t count;
+  int capacity;
+} knapsack_instance_t;
+
+/** Solve many independent instances in one call.
+ *
+ *  With options->pool set, instances are handed out dynamically to the
+ *  pool's workers, each of which keeps one workspace for all the instances
+ *  it solves (each instance is then solved on a single thread; the custom
+ *  allocator, if any, must be thread-safe). Without a pool the batch runs on
+ *  the calling thread, still reusing a single workspace. options->device
+ *  can move the instances to a GPU (see knapsack_gpu_available).
+ *
+ *  @param instances      Array of @p instance_count instances.
+ *  @param instance_count Number of instances; 0 is a no-op.
+ *  @param options        Options from knapsack_options_init, or NULL for
+ *                        defaults. Limits and reconstruction mode apply to
+ *                        every instance.
+ *  @param out_results    Array of @p instance_count results. Entry i is
+ *                        filled exactly as knapsack_solve_opts would; release
+ *                        each successful one via knapsack_result_free_ex with
+ *                        options->allocator.
+ *  @param out_statuses   Array of @p instance_count statuses, one per instance.
+ *  @return KNAPSACK_OK once every instance has been attempted (see
+ *          @p out_statuses), or KNAPSACK_ERR_INVALID_ARGUMENT if an array is
+ *          NULL or @p options is malformed (nothing is written then).
+ */
+knapsack_status_t knapsack_solve_batch(const knapsack_instance_t *instances,
+                                       size_t instance_count, const knapsack_options_t *options,
+                                       knapsack_result_t *out_results,
+                                       knapsack_status_t *out_statuses);
+
+/** Whether knapsack_solve_batch can run instances on a GPU: the library was
+ *  configured with -DENABLE_GPU=ON (experimental) and the CUDA runtime
+ *  reports a device.
+ *
+ *  With options->device set to KNAPSACK_DEVICE_GPU, the batch sends every
+ *  instance the dense engine would solve -- KNAPSACK_ENGINE_AUTO or
+ *  KNAPSACK_ENGINE_DENSE, KNAPSACK_RECONSTRUCT_BITSET or
+ *  KNAPSACK_RECONSTRUCT_NONE, valid inputs -- to the device, one thread
+ *  block per instance. The decision bits stay in device memory; only each
+ *  instance's value, weight and selected indices are copied back. Results
+ *  equal the CPU engines'. Instances the device does not finish (invalid
+ *  ones, other modes, an overflow, a device error, or those left when the
+ *  cancel callback asks to stop between device chunks) are solved on the
+ *  CPU as usual, so every status is the one the CPU path would report.
+ */
+bool knapsack_gpu_available(void);
+
+/** Opaque incremental solver session.
+ *
+ *  A session keeps the DP row and decision bitset of its items between
+ *  calls. Appending an item costs one row update (O(capacity)) instead of a
+ *  full solve. Every cell of the row holds the best selection within that
+ *  cell's capacity, so any capacity up to the one the rows were built for
+ *  is answered without recomputing anything. Raising the capacity beyond
+ *  that rebuilds the rows once, at least doubling their width, so a growing
+ *  capacity triggers only logarithmically many rebuilds. Results equal
+ *  those of knapsack_solve_opts with KNAPSACK_ENGINE_DENSE on the same items
+ *  and capacity, indices included. A session is not thread-safe.
+ *
+ *  Value overflow is checked over the whole width the rows were built for,
+ *  which may exceed the current capacity: a session can report
+ *  KNAPSACK_ERR_INT_OVERFLOW where a one-shot solve at the current capacity
+ *  would not.
+ */
+typedef struct knapsack_session knapsack_session_t;
+
+/** Create an empty session: no items, capacity 0.
+ *
+ *  @param options Options from knapsack_options_init, or NULL for defaults.
+ *                 The allocator, reconstruction mode (BITSET or NONE) and
+ *                 limits are used; the engine must be AUTO or DENSE. The
+ *                 session keeps the allocator pointer, which must outlive it.
+ *  @return A new session, or NULL if @p options is malformed or allocation
+ *          failed.
+ */
+knapsack_session_t *knapsack_session_create(const knapsack_options_t *options);
+
+/** Grow the session so that up to @p count items and any capacity up to
+ *  @p capacity need no further allocation or rebuild.
+ *
+ *  @return KNAPSACK_OK, KNAPSACK_ERR_INVALID_ARGUMENT if @p session is NULL,
+ *          a limit error, KNAPSACK_ERR_ALLOC or KNAPSACK_ERR_INT_OVERFLOW
+ *          (rebuilding at the new width overflowed). On failure the session
+ *          is unchanged.
+ */
+knapsack_status_t knapsack_session_reserve(knapsack_session_t *session, size_t count,
+                                           int capacity);
+
+/** Append one item (it gets index knapsack_session_count at call time).
+ *
+ *  @return KNAPSACK_OK, KNAPSACK_ERR_INVALID_ARGUMENT if @p session is NULL,
+ *          KNAPSACK_ERR_INVALID_ITEMS, KNAPSACK_ERR_TOO_MANY_ITEMS,
+ *          KNAPSACK_ERR_ALLOC or KNAPSACK_ERR_INT_OVERFLOW. On failure the
+ *          item is not added and the session is unchanged.
+ */
+knapsack_status_t knapsack_session_add_item(knapsack_session_t *session, knapsack_item_t item);
+
+/** Change the capacity later results are computed for.
+ *
+ *  @return KNAPSACK_OK, KNAPSACK_ERR_INVALID_ARGUMENT if @p session is NULL,
+ *          KNAPSACK_ERR_INVALID_CAPACITY, or (when the rows have to be rebuilt
+ *          wider) KNAPSACK_ERR_ALLOC or KNAPSACK_ERR_INT_OVERFLOW. On failure
+ *          the session is unchanged.
+ */
+knapsack_status_t knapsack_session_set_capacity(knapsack_session_t *session, int capacity);
+
+/** Number of items appended so far (0 for NULL). */
+size_t knapsack_session_count(const knapsack_session_t *session);
+
+/** Optimal selection of the session's items at its current capacity.
+ *
+ *  @param out_result Receives the result. Release it with
+ *                    knapsack_result_free_ex and the session's allocator. A
+ *                    session without items reports an empty selection.
+ *  @return KNAPSACK_OK, KNAPSACK_ERR_NULL_RESULT, KNAPSACK_ERR_INVALID_ARGUMENT
+ *          if @p session is NULL, or KNAPSACK_ERR_ALLOC.
+ */
+knapsack_status_t knapsack_session_result(const knapsack_session_t *session,
+                                          knapsack_result_t *out_result);
+
+/** The result knapsack_session_result would give after appending @p item,
+ *  without appending it: O(count), the row is not updated. If selected, the
+ *  item is reported with index knapsack_session_count.
+ *
+ *  @return As knapsack_session_result, plus KNAPSACK_ERR_INVALID_ITEMS,
+ *          KNAPSACK_ERR_TOO_MANY_ITEMS and KNAPSACK_ERR_INT_OVERFLOW as
+ *          knapsack_session_add_item would report them at the current
+ *          capacity.
+ */
+knapsack_status_t knapsack_session_peek_item(const knapsack_session_t *session,
+                                             knapsack_item_t item,
+                                             knapsack_result_t *out_result);
+
+/** Release a session and everything it holds. Safe to call with NULL. */
+void knapsack_session_destroy(knapsack_session_t *session);
+
+/** Copy count of an item that may be taken any number of times. Any count
+ *  of at least capacity / weight behaves the same.
+ */
+#define KNAPSACK_UNBOUNDED INT_MAX
+
+/** An item available in several identical copies. */
+typedef struct {
+  int weight;
+  int value;
+  int count; /**< copies available (>= 0), or KNAPSACK_UNBOUNDED. */
+} knapsack_bounded_item_t;
+
+/** Result of knapsack_solve_bounded. selected_indices and quantities are
+ *  allocated by the solver; release them via knapsack_bounded_result_free_ex.
+ */
+typedef struct {
+  int optimal_value;
+  int total_weight;
+  int upper_bound;          /**< as in knapsack_result_t. */
+  size_t selected_count;    /**< items taken at least once. */
+  size_t *selected_indices; /**< those items, ascending. */
+  int *quantities;          /**< copies taken of each, parallel to selected_indices. */
+} knapsack_bounded_result_t;
+
+/** Solve the bounded knapsack problem: item i may be taken up to
+ *  items[i].count times.
+ *
+ *  Each item's count is first clamped to capacity / weight, then split into
+ *  pieces of 1, 2, 4, ... copies and a remainder. The pieces go through the
+ *  0/1 solver as ordinary items -- preprocessing, engine choice, kernels,
+ *  cancellation and statistics included -- and the chosen pieces are summed
+ *  back per item. An item with k copies thus costs O(log k) DP rows instead
+ *  of k. The tie-break is the 0/1 one: maximal value, then minimal total
+ *  weight.
+ *
+ *  @param items      Array of @p count items. Weights must be positive,
+ *                    values and counts non-negative.
+ *  @param count      Number of items (1 .. options->limits.max_items); the
+ *                    pieces are not counted against the limit. In bitset
+ *                    mode the decision bitset has one row per piece.
+ *  @param capacity   Knapsack capacity (0 .. options->limits.max_capacity).
+ *  @param options    Options from knapsack_options_init, or NULL for
+ *                    defaults. With KNAPSACK_RECONSTRUCT_NONE only the value
+ *                    and total weight are reported.
+ *  @param out_result Result destination, zeroed on failure. Memory is owned
+ *                    by options->allocator.
+ *  @return KNAPSACK_OK on success, KNAPSACK_ERR_INT_OVERFLOW if the copies
+ *          of one item that fit are together worth more than INT_MAX, or any
+ *          status knapsack_solve_opts reports.
+ */
+knapsack_status_t knapsack_solve_bounded(const knapsack_bounded_item_t *items, size_t count,
+                                         int capacity, const knapsack_options_t *options,
+                                         knapsack_bounded_result_t *out_result);
+
+/** Release the arrays of a knapsack_bounded_result_t with the allocator
+ *  that produced them (NULL for the default). Safe on a zeroed struct.
+ */
+void knapsack_bounded_result_free_ex(knapsack_bounded_result_t *result,
+                                     const knapsack_allocator_t *allocator);
+
+/** Largest k knapsack_solve_top_k accepts. */
+#define KNAPSACK_MAX_TOP_K 1024U
+
+/** Most memory knapsack_solve_top_k allocates for its table and search,
+ *  128 MiB. The default limits need at most 88 MiB (see there); limits
+ *  raised for KNAPSACK_RECONSTRUCT_NONE can ask for more, and such solves
+ *  fail before allocating.
+ */
+#define KNAPSACK_TOP_K_MAX_BYTES (128U * 1024U * 1024U)
+
+/** Find the k best distinct selections in one DP pass.
+ *
+ *  The dense DP runs once, keeping every row: O(count * (capacity+1)) time
+ *  and 8 bytes per cell. A best-first search over those rows then pops the
+ *  selections in rank order, at most count + 1 steps each, so k adds only
+ *  O(k * count * log(k * count)) time and O(k * count) memory. In all, with
+ *  n the items no heavier than the capacity, one block of
+ *  8 * (n + 1) * (capacity + 1) bytes for the rows, 56 * (1 + 2 * k * n)
+ *  for the search and 16 * n for the items (on 64-bit targets): 81 MB of
+ *  rows at the default limits, plus 11.5 MB of search for k = 1024. A solve
+ *  that would exceed KNAPSACK_TOP_K_MAX_BYTES fails with KNAPSACK_ERR_LIMIT
+ *  before allocating anything. Selections
+ *  are ranked by value (descending), then total weight (ascending); equal
+ *  ones keep a fixed order. Rank 0 is the selection knapsack_solve_opts
+ *  reports with the dense engine.
+ *
+ *  With KNAPSACK_RECONSTRUCT_NONE only values and weights are reported. The
+ *  engine, pool and anytime options do not apply: the solve always runs this
+ *  DP, serially, and a cancelled solve fails. Statistics report the DP cells,
+ *  the kept rows as row_bytes and the search nodes as engine_bytes.
+ *
+ *  @param items       As for knapsack_solve_opts.
+ *  @param count       As for knapsack_solve_opts.
+ *  @param capacity    As for knapsack_solve_opts.
+ *  @param k           Selections wanted, 1 .. KNAPSACK_MAX_TOP_K.
+ *  @param options     Options from knapsack_options_init, or NULL for
+ *                     defaults.
+ *  @param out_results Array of @p k results. The first *out_found receive
+ *                     the selections by rank; the others are zeroed, as is
+ *                     the whole array on failure. Free each with
+ *                     knapsack_result_free_ex and options->allocator.
+ *  @param out_found   Receives the number of selections found: k, or fewer
+ *                     when the instance has fewer feasible selections.
+ *  @return KNAPSACK_OK on success, KNAPSACK_ERR_INVALID_ARGUMENT for a k
+ *          out of range, KNAPSACK_ERR_LIMIT past KNAPSACK_TOP_K_MAX_BYTES,
+ *          or any status knapsack_solve_opts reports.
+ */
+knapsack_status_t knapsack_solve_top_k(const knapsack_item_t *items, size_t count, int capacity,
+                                       size_t k, const knapsack_options_t *options,
+                                       knapsack_result_t *out_results, size_t *out_found);
+
+/** An item whose value needs 64 bits, e.g. an amount in cents. */
+typedef struct {
+  int weight;
+  int64_t value;
+} knapsack_item64_t;
+
+/** Result of knapsack_solve64; release via knapsack_result64_free_ex. */
+typedef struct {
+  int64_t optimal_value;
+  int total_weight;
+  int64_t upper_bound; /**< equals optimal_value: answers are always exact. */
+  size_t selected_count;
+  size_t *selected_indices; /**< ascending. */
+} knapsack_result64_t;
+
+/** Solve an instance with 64-bit values.
+ *
+ *  Runs the dense DP with int64_t value rows through the 64-bit variant of
+ *  the active kernel (AVX2 and AVX-512F have one; other kernel choices run
+ *  the scalar loop). The int32 entry points are unaffected. The tie-break
+ *  and the selection match knapsack_solve_opts with the dense engine
+ *  whenever the values also fit an int. The rows take 12 bytes per
+ *  capacity cell instead of 8.
+ *
+ *  Of the options, limits, allocator, cancel, stats and reconstruct
+ *  (KNAPSACK_RECONSTRUCT_BITSET or _NONE) apply. The solve is always dense
+ *  and serial, and a cancelled solve fails.
+ *
+ *  @param items      Array of @p count items: positive weights,
+ *                    non-negative values.
+ *  @param count      As for knapsack_solve_opts.
+ *  @param capacity   As for knapsack_solve_opts.
+ *  @param options    Options from knapsack_options_init, or NULL for
+ *                    defaults.
+ *  @param out_result Result destination, zeroed on failure.
+ *  @return KNAPSACK_OK on success; KNAPSACK_ERR_INT_OVERFLOW only past
+ *          INT64_MAX; KNAPSACK_ERR_INVALID_ARGUMENT for the Hirschberg mode
+ *          or the sparse and branch-and-bound engines; otherwise as
+ *          knapsack_solve_opts.
+ */
+knapsack_status_t knapsack_solve64(const knapsack_item64_t *items, size_t count, int capacity,
+                                   const knapsack_options_t *options,
+                                   knapsack_result64_t *out_result);
+
+/** Release a knapsack_result64_t with the allocator that produced it (NULL
+ *  for the default). Safe on a zeroed struct or NULL.
+ */
+void knapsack_result64_free_ex(knapsack_result64_t *result, const knapsack_allocator_t *allocator);
+
+/** Most capacity dimensions knapsack_solve_multi accepts. */
+#define KNAPSACK_MAX_DIMENSIONS 4U
+
+/** Most DP cells -- the product of (capacity + 1) over the dimensions --
+ *  knapsack_solve_multi accepts, e.g. 1448 x 1448 in two dimensions.
+ */
+#define KNAPSACK_MAX_MULTI_CELLS 2097152U
+
+/** An item with one weight per capacity dimension (weight and volume, say).
+ *  Entries past the solve's dimension count are ignored.
+ */
+typedef struct {
+  int weights[KNAPSACK_MAX_DIMENSIONS];
+  int value;
+} knapsack_multi_item_t;
+
+/** Result of knapsack_solve_multi; release via knapsack_multi_result_free_ex. */
+typedef struct {
+  int optimal_value;
+  int total_weights[KNAPSACK_MAX_DIMENSIONS]; /**< per dimension; 0 past the count. */
+  size_t selected_count;
+  size_t *selected_indices; /**< ascending. */
+  size_t pruned_count;      /**< items preprocessing removed before the DP. */
+} knapsack_multi_result_t;
+
+/** Solve a 0/1 knapsack with a capacity in each of @p dims dimensions.
+ *
+ *  The DP table is flattened over the capacity vectors, the last dimension
+ *  contiguous, so each item updates it in contiguous runs through the
+ *  active DP kernel: O(count * cells) time, 8 bytes per cell, plus
+ *  count * cells decision bits. A table larger than options->tile_cells
+ *  (knapsack_tile_cells() by default) is cache-blocked along the first
+ *  dimension as KNAPSACK_ENGINE_TILED blocks its row, with two halos of up
+ *  to a block each. The tie-break extends the 0/1 one: maximal
+ *  value, then minimal total weights compared dimension by dimension, the
+ *  first dimension first. With one dimension the value and total weight
+ *  are those of knapsack_solve_opts.
+ *
+ *  Before the DP, items that fit in no knapsack, are worth nothing, or
+ *  are dominated are removed. Item b dominates a if it is worth at least
+ *  as much and weighs no more in any dimension; a is dropped when a and
+ *  all items dominating it together exceed a capacity, since any
+ *  selection taking a could then trade it for one of them.
+ *
+ *  Of the options, limits (per dimension), allocator, cancel, stats,
+ *  tile_cells and reconstruct (KNAPSACK_RECONSTRUCT_BITSET or _NONE)
+ *  apply. The solve is
+ *  always dense and serial, and a cancelled solve fails.
+ *
+ *  @param items      Array of @p count items: weights non-negative and not
+ *                    all zero, values non-negative.
+ *  @param count      Number of items (1 .. options->limits.max_items).
+ *  @param dims       Capacity dimensions, 1 .. KNAPSACK_MAX_DIMENSIONS.
+ *  @param capacities Array of @p dims capacities, each 0 ..
+ *                    options->limits.max_capacity.
+ *  @param options    Options from knapsack_options_init, or NULL for
+ *                    defaults.
+ *  @param out_result Result destination, zeroed on failure. Memory is owned
+ *                    by options->allocator.
+ *  @return KNAPSACK_OK on success; KNAPSACK_ERR_INVALID_CAPACITY for a NULL
+ *          or out-of-range capacity or more than KNAPSACK_MAX_MULTI_CELLS
+ *          cells; KNAPSACK_ERR_INVALID_ARGUMENT for a bad @p dims, the
+ *          Hirschberg mode or the sparse and branch-and-bound engines;
+ *          otherwise as knapsack_solve_opts.
+ */
+knapsack_status_t knapsack_solve_multi(const knapsack_multi_item_t *items, size_t count,
+                                       size_t dims, const int *capacities,
+                                       const knapsack_options_t *options,
+                                       knapsack_multi_result_t *out_result);
+
+/** Release a knapsack_multi_result_t with the allocator that produced it
+ *  (NULL for the default). Safe on a zeroed struct or NULL.
+ */
+void knapsack_multi_result_free_ex(knapsack_multi_result_t *result,
+                                   const knapsack_allocator_t *allocator);
+
+/** Opaque, thread-safe LRU cache of solve results.
+ *
+ *  Sits in front of knapsack_solve_status_ex for callers that solve the
+ *  same instance over and over (retries, fan-out). Entries are keyed by a
+ *  64-bit hash of the capacity and the item array, in order; a hit is
+ *  confirmed by comparing the stored instance in full, so a hash collision
+ *  is only ever a miss. Only successful results are cached.
+ *
+ *  Any number of threads may use one cache. Lookups and inserts are
+ *  serialized on a mutex; the solve of a miss runs outside it, so two
+ *  threads missing the same instance at once both solve it.
+ */
+typedef struct knapsack_cache knapsack_cache_t;
+
+/** Counters of a knapsack_cache_t since it was created. */
+typedef struct {
+  uint64_t hits;      /**< solves answered from the cache. */
+  uint64_t misses;    /**< solves that ran the solver. */
+  uint64_t evictions; /**< entries dropped to make room. */
+  size_t entries;     /**< instances cached right now. */
+} knapsack_cache_stats_t;
+
+/** Create a cache holding up to @p max_entries instances.
+ *
+ *  @param max_entries Entry limit (>= 1); the least recently used entry is
+ *                     evicted to make room. Each entry holds a copy of the
+ *                     items and of the selected indices.
+ *  @param allocator   Custom allocator for the cache's own memory, or NULL
+ *                     for malloc/calloc/free. Kept by the cache; it must
+ *                     outlive it.
+ *  @return A new cache, or NULL if @p max_entries is 0 or allocation failed.
+ */
+knapsack_cache_t *knapsack_cache_create(size_t max_entries, const knapsack_allocator_t *allocator);
+
+/** knapsack_solve_status_ex through @p cache.
+ *
+ *  On a hit the cached result is copied into @p out_result; either way the
+ *  result's memory comes from @p allocator (not the cache's) and is released
+ *  with knapsack_result_free_ex, exactly as for knapsack_solve_status_ex.
+ *
+ *  @return KNAPSACK_ERR_INVALID_ARGUMENT if @p cache is NULL,
+ *          KNAPSACK_ERR_ALLOC if copying a hit failed, otherwise the status
+ *          of knapsack_solve_status_ex. A cache entry that cannot be
+ *          allocated is skipped, not reported.
+ */
+knapsack_status_t knapsack_cache_solve(knapsack_cache_t *cache, const knapsack_item_t *items,
+                                       size_t count, int capacity,
+                                       const knapsack_allocator_t *allocator,
+                                       knapsack_result_t *out_result);
+
+/** Snapshot of the counters; all zero for a NULL @p cache. */
+void knapsack_cache_get_stats(knapsack_cache_t *cache, knapsack_cache_stats_t *out_stats);
+
+/** Invalidate every entry. The counters keep running. */
+void knapsack_cache_clear(knapsack_cache_t *cache);
+
+/** Release the cache and its entries. Safe to call with NULL. */
+void knapsack_cache_destroy(knapsack_cache_t *cache);
+
+/** Opaque executor of asynchronous solves, for event-loop servers.
+ *
+ *  The executor owns a fixed set of worker threads, each with a workspace
+ *  it reuses for every job it runs. knapsack_executor_submit copies the
+ *  instance into a job, queues it and returns at once. It never blocks: a
+ *  full queue refuses the job with KNAPSACK_ERR_QUEUE_FULL, which is the
+ *  caller's cue to shed or defer load.
+ *
+ *  Queued jobs start in priority order, oldest first within a priority.
+ *  Any thread may submit or call knapsack_job_cancel; a handle is otherwise
+ *  used by one thread at a time.
+ */
+typedef struct knapsack_executor knapsack_executor_t;
+
+/** Handle of a submitted solve (see knapsack_executor_submit). */
+typedef struct knapsack_job knapsack_job_t;
+
+/** Priority class of a job; a higher class always starts first. */
+typedef enum { /* NOLINT(performance-enum-size) -- ABI: keep int-sized. */
+               KNAPSACK_PRIORITY_HIGH = 0,
+               KNAPSACK_PRIORITY_NORMAL,
+               KNAPSACK_PRIORITY_LOW
+} knapsack_priority_t;
+
+/** Number of priority classes. */
+#define KNAPSACK_PRIORITY_COUNT 3U
+
+/** Default knapsack_executor_config_t.queue_capacity. */
+#define KNAPSACK_EXECUTOR_QUEUE_CAPACITY 1024U
+
+/** Executor settings. Always initialize with knapsack_executor_config_init. */
+typedef struct {
+  size_t threads; /**< worker threads; 0 (the default) uses the number of online CPUs. */
+  /** Jobs that may wait, over all priorities, before submissions are
+   *  refused; default KNAPSACK_EXECUTOR_QUEUE_CAPACITY. Running jobs do not
+   *  count.
+   */
+  size_t queue_capacity;
+  /** Memory of the executor, its workspaces, the jobs and their results;
+   *  NULL for malloc/calloc/free. Must be thread-safe and outlive every job.
+   */
+  const knapsack_allocator_t *allocator;
+} knapsack_executor_config_t;
+
+/** Called on the worker thread once a job has finished. @p result is owned
+ *  by the callback: release it via knapsack_result_free_ex with the
+ *  executor's allocator. It is zeroed unless @p status is KNAPSACK_OK. The
+ *  callback may submit more jobs but must not wait for its own.
+ */
+typedef void (*knapsack_job_done_fn)(knapsack_status_t status, knapsack_result_t *result,
+                                     void *user_data);
+
+/** Counters of a knapsack_executor_t since it was created. Divide the
+ *  *_ns totals by completed for mean latencies.
+ */
+typedef struct {
+  uint64_t submitted; /**< jobs accepted by knapsack_executor_submit. */
+  uint64_t rejected;  /**< submissions refused with KNAPSACK_ERR_QUEUE_FULL. */
+  uint64_t completed; /**< jobs finished, whatever their status. */
+  uint64_t cancelled; /**< finished jobs whose status was KNAPSACK_ERR_CANCELLED. */
+  size_t queued[KNAPSACK_PRIORITY_COUNT]; /**< jobs waiting right now, per priority. */
+  size_t max_queued;                      /**< most jobs ever waiting at once. */
+  size_t running;                         /**< jobs being solved right now. */
+  uint64_t queue_ns;     /**< time finished jobs spent waiting, in total. */
+  uint64_t max_queue_ns; /**< longest wait of a finished job. */
+  uint64_t run_ns;       /**< time finished jobs spent solving, in total. */
+  uint64_t max_run_ns;   /**< longest solve of a finished job. */
+} knapsack_executor_stats_t;
+
+/** Fill @p config with the defaults. */
+void knapsack_executor_config_init(knapsack_executor_config_t *config);
+
+/** Start an executor.
+ *
+ *  @param config Settings from knapsack_executor_config_init, or NULL for
+ *                the defaults.
+ *  @return A new executor, or NULL if queue_capacity is 0, or allocation or
+ *          thread creation failed.
+ */
+knapsack_executor_t *knapsack_executor_create(const knapsack_executor_config_t *config);
+
+/** Queue a knapsack_solve_opts of the instance.
+ *
+ *  The items are copied, so the caller's array may go away at once.
+ *  @p options is copied as well, but options->stats (if set) is written by
+ *  the worker and must stay valid until the job has finished. As with a
+ *  workspace, options->allocator is ignored: results come from the
+ *  executor's allocator. options->cancel is polled as usual, alongside
+ *  knapsack_job_cancel.
+ *
+ *  Completion is reported through @p on_done, through @p out_job, or both;
+ *  at least one is required.
+ *
+ *  @param options   Options from knapsack_options_init, or NULL for defaults.
+ *  @param priority  Class the job waits in.
+ *  @param on_done   Completion callback, or NULL to collect the result with
+ *                   knapsack_job_wait.
+ *  @param user_data Passed to @p on_done.
+ *  @param out_job   Receives a handle to release with knapsack_job_release,
+ *                   or NULL if the callback is enough. Set to NULL when the
+ *                   job is not queued.
+ *  @return KNAPSACK_OK once the job is queued; KNAPSACK_ERR_QUEUE_FULL if
+ *          queue_capacity jobs are already waiting;
+ *          KNAPSACK_ERR_INVALID_ARGUMENT if @p executor is NULL,
+ *          @p priority is out of range, @p options is malformed, or both
+ *          @p on_done and @p out_job are NULL; KNAPSACK_ERR_INVALID_ITEMS or
+ *          KNAPSACK_ERR_TOO_MANY_ITEMS if the items cannot be copied; or
+ *          KNAPSACK_ERR_ALLOC. The callback does not run for a job that was
+ *          not queued. Every other error is the job's status.
+ */
+knapsack_status_t knapsack_executor_submit(knapsack_executor_t *executor,
+                                           const knapsack_item_t *items, size_t count,
+                                           int capacity, const knapsack_options_t *options,
+                                           knapsack_priority_t priority,
+                                           knapsack_job_done_fn on_done, void *user_data,
+                                           knapsack_job_t **out_job);
+
+/** Snapshot of the counters; all zero for a NULL @p executor. */
+void knapsack_executor_get_stats(knapsack_executor_t *executor,
+                                 knapsack_executor_stats_t *out_stats);
+
+/** Cancel every waiting job, let the running ones finish, and stop the
+ *  workers. Every job's callback has returned by the time this does.
+ *  Handles stay valid until released. No other thread may use the executor
+ *  meanwhile. Safe to call with NULL.
+ */
+void knapsack_executor_destroy(knapsack_executor_t *executor);
+
+/** Whether @p job has finished and its callback, if any, has returned. */
+bool knapsack_job_done(const knapsack_job_t *job);
+
+/** Block until knapsack_job_done(@p job) and return the job's status.
+ *
+ *  @param out_result Receives the result of a job submitted without a
+ *                    callback (release it via knapsack_result_free_ex with
+ *                    the executor's allocator), or NULL to leave it with the
+ *                    job. The result is handed out once; it is zeroed for
+ *                    later calls, for a failed job and for a job with a
+ *                    callback, which received it instead.
+ *  @return The job's status, or KNAPSACK_ERR_INVALID_ARGUMENT if @p job is
+ *          NULL.
+ */
+knapsack_status_t knapsack_job_wait(knapsack_job_t *job, knapsack_result_t *out_result);
+
+/** Ask @p job to stop. A waiting job finishes without being solved, with
+ *  KNAPSACK_ERR_CANCELLED, once a worker reaches it (it keeps its queue
+ *  slot until then); a running one stops as if options->cancel had
+ *  returned true, anytime options included. No effect on a finished job or
+ *  NULL.
+ */
+void knapsack_job_cancel(knapsack_job_t *job);
+
+/** Drop the handle, and the job's result if knapsack_job_wait has not
+ *  taken it. An unfinished job still runs to completion. Safe with NULL.
+ */
+void knapsack_job_release(knapsack_job_t *job);
+
+/** DP inner-loop kernels. The solver picks the best one supported by the
+ *  CPU once, when the library is loaded (CPUID on x86, HWCAP on AArch64).
+ *  All kernels produce bit-identical results; the scalar kernel is the
+ *  reference and the fallback.
+ */
+typedef enum { /* NOLINT(performance-enum-size) -- ABI: keep int-sized. */
+               KNAPSACK_KERNEL_AUTO = 0, /**< best kernel detected for this CPU. */
+               KNAPSACK_KERNEL_SCALAR,   /**< portable scalar loop. */
+               KNAPSACK_KERNEL_SSE41,    /**< x86 SSE4.1, 4 lanes. */
+               KNAPSACK_KERNEL_AVX2,     /**< x86 AVX2, 8 lanes. */
+               KNAPSACK_KERNEL_AVX512,   /**< x86 AVX-512F, 16 lanes. */
+               KNAPSACK_KERNEL_NEON      /**< AArch64 Advanced SIMD, 4 lanes. */
+} knapsack_kernel_t;
+
+/** Whether @p kernel is compiled in and supported by this CPU. AUTO is
+ *  always supported.
+ */
+bool knapsack_kernel_supported(knapsack_kernel_t kernel);
+
+/** Force a kernel process-wide (mainly for testing and benchmarking), or
+ *  pass KNAPSACK_KERNEL_AUTO to return to the detected one.
+ *
+ *  @return KNAPSACK_OK, or KNAPSACK_ERR_INVALID_ARGUMENT if @p kernel is not
+ *          supported here (the current selection is then left unchanged).
+ */
+knapsack_status_t knapsack_set_kernel(knapsack_kernel_t kernel);
+
+/** Kernel that the next solve will use (never KNAPSACK_KERNEL_AUTO). */
+knapsack_kernel_t knapsack_active_kernel(void);
+
+/** Short lower-case name of a kernel, e.g. "avx2". */
+const char *knapsack_kernel_name(knapsack_kernel_t kernel);
+
+/** Block size KNAPSACK_ENGINE_TILED uses when options->tile_cells is 0: a
+ *  multiple of 64 cells whose rows and halos fill half the L2 cache, as
+ *  sysconf reports it on first use (256 KiB assumed where it does not).
+ */
+size_t knapsack_tile_cells(void);
+
+/** Where one solve spent its work, memory and time (see
+ *  knapsack_options_t.stats).
+ *
+ *  Byte counts are the arena segments the solve's layout needed, alignment
+ *  padding included; a reused workspace may hold more. A sparse run tried
+ *  first over the dense rows borrows them and adds no bytes of its own.
+ */
+struct knapsack_stats {
+  /** Engine that produced the answer: KNAPSACK_ENGINE_DENSE (also for
+   *  Hirschberg), SPARSE, BRANCH_BOUND or TILED, or KNAPSACK_ENGINE_AUTO when
+   *  preprocessing answered without running one.
+   */
+  knapsack_engine_t engine;
+  /** DP kernel of the dense rows, or KNAPSACK_KERNEL_AUTO if none ran. */
+  knapsack_kernel_t kernel;
+  size_t workers; /**< threads that filled the rows (1 when serial). */
+  /** Units of work: DP cells for the dense and tiled engines and
+   *  Hirschberg (every row it recomputes), frontier states for the sparse
+   *  engine, search nodes for branch and bound.
+   */
+  uint64_t cells;
+  /** Cells whose decision took the item. Counted from the decision bitset,
+   *  so only the dense and tiled engines with KNAPSACK_RECONSTRUCT_BITSET
+   *  report it.
+   */
+  uint64_t cells_taken;
+  size_t row_bytes;       /**< value/weight rows (both pairs in parallel runs). */
+  size_t take_bits_bytes; /**< decision bitset and its row index; Hirschberg's picked set. */
+  size_t engine_bytes;    /**< sparse frontier, branch and bound arrays, tiled halos. */
+  size_t instance_bytes;  /**< compacted items and their original indices. */
+  size_t arena_bytes;     /**< the whole arena, result slots included. */
+  uint64_t validate_ns;    /**< validation, preprocessing and planning. */
+  uint64_t dp_ns;          /**< the DP, frontier build or search. */
+  uint64_t select_ns;      /**< picking the best cell of the last dense row. */
+  uint64_t reconstruct_ns; /**< recovering the selected items. */
+};
+
+/** Whether this build collects knapsack_stats_t. A library configured with
+ *  -DENABLE_STATS=OFF compiles the collection out; a requested
+ *  knapsack_stats_t is then left zeroed.
+ */
+bool knapsack_stats_available(void);
+
+/** Short lower-case name of an engine, e.g. "branch_bound". */
+const char *knapsack_engine_name(knapsack_engine_t engine);
+
+/** Binary columnar format.
+ *
+ *  Instances and results can be exchanged as compact little-endian records
+ *  instead of text. An instance is a 16-byte header followed by two packed
+ *  int32 columns, so a mapped file can be read in place:
+ *
+ *  | Offset          | Size      | Field                                 |
+ *  | --------------- | --------- | ------------------------------------- |
+ *  | 0               | 4         | magic "KNSI"                          |
+ *  | 4               | 4         | version (KNAPSACK_BINARY_VERSION)     |
+ *  | 8               | 4         | count (uint32)                        |
+ *  | 12              | 4         | capacity (int32)                      |
+ *  | 16              | 4 * count | weights (int32)                       |
+ *  | 16 + 4 * count  | 4 * count | values (int32)                        |
+ *
+ *  A result is a 32-byte header followed by the selected indices:
+ *
+ *  | Offset | Size              | Field                                  |
+ *  | ------ | ----------------- | -------------------------------------- |
+ *  | 0      | 4                 | magic "KNSR"                           |
+ *  | 4      | 4                 | version                                |
+ *  | 8      | 4                 | status (a knapsack_status_t, int32)    |
+ *  | 12     | 4                 | optimal_value (int32)                  |
+ *  | 16     | 4                 | total_weight (int32)                   |
+ *  | 20     | 4                 | upper_bound (int32)                    |
+ *  | 24     | 4                 | selected_count (uint32)                |
+ *  | 28     | 4                 | reserved, 0                            |
+ *  | 32     | 4 * selected      | selected indices (uint32, ascending)   |
+ *
+ *  The helpers work on memory buffers; reading and writing files is left
+ *  to the caller. Loading checks the layout only: item weights and values
+ *  are validated by the solver as usual.
+ */
+#define KNAPSACK_BINARY_VERSION 1U
+#define KNAPSACK_BINARY_INSTANCE_HEADER_SIZE 16U
+#define KNAPSACK_BINARY_RESULT_HEADER_SIZE 32U
+
+/** Bytes of a binary instance with @p count items, or 0 if that would not
+ *  fit the format (count above UINT32_MAX) or size_t.
+ */
+size_t knapsack_binary_instance_size(size_t count);
+
+/** Encode an instance into @p buffer.
+ *
+ *  @param items       Array of @p count items (may be NULL when count is 0).
+ *  @param count       Number of items.
+ *  @param capacity    Knapsack capacity, stored as is.
+ *  @param buffer      Destination of knapsack_binary_instance_size(count)
+ *                     bytes; no alignment is needed.
+ *  @param buffer_size Size of @p buffer.
+ *  @param out_size    Set to the bytes written on success; may be NULL.
+ *  @return KNAPSACK_OK, KNAPSACK_ERR_DIMENSION_OVERFLOW if count does not
+ *          fit the format, or KNAPSACK_ERR_INVALID_ARGUMENT if a pointer is
+ *          NULL or the buffer is too small.
+ */
+knapsack_status_t knapsack_binary_save_instance(const knapsack_item_t *items, size_t count,
+                                                int capacity, void *buffer, size_t buffer_size,
+                                                size_t *out_size);
+
+/** Read the header of a binary instance and check that @p size covers both
+ *  columns (bytes after them are ignored).
+ *
+ *  @return KNAPSACK_OK with *out_count and *out_capacity set,
+ *          KNAPSACK_ERR_INVALID_FORMAT, or KNAPSACK_ERR_INVALID_ARGUMENT if a
+ *          pointer is NULL.
+ */
+knapsack_status_t knapsack_binary_instance_header(const void *data, size_t size,
+                                                  size_t *out_count, int *out_capacity);
+
+/** Decode the columns of a binary instance into @p items, which has room
+ *  for @p item_capacity items (at least the count from its header).
+ *
+ *  @return KNAPSACK_OK, KNAPSACK_ERR_INVALID_FORMAT, or
+ *          KNAPSACK_ERR_INVALID_ARGUMENT if a pointer is NULL or @p items is
+ *          too small.
+ */
+knapsack_status_t knapsack_binary_load_instance(const void *data, size_t size,
+                                                knapsack_item_t *items, size_t item_capacity);
+
+/** Bytes of the binary record of @p result (NULL: a record without
+ *  indices), or 0 if its selection does not fit the format.
+ */
+size_t knapsack_binary_result_size(const knapsack_result_t *result);
+
+/** Encode a solve outcome: @p status and, when @p result is non-NULL, its
+ *  fields and indices (an error record usually passes NULL, which stores
+ *  zeros).
+ *
+ *  @return KNAPSACK_OK, KNAPSACK_ERR_DIMENSION_OVERFLOW if the selection or
+ *          an index does not fit the format, or
+ *          KNAPSACK_ERR_INVALID_ARGUMENT if @p buffer is NULL or too small.
+ */
+knapsack_status_t knapsack_binary_save_result(knapsack_status_t status,
+                                              const knapsack_result_t *result, void *buffer,
+                                              size_t buffer_size, size_t *out_size);
+
+/** Decode a binary result record.
+ *
+ *  @param allocator   Allocates out_result->selected_indices, or NULL for
+ *                     malloc. Release the result via knapsack_result_free_ex
+ *                     with the same allocator.
+ *  @param out_status  Set to the stored status.
+ *  @param out_result  Set to the stored fields. Zeroed on failure.
+ *  @return KNAPSACK_OK, KNAPSACK_ERR_NULL_RESULT, KNAPSACK_ERR_INVALID_FORMAT,
+ *          KNAPSACK_ERR_ALLOC, or KNAPSACK_ERR_INVALID_ARGUMENT if another
+ *          pointer is NULL.
+ */
+knapsack_status_t knapsack_binary_load_result(const void *data, size_t size,
+                                              const knapsack_allocator_t *allocator,
+                                              knapsack_status_t *out_status,
+                                              knapsack_result_t *out_result);
+
+/** Upper-case name of a status code, for example "OK" or "INVALID_ITEMS"
+ *  ("UNKNOWN" for a value outside the enum). Used as the "code" of JSON
+ *  error objects.
+ */
+const char *knapsack_status_name(knapsack_status_t status);
+
+/** JSON output.
+ *
+ *  Results can be rendered as the one-line JSON objects knapsack_demo
+ *  prints, into a byte buffer rather than through stdio. A
+ *  knapsack_writer_t is the buffer; it is set up in one of three ways:
+ *
+ *  - over caller storage with no callback: output that does not fit fails,
+ *    and the objects written so far stay in the buffer;
+ *  - over caller storage with a callback: whenever the storage fills up it
+ *    is handed to the callback in one piece and reused, so output of any
+ *    size goes out in large writes with no allocation;
+ *  - growable: the writer owns storage that doubles as needed.
+ *
+ *  Integers are converted two digits at a time without going through
+ *  printf. The fields are public so a writer can live on the stack; treat
+ *  them as read-only except for resetting length to 0.
+ */
+#define KNAPSACK_WRITER_MIN_SIZE 64U
+
+/** Output callback of a knapsack_writer_t: consume @p size bytes at
+ *  @p data. Returns 0 on success and nonzero if they could not be written.
+ */
+typedef int (*knapsack_write_fn)(const void *data, size_t size, void *user_data);
+
+/** Byte buffer that the JSON writers append to. */
+typedef struct {
+  char *data;                            /**< Buffered output, length bytes (not NUL-terminated). */
+  size_t length;                         /**< Bytes buffered in data. */
+  size_t capacity;                       /**< Bytes of storage behind data. */
+  knapsack_write_fn write_fn;            /**< NULL: keep everything in data. */
+  void *write_user_data;                 /**< Passed through to write_fn. */
+  const knapsack_allocator_t *allocator; /**< Owner of data; NULL for caller storage. */
+} knapsack_writer_t;
+
+/** Write into caller storage.
+ *
+ *  @param storage  Buffer of @p size bytes; it must outlive the writer.
+ *  @param write_fn Callback that receives the storage when it fills up and
+ *                  on knapsack_writer_flush, or NULL. With a callback,
+ *                  @p size must be at least KNAPSACK_WRITER_MIN_SIZE.
+ */
+void knapsack_writer_init(knapsack_writer_t *writer, void *storage, size_t size,
+                          knapsack_write_fn write_fn, void *user_data);
+
+/** Write into storage the writer allocates and grows, starting empty.
+ *
+ *  @param allocator Custom allocator, or NULL to use malloc/free. Release the
+ *                   storage with knapsack_writer_release.
+ */
+void knapsack_writer_init_growable(knapsack_writer_t *writer,
+                                   const knapsack_allocator_t *allocator);
+
+/** Hand everything buffered to the callback and empty the buffer. A no-op
+ *  without a callback.
+ *
+ *  @return KNAPSACK_OK, KNAPSACK_ERR_IO if the callback failed (the bytes
+ *          are dropped), or KNAPSACK_ERR_INVALID_ARGUMENT if @p writer is
+ *          NULL.
+ */
+knapsack_status_t knapsack_writer_flush(knapsack_writer_t *writer);
+
+/** Free growable storage. Does not flush. Safe on a writer over caller
+ *  storage (nothing to free) and on NULL.
+ */
+void knapsack_writer_release(knapsack_writer_t *writer);
+
+/** Append @p size raw bytes. */
+knapsack_status_t knapsack_writer_append(knapsack_writer_t *writer, const void *data,
+                                         size_t size);
+
+/** Append @p text with JSON string escaping, without surrounding quotes. */
+knapsack_status_t knapsack_json_write_string(knapsack_writer_t *writer, const char *text);
+
+/** Append {"status":"ok","optimal_value":V,"selected_indices":[...]} and a
+ *  newline.
+ *
+ *  All the JSON writers return KNAPSACK_OK, KNAPSACK_ERR_INVALID_ARGUMENT
+ *  if an argument is NULL or caller storage without a callback is too
+ *  small, KNAPSACK_ERR_ALLOC if growable storage could not grow, or
+ *  KNAPSACK_ERR_IO if the callback failed. A writer without a callback is
+ *  left as it was before a failed call, so its buffer only ever holds
+ *  whole objects.
+ */
+knapsack_status_t knapsack_json_write_result(knapsack_writer_t *writer,
+                                             const knapsack_result_t *result);
+
+/** Append {"status":"ok","optimal_value":V,"total_weight":W} and a newline
+ *  (the value-only form).
+ */
+knapsack_status_t knapsack_json_write_value(knapsack_writer_t *writer,
+                                            const knapsack_result_t *result);
+
+/** knapsack_json_write_result followed, when @p stats is non-NULL, by a
+ *  member
+ *  "stats":{"engine":"dense","kernel":"avx2","workers":1,"cells":C,
+ *  "cells_taken":T,"bytes":{"rows":R,"take_bits":B,"engine":E,"instance":I,
+ *  "arena":A},"ns":{"validate":V,"dp":D,"select":S,"reconstruct":X}}.
+ */
+knapsack_status_t knapsack_json_write_result_ex(knapsack_writer_t *writer,
+                                                const knapsack_result_t *result,
+                                                const knapsack_stats_t *stats);
+
+/** knapsack_json_write_value with the "stats" member of
+ *  knapsack_json_write_result_ex.
+ */
+knapsack_status_t knapsack_json_write_value_ex(knapsack_writer_t *writer,
+                                               const knapsack_result_t *result,
+                                               const knapsack_stats_t *stats);
+
+/** Append {"status":"error","code":"NAME","message":"..."} and a newline,
+ *  with NAME from knapsack_status_name and @p message (NULL: empty)
+ *  escaped.
+ */
+knapsack_status_t knapsack_json_write_error(knapsack_writer_t *writer, knapsack_status_t status,
+                                            const char *message);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,215 @@
+/* Binary columnar instance and result records (see the format tables in
+ * knapsack.h).
+ *
+ * Every field is encoded byte by byte, so the records are little-endian
+ * whatever the host, and neither the buffers nor the columns need any
+ * alignment. On little-endian targets compilers turn the byte loads and
+ * stores into plain word accesses.
+ */
+#include "knapsack_internal.h"
+
+#include "knapsack/knapsack.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+static const unsigned char k_instance_magic[4] = {'K', 'N', 'S', 'I'};
+static const unsigned char k_result_magic[4] = {'K', 'N', 'S', 'R'};
+
+enum { FIELD_BYTES = 4 };
+
+static void store_u32(unsigned char *out, uint32_t value) {
+  out[0] = (unsigned char)(value & 0xFFU);
+  out[1] = (unsigned char)((value >> 8U) & 0xFFU);
+  out[2] = (unsigned char)((value >> 16U) & 0xFFU);
+  out[3] = (unsigned char)((value >> 24U) & 0xFFU);
+}
+
+static uint32_t load_u32(const unsigned char *in) {
+  return (uint32_t)in[0] | ((uint32_t)in[1] << 8U) | ((uint32_t)in[2] << 16U) |
+         ((uint32_t)in[3] << 24U);
+}
+
+/* int32 fields are stored as their two's-complement bit pattern. */
+static void store_i32(unsigned char *out, int value) { store_u32(out, (uint32_t)value); }
+
+static int load_i32(const unsigned char *in) {
+  const uint32_t bits = load_u32(in);
+  if (bits <= (uint32_t)INT32_MAX) {
+    return (int)bits;
+  }
+  return (int)(bits - (uint32_t)INT32_MAX - 1U) + INT32_MIN;
+}
+
+/* Header + count rows of `columns` 4-byte fields, or 0 if count does not
+ * fit its uint32 field or the size overflows.
+ */
+static size_t record_size(size_t header, size_t count, size_t columns) {
+  if (count > UINT32_MAX || count > (SIZE_MAX - header) / (FIELD_BYTES * columns)) {
+    return 0U;
+  }
+  return header + count * FIELD_BYTES * columns;
+}
+
+size_t knapsack_binary_instance_size(size_t count) {
+  return record_size(KNAPSACK_BINARY_INSTANCE_HEADER_SIZE, count, 2U);
+}
+
+knapsack_status_t knapsack_binary_save_instance(const knapsack_item_t *items, size_t count,
+                                                int capacity, void *buffer, size_t buffer_size,
+                                                size_t *out_size) {
+  if (!buffer || (!items && count > 0U)) {
+    return KNAPSACK_ERR_INVALID_ARGUMENT;
+  }
+  const size_t size = knapsack_binary_instance_size(count);
+  if (size == 0U) {
+    return KNAPSACK_ERR_DIMENSION_OVERFLOW;
+  }
+  if (buffer_size < size) {
+    return KNAPSACK_ERR_INVALID_ARGUMENT;
+  }
+  unsigned char *out = buffer;
+  memcpy(out, k_instance_magic, sizeof k_instance_magic);
+  store_u32(out + 4, KNAPSACK_BINARY_VERSION);
+  store_u32(out + 8, (uint32_t)count);
+  store_i32(out + 12, capacity);
+  unsigned char *weights = out + KNAPSACK_BINARY_INSTANCE_HEADER_SIZE;
+  unsigned char *values = weights + count * FIELD_BYTES;
+  for (size_t i = 0; i < count; ++i) {
+    store_i32(weights + i * FIELD_BYTES, items[i].weight);
+    store_i32(values + i * FIELD_BYTES, items[i].value);
+  }
+  if (out_size) {
+    *out_size = size;
+  }
+  return KNAPSACK_OK;
+}
+
+knapsack_status_t knapsack_binary_instance_header(const void *data, size_t size,
+                                                  size_t *out_count, int *out_capacity) {
+  if (!data || !out_count || !out_capacity) {
+    return KNAPSACK_ERR_INVALID_ARGUMENT;
+  }
+  const unsigned char *in = data;
+  if (size < KNAPSACK_BINARY_INSTANCE_HEADER_SIZE ||
+      memcmp(in, k_instance_magic, sizeof k_instance_magic) != 0 ||
+      load_u32(in + 4) != KNAPSACK_BINARY_VERSION) {
+    return KNAPSACK_ERR_INVALID_FORMAT;
+  }
+  const size_t count = load_u32(in + 8);
+  const size_t needed = knapsack_binary_instance_size(count);
+  if (needed == 0U || size < needed) {
+    return KNAPSACK_ERR_INVALID_FORMAT;
+  }
+  *out_count = count;
+  *out_capacity = load_i32(in + 12);
+  return KNAPSACK_OK;
+}
+
+knapsack_status_t knapsack_binary_load_instance(const void *data, size_t size,
+                                                knapsack_item_t *items, size_t item_capacity) {
+  size_t count = 0U;
+  int capacity = 0;
+  const knapsack_status_t status = knapsack_binary_instance_header(data, size, &count, &capacity);
+  if (status != KNAPSACK_OK) {
+    return status;
+  }
+  if (!items || item_capacity < count) {
+    return KNAPSACK_ERR_INVALID_ARGUMENT;
+  }
+  const unsigned char *weights =
+      (const unsigned char *)data + KNAPSACK_BINARY_INSTANCE_HEADER_SIZE;
+  const unsigned char *values = weights + count * FIELD_BYTES;
+  for (size_t i = 0; i < count; ++i) {
+    items[i].weight = load_i32(weights + i * FIELD_BYTES);
+    items[i].value = load_i32(values + i * FIELD_BYTES);
+  }
+  return KNAPSACK_OK;
+}
+
+size_t knapsack_binary_result_size(const knapsack_result_t *result) {
+  return record_size(KNAPSACK_BINARY_RESULT_HEADER_SIZE, result ? result->selected_count : 0U, 1U);
+}
+
+knapsack_status_t knapsack_binary_save_result(knapsack_status_t status,
+                                              const knapsack_result_t *result, void *buffer,
+                                              size_t buffer_size, size_t *out_size) {
+  if (!buffer || (result && result->selected_count > 0U && !result->selected_indices)) {
+    return KNAPSACK_ERR_INVALID_ARGUMENT;
+  }
+  const size_t size = knapsack_binary_result_size(result);
+  if (size == 0U) {
+    return KNAPSACK_ERR_DIMENSION_OVERFLOW;
+  }
+  if (buffer_size < size) {
+    return KNAPSACK_ERR_INVALID_ARGUMENT;
+  }
+  const size_t selected = result ? result->selected_count : 0U;
+  for (size_t i = 0; i < selected; ++i) {
+    if (result->selected_indices[i] > UINT32_MAX) {
+      return KNAPSACK_ERR_DIMENSION_OVERFLOW;
+    }
+  }
+  unsigned char *out = buffer;
+  memcpy(out, k_result_magic, sizeof k_result_magic);
+  store_u32(out + 4, KNAPSACK_BINARY_VERSION);
+  store_i32(out + 8, (int)status);
+  store_i32(out + 12, result ? result->optimal_value : 0);
+  store_i32(out + 16, result ? result->total_weight : 0);
+  store_i32(out + 20, result ? result->upper_bound : 0);
+  store_u32(out + 24, (uint32_t)selected);
+  store_u32(out + 28, 0U);
+  unsigned char *indices = out + KNAPSACK_BINARY_RESULT_HEADER_SIZE;
+  for (size_t i = 0; i < selected; ++i) {
+    store_u32(indices + i * FIELD_BYTES, (uint32_t)result->selected_indices[i]);
+  }
+  if (out_size) {
+    *out_size = size;
+  }
+  return KNAPSACK_OK;
+}
+
+knapsack_status_t knapsack_binary_load_result(const void *data, size_t size,
+                                              const knapsack_allocator_t *allocator,
+                                              knapsack_status_t *out_status,
+                                              knapsack_result_t *out_result) {
+  if (!out_result) {
+    return KNAPSACK_ERR_NULL_RESULT;
+  }
+  memset(out_result, 0, sizeof *out_result);
+  if (!data || !out_status) {
+    return KNAPSACK_ERR_INVALID_ARGUMENT;
+  }
+  const unsigned char *in = data;
+  if (size < KNAPSACK_BINARY_RESULT_HEADER_SIZE ||
+      memcmp(in, k_result_magic, sizeof k_result_magic) != 0 ||
+      load_u32(in + 4) != KNAPSACK_BINARY_VERSION) {
+    return KNAPSACK_ERR_INVALID_FORMAT;
+  }
+  const size_t selected = load_u32(in + 24);
+  const size_t needed = record_size(KNAPSACK_BINARY_RESULT_HEADER_SIZE, selected, 1U);
+  if (needed == 0U || size < needed) {
+    return KNAPSACK_ERR_INVALID_FORMAT;
+  }
+  size_t *indices = NULL;
+  if (selected > 0U) {
+    const knapsack_allocator_t *alloc = resolve_allocator(allocator);
+    indices = alloc->alloc_fn(selected * sizeof(size_t), alloc->user_data);
+    if (!indices) {
+      return KNAPSACK_ERR_ALLOC;
+    }
+    const unsigned char *stored = in + KNAPSACK_BINARY_RESULT_HEADER_SIZE;
+    for (size_t i = 0; i < selected; ++i) {
+      indices[i] = load_u32(stored + i * FIELD_BYTES);
+    }
+  }
+  *out_status = (knapsack_status_t)load_i32(in + 8);
+  out_result->optimal_value = load_i32(in + 12);
+  out_result->total_weight = load_i32(in + 16);
+  out_result->upper_bound = load_i32(in + 20);
+  out_result->selected_count = selected;
+  out_result->selected_indices = indices;
+  return KNAPSACK_OK;
+}
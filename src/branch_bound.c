@@ -0,0 +1,220 @@
+/* Exact depth-first branch and bound.
+ *
+ * Items with a positive value are sorted by value/weight ratio, best first
+ * (zero-value items only add weight, so no optimal selection takes them).
+ * The search takes the next item when it fits, before trying without it.
+ * A node is cut off when the Martello-Toth U2 bound on its completions falls
+ * below the incumbent's value. When the bound only ties that value, the
+ * node is also cut off if the lightest fractional way of reaching the value
+ * cannot beat the incumbent's weight either. The search therefore ends with
+ * the same (max value, min weight) optimum as the DP. Among selections that
+ * tie on both, it keeps the first one it finds.
+ *
+ * Memory is linear in the item count and independent of the capacity. Time
+ * is exponential in the worst case, but uncorrelated instances are usually
+ * settled after a small number of nodes.
+ */
+#include "knapsack_internal.h"
+
+#include "knapsack/knapsack.h"
+
+#include <limits.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum { BB_PATH_OUT = 0, BB_PATH_TAKEN = 1 };
+
+/* Ratio order: higher value/weight first, then lighter, then lower index. */
+static int compare_ratio(const void *lhs, const void *rhs) {
+  const bb_item_t *a = (const bb_item_t *)lhs;
+  const bb_item_t *b = (const bb_item_t *)rhs;
+  const long long left = (long long)a->value * b->weight;
+  const long long right = (long long)b->value * a->weight;
+  if (left != right) {
+    return left > right ? -1 : 1;
+  }
+  if (a->weight != b->weight) {
+    return a->weight < b->weight ? -1 : 1;
+  }
+  return (a->index > b->index) - (a->index < b->index);
+}
+
+/* First position p in [lo, hi] with prefix[p] > limit, or hi + 1. */
+static size_t first_above(const long long *prefix, size_t lo, size_t hi, long long limit) {
+  size_t end = hi + 1U;
+  while (lo < end) {
+    const size_t mid = lo + (end - lo) / 2U;
+    if (prefix[mid] > limit) {
+      end = mid;
+    } else {
+      lo = mid + 1U;
+    }
+  }
+  return lo;
+}
+
+static long long ceil_div(long long num, long long den) { return (num + den - 1) / den; }
+
+/* Martello-Toth U2 on the value reachable from depth k with room left.
+ * Items k..s-1 fit greedily and item s, the critical item, does not. The
+ * better completion either leaves s out and fills the rest of the room at
+ * the ratio of s + 1, or forces s in and makes room at the ratio of s - 1.
+ */
+static long long upper_bound(const bb_search_t *s, size_t k, long long room) {
+  const size_t m = s->used;
+  const long long *pw = s->prefix_weight;
+  const long long *pv = s->prefix_value;
+  const size_t crit = first_above(pw, k + 1U, m, pw[k] + room) - 1U;
+  const long long gain = pv[crit] - pv[k];
+  if (crit == m) {
+    return gain;
+  }
+  const long long rem = room - (pw[crit] - pw[k]);
+  const bb_item_t *c = &s->order[crit];
+  long long bound = gain;
+  if (crit + 1U < m) {
+    const bb_item_t *next = &s->order[crit + 1U];
+    bound += rem * next->value / next->weight;
+  }
+  if (crit > k) {
+    const bb_item_t *prev = &s->order[crit - 1U];
+    const long long forced =
+        gain + c->value - ceil_div(((long long)c->weight - rem) * prev->value, prev->weight);
+    if (forced > bound) {
+      bound = forced;
+    }
+  }
+  return bound;
+}
+
+/* Lower bound on the weight items k.. must add to gain at least need value,
+ * filling lightest-per-value first and splitting the last item.
+ */
+static long long weight_floor(const bb_search_t *s, size_t k, long long need) {
+  const long long *pw = s->prefix_weight;
+  const long long *pv = s->prefix_value;
+  const size_t full = first_above(pv, k + 1U, s->used, pv[k] + need - 1) - 1U;
+  if (full == s->used) {
+    return pw[full] - pw[k];
+  }
+  const long long short_by = need - (pv[full] - pv[k]);
+  const bb_item_t *part = &s->order[full];
+  return pw[full] - pw[k] + ceil_div(short_by * part->weight, part->value);
+}
+
+/* Whether a node could still lead to a strictly better selection than the
+ * incumbent.
+ */
+static bool promising(const bb_search_t *s, size_t k, long long value, long long weight,
+                      long long capacity) {
+  if (k == s->used) {
+    return false;
+  }
+  const long long bound = value + upper_bound(s, k, capacity - weight);
+  if (bound != s->value) {
+    return bound > s->value;
+  }
+  const long long need = s->value - value;
+  return need > 0 && weight + weight_floor(s, k, need) < s->weight;
+}
+
+static void record(bb_search_t *s, size_t depth, long long value, long long weight) {
+  s->value = value;
+  s->weight = weight;
+  memcpy(s->best, s->path, depth);
+  memset(s->best + depth, BB_PATH_OUT, s->used - depth);
+}
+
+bb_status_t bb_run(const knapsack_item_t *items, size_t count, int capacity,
+                   const cancel_t *cancel, bb_search_t *s) {
+  size_t m = 0U;
+  for (size_t i = 0; i < count; ++i) {
+    if (items[i].value > 0) {
+      s->order[m++] = (bb_item_t){items[i].weight, items[i].value, i};
+    }
+  }
+  s->used = m;
+  qsort(s->order, m, sizeof(bb_item_t), compare_ratio);
+  s->prefix_weight[0] = 0;
+  s->prefix_value[0] = 0;
+  for (size_t i = 0; i < m; ++i) {
+    s->prefix_weight[i + 1U] = s->prefix_weight[i] + s->order[i].weight;
+    s->prefix_value[i + 1U] = s->prefix_value[i] + s->order[i].value;
+  }
+  s->root_bound = upper_bound(s, 0U, capacity);
+
+  /* The empty selection is the first incumbent; the first dive is the
+   * greedy selection.
+   */
+  s->value = 0;
+  s->weight = 0;
+  memset(s->best, BB_PATH_OUT, m);
+  size_t k = 0U;
+  long long value = 0;
+  long long weight = 0;
+  size_t credit = 0U;
+  s->nodes = 0U;
+  for (;;) {
+    ++s->nodes;
+    if (cancel_poll(cancel, &credit, 1U)) {
+      return BB_CANCELLED;
+    }
+    if (value > s->value || (value == s->value && weight < s->weight)) {
+      record(s, k, value, weight);
+      if (value > INT_MAX) {
+        return BB_OVERFLOW;
+      }
+    }
+    if (promising(s, k, value, weight, capacity)) {
+      const bb_item_t *item = &s->order[k];
+      if (weight + item->weight <= capacity) {
+        s->path[k] = BB_PATH_TAKEN;
+        value += item->value;
+        weight += item->weight;
+      } else {
+        s->path[k] = BB_PATH_OUT;
+      }
+      ++k;
+      continue;
+    }
+    /* Back up to the deepest taken item and continue with the branch
+     * without it: a node at the same depth whose item is now out.
+     */
+    while (k > 0U && s->path[k - 1U] != BB_PATH_TAKEN) {
+      --k;
+    }
+    if (k == 0U) {
+      return BB_DONE;
+    }
+    const bb_item_t *item = &s->order[k - 1U];
+    s->path[k - 1U] = BB_PATH_OUT;
+    value -= item->value;
+    weight -= item->weight;
+  }
+}
+
+size_t bb_collect(bb_search_t *s, size_t count, size_t *indices) {
+  size_t selected = 0U;
+  for (size_t i = 0; i < s->used; ++i) {
+    selected += s->best[i] == BB_PATH_TAKEN;
+  }
+  if (!indices || selected == 0U) {
+    return selected;
+  }
+  /* Mark by instance index (path is free now) so the output is ascending. */
+  memset(s->path, BB_PATH_OUT, count);
+  for (size_t i = 0; i < s->used; ++i) {
+    if (s->best[i] == BB_PATH_TAKEN) {
+      s->path[s->order[i].index] = BB_PATH_TAKEN;
+    }
+  }
+  size_t write = 0U;
+  for (size_t i = 0; i < count; ++i) {
+    if (s->path[i] == BB_PATH_TAKEN) {
+      indices[write++] = i;
+    }
+  }
+  return selected;
+}
@@ -1,5 +1,5 @@
-/* Internal interface shared between src/cli/parse.c, src/cli/format.c and
- * src/main.c. NOT part of the public knapsack library API.
+/* Internal interface shared between src/cli/parse.c, src/cli/format.c,
+ * src/cli/input.c, src/cli/stream.c and src/main.c. NOT part of the public knapsack library API.
  */
 #ifndef KNAPSACK_CLI_INTERNAL_H
 #define KNAPSACK_CLI_INTERNAL_H
@@ -20,11 +20,85 @@ extern "C" {
  */
 enum {
   KNAPSACK_CLI_CAP_LINE_MAX = 256,
-  KNAPSACK_CLI_ITEM_LINE_MAX = 8192,
-  KNAPSACK_CLI_INITIAL_ITEM_CAP = 16
+  KNAPSACK_CLI_TOKEN_MAX = 64,       /* longest accepted weight:value token, exclusive */
+  KNAPSACK_CLI_INITIAL_ITEM_CAP = 16,
+  KNAPSACK_CLI_READ_CHUNK = 65536,   /* read() size when the input cannot be mapped */
+  KNAPSACK_CLI_STREAM_BATCH = 256,   /* most --stream records handed to a pool at once */
+  KNAPSACK_CLI_OUTPUT_BUFFER = 65536 /* --stream output buffered between writes */
 };
 
-/* JSON-friendly name of a status code, for example "OK", "INVALID_ITEMS". */
+/* The whole input, read-only. Regular files are mapped (mapping != NULL);
+ * pipes, terminals and other streams are read in chunks into heap.
+ */
+typedef struct {
+  const char *data;
+  size_t length;
+  void *mapping;
+  size_t mapping_length;
+  char *heap;
+} cli_input_t;
+
+/* Open path ("-" is stdin) and make its contents available in *input.
+ * Returns 0 on success, -1 on failure with errno set (for perror).
+ */
+int cli_input_open(const char *path, cli_input_t *input);
+
+/* Release what cli_input_open acquired. Safe on a zeroed input. */
+void cli_input_close(cli_input_t *input);
+
+/* Line reader for inputs of unbounded length (--stream). The buffer holds
+ * the unconsumed tail of what has been read and grows to the longest line.
+ */
+typedef struct {
+  int fd;
+  bool owns_fd;
+  bool eof;
+  char *buffer;
+  size_t size;    /* bytes allocated */
+  size_t start;   /* first byte of the next line */
+  size_t scanned; /* [start, scanned) is known to hold no newline */
+  size_t end;     /* one past the last byte read */
+} cli_stream_t;
+
+/* Open path ("-" is stdin) for line reading. Returns 0 on success, -1 with
+ * errno set on failure.
+ */
+int cli_stream_open(const char *path, cli_stream_t *stream);
+
+/* Read the next line. Returns 1 and sets *line and *length (newline
+ * excluded; the last line need not have one), 0 at end of input, or -1 with
+ * errno set on a read or allocation failure. The line stays valid until the
+ * next call.
+ */
+int cli_stream_next_line(cli_stream_t *stream, const char **line, size_t *length);
+
+/* True if cli_stream_next_line would return without blocking: a whole line
+ * is buffered, the input has ended, or the descriptor is readable now.
+ */
+bool cli_stream_ready(cli_stream_t *stream);
+
+/* Release the buffer and close the descriptor if open opened it. */
+void cli_stream_close(cli_stream_t *stream);
+
+/* --stream settings. */
+typedef struct {
+  bool value_only;              /* report value and weight only */
+  bool binary;                  /* binary result records instead of NDJSON */
+  knapsack_thread_pool_t *pool; /* NULL solves records one at a time */
+} cli_stream_config_t;
+
+/* Solve every (capacity line, items line) record of input and write one
+ * result per record to stdout, in input order, flushing whenever the input
+ * would block. Blank lines between records are skipped. A malformed or
+ * unsolvable record gets an error result and the stream carries on.
+ * Returns 0 at end of input, -1 with errno set if reading, writing or an
+ * allocation failed.
+ */
+int cli_stream_run(cli_stream_t *input, const cli_stream_config_t *config);
+
+/* JSON-friendly name of a status code, for example "OK", "INVALID_ITEMS"
+ * (knapsack_status_name).
+ */
 const char *cli_status_to_string(knapsack_status_t status);
 
 /* Append a JSON-escaped string into the given stream (no surrounding quotes). */
@@ -39,15 +113,47 @@ int cli_parse_capacity(FILE *file, int *capacity);
  * *count. On failure returns -1 and *items is NULL. */
 int cli_parse_items(FILE *file, knapsack_item_t **items, size_t *count);
 
+/* Zero-copy line parsers over [*cursor, end): each parses the line that
+ * starts at *cursor in place and, on success, advances *cursor past its
+ * newline (or to end). Lines have no length limit other than the capacity
+ * line's KNAPSACK_CLI_CAP_LINE_MAX. Same results and ownership as the FILE
+ * variants above.
+ */
+int cli_parse_capacity_line(const char **cursor, const char *end, int *capacity);
+int cli_parse_items_line(const char **cursor, const char *end, knapsack_item_t **items,
+                         size_t *count);
+
 /* Parse a single buffer (e.g. for fuzzing). buffer need not be NUL terminated;
- * length bytes are consumed. Returns 0 on success and sets items and count
+ * the first line is the capacity and the second the items; anything after it
+ * is ignored, as it is in a file. Returns 0 on success and sets items and count
  * outputs. Caller must free the items array. */
 int cli_parse_buffer(const char *buffer, size_t length, int *capacity, knapsack_item_t **items,
                      size_t *count);
 
-/* Output helpers; all write to stdout. */
+/* Decode a binary instance (see knapsack_binary_save_instance) of length
+ * bytes. Returns 0 on success and sets the outputs; *items is malloc'd (NULL
+ * for an empty instance) and the caller frees it. Returns -1 with *items NULL
+ * if the data is malformed or allocation fails.
+ */
+int cli_parse_binary(const char *data, size_t length, int *capacity, knapsack_item_t **items,
+                     size_t *count);
+
+/* Write the binary result record of status (and result, which may be NULL
+ * for an error) to stream. Returns 0 on success, -1 if it cannot be built
+ * or written.
+ */
+int cli_print_result_binary(FILE *stream, knapsack_status_t status,
+                            const knapsack_result_t *result);
+
+/* Text and JSON output helpers; all write to stdout. The JSON ones are
+ * wrappers that render through a knapsack_writer_t on the stack and write
+ * the object with one fwrite; a non-NULL stats adds its "stats" member.
+ */
 void cli_print_result_text(const knapsack_result_t *result);
-void cli_print_result_json(const knapsack_result_t *result);
+void cli_print_result_json(const knapsack_result_t *result, const knapsack_stats_t *stats);
+/* --value-only variants: optimal value and total weight, no indices. */
+void cli_print_value_text(const knapsack_result_t *result);
+void cli_print_value_json(const knapsack_result_t *result, const knapsack_stats_t *stats);
 void cli_print_error_text(FILE *stream, const char *message);
 void cli_print_error_json(FILE *stream, const char *message, knapsack_status_t status);
 
@@ -3,65 +3,25 @@
 #include "knapsack/knapsack.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 
-const char *cli_status_to_string(knapsack_status_t status) {
-  switch (status) {
-  case KNAPSACK_OK:
-    return "OK";
-  case KNAPSACK_ERR_NULL_RESULT:
-    return "NULL_RESULT";
-  case KNAPSACK_ERR_INVALID_ITEMS:
-    return "INVALID_ITEMS";
-  case KNAPSACK_ERR_TOO_MANY_ITEMS:
-    return "TOO_MANY_ITEMS";
-  case KNAPSACK_ERR_INVALID_CAPACITY:
-    return "INVALID_CAPACITY";
-  case KNAPSACK_ERR_DIMENSION_OVERFLOW:
-    return "DIMENSION_OVERFLOW";
-  case KNAPSACK_ERR_INT_OVERFLOW:
-    return "INT_OVERFLOW";
-  case KNAPSACK_ERR_ALLOC:
-    return "ALLOC";
-  }
-  return "UNKNOWN";
+const char *cli_status_to_string(knapsack_status_t status) { return knapsack_status_name(status); }
+
+static int write_to_file(const void *data, size_t size, void *user_data) {
+  return fwrite(data, 1, size, user_data) == size ? 0 : -1;
 }
 
+/* The FILE* helpers below render through a knapsack_writer_t over this much
+ * stack, which reaches the stream in one fwrite for any ordinary result.
+ */
+enum { PRINT_BUFFER_SIZE = 4096 };
+
 void cli_json_quote(FILE *stream, const char *text) {
-  if (!text) {
-    return;
-  }
-  for (const unsigned char *p = (const unsigned char *)text; *p != '\0'; ++p) {
-    const unsigned char c = *p;
-    switch (c) {
-    case '"':
-      fputs("\\\"", stream);
-      break;
-    case '\\':
-      fputs("\\\\", stream);
-      break;
-    case '\b':
-      fputs("\\b", stream);
-      break;
-    case '\f':
-      fputs("\\f", stream);
-      break;
-    case '\n':
-      fputs("\\n", stream);
-      break;
-    case '\r':
-      fputs("\\r", stream);
-      break;
-    case '\t':
-      fputs("\\t", stream);
-      break;
-    default:
-      if (c < 0x20U) {
-        fprintf(stream, "\\u%04x", c);
-      } else {
-        fputc((int)c, stream);
-      }
-      break;
-    }
+  char storage[PRINT_BUFFER_SIZE];
+  knapsack_writer_t writer;
+  knapsack_writer_init(&writer, storage, sizeof storage, write_to_file, stream);
+  if (knapsack_json_write_string(&writer, text) == KNAPSACK_OK) {
+    (void)knapsack_writer_flush(&writer);
   }
 }
 
@@ -74,15 +34,27 @@ void cli_print_result_text(const knapsack_result_t *result) {
   printf("\n");
 }
 
-void cli_print_result_json(const knapsack_result_t *result) {
-  printf("{\"status\":\"ok\",\"optimal_value\":%d,\"selected_indices\":[", result->optimal_value);
-  for (size_t i = 0; i < result->selected_count; ++i) {
-    if (i > 0U) {
-      fputc(',', stdout);
-    }
-    printf("%zu", result->selected_indices[i]);
+void cli_print_result_json(const knapsack_result_t *result, const knapsack_stats_t *stats) {
+  char storage[PRINT_BUFFER_SIZE];
+  knapsack_writer_t writer;
+  knapsack_writer_init(&writer, storage, sizeof storage, write_to_file, stdout);
+  if (knapsack_json_write_result_ex(&writer, result, stats) == KNAPSACK_OK) {
+    (void)knapsack_writer_flush(&writer);
+  }
+}
+
+void cli_print_value_text(const knapsack_result_t *result) {
+  printf("Optimal value: %d\n", result->optimal_value);
+  printf("Total weight: %d\n", result->total_weight);
+}
+
+void cli_print_value_json(const knapsack_result_t *result, const knapsack_stats_t *stats) {
+  char storage[PRINT_BUFFER_SIZE];
+  knapsack_writer_t writer;
+  knapsack_writer_init(&writer, storage, sizeof storage, write_to_file, stdout);
+  if (knapsack_json_write_value_ex(&writer, result, stats) == KNAPSACK_OK) {
+    (void)knapsack_writer_flush(&writer);
   }
-  fputs("]}\n", stdout);
 }
 
 void cli_print_error_text(FILE *stream, const char *message) {
@@ -93,9 +65,27 @@ void cli_print_error_text(FILE *stream, const char *message) {
 }
 
 void cli_print_error_json(FILE *stream, const char *message, knapsack_status_t status) {
-  fputs("{\"status\":\"error\",\"code\":\"", stream);
-  fputs(cli_status_to_string(status), stream);
-  fputs("\",\"message\":\"", stream);
-  cli_json_quote(stream, message ? message : "");
-  fputs("\"}\n", stream);
+  char storage[PRINT_BUFFER_SIZE];
+  knapsack_writer_t writer;
+  knapsack_writer_init(&writer, storage, sizeof storage, write_to_file, stream);
+  if (knapsack_json_write_error(&writer, status, message) == KNAPSACK_OK) {
+    (void)knapsack_writer_flush(&writer);
+  }
+}
+
+int cli_print_result_binary(FILE *stream, knapsack_status_t status,
+                            const knapsack_result_t *result) {
+  const size_t size = knapsack_binary_result_size(result);
+  unsigned char *record = size > 0U ? malloc(size) : NULL;
+  if (!record) {
+    return -1;
+  }
+  size_t written = 0U;
+  int rc = -1;
+  if (knapsack_binary_save_result(status, result, record, size, &written) == KNAPSACK_OK &&
+      fwrite(record, 1, written, stream) == written) {
+    rc = 0;
+  }
+  free(record);
+  return rc;
 }
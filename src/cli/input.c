@@ -0,0 +1,211 @@
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE /* madvise */
+
+#include "cli_internal.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* Read everything from fd into a heap block that doubles as it fills. */
+static int read_all(int fd, cli_input_t *input) {
+  size_t size = 0U;
+  size_t length = 0U;
+  char *heap = NULL;
+  for (;;) {
+    if (size - length < (size_t)KNAPSACK_CLI_READ_CHUNK) {
+      const size_t grown = size == 0U ? (size_t)KNAPSACK_CLI_READ_CHUNK : size * 2U;
+      if (grown < size) {
+        free(heap);
+        errno = ENOMEM;
+        return -1;
+      }
+      char *tmp = realloc(heap, grown);
+      if (!tmp) {
+        free(heap);
+        errno = ENOMEM;
+        return -1;
+      }
+      heap = tmp;
+      size = grown;
+    }
+    const ssize_t got = read(fd, heap + length, size - length);
+    if (got < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      const int saved = errno;
+      free(heap);
+      errno = saved;
+      return -1;
+    }
+    if (got == 0) {
+      break;
+    }
+    length += (size_t)got;
+  }
+  input->heap = heap;
+  input->data = heap;
+  input->length = length;
+  return 0;
+}
+
+int cli_input_open(const char *path, cli_input_t *input) {
+  if (!path || !input) {
+    errno = EINVAL;
+    return -1;
+  }
+  memset(input, 0, sizeof *input);
+  const bool is_stdin = strcmp(path, "-") == 0;
+  const int fd = is_stdin ? STDIN_FILENO : open(path, O_RDONLY);
+  if (fd < 0) {
+    return -1;
+  }
+
+  /* Map regular files so the parsers read the page cache directly. Empty
+   * files cannot be mapped and anything else (pipes, terminals) may not be
+   * seekable; those are read instead.
+   */
+  int rc = 0;
+  struct stat info;
+  if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0 &&
+      (uintmax_t)info.st_size <= (uintmax_t)SIZE_MAX) {
+    const size_t length = (size_t)info.st_size;
+    void *mapping = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapping != MAP_FAILED) {
+#ifdef MADV_SEQUENTIAL
+      (void)madvise(mapping, length, MADV_SEQUENTIAL);
+#endif
+      input->mapping = mapping;
+      input->mapping_length = length;
+      input->data = mapping;
+      input->length = length;
+    } else {
+      rc = read_all(fd, input);
+    }
+  } else {
+    rc = read_all(fd, input);
+  }
+
+  if (!is_stdin) {
+    const int saved = errno;
+    close(fd);
+    errno = saved;
+  }
+  return rc;
+}
+
+void cli_input_close(cli_input_t *input) {
+  if (!input) {
+    return;
+  }
+  if (input->mapping) {
+    munmap(input->mapping, input->mapping_length);
+  }
+  free(input->heap);
+  memset(input, 0, sizeof *input);
+}
+
+int cli_stream_open(const char *path, cli_stream_t *stream) {
+  if (!path || !stream) {
+    errno = EINVAL;
+    return -1;
+  }
+  memset(stream, 0, sizeof *stream);
+  const bool is_stdin = strcmp(path, "-") == 0;
+  stream->fd = is_stdin ? STDIN_FILENO : open(path, O_RDONLY);
+  if (stream->fd < 0) {
+    return -1;
+  }
+  stream->owns_fd = !is_stdin;
+  return 0;
+}
+
+/* Make room for another read: drop consumed bytes, then double if full. */
+static int make_room(cli_stream_t *stream) {
+  if (stream->start > 0U) {
+    const size_t kept = stream->end - stream->start;
+    memmove(stream->buffer, stream->buffer + stream->start, kept);
+    stream->scanned -= stream->start;
+    stream->end = kept;
+    stream->start = 0U;
+  }
+  if (stream->size - stream->end >= (size_t)KNAPSACK_CLI_READ_CHUNK) {
+    return 0;
+  }
+  const size_t grown = stream->size == 0U ? (size_t)KNAPSACK_CLI_READ_CHUNK : stream->size * 2U;
+  if (grown < stream->size) {
+    errno = ENOMEM;
+    return -1;
+  }
+  char *tmp = realloc(stream->buffer, grown);
+  if (!tmp) {
+    errno = ENOMEM;
+    return -1;
+  }
+  stream->buffer = tmp;
+  stream->size = grown;
+  return 0;
+}
+
+int cli_stream_next_line(cli_stream_t *stream, const char **line, size_t *length) {
+  for (;;) {
+    const char *newline = NULL;
+    if (stream->scanned < stream->end) {
+      newline = memchr(stream->buffer + stream->scanned, '\n', stream->end - stream->scanned);
+    }
+    if (newline || (stream->eof && stream->start < stream->end)) {
+      const size_t stop = newline ? (size_t)(newline - stream->buffer) : stream->end;
+      *line = stream->buffer + stream->start;
+      *length = stop - stream->start;
+      stream->start = newline ? stop + 1U : stop;
+      stream->scanned = stream->start;
+      return 1;
+    }
+    if (stream->eof) {
+      return 0;
+    }
+    stream->scanned = stream->end;
+    if (make_room(stream) != 0) {
+      return -1;
+    }
+    const ssize_t got = read(stream->fd, stream->buffer + stream->end, stream->size - stream->end);
+    if (got < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return -1;
+    }
+    if (got == 0) {
+      stream->eof = true;
+    }
+    stream->end += (size_t)got;
+  }
+}
+
+bool cli_stream_ready(cli_stream_t *stream) {
+  if (stream->eof || (stream->scanned < stream->end &&
+                      memchr(stream->buffer + stream->scanned, '\n',
+                             stream->end - stream->scanned) != NULL)) {
+    return true;
+  }
+  struct pollfd pfd = {.fd = stream->fd, .events = POLLIN, .revents = 0};
+  return poll(&pfd, 1, 0) > 0;
+}
+
+void cli_stream_close(cli_stream_t *stream) {
+  if (!stream) {
+    return;
+  }
+  if (stream->owns_fd && stream->fd >= 0) {
+    close(stream->fd);
+  }
+  free(stream->buffer);
+  memset(stream, 0, sizeof *stream);
+}
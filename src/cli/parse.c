@@ -4,110 +4,175 @@
 
 #include "knapsack/knapsack.h"
 
-#include <assert.h>
-#include <ctype.h>
-#include <errno.h>
 #include <limits.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/types.h>
 
-/* Compile-time guard: the line buffers must fit in fgets's int size argument.
- * These are now enum constants, so _Static_assert works as intended.
+/* Compile-time guard: the capacity line buffer must fit in fgets's int size
+ * argument. These are enum constants, so _Static_assert works as intended.
  */
 _Static_assert(KNAPSACK_CLI_CAP_LINE_MAX > 0 && KNAPSACK_CLI_CAP_LINE_MAX <= INT_MAX,
                "CAP_LINE_MAX must fit in int");
-_Static_assert(KNAPSACK_CLI_ITEM_LINE_MAX > 0 && KNAPSACK_CLI_ITEM_LINE_MAX <= INT_MAX,
-               "ITEM_LINE_MAX must fit in int");
 
 static const int DECIMAL_BASE = 10;
 
-static bool has_only_trailing_space(const char *cursor) {
-  while (*cursor != '\0') {
-    if (*cursor != ' ' && *cursor != '\t' && *cursor != '\r' && *cursor != '\n') {
-      return false;
-    }
-    ++cursor;
-  }
-  return true;
-}
+/* Smallest item token ("w:v") plus one delimiter: no line holds more items
+ * than its length divided by this (rounded up).
+ */
+enum { KNAPSACK_CLI_MIN_ITEM_BYTES = 4, KNAPSACK_CLI_TYPICAL_ITEM_BYTES = 8 };
 
-static int read_line_into(char *buffer, size_t buffer_size, FILE *file) {
-  if (!buffer || buffer_size == 0U || !file) {
-    return -1;
-  }
-  if (!fgets(buffer, (int)buffer_size, file)) {
-    return -1;
+/* Character classes for the item scanner: one table load per byte instead
+ * of a chain of comparisons. DELIMITER separates tokens; strtol also skips
+ * SPACE (and the white-space delimiters) before a number.
+ */
+enum { CLASS_OTHER = 0, CLASS_DELIMITER = 1, CLASS_SPACE = 2 };
+
+static const unsigned char k_char_class[UCHAR_MAX + 1] = {
+    [' '] = CLASS_DELIMITER,  [','] = CLASS_DELIMITER,  ['\t'] = CLASS_DELIMITER,
+    ['\r'] = CLASS_DELIMITER, ['\n'] = CLASS_DELIMITER, ['\v'] = CLASS_SPACE,
+    ['\f'] = CLASS_SPACE,
+};
+
+static unsigned char char_class(char c) { return k_char_class[(unsigned char)c]; }
+
+static bool is_strtol_space(char c) { return c != ',' && char_class(c) != CLASS_OTHER; }
+
+static bool is_digit(char c) { return (unsigned char)(c - '0') < 10U; }
+
+static bool is_trailing_space(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; }
+
+/* Eight digits at a time, on targets where a byte load order is known. The
+ * numbers are at most ten significant digits, so one word usually covers a
+ * whole number and its terminator.
+ */
+#if defined(__GNUC__) && defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define KNAPSACK_CLI_SWAR 1
+
+static const uint64_t SWAR_ONES = 0x0101010101010101ULL;
+
+/* Leading digits of cursor[0, 8) (byte i is character i): their count, and
+ * their value in *value.
+ */
+static unsigned swar_digits(const char *cursor, uint64_t *value) {
+  uint64_t word = 0;
+  memcpy(&word, cursor, sizeof word);
+  /* A byte is a digit when it and it + 6 both have the high nibble 3. A
+   * carry out of a byte can only come from a non-digit, so it never hides
+   * the first one.
+   */
+  const uint64_t high = SWAR_ONES * 0xF0U;
+  const uint64_t three = SWAR_ONES * 0x30U;
+  const uint64_t other = ((word & high) ^ three) | (((word + SWAR_ONES * 0x06U) & high) ^ three);
+  const unsigned count = other ? (unsigned)__builtin_ctzll(other) / 8U : 8U;
+  if (count == 0U) {
+    return 0U;
   }
-  if (strchr(buffer, '\n') == NULL && !feof(file)) {
-    return -1; /* line too long */
+  /* Keep the digits and move them to the top, so the bytes below read as
+   * leading zeros; then fold pairs, quads and octets.
+   */
+  uint64_t digits = word - three;
+  if (count < 8U) {
+    digits <<= 8U * (8U - count);
   }
-  return 0;
+  digits = (digits * 10U + (digits >> 8U)) & 0x00FF00FF00FF00FFULL;
+  digits = (digits * 100U + (digits >> 16U)) & 0x0000FFFF0000FFFFULL;
+  digits = (digits * 10000U + (digits >> 32U)) & 0xFFFFFFFFULL;
+  *value = digits;
+  return count;
 }
+#endif
 
-int cli_parse_capacity(FILE *file, int *capacity) {
-  char line[KNAPSACK_CLI_CAP_LINE_MAX];
-  if (read_line_into(line, sizeof line, file) != 0) {
-    return -1;
+/* The digits at *cursor, before stop: at least one, with a value of at most
+ * INT_MAX (every caller rejects more, as it rejected strtol's range). On
+ * success *cursor is the first byte after them.
+ */
+static bool scan_digits(const char **cursor, const char *stop, uint64_t *out) {
+  const char *at = *cursor;
+  uint64_t magnitude = 0;
+#ifdef KNAPSACK_CLI_SWAR
+  static const uint64_t k_pow10[9] = {1,      10,      100,      1000,     10000,
+                                       100000, 1000000, 10000000, 100000000};
+  while (stop - at >= 8) {
+    uint64_t chunk = 0;
+    const unsigned count = swar_digits(at, &chunk);
+    magnitude = magnitude * k_pow10[count] + chunk;
+    at += count;
+    if (magnitude > INT_MAX) {
+      return false;
+    }
+    if (count < 8U) {
+      break;
+    }
   }
-  errno = 0;
-  char *endptr = NULL;
-  const long parsed = strtol(line, &endptr, DECIMAL_BASE);
-  if (errno != 0 || endptr == line || !has_only_trailing_space(endptr)) {
-    return -1;
+#endif
+  while (at < stop && is_digit(*at)) {
+    magnitude = magnitude * (uint64_t)DECIMAL_BASE + (uint64_t)(*at - '0');
+    if (magnitude > INT_MAX) {
+      return false;
+    }
+    ++at;
   }
-  if (parsed < 0 || parsed > INT_MAX) {
-    return -1;
+  if (at == *cursor) {
+    return false;
   }
-  *capacity = (int)parsed;
-  return 0;
+  *cursor = at;
+  *out = magnitude;
+  return true;
 }
 
-static bool parse_item_token(const char *token, int *weight_out, int *value_out) {
-  const char *colon = strchr(token, ':');
-  if (!colon || colon == token || colon[1] == '\0') {
-    return false;
-  }
-  /* Make a local copy so we can NUL-terminate the weight side. */
-  char buffer[64];
-  const size_t token_len = strlen(token);
-  if (token_len >= sizeof buffer) {
-    return false;
+/* strtol's grammar for a non-negative int: optional white space and sign,
+ * then digits ("-0" is zero, as strtol reads it). Inside an item token the
+ * only white space left to skip is what is not a delimiter.
+ */
+static bool scan_number(const char **cursor, const char *stop, bool in_token, int *out) {
+  const char *at = *cursor;
+  while (at < stop && (in_token ? char_class(*at) == CLASS_SPACE : is_strtol_space(*at))) {
+    ++at;
   }
-  memcpy(buffer, token, token_len + 1U);
-  const size_t colon_offset = (size_t)(colon - token);
-  buffer[colon_offset] = '\0';
-  const char *const weight_str = buffer;
-  const char *const value_str = buffer + colon_offset + 1U;
-
-  errno = 0;
-  char *endptr = NULL;
-  const long weight_val = strtol(weight_str, &endptr, DECIMAL_BASE);
-  if (errno != 0 || endptr == weight_str || *endptr != '\0') {
-    return false;
+  bool negative = false;
+  if (at < stop && (*at == '+' || *at == '-')) {
+    negative = *at == '-';
+    ++at;
   }
-  if (weight_val <= 0 || weight_val > INT_MAX) {
+  uint64_t magnitude = 0;
+  if (!scan_digits(&at, stop, &magnitude) || (negative && magnitude != 0U)) {
     return false;
   }
+  *cursor = at;
+  *out = (int)magnitude;
+  return true;
+}
 
-  errno = 0;
-  endptr = NULL;
-  const long value_val = strtol(value_str, &endptr, DECIMAL_BASE);
-  if (errno != 0 || endptr == value_str || *endptr != '\0') {
+/* One weight:value token at *cursor, in a single pass. Tokens as long as
+ * the fixed copy buffer the parser once used (KNAPSACK_CLI_TOKEN_MAX) are
+ * still rejected, so the scan never looks further than that.
+ */
+static bool scan_item(const char **cursor, const char *end, knapsack_item_t *item) {
+  const char *at = *cursor;
+  const char *stop =
+      end - at >= KNAPSACK_CLI_TOKEN_MAX ? at + (KNAPSACK_CLI_TOKEN_MAX - 1) : end;
+  int weight = 0;
+  int value = 0;
+  if (!scan_number(&at, stop, true, &weight) || weight == 0 || at == stop || *at != ':') {
     return false;
   }
-  if (value_val < 0 || value_val > INT_MAX) {
+  ++at;
+  if (!scan_number(&at, stop, true, &value) || (at < end && char_class(*at) != CLASS_DELIMITER)) {
     return false;
   }
-
-  *weight_out = (int)weight_val;
-  *value_out = (int)value_val;
+  item->weight = weight;
+  item->value = value;
+  *cursor = at;
   return true;
 }
 
-static bool ensure_item_capacity(knapsack_item_t **items, size_t *capacity, size_t count) {
+/* Grow toward limit (the most items the line can hold) by doubling. */
+static bool ensure_item_capacity(knapsack_item_t **items, size_t *capacity, size_t count,
+                                 size_t limit) {
   if (count < *capacity) {
     return true;
   }
@@ -115,6 +180,9 @@ static bool ensure_item_capacity(knapsack_item_t **items, size_t *capacity, size
     return false;
   }
   size_t new_capacity = *capacity * 2U;
+  if (new_capacity > limit) {
+    new_capacity = limit > count ? limit : count + 1U;
+  }
   if (new_capacity > SIZE_MAX / sizeof(knapsack_item_t)) {
     return false;
   }
@@ -127,32 +195,46 @@ static bool ensure_item_capacity(knapsack_item_t **items, size_t *capacity, size
   return true;
 }
 
-/* Parse a NUL-terminated, mutable line into items. Returns 0 on success. */
-static int parse_items_line(char *line, knapsack_item_t **items_out, size_t *count_out) {
-  size_t capacity = (size_t)KNAPSACK_CLI_INITIAL_ITEM_CAP;
+/* End of the line starting at cursor: its newline, or end. */
+static const char *line_end(const char *cursor, const char *end) {
+  const char *newline = memchr(cursor, '\n', (size_t)(end - cursor));
+  return newline ? newline : end;
+}
+
+/* Parse the items in [line, end) in place. The array is sized from the line
+ * length up front, so typical inputs never reallocate.
+ */
+static int parse_items_span(const char *line, const char *end, knapsack_item_t **items_out,
+                            size_t *count_out) {
+  const size_t length = (size_t)(end - line);
+  const size_t limit = length / KNAPSACK_CLI_MIN_ITEM_BYTES + 1U;
+  size_t capacity = length / KNAPSACK_CLI_TYPICAL_ITEM_BYTES + 1U;
+  if (capacity < (size_t)KNAPSACK_CLI_INITIAL_ITEM_CAP) {
+    capacity = (size_t)KNAPSACK_CLI_INITIAL_ITEM_CAP;
+  }
+  if (capacity > SIZE_MAX / sizeof(knapsack_item_t)) {
+    return -1;
+  }
   size_t count = 0U;
   knapsack_item_t *items = malloc(capacity * sizeof(knapsack_item_t));
   if (!items) {
     return -1;
   }
 
-  const char *delims = " ,\t\r\n";
   bool ok = true;
-  char *saveptr = NULL;
-  for (const char *token = strtok_r(line, delims, &saveptr); token != NULL;
-       token = strtok_r(NULL, delims, &saveptr)) {
-    int weight = 0;
-    int value = 0;
-    if (!parse_item_token(token, &weight, &value)) {
-      ok = false;
+  const char *cursor = line;
+  for (;;) {
+    while (cursor < end && char_class(*cursor) == CLASS_DELIMITER) {
+      ++cursor;
+    }
+    if (cursor == end) {
       break;
     }
-    if (!ensure_item_capacity(&items, &capacity, count)) {
+    if (!ensure_item_capacity(&items, &capacity, count, limit) ||
+        !scan_item(&cursor, end, &items[count])) {
       ok = false;
       break;
     }
-    items[count].weight = weight;
-    items[count].value = value;
     ++count;
   }
 
@@ -165,12 +247,81 @@ static int parse_items_line(char *line, knapsack_item_t **items_out, size_t *cou
   return 0;
 }
 
+int cli_parse_capacity_line(const char **cursor, const char *end, int *capacity) {
+  if (!cursor || !*cursor || !end || *cursor > end || !capacity) {
+    return -1;
+  }
+  const char *line = *cursor;
+  const char *stop_at = line_end(line, end);
+  if ((size_t)(stop_at - line) + 1U >= (size_t)KNAPSACK_CLI_CAP_LINE_MAX) {
+    return -1;
+  }
+  int parsed = 0;
+  const char *stop = line;
+  if (!scan_number(&stop, stop_at, false, &parsed)) {
+    return -1;
+  }
+  while (stop < stop_at && is_trailing_space(*stop)) {
+    ++stop;
+  }
+  if (stop != stop_at) {
+    return -1;
+  }
+  *capacity = parsed;
+  *cursor = stop_at < end ? stop_at + 1 : end;
+  return 0;
+}
+
+int cli_parse_items_line(const char **cursor, const char *end, knapsack_item_t **items,
+                         size_t *count) {
+  if (!items) {
+    return -1;
+  }
+  *items = NULL;
+  if (!cursor || !*cursor || !end || *cursor > end || !count) {
+    return -1;
+  }
+  const char *line = *cursor;
+  const char *stop_at = line_end(line, end);
+  if (parse_items_span(line, stop_at, items, count) != 0) {
+    return -1;
+  }
+  *cursor = stop_at < end ? stop_at + 1 : end;
+  return 0;
+}
+
+int cli_parse_capacity(FILE *file, int *capacity) {
+  if (!file) {
+    return -1;
+  }
+  char line[KNAPSACK_CLI_CAP_LINE_MAX];
+  if (!fgets(line, (int)sizeof line, file)) {
+    return -1;
+  }
+  if (strchr(line, '\n') == NULL && !feof(file)) {
+    return -1; /* line too long */
+  }
+  const char *cursor = line;
+  return cli_parse_capacity_line(&cursor, line + strlen(line), capacity);
+}
+
 int cli_parse_items(FILE *file, knapsack_item_t **items_out, size_t *count_out) {
-  char line[KNAPSACK_CLI_ITEM_LINE_MAX];
-  if (read_line_into(line, sizeof line, file) != 0) {
+  if (items_out) {
+    *items_out = NULL;
+  }
+  if (!file) {
     return -1;
   }
-  return parse_items_line(line, items_out, count_out);
+  char *line = NULL;
+  size_t line_size = 0U;
+  const ssize_t length = getline(&line, &line_size, file);
+  int rc = -1;
+  if (length >= 0) {
+    const char *cursor = line;
+    rc = cli_parse_items_line(&cursor, line + length, items_out, count_out);
+  }
+  free(line);
+  return rc;
 }
 
 int cli_parse_buffer(const char *buffer, size_t length, int *capacity, knapsack_item_t **items,
@@ -181,38 +332,40 @@ int cli_parse_buffer(const char *buffer, size_t length, int *capacity, knapsack_
   *items = NULL;
   *count = 0;
 
-  /* Split into the first newline (capacity line) and the rest (items line). */
-  const char *newline = memchr(buffer, '\n', length);
-  if (!newline) {
+  const char *cursor = buffer;
+  const char *end = buffer + length;
+  if (!memchr(buffer, '\n', length) || cli_parse_capacity_line(&cursor, end, capacity) != 0) {
     return -1;
   }
-  const size_t cap_len = (size_t)(newline - buffer);
-  if (cap_len + 1U >= (size_t)KNAPSACK_CLI_CAP_LINE_MAX) {
+  return cli_parse_items_line(&cursor, end, items, count);
+}
+
+int cli_parse_binary(const char *data, size_t length, int *capacity, knapsack_item_t **items,
+                     size_t *count) {
+  if (!items) {
     return -1;
   }
-  const size_t items_offset = cap_len + 1U;
-  const size_t items_len = length - items_offset;
-  if (items_len + 1U >= (size_t)KNAPSACK_CLI_ITEM_LINE_MAX) {
+  *items = NULL;
+  if (!data || !capacity || !count) {
     return -1;
   }
-
-  char cap_line[KNAPSACK_CLI_CAP_LINE_MAX];
-  memcpy(cap_line, buffer, cap_len);
-  cap_line[cap_len] = '\0';
-
-  errno = 0;
-  char *endptr = NULL;
-  const long parsed = strtol(cap_line, &endptr, DECIMAL_BASE);
-  if (errno != 0 || endptr == cap_line || !has_only_trailing_space(endptr)) {
+  size_t stored = 0U;
+  if (knapsack_binary_instance_header(data, length, &stored, capacity) != KNAPSACK_OK) {
     return -1;
   }
-  if (parsed < 0 || parsed > INT_MAX) {
-    return -1;
+  /* An empty instance parses; the solver reports it like any other. */
+  knapsack_item_t *decoded = NULL;
+  if (stored > 0U) {
+    if (stored > SIZE_MAX / sizeof(knapsack_item_t)) {
+      return -1;
+    }
+    decoded = malloc(stored * sizeof(knapsack_item_t));
+    if (!decoded || knapsack_binary_load_instance(data, length, decoded, stored) != KNAPSACK_OK) {
+      free(decoded);
+      return -1;
+    }
   }
-  *capacity = (int)parsed;
-
-  char items_line[KNAPSACK_CLI_ITEM_LINE_MAX];
-  memcpy(items_line, buffer + items_offset, items_len);
-  items_line[items_len] = '\0';
-  return parse_items_line(items_line, items, count);
+  *items = decoded;
+  *count = stored;
+  return 0;
 }
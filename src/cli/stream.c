@@ -0,0 +1,293 @@
+/* --stream: solve a sequence of (capacity line, items line) records and
+ * write one result per record.
+ *
+ * Records are read in batches that end when the input would block, so a
+ * sidecar answering one request at a time sees each answer as soon as it is
+ * computed, while a file or a busy pipe is processed without a flush per
+ * record. Without a pool every record is solved in one long-lived
+ * workspace; with a pool each batch goes through knapsack_solve_batch and
+ * the results are written back in input order. Results are rendered into
+ * one knapsack_writer_t that reaches stdout in large writes.
+ */
+#include "cli_internal.h"
+
+#include "knapsack/knapsack.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* One record on its way from the parser to the output. */
+typedef struct {
+  knapsack_item_t *items;
+  size_t count;
+  int capacity;
+  knapsack_status_t status; /* parse or solve failure, KNAPSACK_OK otherwise */
+  const char *message;      /* what failed, when status is not KNAPSACK_OK */
+  knapsack_result_t result; /* owned by the record when status is KNAPSACK_OK */
+} record_t;
+
+/* Per-run state: the reusable buffers behind every batch. */
+typedef struct {
+  const cli_stream_config_t *config;
+  knapsack_options_t options;
+  knapsack_workspace_t *workspace; /* serial runs only */
+  record_t *records;
+  size_t batch_max;
+  knapsack_instance_t *instances; /* pooled runs only, batch_max entries each */
+  knapsack_result_t *results;
+  knapsack_status_t *statuses;
+  size_t *slots; /* record index of each instance */
+  knapsack_writer_t writer;
+  char *output;           /* the writer's storage */
+  unsigned char *scratch; /* binary result records, grown as needed */
+  size_t scratch_size;
+} stream_state_t;
+
+static int write_to_file(const void *data, size_t size, void *user_data) {
+  return fwrite(data, 1, size, user_data) == size ? 0 : -1;
+}
+
+static bool is_blank(const char *line, size_t length) {
+  for (size_t i = 0; i < length; ++i) {
+    if (!isspace((unsigned char)line[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void fail_record(record_t *record, knapsack_status_t status, const char *message) {
+  free(record->items);
+  record->items = NULL;
+  record->count = 0U;
+  record->status = status;
+  record->message = message;
+}
+
+/* Read and parse the next record, skipping blank lines before it. Returns 1
+ * with *record filled (a malformed record carries its error), 0 at end of
+ * input or -1 if reading failed.
+ */
+static int read_record(cli_stream_t *input, record_t *record) {
+  const char *line = NULL;
+  size_t length = 0U;
+  int got = 0;
+  do {
+    got = cli_stream_next_line(input, &line, &length);
+  } while (got == 1 && is_blank(line, length));
+  if (got != 1) {
+    return got;
+  }
+
+  *record = (record_t){.status = KNAPSACK_OK};
+  const char *cursor = line;
+  const bool capacity_ok = cli_parse_capacity_line(&cursor, line + length, &record->capacity) == 0;
+  /* The items line belongs to this record even when the capacity is bad, so
+   * one malformed record does not shift every later one.
+   */
+  got = cli_stream_next_line(input, &line, &length);
+  if (got < 0) {
+    return -1;
+  }
+  if (!capacity_ok) {
+    fail_record(record, KNAPSACK_ERR_INVALID_CAPACITY, "Failed to parse capacity");
+    return 1;
+  }
+  cursor = line;
+  if (got == 0 ||
+      cli_parse_items_line(&cursor, line + length, &record->items, &record->count) != 0) {
+    fail_record(record, KNAPSACK_ERR_INVALID_ITEMS, "Failed to parse items");
+  }
+  return 1;
+}
+
+static void solve_serial(stream_state_t *state, record_t *record) {
+  record->status = knapsack_workspace_solve_opts(state->workspace, record->items, record->count,
+                                                 record->capacity, &state->options,
+                                                 &record->result);
+  if (record->status != KNAPSACK_OK) {
+    fail_record(record, record->status, "Knapsack solve failed");
+  }
+}
+
+static void solve_pooled(stream_state_t *state, size_t record_count) {
+  size_t instance_count = 0U;
+  for (size_t i = 0; i < record_count; ++i) {
+    const record_t *record = &state->records[i];
+    if (record->status == KNAPSACK_OK) {
+      state->instances[instance_count] =
+          (knapsack_instance_t){record->items, record->count, record->capacity};
+      state->slots[instance_count++] = i;
+    }
+  }
+  /* The options were validated when the run started, so every instance is
+   * attempted and reports through its own status.
+   */
+  (void)knapsack_solve_batch(state->instances, instance_count, &state->options, state->results,
+                             state->statuses);
+  for (size_t j = 0; j < instance_count; ++j) {
+    record_t *record = &state->records[state->slots[j]];
+    record->status = state->statuses[j];
+    record->result = state->results[j];
+    if (record->status != KNAPSACK_OK) {
+      fail_record(record, record->status, "Knapsack solve failed");
+    }
+  }
+}
+
+/* Append a binary result record through the scratch buffer. */
+static knapsack_status_t write_binary(stream_state_t *state, knapsack_status_t status,
+                                      const knapsack_result_t *result) {
+  const size_t size = knapsack_binary_result_size(result);
+  if (size == 0U) {
+    return KNAPSACK_ERR_DIMENSION_OVERFLOW;
+  }
+  if (size > state->scratch_size) {
+    unsigned char *grown = realloc(state->scratch, size);
+    if (!grown) {
+      return KNAPSACK_ERR_ALLOC;
+    }
+    state->scratch = grown;
+    state->scratch_size = size;
+  }
+  const knapsack_status_t saved =
+      knapsack_binary_save_result(status, result, state->scratch, size, NULL);
+  if (saved != KNAPSACK_OK) {
+    return saved;
+  }
+  return knapsack_writer_append(&state->writer, state->scratch, size);
+}
+
+/* Write one record's result. Returns 0, or -1 if it could not be built or
+ * written.
+ */
+static int emit_record(stream_state_t *state, const record_t *record) {
+  const cli_stream_config_t *config = state->config;
+  knapsack_status_t status = KNAPSACK_OK;
+  if (record->status != KNAPSACK_OK) {
+    if (config->binary) {
+      cli_print_error_text(stderr, record->message);
+      status = write_binary(state, record->status, NULL);
+    } else {
+      status = knapsack_json_write_error(&state->writer, record->status, record->message);
+    }
+  } else if (config->binary) {
+    status = write_binary(state, KNAPSACK_OK, &record->result);
+  } else if (config->value_only) {
+    status = knapsack_json_write_value(&state->writer, &record->result);
+  } else {
+    status = knapsack_json_write_result(&state->writer, &record->result);
+  }
+  return status == KNAPSACK_OK ? 0 : -1;
+}
+
+static void release_record(record_t *record) {
+  if (record->status == KNAPSACK_OK) {
+    knapsack_result_free(&record->result);
+  }
+  free(record->items);
+  record->items = NULL;
+}
+
+static void release_state(stream_state_t *state) {
+  knapsack_workspace_destroy(state->workspace);
+  free(state->records);
+  free(state->instances);
+  free(state->results);
+  free(state->statuses);
+  free(state->slots);
+  free(state->output);
+  free(state->scratch);
+}
+
+static int init_state(stream_state_t *state, const cli_stream_config_t *config) {
+  *state = (stream_state_t){.config = config, .batch_max = 1U};
+  knapsack_options_init(&state->options);
+  if (config->value_only) {
+    state->options.reconstruct = KNAPSACK_RECONSTRUCT_NONE;
+  }
+  state->options.pool = config->pool;
+  bool ok = false;
+  if (config->pool) {
+    const size_t n = KNAPSACK_CLI_STREAM_BATCH;
+    state->batch_max = n;
+    state->instances = malloc(n * sizeof *state->instances);
+    state->results = malloc(n * sizeof *state->results);
+    state->statuses = malloc(n * sizeof *state->statuses);
+    state->slots = malloc(n * sizeof *state->slots);
+    ok = state->instances && state->results && state->statuses && state->slots;
+  } else {
+    state->workspace = knapsack_workspace_create(NULL);
+    ok = state->workspace != NULL;
+  }
+  state->records = malloc(state->batch_max * sizeof *state->records);
+  state->output = malloc(KNAPSACK_CLI_OUTPUT_BUFFER);
+  knapsack_writer_init(&state->writer, state->output, KNAPSACK_CLI_OUTPUT_BUFFER, write_to_file,
+                       stdout);
+  if (!ok || !state->records || !state->output) {
+    release_state(state);
+    errno = ENOMEM;
+    return -1;
+  }
+  return 0;
+}
+
+int cli_stream_run(cli_stream_t *input, const cli_stream_config_t *config) {
+  if (!input || !config) {
+    errno = EINVAL;
+    return -1;
+  }
+  stream_state_t state;
+  if (init_state(&state, config) != 0) {
+    return -1;
+  }
+
+  int rc = 0;
+  for (;;) {
+    size_t count = 0U;
+    int got = 1;
+    while (count < state.batch_max && (got = read_record(input, &state.records[count])) == 1) {
+      ++count;
+      if (!cli_stream_ready(input)) {
+        break;
+      }
+    }
+    /* Keep the read error for the caller; the records before it are still
+     * answered.
+     */
+    const int read_errno = errno;
+
+    if (config->pool) {
+      solve_pooled(&state, count);
+    } else if (count > 0U && state.records[0].status == KNAPSACK_OK) {
+      solve_serial(&state, &state.records[0]);
+    }
+    for (size_t i = 0; i < count; ++i) {
+      if (emit_record(&state, &state.records[i]) != 0 && rc == 0) {
+        rc = -1;
+        errno = EIO;
+      }
+      release_record(&state.records[i]);
+    }
+
+    if (got != 1 || !cli_stream_ready(input)) {
+      if ((knapsack_writer_flush(&state.writer) != KNAPSACK_OK || fflush(stdout) != 0) &&
+          rc == 0) {
+        rc = -1;
+        errno = EIO;
+      }
+    }
+    if (got < 0 && rc == 0) {
+      rc = -1;
+      errno = read_errno;
+    }
+    if (got != 1 || rc != 0) {
+      break;
+    }
+  }
+  release_state(&state);
+  return rc;
+}
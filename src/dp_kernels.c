@@ -0,0 +1,480 @@
+/* DP row kernels and runtime dispatch.
+ *
+ * Every kernel implements the dp_span_t contract from knapsack_internal.h.
+ * The scalar kernel is the reference and the fallback. The SIMD kernels
+ * process 32-bit value and weight lanes side by side, compare all lanes at
+ * once, and OR the per-lane "take" mask straight into take_bits. Any lanes
+ * left over at the low end of a span go through the scalar path.
+ *
+ * knapsack_solve64 runs 64-bit value variants (dp_span64_t): AVX2 and
+ * AVX-512F kernels, and the scalar kernel, which is one macro template
+ * instantiated for both widths.
+ *
+ * The x86 kernels are compiled with per-function target attributes, so the
+ * library itself needs no -m flags. The best supported kernel is picked once
+ * when the library is loaded; knapsack_set_kernel can override it.
+ */
+
+#include "knapsack_internal.h"
+
+#include "knapsack/knapsack.h"
+
+#include <limits.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define KNAPSACK_HAVE_X86_KERNELS 1
+#include <immintrin.h>
+#else
+#define KNAPSACK_HAVE_X86_KERNELS 0
+#endif
+
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#define KNAPSACK_HAVE_NEON_KERNEL 1
+#include <arm_neon.h>
+#if defined(__linux__)
+#include <asm/hwcap.h>
+#include <sys/auxv.h>
+#endif
+#else
+#define KNAPSACK_HAVE_NEON_KERNEL 0
+#endif
+
+/* ------------------------------------------------------------------------- */
+/* Shared helpers                                                             */
+/* ------------------------------------------------------------------------- */
+
+/* OR the low `lanes` bits of mask into bits at bit position pos. Words whose
+ * contribution is zero are not written; a NULL bits records nothing.
+ */
+static void or_mask_bits(uint64_t *bits, size_t pos, uint64_t mask, unsigned lanes) {
+  if (mask == 0U || !bits) {
+    return;
+  }
+  const size_t word = pos / KNAPSACK_BITSET_WORD_BITS;
+  const unsigned shift = (unsigned)(pos % KNAPSACK_BITSET_WORD_BITS);
+  const uint64_t low = mask << shift;
+  if (low != 0U) {
+    bits[word] |= low;
+  }
+  if (shift != 0U && shift + lanes > KNAPSACK_BITSET_WORD_BITS) {
+    const uint64_t high = mask >> (KNAPSACK_BITSET_WORD_BITS - shift);
+    if (high != 0U) {
+      bits[word + 1U] |= high;
+    }
+  }
+}
+
+/* Scalar update of cells [0, end) of the span, from high to low. Stored
+ * and item values are never negative, so take + item overflows exactly when
+ * take > max - item. One template serves both value widths: dp_span_t with
+ * int values and dp_span64_t with int64_t ones.
+ */
+#define DEFINE_SCALAR_KERNEL(suffix, span_t, value_t, value_max)                                  \
+  static bool scalar_cells##suffix(const span_t *s, size_t end) {                                 \
+    const bool in_place = s->out_value == s->keep_value;                                          \
+    for (size_t j = end; j-- > 0;) {                                                              \
+      if (s->take_value[j] > (value_max) - s->item_value) {                                       \
+        return false;                                                                             \
+      }                                                                                           \
+      const value_t candidate_val = s->take_value[j] + s->item_value;                             \
+      const uint32_t candidate_weight = s->take_weight[j] + s->item_weight;                       \
+      const value_t current_val = s->keep_value[j];                                               \
+      const uint32_t current_weight = s->keep_weight[j];                                          \
+                                                                                                  \
+      if (candidate_val > current_val ||                                                          \
+          (candidate_val == current_val && candidate_weight < current_weight)) {                  \
+        s->out_value[j] = candidate_val;                                                          \
+        s->out_weight[j] = candidate_weight;                                                      \
+        or_mask_bits(s->bits, s->bit_offset + j, 1U, 1U);                                         \
+      } else if (!in_place) {                                                                     \
+        s->out_value[j] = current_val;                                                            \
+        s->out_weight[j] = current_weight;                                                        \
+      }                                                                                           \
+    }                                                                                             \
+    return true;                                                                                  \
+  }                                                                                               \
+                                                                                                  \
+  static bool dp_kernel_scalar##suffix(const span_t *s) { return scalar_cells##suffix(s, s->n); }
+
+DEFINE_SCALAR_KERNEL(, dp_span_t, int, INT_MAX)
+DEFINE_SCALAR_KERNEL(64, dp_span64_t, int64_t, INT64_MAX)
+
+/* ------------------------------------------------------------------------- */
+/* x86: SSE4.1 (4 lanes), AVX2 (8 lanes), AVX-512F (16 lanes)                 */
+/* ------------------------------------------------------------------------- */
+
+/* Values and weights are both 32-bit lanes. Because every stored value and
+ * the item value are in [0, INT_MAX], their sum fits in 32 unsigned bits, so
+ * a lane overflowed exactly when its signed sum is negative: OR-ing the sums
+ * and testing the sign bits detects overflow without widening. Weights are
+ * at most INT_MAX (see dp_span_t), so signed compares are exact for them too.
+ */
+
+#if KNAPSACK_HAVE_X86_KERNELS
+
+__attribute__((target("sse4.1"))) static bool dp_kernel_sse41(const dp_span_t *s) {
+  const __m128i item_value = _mm_set1_epi32(s->item_value);
+  const __m128i item_weight = _mm_set1_epi32((int)s->item_weight);
+  __m128i overflow = _mm_setzero_si128();
+  size_t j = s->n;
+  while (j >= 4U) {
+    j -= 4U;
+    const __m128i keep_v = _mm_loadu_si128((const __m128i *)(const void *)(s->keep_value + j));
+    const __m128i cand_v = _mm_add_epi32(
+        _mm_loadu_si128((const __m128i *)(const void *)(s->take_value + j)), item_value);
+    const __m128i keep_w = _mm_loadu_si128((const __m128i *)(const void *)(s->keep_weight + j));
+    const __m128i cand_w = _mm_add_epi32(
+        _mm_loadu_si128((const __m128i *)(const void *)(s->take_weight + j)), item_weight);
+    overflow = _mm_or_si128(overflow, cand_v);
+
+    const __m128i better = _mm_or_si128(
+        _mm_cmpgt_epi32(cand_v, keep_v),
+        _mm_and_si128(_mm_cmpeq_epi32(cand_v, keep_v), _mm_cmpgt_epi32(keep_w, cand_w)));
+    _mm_storeu_si128((__m128i *)(void *)(s->out_value + j),
+                     _mm_blendv_epi8(keep_v, cand_v, better));
+    _mm_storeu_si128((__m128i *)(void *)(s->out_weight + j),
+                     _mm_blendv_epi8(keep_w, cand_w, better));
+    or_mask_bits(s->bits, s->bit_offset + j,
+                 (uint64_t)(unsigned)_mm_movemask_ps(_mm_castsi128_ps(better)), 4U);
+  }
+  if (_mm_movemask_ps(_mm_castsi128_ps(overflow)) != 0) {
+    return false;
+  }
+  return scalar_cells(s, j);
+}
+
+__attribute__((target("avx2"))) static bool dp_kernel_avx2(const dp_span_t *s) {
+  const __m256i item_value = _mm256_set1_epi32(s->item_value);
+  const __m256i item_weight = _mm256_set1_epi32((int)s->item_weight);
+  __m256i overflow = _mm256_setzero_si256();
+  size_t j = s->n;
+  while (j >= 8U) {
+    j -= 8U;
+    const __m256i keep_v =
+        _mm256_loadu_si256((const __m256i *)(const void *)(s->keep_value + j));
+    const __m256i cand_v = _mm256_add_epi32(
+        _mm256_loadu_si256((const __m256i *)(const void *)(s->take_value + j)), item_value);
+    const __m256i keep_w =
+        _mm256_loadu_si256((const __m256i *)(const void *)(s->keep_weight + j));
+    const __m256i cand_w = _mm256_add_epi32(
+        _mm256_loadu_si256((const __m256i *)(const void *)(s->take_weight + j)), item_weight);
+    overflow = _mm256_or_si256(overflow, cand_v);
+
+    const __m256i better = _mm256_or_si256(
+        _mm256_cmpgt_epi32(cand_v, keep_v),
+        _mm256_and_si256(_mm256_cmpeq_epi32(cand_v, keep_v), _mm256_cmpgt_epi32(keep_w, cand_w)));
+    _mm256_storeu_si256((__m256i *)(void *)(s->out_value + j),
+                        _mm256_blendv_epi8(keep_v, cand_v, better));
+    _mm256_storeu_si256((__m256i *)(void *)(s->out_weight + j),
+                        _mm256_blendv_epi8(keep_w, cand_w, better));
+    or_mask_bits(s->bits, s->bit_offset + j,
+                 (uint64_t)(unsigned)_mm256_movemask_ps(_mm256_castsi256_ps(better)), 8U);
+  }
+  if (_mm256_movemask_ps(_mm256_castsi256_ps(overflow)) != 0) {
+    return false;
+  }
+  return scalar_cells(s, j);
+}
+
+__attribute__((target("avx512f"))) static bool dp_kernel_avx512(const dp_span_t *s) {
+  const __m512i item_value = _mm512_set1_epi32(s->item_value);
+  const __m512i item_weight = _mm512_set1_epi32((int)s->item_weight);
+  const __m512i zero = _mm512_setzero_si512();
+  __m512i overflow = zero;
+  size_t j = s->n;
+  while (j >= 16U) {
+    j -= 16U;
+    const __m512i keep_v = _mm512_loadu_si512((const void *)(s->keep_value + j));
+    const __m512i cand_v =
+        _mm512_add_epi32(_mm512_loadu_si512((const void *)(s->take_value + j)), item_value);
+    const __m512i keep_w = _mm512_loadu_si512((const void *)(s->keep_weight + j));
+    const __m512i cand_w =
+        _mm512_add_epi32(_mm512_loadu_si512((const void *)(s->take_weight + j)), item_weight);
+    overflow = _mm512_or_si512(overflow, cand_v);
+
+    const __mmask16 better =
+        (__mmask16)(_mm512_cmpgt_epi32_mask(cand_v, keep_v) |
+                    (_mm512_cmpeq_epi32_mask(cand_v, keep_v) &
+                     _mm512_cmplt_epi32_mask(cand_w, keep_w)));
+    _mm512_storeu_si512((void *)(s->out_value + j),
+                        _mm512_mask_blend_epi32(better, keep_v, cand_v));
+    _mm512_storeu_si512((void *)(s->out_weight + j),
+                        _mm512_mask_blend_epi32(better, keep_w, cand_w));
+    or_mask_bits(s->bits, s->bit_offset + j, (uint64_t)better, 16U);
+  }
+  if (_mm512_cmplt_epi32_mask(overflow, zero) != 0U) {
+    return false;
+  }
+  return scalar_cells(s, j);
+}
+
+/* 64-bit values: 4 (AVX2) or 8 (AVX-512F) lanes. Weights stay 32-bit in
+ * memory and are widened to 64-bit lanes next to their values, then
+ * narrowed again for the store. The sign-bit overflow test carries over:
+ * two values in [0, INT64_MAX] sum below 2^64. SSE4.1 has no 64-bit
+ * compare, so that kernel choice runs the scalar 64-bit loop.
+ */
+
+__attribute__((target("avx2"))) static bool dp_kernel64_avx2(const dp_span64_t *s) {
+  const __m256i item_value = _mm256_set1_epi64x(s->item_value);
+  const __m256i item_weight = _mm256_set1_epi64x((long long)s->item_weight);
+  const __m256i low_halves = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+  __m256i overflow = _mm256_setzero_si256();
+  size_t j = s->n;
+  while (j >= 4U) {
+    j -= 4U;
+    const __m256i keep_v =
+        _mm256_loadu_si256((const __m256i *)(const void *)(s->keep_value + j));
+    const __m256i cand_v = _mm256_add_epi64(
+        _mm256_loadu_si256((const __m256i *)(const void *)(s->take_value + j)), item_value);
+    const __m256i keep_w = _mm256_cvtepu32_epi64(
+        _mm_loadu_si128((const __m128i *)(const void *)(s->keep_weight + j)));
+    const __m256i cand_w = _mm256_add_epi64(
+        _mm256_cvtepu32_epi64(_mm_loadu_si128((const __m128i *)(const void *)(s->take_weight + j))),
+        item_weight);
+    overflow = _mm256_or_si256(overflow, cand_v);
+
+    const __m256i better = _mm256_or_si256(
+        _mm256_cmpgt_epi64(cand_v, keep_v),
+        _mm256_and_si256(_mm256_cmpeq_epi64(cand_v, keep_v), _mm256_cmpgt_epi64(keep_w, cand_w)));
+    _mm256_storeu_si256((__m256i *)(void *)(s->out_value + j),
+                        _mm256_blendv_epi8(keep_v, cand_v, better));
+    const __m256i out_w = _mm256_blendv_epi8(keep_w, cand_w, better);
+    _mm_storeu_si128((__m128i *)(void *)(s->out_weight + j),
+                     _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(out_w, low_halves)));
+    or_mask_bits(s->bits, s->bit_offset + j,
+                 (uint64_t)(unsigned)_mm256_movemask_pd(_mm256_castsi256_pd(better)), 4U);
+  }
+  if (_mm256_movemask_pd(_mm256_castsi256_pd(overflow)) != 0) {
+    return false;
+  }
+  return scalar_cells64(s, j);
+}
+
+__attribute__((target("avx512f"))) static bool dp_kernel64_avx512(const dp_span64_t *s) {
+  const __m512i item_value = _mm512_set1_epi64(s->item_value);
+  const __m512i item_weight = _mm512_set1_epi64((long long)s->item_weight);
+  const __m512i zero = _mm512_setzero_si512();
+  __m512i overflow = zero;
+  size_t j = s->n;
+  while (j >= 8U) {
+    j -= 8U;
+    const __m512i keep_v = _mm512_loadu_si512((const void *)(s->keep_value + j));
+    const __m512i cand_v =
+        _mm512_add_epi64(_mm512_loadu_si512((const void *)(s->take_value + j)), item_value);
+    const __m512i keep_w = _mm512_cvtepu32_epi64(
+        _mm256_loadu_si256((const __m256i *)(const void *)(s->keep_weight + j)));
+    const __m512i cand_w =
+        _mm512_add_epi64(_mm512_cvtepu32_epi64(_mm256_loadu_si256(
+                             (const __m256i *)(const void *)(s->take_weight + j))),
+                         item_weight);
+    overflow = _mm512_or_si512(overflow, cand_v);
+
+    const __mmask8 better =
+        (__mmask8)(_mm512_cmpgt_epi64_mask(cand_v, keep_v) |
+                   (_mm512_cmpeq_epi64_mask(cand_v, keep_v) &
+                    _mm512_cmplt_epi64_mask(cand_w, keep_w)));
+    _mm512_storeu_si512((void *)(s->out_value + j),
+                        _mm512_mask_blend_epi64(better, keep_v, cand_v));
+    _mm256_storeu_si256((__m256i *)(void *)(s->out_weight + j),
+                        _mm512_cvtepi64_epi32(_mm512_mask_blend_epi64(better, keep_w, cand_w)));
+    or_mask_bits(s->bits, s->bit_offset + j, (uint64_t)better, 8U);
+  }
+  if (_mm512_cmplt_epi64_mask(overflow, zero) != 0U) {
+    return false;
+  }
+  return scalar_cells64(s, j);
+}
+
+#endif /* KNAPSACK_HAVE_X86_KERNELS */
+
+/* ------------------------------------------------------------------------- */
+/* AArch64: NEON (4 lanes)                                                    */
+/* ------------------------------------------------------------------------- */
+
+#if KNAPSACK_HAVE_NEON_KERNEL
+
+static bool dp_kernel_neon(const dp_span_t *s) {
+  static const uint32_t lane_bits[4] = {1U, 2U, 4U, 8U};
+  const uint32x4_t lane_bit = vld1q_u32(lane_bits);
+  const int32x4_t item_value = vdupq_n_s32(s->item_value);
+  const uint32x4_t item_weight = vdupq_n_u32(s->item_weight);
+  uint32x4_t overflow = vdupq_n_u32(0U);
+  size_t j = s->n;
+  while (j >= 4U) {
+    j -= 4U;
+    const int32x4_t keep_v = vld1q_s32(s->keep_value + j);
+    const int32x4_t cand_v = vaddq_s32(vld1q_s32(s->take_value + j), item_value);
+    const uint32x4_t keep_w = vld1q_u32(s->keep_weight + j);
+    const uint32x4_t cand_w = vaddq_u32(vld1q_u32(s->take_weight + j), item_weight);
+    overflow = vorrq_u32(overflow, vreinterpretq_u32_s32(cand_v));
+
+    const uint32x4_t better =
+        vorrq_u32(vcgtq_s32(cand_v, keep_v),
+                  vandq_u32(vceqq_s32(cand_v, keep_v), vcltq_u32(cand_w, keep_w)));
+    vst1q_s32(s->out_value + j, vbslq_s32(better, cand_v, keep_v));
+    vst1q_u32(s->out_weight + j, vbslq_u32(better, cand_w, keep_w));
+    or_mask_bits(s->bits, s->bit_offset + j, (uint64_t)vaddvq_u32(vandq_u32(better, lane_bit)),
+                 4U);
+  }
+  if (vmaxvq_u32(vshrq_n_u32(overflow, 31)) != 0U) {
+    return false;
+  }
+  return scalar_cells(s, j);
+}
+
+#endif /* KNAPSACK_HAVE_NEON_KERNEL */
+
+/* ------------------------------------------------------------------------- */
+/* Dispatch                                                                   */
+/* ------------------------------------------------------------------------- */
+
+static dp_kernel_fn kernel_fn(knapsack_kernel_t kernel) {
+  switch (kernel) {
+  case KNAPSACK_KERNEL_SCALAR:
+    return dp_kernel_scalar;
+#if KNAPSACK_HAVE_X86_KERNELS
+  case KNAPSACK_KERNEL_SSE41:
+    return dp_kernel_sse41;
+  case KNAPSACK_KERNEL_AVX2:
+    return dp_kernel_avx2;
+  case KNAPSACK_KERNEL_AVX512:
+    return dp_kernel_avx512;
+#endif
+#if KNAPSACK_HAVE_NEON_KERNEL
+  case KNAPSACK_KERNEL_NEON:
+    return dp_kernel_neon;
+#endif
+  default:
+    return NULL;
+  }
+}
+
+/* The 64-bit kernel paired with each kernel choice; the choices without a
+ * 64-bit variant (SSE4.1 and NEON) run the scalar one.
+ */
+static dp_kernel64_fn kernel64_fn(knapsack_kernel_t kernel) {
+  switch (kernel) {
+#if KNAPSACK_HAVE_X86_KERNELS
+  case KNAPSACK_KERNEL_AVX2:
+    return dp_kernel64_avx2;
+  case KNAPSACK_KERNEL_AVX512:
+    return dp_kernel64_avx512;
+#endif
+  default:
+    return dp_kernel_scalar64;
+  }
+}
+
+static bool cpu_supports(knapsack_kernel_t kernel) {
+  switch (kernel) {
+  case KNAPSACK_KERNEL_SCALAR:
+    return true;
+#if KNAPSACK_HAVE_X86_KERNELS
+  case KNAPSACK_KERNEL_SSE41:
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse4.1") != 0;
+  case KNAPSACK_KERNEL_AVX2:
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") != 0;
+  case KNAPSACK_KERNEL_AVX512:
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx512f") != 0;
+#endif
+#if KNAPSACK_HAVE_NEON_KERNEL
+  case KNAPSACK_KERNEL_NEON:
+#if defined(__linux__)
+    return (getauxval(AT_HWCAP) & HWCAP_ASIMD) != 0U;
+#else
+    return true; /* Advanced SIMD is mandatory on AArch64. */
+#endif
+#endif
+  default:
+    return false;
+  }
+}
+
+static knapsack_kernel_t detect_best_kernel(void) {
+  static const knapsack_kernel_t preference[] = {
+      KNAPSACK_KERNEL_AVX512,
+      KNAPSACK_KERNEL_AVX2,
+      KNAPSACK_KERNEL_SSE41,
+      KNAPSACK_KERNEL_NEON,
+  };
+  for (size_t i = 0; i < sizeof preference / sizeof preference[0]; ++i) {
+    if (cpu_supports(preference[i])) {
+      return preference[i];
+    }
+  }
+  return KNAPSACK_KERNEL_SCALAR;
+}
+
+/* KNAPSACK_KERNEL_AUTO in g_detected_kernel means "not detected yet"; in
+ * g_kernel_override it means "no override".
+ */
+static atomic_int g_detected_kernel = KNAPSACK_KERNEL_AUTO;
+static atomic_int g_kernel_override = KNAPSACK_KERNEL_AUTO;
+
+static knapsack_kernel_t detected_kernel(void) {
+  int kernel = atomic_load_explicit(&g_detected_kernel, memory_order_relaxed);
+  if (kernel == KNAPSACK_KERNEL_AUTO) {
+    kernel = (int)detect_best_kernel();
+    atomic_store_explicit(&g_detected_kernel, kernel, memory_order_relaxed);
+  }
+  return (knapsack_kernel_t)kernel;
+}
+
+#if defined(__GNUC__)
+/* Resolve the kernel at load time so the first solve does not pay for it. */
+__attribute__((constructor)) static void knapsack_kernels_init(void) { (void)detected_kernel(); }
+#endif
+
+dp_kernel_fn dp_active_kernel(void) { return kernel_fn(knapsack_active_kernel()); }
+
+dp_kernel64_fn dp_active_kernel64(void) { return kernel64_fn(knapsack_active_kernel()); }
+
+/* ------------------------------------------------------------------------- */
+/* Public API                                                                 */
+/* ------------------------------------------------------------------------- */
+
+bool knapsack_kernel_supported(knapsack_kernel_t kernel) {
+  if (kernel == KNAPSACK_KERNEL_AUTO) {
+    return true;
+  }
+  return kernel_fn(kernel) != NULL && cpu_supports(kernel);
+}
+
+knapsack_status_t knapsack_set_kernel(knapsack_kernel_t kernel) {
+  if (!knapsack_kernel_supported(kernel)) {
+    return KNAPSACK_ERR_INVALID_ARGUMENT;
+  }
+  atomic_store_explicit(&g_kernel_override, (int)kernel, memory_order_relaxed);
+  return KNAPSACK_OK;
+}
+
+knapsack_kernel_t knapsack_active_kernel(void) {
+  const int kernel = atomic_load_explicit(&g_kernel_override, memory_order_relaxed);
+  return kernel == KNAPSACK_KERNEL_AUTO ? detected_kernel() : (knapsack_kernel_t)kernel;
+}
+
+const char *knapsack_kernel_name(knapsack_kernel_t kernel) {
+  switch (kernel) {
+  case KNAPSACK_KERNEL_AUTO:
+    return "auto";
+  case KNAPSACK_KERNEL_SCALAR:
+    return "scalar";
+  case KNAPSACK_KERNEL_SSE41:
+    return "sse4.1";
+  case KNAPSACK_KERNEL_AVX2:
+    return "avx2";
+  case KNAPSACK_KERNEL_AVX512:
+    return "avx512";
+  case KNAPSACK_KERNEL_NEON:
+    return "neon";
+  }
+  return "unknown";
+}
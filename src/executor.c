@@ -0,0 +1,448 @@
+/* Asynchronous solves behind knapsack_executor_t.
+ *
+ * The executor has a FIFO per priority class and its own worker threads,
+ * which take the oldest job of the highest non-empty class. Unlike the
+ * pool's fork-join runs, nothing here waits for a set of workers: each job
+ * is solved on one thread, in that worker's arena (the per-worker arena
+ * knapsack_solve_batch's workers use too), and reported on its own.
+ *
+ * One mutex guards the queues and the counters. Submission reserves a
+ * queue slot under it before allocating the job, so an overloaded executor
+ * refuses work without touching the allocator. A job is one allocation,
+ * the header followed by its copy of the items, and is freed by whichever
+ * of the executor and the handle lets go of it last.
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include "knapsack_internal.h"
+
+#include "knapsack/knapsack.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+struct knapsack_job {
+  struct knapsack_job *next; /* in its queue */
+  struct knapsack_executor *executor;
+  const knapsack_allocator_t *alloc;
+  atomic_uint refs; /* the executor until the job is done, plus the handle */
+  atomic_bool cancelled;
+  atomic_bool done;
+  uint64_t queued_at;
+  knapsack_item_t *items; /* inside the job's block */
+  size_t count;
+  int capacity;
+  knapsack_options_t options; /* cancel goes through job_cancelled */
+  knapsack_cancel_fn cancel;  /* the caller's */
+  void *cancel_user_data;
+  knapsack_job_done_fn on_done;
+  void *user_data;
+  knapsack_status_t status;
+  knapsack_result_t result; /* kept for knapsack_job_wait when there is no on_done */
+};
+
+typedef struct {
+  knapsack_job_t *head;
+  knapsack_job_t *tail;
+} job_queue_t;
+
+typedef struct {
+  struct knapsack_executor *executor;
+  worker_arena_t arena;
+} executor_worker_t;
+
+struct knapsack_executor {
+  const knapsack_allocator_t *alloc;
+  pthread_mutex_t lock;
+  pthread_cond_t work;     /* a job was queued, or stop */
+  pthread_cond_t finished; /* a job is done */
+  job_queue_t queues[KNAPSACK_PRIORITY_COUNT];
+  size_t reserved; /* queued jobs plus slots taken by submissions in flight */
+  size_t queue_capacity;
+  size_t idle; /* workers waiting for work */
+  bool stop;
+  size_t size;
+  pthread_t *threads;
+  executor_worker_t *workers; /* one per thread */
+  size_t started;             /* threads successfully created */
+  knapsack_executor_stats_t stats;
+};
+
+static uint64_t executor_clock(void) {
+  struct timespec now;
+  if (clock_gettime(CLOCK_MONOTONIC, &now) != 0) {
+    return 0U;
+  }
+  return (uint64_t)now.tv_sec * UINT64_C(1000000000) + (uint64_t)now.tv_nsec;
+}
+
+static size_t online_cpus(void) {
+  const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  return cpus > 0 ? (size_t)cpus : 1U;
+}
+
+static void job_unref(knapsack_job_t *job) {
+  if (atomic_fetch_sub_explicit(&job->refs, 1U, memory_order_acq_rel) != 1U) {
+    return;
+  }
+  const knapsack_allocator_t *alloc = job->alloc;
+  knapsack_result_free_ex(&job->result, alloc);
+  alloc->free_fn(job, alloc->user_data);
+}
+
+static bool job_cancelled(void *user_data) {
+  knapsack_job_t *job = user_data;
+  if (atomic_load_explicit(&job->cancelled, memory_order_relaxed)) {
+    return true;
+  }
+  return job->cancel && job->cancel(job->cancel_user_data);
+}
+
+/* Caller holds the lock. */
+static knapsack_job_t *pop_job(knapsack_executor_t *executor) {
+  for (size_t p = 0; p < KNAPSACK_PRIORITY_COUNT; ++p) {
+    job_queue_t *queue = &executor->queues[p];
+    knapsack_job_t *job = queue->head;
+    if (job) {
+      queue->head = job->next;
+      if (!queue->head) {
+        queue->tail = NULL;
+      }
+      --executor->reserved;
+      --executor->stats.queued[p];
+      return job;
+    }
+  }
+  return NULL;
+}
+
+static void run_job(knapsack_executor_t *executor, worker_arena_t *arena, knapsack_job_t *job) {
+  const uint64_t started = executor_clock();
+  knapsack_result_t result = {0};
+  knapsack_status_t status = KNAPSACK_ERR_CANCELLED;
+  if (!atomic_load_explicit(&job->cancelled, memory_order_relaxed)) {
+    /* The options were checked on submission. */
+    status = worker_arena_solve(arena, job->items, job->count, job->capacity, &job->options,
+                                job->options.pool, job->options.stats, &result);
+  }
+  const uint64_t finished = executor_clock();
+  job->status = status;
+  if (job->on_done) {
+    job->on_done(status, &result, job->user_data);
+  } else {
+    job->result = result;
+  }
+
+  const uint64_t queue_ns = started - job->queued_at;
+  const uint64_t run_ns = finished - started;
+  knapsack_executor_stats_t *stats = &executor->stats;
+  pthread_mutex_lock(&executor->lock);
+  --stats->running;
+  ++stats->completed;
+  if (status == KNAPSACK_ERR_CANCELLED) {
+    ++stats->cancelled;
+  }
+  stats->queue_ns += queue_ns;
+  stats->run_ns += run_ns;
+  if (queue_ns > stats->max_queue_ns) {
+    stats->max_queue_ns = queue_ns;
+  }
+  if (run_ns > stats->max_run_ns) {
+    stats->max_run_ns = run_ns;
+  }
+  atomic_store_explicit(&job->done, true, memory_order_release);
+  pthread_cond_broadcast(&executor->finished);
+  pthread_mutex_unlock(&executor->lock);
+  job_unref(job);
+}
+
+static void *executor_main(void *arg) {
+  executor_worker_t *self = arg;
+  knapsack_executor_t *executor = self->executor;
+  pthread_mutex_lock(&executor->lock);
+  for (;;) {
+    knapsack_job_t *job = pop_job(executor);
+    if (!job) {
+      /* Stopping: only once the queues are drained. */
+      if (executor->stop) {
+        break;
+      }
+      ++executor->idle;
+      pthread_cond_wait(&executor->work, &executor->lock);
+      --executor->idle;
+      continue;
+    }
+    ++executor->stats.running;
+    pthread_mutex_unlock(&executor->lock);
+    run_job(executor, &self->arena, job);
+    pthread_mutex_lock(&executor->lock);
+  }
+  pthread_mutex_unlock(&executor->lock);
+  return NULL;
+}
+
+/* Cancel what is queued, join the first executor->started threads (which
+ * finish the queues first), then free everything.
+ */
+static void executor_teardown(knapsack_executor_t *executor) {
+  pthread_mutex_lock(&executor->lock);
+  executor->stop = true;
+  for (size_t p = 0; p < KNAPSACK_PRIORITY_COUNT; ++p) {
+    for (knapsack_job_t *job = executor->queues[p].head; job; job = job->next) {
+      atomic_store_explicit(&job->cancelled, true, memory_order_relaxed);
+    }
+  }
+  pthread_cond_broadcast(&executor->work);
+  pthread_mutex_unlock(&executor->lock);
+  for (size_t i = 0; i < executor->started; ++i) {
+    pthread_join(executor->threads[i], NULL);
+  }
+
+  const knapsack_allocator_t *alloc = executor->alloc;
+  if (executor->workers) {
+    for (size_t i = 0; i < executor->size; ++i) {
+      worker_arena_release(&executor->workers[i].arena);
+    }
+  }
+  pthread_cond_destroy(&executor->finished);
+  pthread_cond_destroy(&executor->work);
+  pthread_mutex_destroy(&executor->lock);
+  alloc->free_fn(executor->workers, alloc->user_data);
+  alloc->free_fn(executor->threads, alloc->user_data);
+  alloc->free_fn(executor, alloc->user_data);
+}
+
+void knapsack_executor_config_init(knapsack_executor_config_t *config) {
+  if (!config) {
+    return;
+  }
+  *config = (knapsack_executor_config_t){
+      .threads = 0U,
+      .queue_capacity = KNAPSACK_EXECUTOR_QUEUE_CAPACITY,
+      .allocator = NULL,
+  };
+}
+
+knapsack_executor_t *knapsack_executor_create(const knapsack_executor_config_t *config) {
+  knapsack_executor_config_t defaults;
+  if (!config) {
+    knapsack_executor_config_init(&defaults);
+    config = &defaults;
+  }
+  if (config->queue_capacity == 0U) {
+    return NULL;
+  }
+  const knapsack_allocator_t *alloc = resolve_allocator(config->allocator);
+  const size_t size = config->threads == 0U ? online_cpus() : config->threads;
+  if (size > SIZE_MAX / sizeof(pthread_t) || size > SIZE_MAX / sizeof(executor_worker_t)) {
+    return NULL;
+  }
+
+  knapsack_executor_t *executor = alloc->alloc_fn(sizeof(*executor), alloc->user_data);
+  if (!executor) {
+    return NULL;
+  }
+  *executor = (knapsack_executor_t){
+      .alloc = alloc,
+      .reserved = 0U,
+      .queue_capacity = config->queue_capacity,
+      .idle = 0U,
+      .stop = false,
+      .size = size,
+      .threads = NULL,
+      .workers = NULL,
+      .started = 0U,
+  };
+  pthread_mutex_init(&executor->lock, NULL);
+  pthread_cond_init(&executor->work, NULL);
+  pthread_cond_init(&executor->finished, NULL);
+
+  executor->threads = alloc->alloc_fn(size * sizeof(pthread_t), alloc->user_data);
+  executor->workers = alloc->alloc_fn(size * sizeof(executor_worker_t), alloc->user_data);
+  if (!executor->threads || !executor->workers) {
+    alloc->free_fn(executor->workers, alloc->user_data);
+    executor->workers = NULL;
+    executor_teardown(executor);
+    return NULL;
+  }
+  for (size_t i = 0; i < size; ++i) {
+    executor->workers[i].executor = executor;
+    worker_arena_init(&executor->workers[i].arena, alloc);
+  }
+  for (size_t i = 0; i < size; ++i) {
+    if (pthread_create(&executor->threads[i], NULL, executor_main, &executor->workers[i]) != 0) {
+      executor_teardown(executor);
+      return NULL;
+    }
+    ++executor->started;
+  }
+  return executor;
+}
+
+/* Take a queue slot, or count the rejection. */
+static bool reserve_slot(knapsack_executor_t *executor) {
+  pthread_mutex_lock(&executor->lock);
+  const bool room = executor->reserved < executor->queue_capacity;
+  if (room) {
+    ++executor->reserved;
+  } else {
+    ++executor->stats.rejected;
+  }
+  pthread_mutex_unlock(&executor->lock);
+  return room;
+}
+
+knapsack_status_t knapsack_executor_submit(knapsack_executor_t *executor,
+                                           const knapsack_item_t *items, size_t count,
+                                           int capacity, const knapsack_options_t *options,
+                                           knapsack_priority_t priority,
+                                           knapsack_job_done_fn on_done, void *user_data,
+                                           knapsack_job_t **out_job) {
+  if (out_job) {
+    *out_job = NULL;
+  }
+  knapsack_options_t defaults;
+  if (!options) {
+    knapsack_options_init(&defaults);
+    options = &defaults;
+  }
+  if (!executor || priority < KNAPSACK_PRIORITY_HIGH || priority > KNAPSACK_PRIORITY_LOW ||
+      (!on_done && !out_job) || !options_valid(options)) {
+    return KNAPSACK_ERR_INVALID_ARGUMENT;
+  }
+  if (!items || count == 0U) {
+    return KNAPSACK_ERR_INVALID_ITEMS;
+  }
+  if (count > options->limits.max_items ||
+      count > (SIZE_MAX - sizeof(knapsack_job_t)) / sizeof(knapsack_item_t)) {
+    return KNAPSACK_ERR_TOO_MANY_ITEMS;
+  }
+  if (!reserve_slot(executor)) {
+    return KNAPSACK_ERR_QUEUE_FULL;
+  }
+
+  const knapsack_allocator_t *alloc = executor->alloc;
+  knapsack_job_t *job = alloc->alloc_fn(sizeof(*job) + count * sizeof(knapsack_item_t),
+                                        alloc->user_data);
+  if (!job) {
+    pthread_mutex_lock(&executor->lock);
+    --executor->reserved;
+    pthread_mutex_unlock(&executor->lock);
+    return KNAPSACK_ERR_ALLOC;
+  }
+  *job = (knapsack_job_t){
+      .next = NULL,
+      .executor = executor,
+      .alloc = alloc,
+      .items = (knapsack_item_t *)(job + 1),
+      .count = count,
+      .capacity = capacity,
+      .options = *options,
+      .cancel = options->cancel,
+      .cancel_user_data = options->cancel_user_data,
+      .on_done = on_done,
+      .user_data = user_data,
+      .status = KNAPSACK_OK,
+      .result = {0},
+  };
+  atomic_init(&job->refs, out_job ? 2U : 1U);
+  atomic_init(&job->cancelled, false);
+  atomic_init(&job->done, false);
+  memcpy(job->items, items, count * sizeof(knapsack_item_t));
+  job->options.cancel = job_cancelled;
+  job->options.cancel_user_data = job;
+  job->queued_at = executor_clock();
+
+  knapsack_executor_stats_t *stats = &executor->stats;
+  pthread_mutex_lock(&executor->lock);
+  job_queue_t *queue = &executor->queues[priority];
+  if (queue->tail) {
+    queue->tail->next = job;
+  } else {
+    queue->head = job;
+  }
+  queue->tail = job;
+  ++stats->submitted;
+  ++stats->queued[priority];
+  const size_t queued = stats->queued[KNAPSACK_PRIORITY_HIGH] +
+                        stats->queued[KNAPSACK_PRIORITY_NORMAL] +
+                        stats->queued[KNAPSACK_PRIORITY_LOW];
+  if (queued > stats->max_queued) {
+    stats->max_queued = queued;
+  }
+  /* Busy workers look at the queues before they sleep again. */
+  if (executor->idle != 0U) {
+    pthread_cond_signal(&executor->work);
+  }
+  pthread_mutex_unlock(&executor->lock);
+  if (out_job) {
+    *out_job = job;
+  }
+  return KNAPSACK_OK;
+}
+
+void knapsack_executor_get_stats(knapsack_executor_t *executor,
+                                 knapsack_executor_stats_t *out_stats) {
+  if (!out_stats) {
+    return;
+  }
+  if (!executor) {
+    *out_stats = (knapsack_executor_stats_t){0};
+    return;
+  }
+  pthread_mutex_lock(&executor->lock);
+  *out_stats = executor->stats;
+  pthread_mutex_unlock(&executor->lock);
+}
+
+void knapsack_executor_destroy(knapsack_executor_t *executor) {
+  if (!executor) {
+    return;
+  }
+  executor_teardown(executor);
+}
+
+bool knapsack_job_done(const knapsack_job_t *job) {
+  return job && atomic_load_explicit(&job->done, memory_order_acquire);
+}
+
+knapsack_status_t knapsack_job_wait(knapsack_job_t *job, knapsack_result_t *out_result) {
+  if (out_result) {
+    *out_result = (knapsack_result_t){0};
+  }
+  if (!job) {
+    return KNAPSACK_ERR_INVALID_ARGUMENT;
+  }
+  /* A done job never touches the executor, which may be gone by now. */
+  if (!atomic_load_explicit(&job->done, memory_order_acquire)) {
+    knapsack_executor_t *executor = job->executor;
+    pthread_mutex_lock(&executor->lock);
+    while (!atomic_load_explicit(&job->done, memory_order_acquire)) {
+      pthread_cond_wait(&executor->finished, &executor->lock);
+    }
+    pthread_mutex_unlock(&executor->lock);
+  }
+  if (out_result) {
+    *out_result = job->result;
+    job->result = (knapsack_result_t){0};
+  }
+  return job->status;
+}
+
+void knapsack_job_cancel(knapsack_job_t *job) {
+  if (job) {
+    atomic_store_explicit(&job->cancelled, true, memory_order_relaxed);
+  }
+}
+
+void knapsack_job_release(knapsack_job_t *job) {
+  if (job) {
+    job_unref(job);
+  }
+}
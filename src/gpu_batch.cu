@@ -0,0 +1,368 @@
+/* CUDA backend for knapsack_solve_batch (ENABLE_GPU).
+ *
+ * Picked instances are packed into chunks that fit in half the free device
+ * memory, one kernel launch per chunk and one thread block per instance.
+ * The block's threads sweep an item's row together, ping-ponging between
+ * two value/weight row pairs (a parallel update cannot run in place), and
+ * each warp's __ballot_sync over its 32 cells is one 32-bit word of the
+ * instance's decision bits. Picking the best cell and walking back through
+ * the bits happen on the device as well, so the bits never leave it: a
+ * chunk copies back one answer per instance and the selected indices.
+ *
+ * The cell update, its overflow check and the choice of the best cell are
+ * the dense engine's (higher value, then lower weight, then lower cell), so
+ * results match the CPU. The CPU's preprocessing -- dropping items heavier
+ * than the capacity, scaling by the weights' gcd -- does not change them.
+ */
+#include "knapsack_internal.h"
+
+#include "knapsack/knapsack.h"
+
+#include <cuda_runtime.h>
+
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace {
+
+constexpr unsigned kBlockThreads = 256U; /* a whole number of warps */
+constexpr unsigned kWordBits = 32U;      /* one warp ballot */
+constexpr size_t kAlign = 256U;          /* device segment alignment */
+constexpr size_t kSegments = 8U;
+constexpr size_t kMaxChunk = 65536U; /* instances per launch */
+
+/* Where an instance lives in its chunk's buffers, in elements. */
+struct gpu_instance_t {
+  size_t items; /* weights, values and selected indices */
+  size_t count;
+  size_t rows; /* two rows of capacity + 1 cells */
+  size_t bits; /* count * words decision words */
+  int capacity;
+};
+
+struct gpu_answer_t {
+  int value;
+  unsigned weight;
+  unsigned selected;
+  int overflow;
+};
+
+__device__ bool beats(int value, unsigned weight, int other_value, unsigned other_weight) {
+  return value > other_value || (value == other_value && weight < other_weight);
+}
+
+/* bits and indices are NULL for value-only batches. */
+__global__ void solve_kernel(const gpu_instance_t *instances, const int *weights,
+                             const int *values, int *row_value, unsigned *row_weight,
+                             unsigned *bits, unsigned *indices, gpu_answer_t *answers) {
+  const gpu_instance_t inst = instances[blockIdx.x];
+  const size_t width = (size_t)inst.capacity + 1U;
+  const size_t words = (width + kWordBits - 1U) / kWordBits;
+  /* Every lane of a warp runs every pass so that its ballot is complete. */
+  const size_t span = (width + blockDim.x - 1U) / blockDim.x * blockDim.x;
+  int *keep_value = row_value + inst.rows;
+  unsigned *keep_weight = row_weight + inst.rows;
+  int *out_value = keep_value + width;
+  unsigned *out_weight = keep_weight + width;
+
+  for (size_t j = threadIdx.x; j < width; j += blockDim.x) {
+    keep_value[j] = 0;
+    keep_weight[j] = 0U;
+  }
+  __syncthreads();
+
+  bool overflow = false;
+  for (size_t i = 0; i < inst.count; ++i) {
+    const size_t w = (size_t)weights[inst.items + i];
+    const int v = values[inst.items + i];
+    if (w >= width) {
+      continue; /* never taken: its bits are never read either */
+    }
+    for (size_t j = threadIdx.x; j < span; j += blockDim.x) {
+      bool take = false;
+      if (j < width) {
+        int value = keep_value[j];
+        unsigned weight = keep_weight[j];
+        if (j >= w) {
+          const int base = keep_value[j - w];
+          if (base > INT_MAX - v) {
+            overflow = true;
+          } else if (beats(base + v, keep_weight[j - w] + (unsigned)w, value, weight)) {
+            take = true;
+            value = base + v;
+            weight = keep_weight[j - w] + (unsigned)w;
+          }
+        }
+        out_value[j] = value;
+        out_weight[j] = weight;
+      }
+      const unsigned ballot = __ballot_sync(0xFFFFFFFFU, take);
+      if (bits && threadIdx.x % kWordBits == 0U && j < width) {
+        bits[inst.bits + i * words + j / kWordBits] = ballot;
+      }
+    }
+    if (__syncthreads_or(overflow)) {
+      if (threadIdx.x == 0U) {
+        answers[blockIdx.x] = gpu_answer_t{0, 0U, 0U, 1};
+      }
+      return;
+    }
+    int *swap_value = keep_value;
+    keep_value = out_value;
+    out_value = swap_value;
+    unsigned *swap_weight = keep_weight;
+    keep_weight = out_weight;
+    out_weight = swap_weight;
+  }
+
+  /* Best cell: each thread scans its cells in ascending order, then a tree
+   * reduction keeps the lower cell of two equal candidates.
+   */
+  __shared__ int best_value[kBlockThreads];
+  __shared__ unsigned best_weight[kBlockThreads];
+  __shared__ size_t best_cell[kBlockThreads];
+  size_t cell = SIZE_MAX;
+  int value = 0;
+  unsigned weight = 0U;
+  for (size_t j = threadIdx.x; j < width; j += blockDim.x) {
+    if (cell == SIZE_MAX || beats(keep_value[j], keep_weight[j], value, weight)) {
+      cell = j;
+      value = keep_value[j];
+      weight = keep_weight[j];
+    }
+  }
+  best_value[threadIdx.x] = value;
+  best_weight[threadIdx.x] = weight;
+  best_cell[threadIdx.x] = cell;
+  __syncthreads();
+  for (unsigned half = blockDim.x / 2U; half > 0U; half /= 2U) {
+    if (threadIdx.x < half) {
+      const unsigned other = threadIdx.x + half;
+      const size_t mine = best_cell[threadIdx.x];
+      const size_t theirs = best_cell[other];
+      if (theirs != SIZE_MAX &&
+          (mine == SIZE_MAX ||
+           beats(best_value[other], best_weight[other], best_value[threadIdx.x],
+                 best_weight[threadIdx.x]) ||
+           (best_value[other] == best_value[threadIdx.x] &&
+            best_weight[other] == best_weight[threadIdx.x] && theirs < mine))) {
+        best_value[threadIdx.x] = best_value[other];
+        best_weight[threadIdx.x] = best_weight[other];
+        best_cell[threadIdx.x] = theirs;
+      }
+    }
+    __syncthreads();
+  }
+  if (threadIdx.x != 0U) {
+    return;
+  }
+
+  /* Walk back from the best cell; indices come out in descending order. */
+  unsigned selected = 0U;
+  if (bits) {
+    size_t at = best_cell[0];
+    for (size_t i = inst.count; i-- > 0;) {
+      const size_t w = (size_t)weights[inst.items + i];
+      if (w <= at && (bits[inst.bits + i * words + at / kWordBits] >> (at % kWordBits)) & 1U) {
+        indices[inst.items + selected++] = (unsigned)i;
+        at -= w;
+      }
+    }
+  }
+  answers[blockIdx.x] = gpu_answer_t{best_value[0], best_weight[0], selected, 0};
+}
+
+size_t align_up(size_t bytes) { return (bytes + kAlign - 1U) / kAlign * kAlign; }
+
+size_t row_words(const knapsack_instance_t *instance) {
+  return ((size_t)instance->capacity + kWordBits) / kWordBits;
+}
+
+/* Device bytes an instance needs, alignment aside. */
+size_t instance_bytes(const knapsack_instance_t *instance, bool value_only) {
+  const size_t width = (size_t)instance->capacity + 1U;
+  size_t bytes = sizeof(gpu_instance_t) + sizeof(gpu_answer_t) +
+                 instance->count * (2U * sizeof(int) + sizeof(unsigned)) +
+                 2U * width * (sizeof(int) + sizeof(unsigned));
+  if (!value_only) {
+    bytes += instance->count * row_words(instance) * sizeof(unsigned);
+  }
+  return bytes;
+}
+
+/* Solve picked[0 .. n) in one launch. false on a device or host allocation
+ * failure, which leaves the chunk to the CPU.
+ */
+/* NOLINTBEGIN(bugprone-easily-swappable-parameters) -- internal helper, params are documented. */
+bool run_chunk(const knapsack_instance_t *instances, const size_t *picked, size_t n,
+               bool value_only, const knapsack_allocator_t *alloc, knapsack_result_t *results,
+               knapsack_status_t *statuses, bool *solved) {
+  size_t items = 0U;
+  size_t cells = 0U;
+  size_t words = 0U;
+  for (size_t k = 0; k < n; ++k) {
+    const knapsack_instance_t *instance = &instances[picked[k]];
+    items += instance->count;
+    cells += 2U * ((size_t)instance->capacity + 1U);
+    words += value_only ? 0U : instance->count * row_words(instance);
+  }
+
+  /* Host staging: descriptors, weights, values, answers, indices. */
+  const size_t host_bytes = n * (sizeof(gpu_instance_t) + sizeof(gpu_answer_t)) +
+                            items * (2U * sizeof(int) + sizeof(unsigned));
+  unsigned char *host = static_cast<unsigned char *>(alloc->alloc_fn(host_bytes, alloc->user_data));
+  if (!host) {
+    return false;
+  }
+  gpu_instance_t *host_instances = reinterpret_cast<gpu_instance_t *>(host);
+  gpu_answer_t *host_answers = reinterpret_cast<gpu_answer_t *>(host_instances + n);
+  int *host_weights = reinterpret_cast<int *>(host_answers + n);
+  int *host_values = host_weights + items;
+  unsigned *host_indices = reinterpret_cast<unsigned *>(host_values + items);
+
+  size_t at_items = 0U;
+  size_t at_rows = 0U;
+  size_t at_bits = 0U;
+  for (size_t k = 0; k < n; ++k) {
+    const knapsack_instance_t *instance = &instances[picked[k]];
+    host_instances[k] = gpu_instance_t{at_items, instance->count, at_rows, at_bits,
+                                       instance->capacity};
+    for (size_t i = 0; i < instance->count; ++i) {
+      host_weights[at_items + i] = instance->items[i].weight;
+      host_values[at_items + i] = instance->items[i].value;
+    }
+    at_items += instance->count;
+    at_rows += 2U * ((size_t)instance->capacity + 1U);
+    at_bits += value_only ? 0U : instance->count * row_words(instance);
+  }
+
+  /* Device block: the same segments plus the rows and the bits. */
+  const size_t seg_instances = align_up(n * sizeof(gpu_instance_t));
+  const size_t seg_answers = align_up(n * sizeof(gpu_answer_t));
+  const size_t seg_items = align_up(items * sizeof(int));
+  const size_t seg_rows = align_up(cells * sizeof(int));
+  const size_t seg_bits = align_up(words * sizeof(unsigned));
+  unsigned char *device = nullptr;
+  if (cudaMalloc(reinterpret_cast<void **>(&device), seg_instances + seg_answers +
+                                                         3U * seg_items + 2U * seg_rows +
+                                                         seg_bits) != cudaSuccess) {
+    alloc->free_fn(host, alloc->user_data);
+    return false;
+  }
+  gpu_instance_t *dev_instances = reinterpret_cast<gpu_instance_t *>(device);
+  gpu_answer_t *dev_answers = reinterpret_cast<gpu_answer_t *>(device + seg_instances);
+  int *dev_weights = reinterpret_cast<int *>(device + seg_instances + seg_answers);
+  int *dev_values = reinterpret_cast<int *>(device + seg_instances + seg_answers + seg_items);
+  unsigned *dev_indices =
+      reinterpret_cast<unsigned *>(device + seg_instances + seg_answers + 2U * seg_items);
+  int *dev_row_value =
+      reinterpret_cast<int *>(device + seg_instances + seg_answers + 3U * seg_items);
+  unsigned *dev_row_weight = reinterpret_cast<unsigned *>(device + seg_instances + seg_answers +
+                                                          3U * seg_items + seg_rows);
+  unsigned *dev_bits = reinterpret_cast<unsigned *>(device + seg_instances + seg_answers +
+                                                    3U * seg_items + 2U * seg_rows);
+
+  bool ok = cudaMemcpy(dev_instances, host_instances, n * sizeof(gpu_instance_t),
+                       cudaMemcpyHostToDevice) == cudaSuccess &&
+            cudaMemcpy(dev_weights, host_weights, items * sizeof(int), cudaMemcpyHostToDevice) ==
+                cudaSuccess &&
+            cudaMemcpy(dev_values, host_values, items * sizeof(int), cudaMemcpyHostToDevice) ==
+                cudaSuccess;
+  if (ok) {
+    solve_kernel<<<static_cast<unsigned>(n), kBlockThreads>>>(
+        dev_instances, dev_weights, dev_values, dev_row_value, dev_row_weight,
+        value_only ? nullptr : dev_bits, value_only ? nullptr : dev_indices, dev_answers);
+    ok = cudaGetLastError() == cudaSuccess &&
+         cudaMemcpy(host_answers, dev_answers, n * sizeof(gpu_answer_t),
+                    cudaMemcpyDeviceToHost) == cudaSuccess &&
+         (value_only || cudaMemcpy(host_indices, dev_indices, items * sizeof(unsigned),
+                                   cudaMemcpyDeviceToHost) == cudaSuccess);
+  }
+  cudaFree(device);
+
+  for (size_t k = 0; ok && k < n; ++k) {
+    const gpu_answer_t *answer = &host_answers[k];
+    if (answer->overflow) {
+      continue; /* the CPU reports it */
+    }
+    size_t *selected = nullptr;
+    if (answer->selected != 0U) {
+      selected = static_cast<size_t *>(
+          alloc->alloc_fn(answer->selected * sizeof(size_t), alloc->user_data));
+      if (!selected) {
+        continue;
+      }
+      /* The walk wrote them in descending order. */
+      const unsigned *walked = host_indices + host_instances[k].items;
+      for (unsigned s = 0; s < answer->selected; ++s) {
+        selected[s] = walked[answer->selected - 1U - s];
+      }
+    }
+    const size_t i = picked[k];
+    results[i] = knapsack_result_t{answer->value, answer->selected, selected,
+                                   static_cast<int>(answer->weight), answer->value};
+    statuses[i] = KNAPSACK_OK;
+    solved[i] = true;
+  }
+  alloc->free_fn(host, alloc->user_data);
+  return ok;
+}
+/* NOLINTEND(bugprone-easily-swappable-parameters) */
+
+} // namespace
+
+extern "C" bool gpu_device_present(void) {
+  static const bool present = [] {
+    int devices = 0;
+    return cudaGetDeviceCount(&devices) == cudaSuccess && devices > 0;
+  }();
+  return present;
+}
+
+/* NOLINTBEGIN(bugprone-easily-swappable-parameters) -- internal interface. */
+extern "C" void gpu_solve_batch(const knapsack_instance_t *instances, const size_t *picked,
+                                size_t picked_count, bool value_only,
+                                const knapsack_allocator_t *alloc, const cancel_t *cancel,
+                                knapsack_result_t *results, knapsack_status_t *statuses,
+                                bool *solved) {
+  size_t free_bytes = 0U;
+  size_t total_bytes = 0U;
+  if (cudaMemGetInfo(&free_bytes, &total_bytes) != cudaSuccess ||
+      free_bytes / 2U <= kSegments * kAlign) {
+    return;
+  }
+  const size_t budget = free_bytes / 2U - kSegments * kAlign;
+  size_t credit = 0U;
+  size_t first = 0U;
+  while (first < picked_count) {
+    /* An instance too large for the device on its own stays on the CPU. */
+    if (instance_bytes(&instances[picked[first]], value_only) > budget) {
+      ++first;
+      continue;
+    }
+    size_t last = first;
+    size_t bytes = 0U;
+    size_t work = 0U;
+    while (last < picked_count && last - first < kMaxChunk) {
+      const knapsack_instance_t *instance = &instances[picked[last]];
+      const size_t need = instance_bytes(instance, value_only);
+      if (need > budget - bytes) {
+        break;
+      }
+      bytes += need;
+      work += instance->count * ((size_t)instance->capacity + 1U);
+      ++last;
+    }
+    if (!run_chunk(instances, picked + first, last - first, value_only, alloc, results, statuses,
+                   solved)) {
+      return;
+    }
+    first = last;
+    if (first < picked_count && cancel_poll(cancel, &credit, work)) {
+      return;
+    }
+  }
+}
+/* NOLINTEND(bugprone-easily-swappable-parameters) */
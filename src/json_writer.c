@@ -0,0 +1,525 @@
+/* JSON result objects written into a knapsack_writer_t buffer.
+ *
+ * Everything funnels through reserve(), which makes room for a few bytes at
+ * the end of the buffer by flushing to the callback or growing the storage.
+ * The index loop reserves once per run of indices that are sure to fit and
+ * then stores digits straight into the buffer, so a result with thousands
+ * of indices costs a handful of capacity checks.
+ */
+#include "knapsack_internal.h"
+
+#include "knapsack/knapsack.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/* Longest decimal uint64 (20 digits) plus a separating comma. */
+enum { INDEX_FIELD_MAX = 21, INT_FIELD_MAX = 11 };
+
+static const char k_digit_pairs[] = "00010203040506070809"
+                                    "10111213141516171819"
+                                    "20212223242526272829"
+                                    "30313233343536373839"
+                                    "40414243444546474849"
+                                    "50515253545556575859"
+                                    "60616263646566676869"
+                                    "70717273747576777879"
+                                    "80818283848586878889"
+                                    "90919293949596979899";
+
+const char *knapsack_status_name(knapsack_status_t status) {
+  switch (status) {
+  case KNAPSACK_OK:
+    return "OK";
+  case KNAPSACK_ERR_NULL_RESULT:
+    return "NULL_RESULT";
+  case KNAPSACK_ERR_INVALID_ITEMS:
+    return "INVALID_ITEMS";
+  case KNAPSACK_ERR_TOO_MANY_ITEMS:
+    return "TOO_MANY_ITEMS";
+  case KNAPSACK_ERR_INVALID_CAPACITY:
+    return "INVALID_CAPACITY";
+  case KNAPSACK_ERR_DIMENSION_OVERFLOW:
+    return "DIMENSION_OVERFLOW";
+  case KNAPSACK_ERR_INT_OVERFLOW:
+    return "INT_OVERFLOW";
+  case KNAPSACK_ERR_ALLOC:
+    return "ALLOC";
+  case KNAPSACK_ERR_INVALID_ARGUMENT:
+    return "INVALID_ARGUMENT";
+  case KNAPSACK_ERR_CANCELLED:
+    return "CANCELLED";
+  case KNAPSACK_ERR_INVALID_FORMAT:
+    return "INVALID_FORMAT";
+  case KNAPSACK_ERR_IO:
+    return "IO";
+  case KNAPSACK_ERR_QUEUE_FULL:
+    return "QUEUE_FULL";
+  case KNAPSACK_ERR_LIMIT:
+    return "LIMIT";
+  }
+  return "UNKNOWN";
+}
+
+/* Number of decimal digits of value. */
+static size_t decimal_length(uint64_t value) {
+  size_t length = 1U;
+  for (uint64_t bound = 10U; value >= bound; bound *= 10U) {
+    ++length;
+    if (length == 20U) {
+      break;
+    }
+  }
+  return length;
+}
+
+/* Store value in decimal at out, two digits per step from the right, and
+ * return the end of the digits.
+ */
+static char *put_u64(char *out, uint64_t value) {
+  char *end = out + decimal_length(value);
+  char *at = end;
+  while (value >= 100U) {
+    const size_t pair = (size_t)(value % 100U) * 2U;
+    value /= 100U;
+    at -= 2;
+    memcpy(at, k_digit_pairs + pair, 2U);
+  }
+  if (value >= 10U) {
+    memcpy(at - 2, k_digit_pairs + (size_t)value * 2U, 2U);
+  } else {
+    at[-1] = (char)('0' + (int)value);
+  }
+  return end;
+}
+
+static char *put_int(char *out, int value) {
+  if (value < 0) {
+    *out++ = '-';
+    return put_u64(out, (uint64_t)(-(int64_t)value));
+  }
+  return put_u64(out, (uint64_t)value);
+}
+
+void knapsack_writer_init(knapsack_writer_t *writer, void *storage, size_t size,
+                          knapsack_write_fn write_fn, void *user_data) {
+  if (!writer) {
+    return;
+  }
+  *writer = (knapsack_writer_t){
+      .data = storage,
+      .length = 0U,
+      .capacity = storage ? size : 0U,
+      .write_fn = write_fn,
+      .write_user_data = user_data,
+      .allocator = NULL,
+  };
+}
+
+void knapsack_writer_init_growable(knapsack_writer_t *writer,
+                                   const knapsack_allocator_t *allocator) {
+  if (!writer) {
+    return;
+  }
+  *writer = (knapsack_writer_t){
+      .data = NULL,
+      .length = 0U,
+      .capacity = 0U,
+      .write_fn = NULL,
+      .write_user_data = NULL,
+      .allocator = resolve_allocator(allocator),
+  };
+}
+
+knapsack_status_t knapsack_writer_flush(knapsack_writer_t *writer) {
+  if (!writer) {
+    return KNAPSACK_ERR_INVALID_ARGUMENT;
+  }
+  if (!writer->write_fn || writer->length == 0U) {
+    return KNAPSACK_OK;
+  }
+  const int rc = writer->write_fn(writer->data, writer->length, writer->write_user_data);
+  writer->length = 0U;
+  return rc == 0 ? KNAPSACK_OK : KNAPSACK_ERR_IO;
+}
+
+void knapsack_writer_release(knapsack_writer_t *writer) {
+  if (!writer) {
+    return;
+  }
+  if (writer->allocator && writer->data) {
+    writer->allocator->free_fn(writer->data, writer->allocator->user_data);
+  }
+  writer->data = NULL;
+  writer->length = 0U;
+  writer->capacity = 0U;
+}
+
+/* Grow owned storage to hold at least needed more bytes. The allocator
+ * interface has no realloc, so the buffered bytes are copied over.
+ */
+static knapsack_status_t grow(knapsack_writer_t *writer, size_t needed) {
+  if (needed > SIZE_MAX - writer->length) {
+    return KNAPSACK_ERR_ALLOC;
+  }
+  size_t capacity = writer->capacity > 0U ? writer->capacity : (size_t)KNAPSACK_WRITER_MIN_SIZE;
+  while (capacity - writer->length < needed) {
+    if (capacity > SIZE_MAX / 2U) {
+      capacity = writer->length + needed;
+      break;
+    }
+    capacity *= 2U;
+  }
+  const knapsack_allocator_t *alloc = writer->allocator;
+  char *data = alloc->alloc_fn(capacity, alloc->user_data);
+  if (!data) {
+    return KNAPSACK_ERR_ALLOC;
+  }
+  if (writer->length > 0U) {
+    memcpy(data, writer->data, writer->length);
+  }
+  if (writer->data) {
+    alloc->free_fn(writer->data, alloc->user_data);
+  }
+  writer->data = data;
+  writer->capacity = capacity;
+  return KNAPSACK_OK;
+}
+
+/* Room for needed bytes at data + length. With a callback, needed must be
+ * at most KNAPSACK_WRITER_MIN_SIZE for this always to succeed.
+ */
+static knapsack_status_t reserve(knapsack_writer_t *writer, size_t needed) {
+  if (writer->capacity - writer->length >= needed) {
+    return KNAPSACK_OK;
+  }
+  if (writer->write_fn) {
+    const knapsack_status_t status = knapsack_writer_flush(writer);
+    if (status != KNAPSACK_OK) {
+      return status;
+    }
+    return writer->capacity >= needed ? KNAPSACK_OK : KNAPSACK_ERR_INVALID_ARGUMENT;
+  }
+  if (writer->allocator) {
+    return grow(writer, needed);
+  }
+  return KNAPSACK_ERR_INVALID_ARGUMENT;
+}
+
+static knapsack_status_t append(knapsack_writer_t *writer, const char *data, size_t size) {
+  if (size == 0U) {
+    return KNAPSACK_OK;
+  }
+  if (writer->capacity - writer->length >= size) {
+    memcpy(writer->data + writer->length, data, size);
+    writer->length += size;
+    return KNAPSACK_OK;
+  }
+  if (!writer->write_fn) {
+    const knapsack_status_t status = reserve(writer, size);
+    if (status != KNAPSACK_OK) {
+      return status;
+    }
+    memcpy(writer->data + writer->length, data, size);
+    writer->length += size;
+    return KNAPSACK_OK;
+  }
+  /* Fill the storage, pass it on, and send a tail too big to buffer
+   * straight to the callback.
+   */
+  const size_t head = writer->capacity - writer->length;
+  memcpy(writer->data + writer->length, data, head);
+  writer->length += head;
+  knapsack_status_t status = knapsack_writer_flush(writer);
+  if (status != KNAPSACK_OK) {
+    return status;
+  }
+  data += head;
+  size -= head;
+  if (size >= writer->capacity) {
+    return writer->write_fn(data, size, writer->write_user_data) == 0 ? KNAPSACK_OK
+                                                                      : KNAPSACK_ERR_IO;
+  }
+  memcpy(writer->data, data, size);
+  writer->length = size;
+  return KNAPSACK_OK;
+}
+
+/* A failed object is taken back out of a buffer without a callback; bytes
+ * already handed to a callback cannot be.
+ */
+static knapsack_status_t finish(knapsack_writer_t *writer, size_t mark,
+                                knapsack_status_t status) {
+  if (status != KNAPSACK_OK && !writer->write_fn) {
+    writer->length = mark;
+  }
+  return status;
+}
+
+#define APPEND_LITERAL(writer, text) append((writer), (text), sizeof(text) - 1U)
+
+knapsack_status_t knapsack_writer_append(knapsack_writer_t *writer, const void *data,
+                                         size_t size) {
+  if (!writer || (!data && size > 0U)) {
+    return KNAPSACK_ERR_INVALID_ARGUMENT;
+  }
+  const size_t mark = writer->length;
+  return finish(writer, mark, append(writer, data, size));
+}
+
+static knapsack_status_t write_escaped(knapsack_writer_t *writer, const char *text) {
+  static const char k_hex[] = "0123456789abcdef";
+  const unsigned char *run = (const unsigned char *)text;
+  for (const unsigned char *p = run;; ++p) {
+    const unsigned char c = *p;
+    if (c >= 0x20U && c != '"' && c != '\\') {
+      continue;
+    }
+    /* Copy the run of plain characters before c in one go. */
+    knapsack_status_t status = append(writer, (const char *)run, (size_t)(p - run));
+    if (status != KNAPSACK_OK || c == '\0') {
+      return status;
+    }
+    char escape[6] = {'\\', (char)c, 0, 0, 0, 0};
+    size_t length = 2U;
+    switch (c) {
+    case '"':
+    case '\\':
+      break;
+    case '\b':
+      escape[1] = 'b';
+      break;
+    case '\f':
+      escape[1] = 'f';
+      break;
+    case '\n':
+      escape[1] = 'n';
+      break;
+    case '\r':
+      escape[1] = 'r';
+      break;
+    case '\t':
+      escape[1] = 't';
+      break;
+    default:
+      memcpy(escape + 1, "u00", 3U);
+      escape[4] = k_hex[c >> 4U];
+      escape[5] = k_hex[c & 0xFU];
+      length = 6U;
+      break;
+    }
+    status = append(writer, escape, length);
+    if (status != KNAPSACK_OK) {
+      return status;
+    }
+    run = p + 1;
+  }
+}
+
+knapsack_status_t knapsack_json_write_string(knapsack_writer_t *writer, const char *text) {
+  if (!writer) {
+    return KNAPSACK_ERR_INVALID_ARGUMENT;
+  }
+  const size_t mark = writer->length;
+  return finish(writer, mark, text ? write_escaped(writer, text) : KNAPSACK_OK);
+}
+
+/* Append an int field's digits. */
+static knapsack_status_t write_int(knapsack_writer_t *writer, int value) {
+  const knapsack_status_t status = reserve(writer, INT_FIELD_MAX);
+  if (status == KNAPSACK_OK) {
+    writer->length = (size_t)(put_int(writer->data + writer->length, value) - writer->data);
+  }
+  return status;
+}
+
+static knapsack_status_t write_indices(knapsack_writer_t *writer, const size_t *indices,
+                                       size_t count) {
+  size_t i = 0U;
+  while (i < count) {
+    const knapsack_status_t status = reserve(writer, INDEX_FIELD_MAX);
+    if (status != KNAPSACK_OK) {
+      return status;
+    }
+    const size_t fit = (writer->capacity - writer->length) / INDEX_FIELD_MAX;
+    const size_t stop = count - i < fit ? count : i + fit;
+    char *out = writer->data + writer->length;
+    for (; i < stop; ++i) {
+      if (i > 0U) {
+        *out++ = ',';
+      }
+      out = put_u64(out, (uint64_t)indices[i]);
+    }
+    writer->length = (size_t)(out - writer->data);
+  }
+  return KNAPSACK_OK;
+}
+
+static knapsack_status_t write_u64(knapsack_writer_t *writer, uint64_t value) {
+  const knapsack_status_t status = reserve(writer, INDEX_FIELD_MAX);
+  if (status == KNAPSACK_OK) {
+    writer->length = (size_t)(put_u64(writer->data + writer->length, value) - writer->data);
+  }
+  return status;
+}
+
+/* A numeric member of the stats object: the text before the number. */
+typedef struct {
+  const char *prefix;
+  uint64_t value;
+} stats_field_t;
+
+/* Append the ,"stats":{...} member (see knapsack_json_write_result_ex). */
+static knapsack_status_t write_stats(knapsack_writer_t *writer, const knapsack_stats_t *stats) {
+  const char *engine = knapsack_engine_name(stats->engine);
+  const char *kernel = knapsack_kernel_name(stats->kernel);
+  const stats_field_t fields[] = {
+      {"\",\"workers\":", stats->workers},
+      {",\"cells\":", stats->cells},
+      {",\"cells_taken\":", stats->cells_taken},
+      {",\"bytes\":{\"rows\":", stats->row_bytes},
+      {",\"take_bits\":", stats->take_bits_bytes},
+      {",\"engine\":", stats->engine_bytes},
+      {",\"instance\":", stats->instance_bytes},
+      {",\"arena\":", stats->arena_bytes},
+      {"},\"ns\":{\"validate\":", stats->validate_ns},
+      {",\"dp\":", stats->dp_ns},
+      {",\"select\":", stats->select_ns},
+      {",\"reconstruct\":", stats->reconstruct_ns},
+  };
+  knapsack_status_t status = APPEND_LITERAL(writer, ",\"stats\":{\"engine\":\"");
+  if (status == KNAPSACK_OK) {
+    status = append(writer, engine, strlen(engine));
+  }
+  if (status == KNAPSACK_OK) {
+    status = APPEND_LITERAL(writer, "\",\"kernel\":\"");
+  }
+  if (status == KNAPSACK_OK) {
+    status = append(writer, kernel, strlen(kernel));
+  }
+  for (size_t i = 0; status == KNAPSACK_OK && i < sizeof fields / sizeof fields[0]; ++i) {
+    status = append(writer, fields[i].prefix, strlen(fields[i].prefix));
+    if (status == KNAPSACK_OK) {
+      status = write_u64(writer, fields[i].value);
+    }
+  }
+  if (status == KNAPSACK_OK) {
+    status = APPEND_LITERAL(writer, "}}");
+  }
+  return status;
+}
+
+/* Close an object, after its stats member if there is one. */
+static knapsack_status_t write_close(knapsack_writer_t *writer, const knapsack_stats_t *stats) {
+  knapsack_status_t status = KNAPSACK_OK;
+  if (stats) {
+    status = write_stats(writer, stats);
+  }
+  if (status == KNAPSACK_OK) {
+    status = APPEND_LITERAL(writer, "}\n");
+  }
+  return status;
+}
+
+static knapsack_status_t write_result(knapsack_writer_t *writer, const knapsack_result_t *result,
+                                      const knapsack_stats_t *stats) {
+  knapsack_status_t status = APPEND_LITERAL(writer, "{\"status\":\"ok\",\"optimal_value\":");
+  if (status == KNAPSACK_OK) {
+    status = write_int(writer, result->optimal_value);
+  }
+  if (status == KNAPSACK_OK) {
+    status = APPEND_LITERAL(writer, ",\"selected_indices\":[");
+  }
+  if (status == KNAPSACK_OK) {
+    status = write_indices(writer, result->selected_indices, result->selected_count);
+  }
+  if (status == KNAPSACK_OK) {
+    status = APPEND_LITERAL(writer, "]");
+  }
+  if (status == KNAPSACK_OK) {
+    status = write_close(writer, stats);
+  }
+  return status;
+}
+
+static knapsack_status_t write_value(knapsack_writer_t *writer, const knapsack_result_t *result,
+                                     const knapsack_stats_t *stats) {
+  knapsack_status_t status = APPEND_LITERAL(writer, "{\"status\":\"ok\",\"optimal_value\":");
+  if (status == KNAPSACK_OK) {
+    status = write_int(writer, result->optimal_value);
+  }
+  if (status == KNAPSACK_OK) {
+    status = APPEND_LITERAL(writer, ",\"total_weight\":");
+  }
+  if (status == KNAPSACK_OK) {
+    status = write_int(writer, result->total_weight);
+  }
+  if (status == KNAPSACK_OK) {
+    status = write_close(writer, stats);
+  }
+  return status;
+}
+
+static knapsack_status_t write_error(knapsack_writer_t *writer, knapsack_status_t code,
+                                     const char *message) {
+  knapsack_status_t status = APPEND_LITERAL(writer, "{\"status\":\"error\",\"code\":\"");
+  if (status == KNAPSACK_OK) {
+    const char *name = knapsack_status_name(code);
+    status = append(writer, name, strlen(name));
+  }
+  if (status == KNAPSACK_OK) {
+    status = APPEND_LITERAL(writer, "\",\"message\":\"");
+  }
+  if (status == KNAPSACK_OK && message) {
+    status = write_escaped(writer, message);
+  }
+  if (status == KNAPSACK_OK) {
+    status = APPEND_LITERAL(writer, "\"}\n");
+  }
+  return status;
+}
+
+static bool result_valid(const knapsack_result_t *result) {
+  return result && (result->selected_count == 0U || result->selected_indices);
+}
+
+knapsack_status_t knapsack_json_write_result(knapsack_writer_t *writer,
+                                             const knapsack_result_t *result) {
+  return knapsack_json_write_result_ex(writer, result, NULL);
+}
+
+knapsack_status_t knapsack_json_write_result_ex(knapsack_writer_t *writer,
+                                                const knapsack_result_t *result,
+                                                const knapsack_stats_t *stats) {
+  if (!writer || !result_valid(result)) {
+    return KNAPSACK_ERR_INVALID_ARGUMENT;
+  }
+  const size_t mark = writer->length;
+  return finish(writer, mark, write_result(writer, result, stats));
+}
+
+knapsack_status_t knapsack_json_write_value(knapsack_writer_t *writer,
+                                            const knapsack_result_t *result) {
+  return knapsack_json_write_value_ex(writer, result, NULL);
+}
+
+knapsack_status_t knapsack_json_write_value_ex(knapsack_writer_t *writer,
+                                               const knapsack_result_t *result,
+                                               const knapsack_stats_t *stats) {
+  if (!writer || !result) {
+    return KNAPSACK_ERR_INVALID_ARGUMENT;
+  }
+  const size_t mark = writer->length;
+  return finish(writer, mark, write_value(writer, result, stats));
+}
+
+knapsack_status_t knapsack_json_write_error(knapsack_writer_t *writer, knapsack_status_t status,
+                                            const char *message) {
+  if (!writer) {
+    return KNAPSACK_ERR_INVALID_ARGUMENT;
+  }
+  const size_t mark = writer->length;
+  return finish(writer, mark, write_error(writer, status, message));
+}
@@ -1,23 +1,55 @@
 /* Knapsack 0/1 DP solver.
  *
- * Memory layout:
- *   prev_value[width], curr_value[width]   -- two int rows for value rolling.
- *   prev_weight[width], curr_weight[width] -- two size_t rows for weight tiebreaking.
- *   take_bits[ceil(count*width / 64)]      -- packed bitset of "take" decisions
- *                                              for reconstruction.
+ * Memory layout (one arena, each segment aligned to a 64-byte cache line):
+ *   value[width]                      -- int row, updated in place per item.
+ *   weight[width]                     -- uint32_t row for weight tiebreaking
+ *                                         (total weight <= capacity <= INT_MAX).
+ *   value_alt[width], weight_alt[width]
+ *                                     -- second row pair, parallel DP only
+ *                                         (it ping-pongs between the two).
+ *   take_bits[...]                    -- packed bitset of "take" decisions
+ *                                         for reconstruction. Each item's row
+ *                                         is trimmed to the words from the one
+ *                                         holding its weight's cell to the end
+ *                                         of the row (row_bits is width rounded
+ *                                         up to 64); nothing below the weight
+ *                                         can take the item. Rows start on a
+ *                                         64-bit word so threads filling
+ *                                         disjoint chunks never share a word.
+ *   take_rows[count + 1]              -- first word of each trimmed row.
+ *   indices[count]                    -- result slots; caller-supplied
+ *                                         buffers only.
+ *   reduced[kept], origin[kept]       -- compacted items and their caller
+ *                                         indices, when preprocessing drops
+ *                                         or rescales items.
+ *
+ * KNAPSACK_RECONSTRUCT_NONE (value only) leaves take_bits out of the arena
+ * entirely: the view's take_bits is NULL and the kernels record nothing.
+ * KNAPSACK_RECONSTRUCT_HIRSCHBERG drops take_bits and instead recovers the
+ * selection by divide and conquer over items, using two value/weight row
+ * pairs and a count-bit "picked" set (see the Hirschberg section).
+ *
+ * The arena belongs to a struct knapsack_workspace (the one-shot API uses a
+ * transient one; a caller-held knapsack_workspace_t reuses it across solves
+ * and only grows it) or is a buffer handed to knapsack_solve_with_buffer.
  *
  * All allocations go through a knapsack_allocator_t; the public default API
  * passes NULL and the implementation falls back to malloc/calloc/free.
  */
 
+#define _POSIX_C_SOURCE 200809L
+
 #include "knapsack/knapsack.h"
+#include "knapsack_internal.h"
 
 #include <limits.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 /* ------------------------------------------------------------------------- */
 /* Allocator plumbing                                                         */
@@ -43,7 +75,7 @@ static const knapsack_allocator_t k_default_allocator = {
     NULL,
 };
 
-static const knapsack_allocator_t *resolve_allocator(const knapsack_allocator_t *user) {
+const knapsack_allocator_t *resolve_allocator(const knapsack_allocator_t *user) {
   return user ? user : &k_default_allocator;
 }
 
@@ -51,15 +83,21 @@ static const knapsack_allocator_t *resolve_allocator(const knapsack_allocator_t
 /* Validation                                                                 */
 /* ------------------------------------------------------------------------- */
 
+static const knapsack_limits_t k_default_limits = {
+    KNAPSACK_MAX_ITEMS,
+    KNAPSACK_MAX_CAPACITY,
+};
+
 /* NOLINTNEXTLINE(bugprone-easily-swappable-parameters) -- public API order. */
-static knapsack_status_t validate_inputs(const knapsack_item_t *items, size_t count, int capacity) {
+static knapsack_status_t validate_inputs(const knapsack_item_t *items, size_t count, int capacity,
+                                         const knapsack_limits_t *limits) {
   if (!items || count == 0U) {
     return KNAPSACK_ERR_INVALID_ITEMS;
   }
-  if (count > KNAPSACK_MAX_ITEMS) {
+  if (count > limits->max_items) {
     return KNAPSACK_ERR_TOO_MANY_ITEMS;
   }
-  if (capacity < 0 || capacity > KNAPSACK_MAX_CAPACITY) {
+  if (capacity < 0 || capacity > limits->max_capacity) {
     return KNAPSACK_ERR_INVALID_CAPACITY;
   }
   for (size_t i = 0; i < count; ++i) {
@@ -70,75 +108,476 @@ static knapsack_status_t validate_inputs(const knapsack_item_t *items, size_t co
   return KNAPSACK_OK;
 }
 
-static bool add_int_no_overflow(int lhs, int rhs, int *out) {
-  const long long sum = (long long)lhs + (long long)rhs;
-  if (sum > INT_MAX || sum < INT_MIN) {
+/* ------------------------------------------------------------------------- */
+/* Statistics                                                                 */
+/* ------------------------------------------------------------------------- */
+
+/* knapsack_stats_t is filled only when a caller asks for it, and every
+ * collection site tests the pointer once per phase, never per cell. Built
+ * with KNAPSACK_NO_STATS (ENABLE_STATS=OFF), config_stats() is a constant
+ * NULL and the sites fold away.
+ */
+#ifdef KNAPSACK_NO_STATS
+#define KNAPSACK_STATS_ENABLED false
+#else
+#define KNAPSACK_STATS_ENABLED true
+#endif
+
+bool knapsack_stats_available(void) { return KNAPSACK_STATS_ENABLED; }
+
+static uint64_t stats_clock(void) {
+  struct timespec now;
+  if (clock_gettime(CLOCK_MONOTONIC, &now) != 0) {
+    return 0U;
+  }
+  return (uint64_t)now.tv_sec * UINT64_C(1000000000) + (uint64_t)now.tv_nsec;
+}
+
+/* Nanoseconds since *mark, which moves on to now. */
+static uint64_t stats_lap(uint64_t *mark) {
+  const uint64_t now = stats_clock();
+  const uint64_t elapsed = now - *mark;
+  *mark = now;
+  return elapsed;
+}
+
+static uint64_t popcount64(uint64_t x) {
+  x -= (x >> 1U) & UINT64_C(0x5555555555555555);
+  x = (x & UINT64_C(0x3333333333333333)) + ((x >> 2U) & UINT64_C(0x3333333333333333));
+  x = (x + (x >> 4U)) & UINT64_C(0x0F0F0F0F0F0F0F0F);
+  return (x * UINT64_C(0x0101010101010101)) >> 56U;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Cancellation                                                               */
+/* ------------------------------------------------------------------------- */
+
+bool cancel_poll(const cancel_t *cancel, size_t *credit, size_t work) {
+  if (!cancel || !cancel->fn) {
     return false;
   }
-  *out = (int)sum;
-  return true;
+  *credit += work;
+  if (*credit < KNAPSACK_CANCEL_POLL_CELLS) {
+    return false;
+  }
+  *credit = 0U;
+  return cancel->fn(cancel->user_data);
+}
+
+/* What the items a cancelled solve did not get to, [done, count), can add
+ * to a selection: neither more than all of them, nor more than the room
+ * left filled at the best value/weight ratio among them.
+ */
+typedef struct {
+  long long total;
+  long long ratio_value;
+  long long ratio_weight;
+} suffix_bound_t;
+
+static suffix_bound_t suffix_rate(const knapsack_item_t *items, size_t done, size_t count) {
+  suffix_bound_t rest = {0, 0, 1};
+  for (size_t i = done; i < count; ++i) {
+    rest.total += items[i].value;
+    if ((long long)items[i].value * rest.ratio_weight > rest.ratio_value * items[i].weight) {
+      rest.ratio_value = items[i].value;
+      rest.ratio_weight = items[i].weight;
+    }
+  }
+  return rest;
+}
+
+static long long suffix_gain(const suffix_bound_t *rest, long long room) {
+  const long long fractional = room * rest->ratio_value / rest->ratio_weight;
+  return fractional < rest->total ? fractional : rest->total;
+}
+
+/* Add items [done, count) first-fit in index order to a selection of value
+ * *value and weight *weight, skipping those that would not fit or would
+ * push the value past INT_MAX. Returns how many were added and, unless
+ * indices is NULL, writes them there.
+ */
+/* NOLINTBEGIN(bugprone-easily-swappable-parameters) -- internal helper, params are documented. */
+static size_t first_fit(const knapsack_item_t *items, size_t done, size_t count, int capacity,
+                        long long *value, long long *weight, size_t *indices) {
+  size_t added = 0U;
+  for (size_t i = done; i < count; ++i) {
+    if (items[i].value > 0 && *weight + items[i].weight <= capacity &&
+        *value + items[i].value <= INT_MAX) {
+      *value += items[i].value;
+      *weight += items[i].weight;
+      if (indices) {
+        indices[added] = i;
+      }
+      ++added;
+    }
+  }
+  return added;
+}
+
+/* Turn out_result, the exact optimum over the first `done` items (with its
+ * selection when history is set), into the anytime answer of a cancelled
+ * solve: the remaining items are added first-fit and upper_bound is set to
+ * bound. When index_storage is non-NULL (room for count entries) it already
+ * holds the prefix selection and alloc is not used. On failure the result
+ * is released and zeroed.
+ */
+static knapsack_status_t complete_anytime(const knapsack_item_t *items, size_t count, size_t done,
+                                          int capacity, long long bound, bool history,
+                                          const knapsack_allocator_t *alloc, size_t *index_storage,
+                                          knapsack_result_t *out_result) {
+  long long value = out_result->optimal_value;
+  long long weight = out_result->total_weight;
+  const size_t added = first_fit(items, done, count, capacity, &value, &weight, NULL);
+  const size_t prefix = out_result->selected_count;
+  if (history && added != 0U) {
+    size_t *indices = index_storage;
+    if (!indices) {
+      indices = alloc->alloc_fn((prefix + added) * sizeof(size_t), alloc->user_data);
+      if (!indices) {
+        alloc->free_fn(out_result->selected_indices, alloc->user_data);
+        *out_result = (knapsack_result_t){0};
+        return KNAPSACK_ERR_ALLOC;
+      }
+      if (prefix != 0U) {
+        memcpy(indices, out_result->selected_indices, prefix * sizeof(size_t));
+        alloc->free_fn(out_result->selected_indices, alloc->user_data);
+      }
+    }
+    long long prefix_value = out_result->optimal_value;
+    long long prefix_weight = out_result->total_weight;
+    (void)first_fit(items, done, count, capacity, &prefix_value, &prefix_weight, indices + prefix);
+    out_result->selected_indices = indices;
+    out_result->selected_count = prefix + added;
+  }
+  out_result->optimal_value = (int)value;
+  out_result->total_weight = (int)weight;
+  out_result->upper_bound = bound < INT_MAX ? (int)(bound > value ? bound : value) : INT_MAX;
+  return KNAPSACK_OK;
 }
+/* NOLINTEND(bugprone-easily-swappable-parameters) */
 
 /* ------------------------------------------------------------------------- */
-/* Bitset helpers                                                             */
+/* Preprocessing                                                              */
 /* ------------------------------------------------------------------------- */
 
-#define KNAPSACK_BITSET_WORD_BITS 64U
+/* Before any row is sized, every engine reduces the instance to what its DP
+ * can actually use:
+ *   - items heavier than the capacity can never be taken and are dropped;
+ *   - the capacity is clamped to the total weight of the remaining items;
+ *   - when nothing remains, or everything remaining fits at once, the answer
+ *     is read off directly (every kept item with a positive value, since a
+ *     zero-value item only adds weight) and no DP runs;
+ *   - weights and capacity are divided by the GCD of the kept weights. Every
+ *     subset weight is a multiple of it, so the same subsets fit.
+ * When items are dropped or rescaled the DP runs over a compacted copy whose
+ * origin[] maps positions back to caller indices. None of this changes the
+ * result or the overflow behaviour: every candidate the full DP would
+ * evaluate has an equal counterpart in the reduced one.
+ */
+typedef struct {
+  size_t kept;  /* items with weight <= capacity */
+  int capacity; /* capacity the DP runs at, in units of scale */
+  int limit;    /* the caller's capacity */
+  int scale;    /* GCD of the kept weights; 1 when nothing is kept */
+  bool trivial; /* nothing or everything fits: solve_trivial, no DP */
+  bool compact; /* the DP needs the compacted copy */
+} reduction_t;
 
-static size_t bitset_words(size_t bit_count) {
-  return (bit_count + KNAPSACK_BITSET_WORD_BITS - 1U) / KNAPSACK_BITSET_WORD_BITS;
+static int gcd_int(int a, int b) {
+  while (b != 0) {
+    const int rem = a % b;
+    a = b;
+    b = rem;
+  }
+  return a;
+}
+
+static reduction_t plan_reduction(const knapsack_item_t *items, size_t count, int capacity) {
+  size_t kept = 0U;
+  uint64_t kept_weight = 0U; /* saturates once above capacity */
+  int scale = 0;
+  for (size_t i = 0; i < count; ++i) {
+    const int weight = items[i].weight;
+    if (weight > capacity) {
+      continue;
+    }
+    ++kept;
+    if (kept_weight <= (uint64_t)capacity) {
+      kept_weight += (uint64_t)weight;
+    }
+    if (scale != 1) {
+      scale = gcd_int(weight, scale);
+    }
+  }
+  if (kept == 0U) {
+    scale = 1;
+  }
+  const bool all_fit = kept_weight <= (uint64_t)capacity;
+  const int reachable = all_fit ? (int)kept_weight : capacity;
+  return (reduction_t){
+      .kept = kept,
+      .capacity = reachable / scale,
+      .limit = capacity,
+      .scale = scale,
+      .trivial = kept == 0U || all_fit,
+      .compact = !(kept == 0U || all_fit) && (kept < count || scale > 1),
+  };
+}
+
+/* Write the compacted instance: kept items in order, weights divided by scale. */
+static void apply_reduction(const reduction_t *r, const knapsack_item_t *items, size_t count,
+                            knapsack_item_t *reduced, size_t *origin) {
+  size_t write = 0U;
+  for (size_t i = 0; i < count; ++i) {
+    if (items[i].weight > r->limit) {
+      continue;
+    }
+    reduced[write] = (knapsack_item_t){items[i].weight / r->scale, items[i].value};
+    origin[write] = i;
+    ++write;
+  }
+}
+
+/* Map a result over the reduced instance back to caller terms. origin is
+ * increasing, so the indices stay sorted.
+ */
+static void restore_result(const reduction_t *r, const size_t *origin,
+                           knapsack_result_t *out_result) {
+  /* An exact answer leaves upper_bound at 0: the optimum is its own bound. */
+  if (out_result->upper_bound < out_result->optimal_value) {
+    out_result->upper_bound = out_result->optimal_value;
+  }
+  out_result->total_weight *= r->scale;
+  if (!origin) {
+    return;
+  }
+  for (size_t k = 0; k < out_result->selected_count; ++k) {
+    out_result->selected_indices[k] = origin[out_result->selected_indices[k]];
+  }
+}
+
+/* Answer of a trivial reduction: every item that fits and has a positive
+ * value. Fails like the DP would if that total exceeds INT_MAX.
+ */
+/* NOLINTBEGIN(bugprone-easily-swappable-parameters) -- internal helper, params are documented. */
+static knapsack_status_t solve_trivial(const knapsack_item_t *items, size_t count, int capacity,
+                                       bool value_only, const knapsack_allocator_t *alloc,
+                                       size_t *index_storage, knapsack_result_t *out_result) {
+  long long total_value = 0;
+  long long total_weight = 0;
+  size_t selected = 0U;
+  for (size_t i = 0; i < count; ++i) {
+    if (items[i].weight <= capacity && items[i].value > 0) {
+      total_value += items[i].value;
+      if (total_value > INT_MAX) {
+        return KNAPSACK_ERR_INT_OVERFLOW;
+      }
+      total_weight += items[i].weight;
+      ++selected;
+    }
+  }
+  out_result->optimal_value = (int)total_value;
+  out_result->total_weight = (int)total_weight;
+  out_result->upper_bound = (int)total_value;
+  if (value_only || selected == 0U) {
+    return KNAPSACK_OK;
+  }
+
+  size_t *indices =
+      index_storage ? index_storage : alloc->alloc_fn(selected * sizeof(size_t), alloc->user_data);
+  if (!indices) {
+    return KNAPSACK_ERR_ALLOC;
+  }
+  size_t write = 0U;
+  for (size_t i = 0; i < count; ++i) {
+    if (items[i].weight <= capacity && items[i].value > 0) {
+      indices[write++] = i;
+    }
+  }
+  out_result->selected_indices = indices;
+  out_result->selected_count = selected;
+  return KNAPSACK_OK;
 }
+/* NOLINTEND(bugprone-easily-swappable-parameters) */
+
+/* ------------------------------------------------------------------------- */
+/* Bitset helpers                                                             */
+/* ------------------------------------------------------------------------- */
 
-static void bitset_set(uint64_t *bits, size_t idx) {
-  bits[idx / KNAPSACK_BITSET_WORD_BITS] |= (uint64_t)1 << (idx % KNAPSACK_BITSET_WORD_BITS);
+static size_t bitset_words(size_t bit_count) {
+  return (bit_count + KNAPSACK_BITSET_WORD_BITS - 1U) / KNAPSACK_BITSET_WORD_BITS;
 }
 
 static bool bitset_test(const uint64_t *bits, size_t idx) {
   return (bits[idx / KNAPSACK_BITSET_WORD_BITS] >> (idx % KNAPSACK_BITSET_WORD_BITS)) & 1U;
 }
 
+/* Bits per item row of take_bits: width rounded up to a whole word. */
+static size_t row_stride_bits(size_t width) {
+  return bitset_words(width) * KNAPSACK_BITSET_WORD_BITS;
+}
+
+/* Words of an item's trimmed decision row (see knapsack_internal.h). */
+static size_t take_row_words(size_t width, size_t item_weight) {
+  return item_weight < width ? bitset_words(width) - item_weight / KNAPSACK_BITSET_WORD_BITS : 0U;
+}
+
+size_t take_row_bit(const size_t *row_word, size_t row, size_t item_weight, size_t cap) {
+  const size_t skipped = item_weight / KNAPSACK_BITSET_WORD_BITS * KNAPSACK_BITSET_WORD_BITS;
+  return row_word[row] * KNAPSACK_BITSET_WORD_BITS + (cap - skipped);
+}
+
+void take_rows_clear(uint64_t *take_bits, const size_t *row_word, size_t first, size_t last) {
+  memset(take_bits + row_word[first], 0, (row_word[last] - row_word[first]) * sizeof(uint64_t));
+}
+
+/* Lay out the trimmed rows of items over width cells; row_word has count + 1
+ * entries and the last one is the total word count.
+ */
+static void index_take_rows(const knapsack_item_t *items, size_t count, size_t width,
+                            size_t *row_word) {
+  row_word[0] = 0U;
+  for (size_t i = 0; i < count; ++i) {
+    row_word[i + 1U] = row_word[i] + take_row_words(width, (size_t)items[i].weight);
+  }
+}
+
 /* ------------------------------------------------------------------------- */
 /* Workspace                                                                  */
 /* ------------------------------------------------------------------------- */
 
 typedef struct {
   size_t width;          /* capacity + 1 */
-  size_t take_bit_count; /* count * width */
-  int *prev_value;
-  int *curr_value;
-  size_t *prev_weight;
-  size_t *curr_weight;
+  size_t row_bits;       /* untrimmed take_bits row, a multiple of 64 */
+  size_t take_bit_count; /* bits of all trimmed rows */
+  int *value;            /* best value per capacity, updated in place */
+  uint32_t *weight;      /* total weight of that best value (tie-break) */
+  int *value_alt;        /* second row pair for the parallel DP, else NULL */
+  uint32_t *weight_alt;
   uint64_t *take_bits;
+  size_t *row_word; /* trimmed rows; NULL: row i untrimmed at i * row_bits (sessions) */
 } workspace_t;
 
-static void free_workspace(workspace_t *ws, const knapsack_allocator_t *alloc) {
-  if (!ws) {
-    return;
+/* Every buffer of a workspace_t is carved out of one arena. Each segment
+ * starts on its own cache line so rows never share a line with a neighbour.
+ */
+#define KNAPSACK_ARENA_ALIGN 64U
+
+typedef struct {
+  size_t value;
+  size_t weight;
+  size_t value_alt; /* only populated when two_rows */
+  size_t weight_alt;
+  size_t take_bits;
+  size_t take_rows;
+  size_t indices; /* only populated for caller-supplied buffers */
+  size_t reduced; /* compacted items, when preprocessing needs them */
+  size_t origin;
+  size_t total;
+  bool two_rows;
+} arena_layout_t;
+
+/* Append a segment of nmemb * size bytes at the next aligned offset. */
+static bool arena_push(size_t *cursor, size_t nmemb, size_t size, size_t *offset_out) {
+  if (size != 0U && nmemb > SIZE_MAX / size) {
+    return false;
+  }
+  const size_t bytes = nmemb * size;
+  const size_t pad = (KNAPSACK_ARENA_ALIGN - *cursor % KNAPSACK_ARENA_ALIGN) % KNAPSACK_ARENA_ALIGN;
+  if (*cursor > SIZE_MAX - pad || *cursor + pad > SIZE_MAX - bytes) {
+    return false;
+  }
+  *offset_out = *cursor + pad;
+  *cursor = *offset_out + bytes;
+  return true;
+}
+
+/* NOLINTBEGIN(bugprone-easily-swappable-parameters) -- internal helper, params are documented. */
+static bool plan_arena(size_t width, size_t take_bit_count, size_t row_count, size_t index_count,
+                       size_t reduced_count, bool two_rows, arena_layout_t *layout) {
+  const size_t alt_width = two_rows ? width : 0U;
+  const size_t row_index = take_bit_count != 0U ? row_count + 1U : 0U;
+  size_t cursor = 0U;
+  layout->two_rows = two_rows;
+  if (!arena_push(&cursor, width, sizeof(int), &layout->value) ||
+      !arena_push(&cursor, width, sizeof(uint32_t), &layout->weight) ||
+      !arena_push(&cursor, alt_width, sizeof(int), &layout->value_alt) ||
+      !arena_push(&cursor, alt_width, sizeof(uint32_t), &layout->weight_alt) ||
+      !arena_push(&cursor, bitset_words(take_bit_count), sizeof(uint64_t), &layout->take_bits) ||
+      !arena_push(&cursor, row_index, sizeof(size_t), &layout->take_rows) ||
+      !arena_push(&cursor, index_count, sizeof(size_t), &layout->indices) ||
+      !arena_push(&cursor, reduced_count, sizeof(knapsack_item_t), &layout->reduced) ||
+      !arena_push(&cursor, reduced_count, sizeof(size_t), &layout->origin)) {
+    return false;
+  }
+  layout->total = cursor;
+  return true;
+}
+/* NOLINTEND(bugprone-easily-swappable-parameters) */
+
+static unsigned char *align_arena(void *block) {
+  const uintptr_t addr = (uintptr_t)block;
+  const uintptr_t aligned =
+      (addr + (KNAPSACK_ARENA_ALIGN - 1U)) & ~(uintptr_t)(KNAPSACK_ARENA_ALIGN - 1U);
+  return (unsigned char *)block + (aligned - addr);
+}
+
+/* Build a per-solve view over an aligned arena laid out by plan_arena. The
+ * rows are zeroed unless the arena is known to be fresh from calloc_fn. The
+ * alternate rows are never read before being written, so they are left as
+ * they are, and the engines zero each decision row just before filling it.
+ * row_word still has to be laid out with index_take_rows.
+ */
+static workspace_t carve_workspace(unsigned char *arena, const arena_layout_t *layout,
+                                   size_t width, size_t take_bit_count, bool already_zeroed) {
+  workspace_t view = {
+      .width = width,
+      .row_bits = row_stride_bits(width),
+      .take_bit_count = take_bit_count,
+      .value = (int *)(void *)(arena + layout->value),
+      .weight = (uint32_t *)(void *)(arena + layout->weight),
+      .value_alt = layout->two_rows ? (int *)(void *)(arena + layout->value_alt) : NULL,
+      .weight_alt = layout->two_rows ? (uint32_t *)(void *)(arena + layout->weight_alt) : NULL,
+      .take_bits = take_bit_count ? (uint64_t *)(void *)(arena + layout->take_bits) : NULL,
+      .row_word = take_bit_count ? (size_t *)(void *)(arena + layout->take_rows) : NULL,
+  };
+  if (!already_zeroed) {
+    memset(view.value, 0, width * sizeof(int));
+    memset(view.weight, 0, width * sizeof(uint32_t));
+  }
+  return view;
+}
+
+/* struct knapsack_workspace (knapsack_internal.h) is the reusable arena; a
+ * workspace_t above is the per-solve view onto it.
+ */
+static void release_buffers(struct knapsack_workspace *ws) {
+  ws->alloc->free_fn(ws->block, ws->alloc->user_data);
+  ws->block = NULL;
+  ws->arena = NULL;
+  ws->arena_size = 0U;
+  ws->arena_zeroed = false;
+}
+
+/* Grow (never shrink) the arena to at least total bytes. A single calloc_fn
+ * call backs the whole arena. On failure the arena is released.
+ */
+static bool reserve_buffers(struct knapsack_workspace *ws, size_t total) {
+  if (ws->block && total <= ws->arena_size) {
+    return true;
+  }
+  release_buffers(ws);
+  if (total > SIZE_MAX - (KNAPSACK_ARENA_ALIGN - 1U)) {
+    return false;
   }
-  alloc->free_fn(ws->prev_value, alloc->user_data);
-  alloc->free_fn(ws->curr_value, alloc->user_data);
-  alloc->free_fn(ws->prev_weight, alloc->user_data);
-  alloc->free_fn(ws->curr_weight, alloc->user_data);
-  alloc->free_fn(ws->take_bits, alloc->user_data);
-  ws->prev_value = NULL;
-  ws->curr_value = NULL;
-  ws->prev_weight = NULL;
-  ws->curr_weight = NULL;
-  ws->take_bits = NULL;
-}
-
-static bool allocate_workspace(workspace_t *ws, const knapsack_allocator_t *alloc) {
-  ws->prev_value = alloc->calloc_fn(ws->width, sizeof(int), alloc->user_data);
-  ws->curr_value = alloc->calloc_fn(ws->width, sizeof(int), alloc->user_data);
-  ws->prev_weight = alloc->calloc_fn(ws->width, sizeof(size_t), alloc->user_data);
-  ws->curr_weight = alloc->calloc_fn(ws->width, sizeof(size_t), alloc->user_data);
-  const size_t words = bitset_words(ws->take_bit_count);
-  ws->take_bits = alloc->calloc_fn(words, sizeof(uint64_t), alloc->user_data);
-  if (!ws->prev_value || !ws->curr_value || !ws->prev_weight || !ws->curr_weight ||
-      !ws->take_bits) {
-    free_workspace(ws, alloc);
+  const size_t bytes = total + (KNAPSACK_ARENA_ALIGN - 1U);
+  ws->block = ws->alloc->calloc_fn(bytes, 1U, ws->alloc->user_data);
+  if (!ws->block) {
     return false;
   }
+  ws->arena = align_arena(ws->block);
+  ws->arena_size = bytes - (size_t)(ws->arena - (unsigned char *)ws->block);
+  ws->arena_zeroed = true;
   return true;
 }
 
@@ -146,55 +585,269 @@ static bool allocate_workspace(workspace_t *ws, const knapsack_allocator_t *allo
 /* DP                                                                         */
 /* ------------------------------------------------------------------------- */
 
-static void copy_row(size_t width, int *dest_value, const int *src_value, size_t *dest_weight,
-                     const size_t *src_weight) {
-  memcpy(dest_value, src_value, width * sizeof(int));
-  memcpy(dest_weight, src_weight, width * sizeof(size_t));
-}
+/* Single-row 0/1 DP. Sweeping capacity high-to-low means value[cap - w] is
+ * still the previous item's entry when cap is updated, so one row replaces
+ * the classic prev/curr pair and no per-item row copy is needed. Decisions
+ * and tie-breaks are identical to the two-row formulation. The per-item
+ * update itself is delegated to the dispatched kernel (dp_kernels.c).
+ */
+/* Cancellation state of one DP run; done is the number of items whose row
+ * update is complete when the run stops, cells the cells they updated.
+ */
+typedef struct {
+  const cancel_t *cancel;
+  size_t credit;
+  size_t done;
+  uint64_t cells;
+} dp_progress_t;
 
-static bool run_dp(const knapsack_item_t *items, size_t count, workspace_t *ws) {
-  const size_t width = ws->width;
+/* With take_bits NULL the rows are still filled but no decisions are kept.
+ * With row_word non-NULL take_bits holds trimmed rows, each zeroed just
+ * before its item fills it; otherwise row i starts at bit i * row_bits and
+ * is already zero. With progress non-NULL, cancellation is polled between
+ * items; the rows then hold the exact DP over the first progress->done
+ * items.
+ */
+/* NOLINTBEGIN(bugprone-easily-swappable-parameters) -- internal helper, params are documented. */
+static knapsack_status_t sweep_items(const knapsack_item_t *items, size_t count, size_t width,
+                                     size_t row_bits, const size_t *row_word, int *value,
+                                     uint32_t *weight, uint64_t *take_bits,
+                                     dp_progress_t *progress) {
+  const dp_kernel_fn kernel = dp_active_kernel();
 
   for (size_t i = 0; i < count; ++i) {
-    copy_row(width, ws->curr_value, ws->prev_value, ws->curr_weight, ws->prev_weight);
-
     const size_t item_weight = (size_t)items[i].weight;
-    const int item_value = items[i].value;
+    if (item_weight >= width) {
+      continue;
+    }
+    size_t bit_offset = 0U;
+    if (take_bits && row_word) {
+      take_rows_clear(take_bits, row_word, i, i + 1U);
+      bit_offset = take_row_bit(row_word, i, item_weight, item_weight);
+    } else if (take_bits) {
+      bit_offset = i * row_bits + item_weight;
+    }
+    const dp_span_t span = {
+        .out_value = value + item_weight,
+        .out_weight = weight + item_weight,
+        .keep_value = value + item_weight,
+        .keep_weight = weight + item_weight,
+        .take_value = value,
+        .take_weight = weight,
+        .n = width - item_weight,
+        .item_value = items[i].value,
+        .item_weight = (uint32_t)item_weight,
+        .bits = take_bits,
+        .bit_offset = bit_offset,
+    };
+    if (!kernel(&span)) {
+      return KNAPSACK_ERR_INT_OVERFLOW;
+    }
+    if (!progress) {
+      continue;
+    }
+    progress->cells += span.n;
+    if (i + 1U < count && cancel_poll(progress->cancel, &progress->credit, span.n)) {
+      progress->done = i + 1U;
+      return KNAPSACK_ERR_CANCELLED;
+    }
+  }
+  if (progress) {
+    progress->done = count;
+  }
+  return KNAPSACK_OK;
+}
+/* NOLINTEND(bugprone-easily-swappable-parameters) */
 
-    for (size_t cap = item_weight; cap < width; ++cap) {
-      int candidate_val = 0;
-      if (!add_int_no_overflow(ws->prev_value[cap - item_weight], item_value, &candidate_val)) {
-        return false;
-      }
-      const size_t candidate_weight = ws->prev_weight[cap - item_weight] + item_weight;
-      const int current_val = ws->curr_value[cap];
-      const size_t current_weight = ws->curr_weight[cap];
-
-      if (candidate_val > current_val ||
-          (candidate_val == current_val && candidate_weight < current_weight)) {
-        ws->curr_value[cap] = candidate_val;
-        ws->curr_weight[cap] = candidate_weight;
-        bitset_set(ws->take_bits, i * width + cap);
+static knapsack_status_t run_dp(const knapsack_item_t *items, size_t count, workspace_t *ws,
+                                dp_progress_t *progress) {
+  return sweep_items(items, count, ws->width, ws->row_bits, ws->row_word, ws->value, ws->weight,
+                     ws->take_bits, progress);
+}
+
+/* The cache-blocked DP (tiled_dp.c) over the view's rows; tiled brings the
+ * halo buffers and the block size. Rows, decisions and progress end up as
+ * run_dp leaves them over the same items.
+ */
+static knapsack_status_t run_dp_tiled(const knapsack_item_t *items, size_t count,
+                                      workspace_t *ws, tiled_dp_t *tiled,
+                                      dp_progress_t *progress) {
+  tiled->value = ws->value;
+  tiled->weight = ws->weight;
+  tiled->take_bits = ws->take_bits;
+  tiled->row_word = ws->row_word;
+  tiled->width = ws->width;
+  const tiled_status_t status = tiled_run(items, count, progress->cancel, tiled);
+  progress->done = tiled->done;
+  progress->cells = tiled->cells;
+  switch (status) {
+  case TILED_DONE:
+    return KNAPSACK_OK;
+  case TILED_OVERFLOW:
+    return KNAPSACK_ERR_INT_OVERFLOW;
+  case TILED_CANCELLED:
+    break;
+  }
+  return KNAPSACK_ERR_CANCELLED;
+}
+
+/* Capacity-partitioned DP. Within one item every cell depends only on the
+ * previous item's row, so the row is split into per-worker chunks of whole
+ * take_bits words and the workers meet at a barrier after each item. The
+ * update cannot run in place here (a chunk reads cells left of its start
+ * that another worker is rewriting), so it ping-pongs between the two row
+ * pairs of the view. Decisions are the same as in run_dp.
+ */
+#define KNAPSACK_PARALLEL_MIN_CHUNK_WORDS 16U /* 1024 cells per worker */
+
+typedef struct {
+  const knapsack_item_t *items;
+  size_t count;
+  const workspace_t *ws;
+  dp_kernel_fn kernel;
+  knapsack_thread_pool_t *pool;
+  atomic_size_t overflow_item; /* lowest overflowing item index, SIZE_MAX if none */
+  dp_progress_t *progress;     /* polled by worker 0 only */
+  atomic_size_t cancel_item;   /* item after which to stop, SIZE_MAX if none */
+} parallel_dp_t;
+
+static void note_overflow(atomic_size_t *slot, size_t item) {
+  size_t seen = atomic_load_explicit(slot, memory_order_relaxed);
+  while (item < seen && !atomic_compare_exchange_weak_explicit(slot, &seen, item,
+                                                               memory_order_relaxed,
+                                                               memory_order_relaxed)) {
+  }
+}
+
+static void parallel_dp_task(void *ctx, size_t worker, size_t workers) {
+  parallel_dp_t *job = ctx;
+  const workspace_t *ws = job->ws;
+  const size_t words = ws->row_bits / KNAPSACK_BITSET_WORD_BITS;
+  const size_t lo = words * worker / workers * KNAPSACK_BITSET_WORD_BITS;
+  size_t hi = words * (worker + 1U) / workers * KNAPSACK_BITSET_WORD_BITS;
+  if (hi > ws->width) {
+    hi = ws->width;
+  }
+
+  int *src_value = ws->value;
+  uint32_t *src_weight = ws->weight;
+  int *dst_value = ws->value_alt;
+  uint32_t *dst_weight = ws->weight_alt;
+  for (size_t i = 0; i < job->count; ++i) {
+    const size_t item_weight = (size_t)job->items[i].weight;
+    if (item_weight >= ws->width) {
+      continue; /* same decision on every worker: no barrier, no swap */
+    }
+    size_t split = item_weight < lo ? lo : item_weight;
+    if (split > hi) {
+      split = hi;
+    }
+    /* Cells [lo, split) cannot hold the item: carry them over. */
+    memcpy(dst_value + lo, src_value + lo, (split - lo) * sizeof(int));
+    memcpy(dst_weight + lo, src_weight + lo, (split - lo) * sizeof(uint32_t));
+    if (hi > split && ws->take_bits) {
+      /* This chunk's words of the trimmed row, from the one holding split. */
+      const size_t first_bit = take_row_bit(ws->row_word, i, item_weight, split);
+      const size_t end_bit = take_row_bit(ws->row_word, i, item_weight, hi - 1U) + 1U;
+      memset(ws->take_bits + first_bit / KNAPSACK_BITSET_WORD_BITS, 0,
+             (bitset_words(end_bit) - first_bit / KNAPSACK_BITSET_WORD_BITS) * sizeof(uint64_t));
+    }
+    if (hi > split) {
+      const dp_span_t span = {
+          .out_value = dst_value + split,
+          .out_weight = dst_weight + split,
+          .keep_value = src_value + split,
+          .keep_weight = src_weight + split,
+          .take_value = src_value + (split - item_weight),
+          .take_weight = src_weight + (split - item_weight),
+          .n = hi - split,
+          .item_value = job->items[i].value,
+          .item_weight = (uint32_t)item_weight,
+          .bits = ws->take_bits,
+          .bit_offset = ws->take_bits ? take_row_bit(ws->row_word, i, item_weight, split) : 0U,
+      };
+      if (!job->kernel(&span)) {
+        note_overflow(&job->overflow_item, i);
       }
     }
+    /* The callback runs on worker 0 alone; its verdict is published by the
+     * barrier like an overflow.
+     */
+    if (worker == 0U && i + 1U < job->count &&
+        cancel_poll(job->progress->cancel, &job->progress->credit, ws->width - item_weight)) {
+      atomic_store_explicit(&job->cancel_item, i, memory_order_relaxed);
+    }
+    pool_barrier_wait(job->pool);
+    /* Only items <= i can have been flagged by now, on any worker, so every
+     * worker takes this exit at the same item.
+     */
+    if (atomic_load_explicit(&job->overflow_item, memory_order_relaxed) <= i ||
+        atomic_load_explicit(&job->cancel_item, memory_order_relaxed) <= i) {
+      return;
+    }
+    int *const tmp_value = src_value;
+    uint32_t *const tmp_weight = src_weight;
+    src_value = dst_value;
+    src_weight = dst_weight;
+    dst_value = tmp_value;
+    dst_weight = tmp_weight;
+  }
+}
+
+static size_t parallel_workers(const workspace_t *ws, knapsack_thread_pool_t *pool) {
+  const size_t words = ws->row_bits / KNAPSACK_BITSET_WORD_BITS;
+  const size_t by_width = words / KNAPSACK_PARALLEL_MIN_CHUNK_WORDS;
+  const size_t size = knapsack_thread_pool_size(pool);
+  return by_width < size ? by_width : size;
+}
+
+static knapsack_status_t run_dp_parallel(const knapsack_item_t *items, size_t count,
+                                         workspace_t *ws, knapsack_thread_pool_t *pool,
+                                         size_t workers, dp_progress_t *progress) {
+  parallel_dp_t job = {
+      .items = items,
+      .count = count,
+      .ws = ws,
+      .kernel = dp_active_kernel(),
+      .pool = pool,
+      .progress = progress,
+  };
+  atomic_init(&job.overflow_item, SIZE_MAX);
+  atomic_init(&job.cancel_item, SIZE_MAX);
+  pool_run(pool, workers, parallel_dp_task, &job);
+  if (atomic_load_explicit(&job.overflow_item, memory_order_relaxed) != SIZE_MAX) {
+    return KNAPSACK_ERR_INT_OVERFLOW;
+  }
+  const size_t cancel_item = atomic_load_explicit(&job.cancel_item, memory_order_relaxed);
+  progress->done = cancel_item == SIZE_MAX ? count : cancel_item + 1U;
 
-    int *tmp_v = ws->prev_value;
-    ws->prev_value = ws->curr_value;
-    ws->curr_value = tmp_v;
-    size_t *tmp_w = ws->prev_weight;
-    ws->prev_weight = ws->curr_weight;
-    ws->curr_weight = tmp_w;
+  /* Every applied item swapped the rows once; point the view at the last. */
+  size_t applied = 0U;
+  for (size_t i = 0; i < progress->done; ++i) {
+    const size_t item_weight = (size_t)items[i].weight;
+    if (item_weight < ws->width) {
+      ++applied;
+      progress->cells += ws->width - item_weight;
+    }
   }
-  return true;
+  if (applied % 2U != 0U) {
+    int *const tmp_value = ws->value;
+    uint32_t *const tmp_weight = ws->weight;
+    ws->value = ws->value_alt;
+    ws->weight = ws->weight_alt;
+    ws->value_alt = tmp_value;
+    ws->weight_alt = tmp_weight;
+  }
+  return progress->done == count ? KNAPSACK_OK : KNAPSACK_ERR_CANCELLED;
 }
 
 static size_t select_best_cap(const workspace_t *ws) {
   size_t best_cap = 0U;
-  int best_val = ws->prev_value[0];
-  size_t best_weight = ws->prev_weight[0];
+  int best_val = ws->value[0];
+  uint32_t best_weight = ws->weight[0];
   for (size_t cap = 1U; cap < ws->width; ++cap) {
-    const int val = ws->prev_value[cap];
-    const size_t weight_at_cap = ws->prev_weight[cap];
+    const int val = ws->value[cap];
+    const uint32_t weight_at_cap = ws->weight[cap];
     if (val > best_val || (val == best_val && weight_at_cap < best_weight)) {
       best_val = val;
       best_weight = weight_at_cap;
@@ -204,42 +857,89 @@ static size_t select_best_cap(const workspace_t *ws) {
   return best_cap;
 }
 
+/* Whether item i (of item_weight) is taken at cap, in either row layout. */
+static bool take_test(const workspace_t *ws, size_t i, size_t item_weight, size_t cap) {
+  if (!ws->row_word) {
+    return bitset_test(ws->take_bits, i * ws->row_bits + cap);
+  }
+  return cap >= item_weight &&
+         bitset_test(ws->take_bits, take_row_bit(ws->row_word, i, item_weight, cap));
+}
+
+/* Decisions that took their item in the rows of the first `rows` items. */
+static uint64_t count_taken(const workspace_t *ws, size_t rows) {
+  const size_t words = ws->row_word ? ws->row_word[rows]
+                                    : rows * (ws->row_bits / KNAPSACK_BITSET_WORD_BITS);
+  uint64_t taken = 0U;
+  for (size_t i = 0; i < words; ++i) {
+    taken += popcount64(ws->take_bits[i]);
+  }
+  return taken;
+}
+
+/* Bound on the full optimum from rows over a prefix of the items: whatever
+ * weight c the optimum spends on the prefix, that part is worth at most
+ * cell c and the rest gains at most suffix_gain of the remaining room.
+ */
+static long long row_bound(const workspace_t *ws, const suffix_bound_t *rest) {
+  const size_t capacity = ws->width - 1U;
+  long long bound = 0;
+  for (size_t cap = 0U; cap < ws->width; ++cap) {
+    const long long cell = ws->value[cap] + suffix_gain(rest, (long long)(capacity - cap));
+    if (cell > bound) {
+      bound = cell;
+    }
+  }
+  return bound;
+}
+
 static int compare_size_t(const void *lhs, const void *rhs) {
   const size_t l = *(const size_t *)lhs;
   const size_t r = *(const size_t *)rhs;
   return (l > r) - (l < r);
 }
 
-/* NOLINTBEGIN(bugprone-easily-swappable-parameters) -- internal helper, params are documented. */
-static knapsack_status_t reconstruct_solution(const workspace_t *ws, const knapsack_item_t *items,
-                                              size_t count, size_t best_cap,
-                                              const knapsack_allocator_t *alloc,
-                                              knapsack_result_t *out_result) {
-  /* First pass: count selections. */
+/* Number of items the decisions select when walked back from best_cap. */
+static size_t count_selected(const workspace_t *ws, const knapsack_item_t *items, size_t count,
+                             size_t best_cap) {
   size_t cap = best_cap;
   size_t selected = 0U;
   for (size_t i = count; i-- > 0;) {
-    if (bitset_test(ws->take_bits, i * ws->width + cap)) {
+    if (take_test(ws, i, (size_t)items[i].weight, cap)) {
       ++selected;
       cap -= (size_t)items[i].weight;
     }
   }
+  return selected;
+}
 
-  out_result->optimal_value = ws->prev_value[best_cap];
+/* When index_storage is non-NULL (room for count entries) the selection is
+ * written there and alloc is not used.
+ */
+/* NOLINTBEGIN(bugprone-easily-swappable-parameters) -- internal helper, params are documented. */
+static knapsack_status_t reconstruct_solution(const workspace_t *ws, const knapsack_item_t *items,
+                                              size_t count, size_t best_cap,
+                                              const knapsack_allocator_t *alloc,
+                                              size_t *index_storage,
+                                              knapsack_result_t *out_result) {
+  const size_t selected = count_selected(ws, items, count, best_cap);
+  out_result->optimal_value = ws->value[best_cap];
+  out_result->total_weight = (int)ws->weight[best_cap];
   if (selected == 0U) {
     return KNAPSACK_OK;
   }
 
-  size_t *indices = alloc->alloc_fn(selected * sizeof(size_t), alloc->user_data);
+  size_t *indices =
+      index_storage ? index_storage : alloc->alloc_fn(selected * sizeof(size_t), alloc->user_data);
   if (!indices) {
     return KNAPSACK_ERR_ALLOC;
   }
 
-  /* Second pass: fill (back-to-front). */
+  /* Fill back-to-front. */
   size_t write = selected;
-  cap = best_cap;
+  size_t cap = best_cap;
   for (size_t i = count; i-- > 0;) {
-    if (bitset_test(ws->take_bits, i * ws->width + cap)) {
+    if (take_test(ws, i, (size_t)items[i].weight, cap)) {
       indices[--write] = i;
       cap -= (size_t)items[i].weight;
     }
@@ -253,75 +953,2560 @@ static knapsack_status_t reconstruct_solution(const workspace_t *ws, const knaps
 /* NOLINTEND(bugprone-easily-swappable-parameters) */
 
 /* ------------------------------------------------------------------------- */
-/* Public API                                                                 */
+/* Hirschberg reconstruction                                                  */
 /* ------------------------------------------------------------------------- */
 
-void knapsack_result_free(knapsack_result_t *result) { knapsack_result_free_ex(result, NULL); }
+/* Divide and conquer over items instead of a count*width decision bitset.
+ * For items [lo, hi) and capacity cap, a forward DP over [lo, mid) and a
+ * second DP over [mid, hi) give, for every c, the best (value, min weight)
+ * of each half within c and within cap - c. The best split of these two
+ * rows is the optimum of the whole range, because both the value and the
+ * weight of the tie-break order add up across halves. Each half is then
+ * solved recursively for the capacity its optimum actually uses, so the
+ * same two row pairs are reused at every level: O(width) memory, and the
+ * recursion is only log2(count) deep. Leaves are visited in index order.
+ */
 
-void knapsack_result_free_ex(knapsack_result_t *result, const knapsack_allocator_t *allocator) {
-  if (!result) {
-    return;
+typedef struct {
+  const knapsack_item_t *items;
+  int *fwd_value;
+  uint32_t *fwd_weight;
+  int *bwd_value;
+  uint32_t *bwd_weight;
+  uint64_t *picked; /* one bit per item */
+  size_t selected;
+  dp_progress_t progress; /* shared by every row the recursion computes */
+} hirschberg_t;
+
+typedef struct {
+  size_t fwd_value;
+  size_t fwd_weight;
+  size_t bwd_value;
+  size_t bwd_weight;
+  size_t picked;
+  size_t reduced;
+  size_t origin;
+  size_t total;
+} hirschberg_layout_t;
+
+static bool plan_hirschberg_arena(size_t width, size_t count, size_t reduced_count,
+                                  hirschberg_layout_t *layout) {
+  size_t cursor = 0U;
+  if (!arena_push(&cursor, width, sizeof(int), &layout->fwd_value) ||
+      !arena_push(&cursor, width, sizeof(uint32_t), &layout->fwd_weight) ||
+      !arena_push(&cursor, width, sizeof(int), &layout->bwd_value) ||
+      !arena_push(&cursor, width, sizeof(uint32_t), &layout->bwd_weight) ||
+      !arena_push(&cursor, bitset_words(count), sizeof(uint64_t), &layout->picked) ||
+      !arena_push(&cursor, reduced_count, sizeof(knapsack_item_t), &layout->reduced) ||
+      !arena_push(&cursor, reduced_count, sizeof(size_t), &layout->origin)) {
+    return false;
   }
-  const knapsack_allocator_t *alloc = resolve_allocator(allocator);
-  alloc->free_fn(result->selected_indices, alloc->user_data);
-  result->selected_indices = NULL;
-  result->selected_count = 0;
-  result->optimal_value = 0;
+  layout->total = cursor;
+  return true;
 }
 
-knapsack_status_t knapsack_solve_status(const knapsack_item_t *items, size_t count, int capacity,
-                                        knapsack_result_t *out_result) {
-  return knapsack_solve_status_ex(items, count, capacity, NULL, out_result);
+/* Best (value, weight) of items within capacity width - 1, into a row pair. */
+static knapsack_status_t hirschberg_row(hirschberg_t *h, size_t lo, size_t hi, size_t width,
+                                        int *value, uint32_t *weight) {
+  memset(value, 0, width * sizeof(int));
+  memset(weight, 0, width * sizeof(uint32_t));
+  return sweep_items(h->items + lo, hi - lo, width, width, NULL, value, weight, NULL,
+                     &h->progress);
 }
 
-knapsack_status_t knapsack_solve_status_ex(const knapsack_item_t *items, size_t count, int capacity,
-                                           const knapsack_allocator_t *allocator,
-                                           knapsack_result_t *out_result) {
-  if (!out_result) {
+static knapsack_status_t hirschberg_solve(hirschberg_t *h, size_t lo, size_t hi, size_t cap) {
+  if (cap == 0U) {
+    return KNAPSACK_OK; /* weights are positive: nothing fits */
+  }
+  if (hi - lo == 1U) {
+    const knapsack_item_t *item = &h->items[lo];
+    if ((size_t)item->weight <= cap && item->value > 0) {
+      h->picked[lo / KNAPSACK_BITSET_WORD_BITS] |= UINT64_C(1) << (lo % KNAPSACK_BITSET_WORD_BITS);
+      ++h->selected;
+    }
+    return KNAPSACK_OK;
+  }
+
+  const size_t mid = lo + (hi - lo) / 2U;
+  const size_t width = cap + 1U;
+  knapsack_status_t row_status = hirschberg_row(h, lo, mid, width, h->fwd_value, h->fwd_weight);
+  if (row_status == KNAPSACK_OK) {
+    row_status = hirschberg_row(h, mid, hi, width, h->bwd_value, h->bwd_weight);
+  }
+  if (row_status != KNAPSACK_OK) {
+    return row_status;
+  }
+
+  size_t best_split = 0U;
+  long long best_value = -1;
+  uint64_t best_weight = UINT64_MAX;
+  for (size_t c = 0U; c <= cap; ++c) {
+    const long long split_value = (long long)h->fwd_value[c] + (long long)h->bwd_value[cap - c];
+    const uint64_t split_weight = (uint64_t)h->fwd_weight[c] + (uint64_t)h->bwd_weight[cap - c];
+    if (split_value > best_value || (split_value == best_value && split_weight < best_weight)) {
+      best_value = split_value;
+      best_weight = split_weight;
+      best_split = c;
+    }
+  }
+  /* Only reachable at the top level: every sub-range optimum is at most the
+   * overall optimum. Matches the bitset engine, which fails as soon as a
+   * partial sum exceeds INT_MAX.
+   */
+  if (best_value > INT_MAX) {
+    return KNAPSACK_ERR_INT_OVERFLOW;
+  }
+
+  /* Read both capacities before the left recursion overwrites the rows. */
+  const size_t left_cap = h->fwd_weight[best_split];
+  const size_t right_cap = h->bwd_weight[cap - best_split];
+  const knapsack_status_t status = hirschberg_solve(h, lo, mid, left_cap);
+  if (status != KNAPSACK_OK) {
+    return status;
+  }
+  return hirschberg_solve(h, mid, hi, right_cap);
+}
+
+/* Copy the picked set into out_result as ascending indices. */
+static knapsack_status_t hirschberg_collect(const hirschberg_t *h, size_t count,
+                                            const knapsack_allocator_t *alloc,
+                                            knapsack_result_t *out_result) {
+  long long total_value = 0;
+  long long total_weight = 0;
+  for (size_t i = 0; i < count; ++i) {
+    if (bitset_test(h->picked, i)) {
+      total_value += h->items[i].value;
+      total_weight += h->items[i].weight;
+    }
+  }
+  out_result->optimal_value = (int)total_value;
+  out_result->total_weight = (int)total_weight;
+  if (h->selected == 0U) {
+    return KNAPSACK_OK;
+  }
+
+  size_t *indices = alloc->alloc_fn(h->selected * sizeof(size_t), alloc->user_data);
+  if (!indices) {
+    return KNAPSACK_ERR_ALLOC;
+  }
+  size_t write = 0U;
+  for (size_t i = 0; i < count; ++i) {
+    if (bitset_test(h->picked, i)) {
+      indices[write++] = i;
+    }
+  }
+  out_result->selected_indices = indices;
+  out_result->selected_count = h->selected;
+  return KNAPSACK_OK;
+}
+
+/* A cancelled anytime solve has no usable partial decisions (the recursion
+ * settles items in no useful order), so it answers first-fit over all items.
+ */
+/* NOLINTBEGIN(bugprone-easily-swappable-parameters) -- internal helper, params are documented. */
+static knapsack_status_t solve_hirschberg(struct knapsack_workspace *handle,
+                                          const knapsack_item_t *items, size_t count, int capacity,
+                                          const knapsack_limits_t *limits, const cancel_t *cancel,
+                                          bool anytime, knapsack_stats_t *stats,
+                                          knapsack_result_t *out_result) {
+  if (!out_result) {
     return KNAPSACK_ERR_NULL_RESULT;
   }
   *out_result = (knapsack_result_t){0};
 
-  const knapsack_status_t input_status = validate_inputs(items, count, capacity);
+  uint64_t mark = stats ? stats_clock() : 0U;
+  const knapsack_status_t input_status = validate_inputs(items, count, capacity, limits);
   if (input_status != KNAPSACK_OK) {
     return input_status;
   }
+  const reduction_t reduction = plan_reduction(items, count, capacity);
+  if (reduction.trivial) {
+    return solve_trivial(items, count, capacity, false, handle->alloc, NULL, out_result);
+  }
+  const size_t kept = reduction.kept;
+  const size_t width = (size_t)reduction.capacity + 1U;
+  hirschberg_layout_t layout;
+  if (!plan_hirschberg_arena(width, kept, reduction.compact ? kept : 0U, &layout)) {
+    return KNAPSACK_ERR_DIMENSION_OVERFLOW;
+  }
+  if (stats) {
+    stats->validate_ns = stats_lap(&mark);
+    stats->row_bytes = layout.picked - layout.fwd_value;
+    stats->take_bits_bytes = layout.reduced - layout.picked;
+    stats->instance_bytes = layout.total - layout.reduced;
+    stats->arena_bytes = layout.total;
+  }
+  if (!reserve_buffers(handle, layout.total)) {
+    return KNAPSACK_ERR_ALLOC;
+  }
+  unsigned char *arena = handle->arena;
+  const size_t *origin = NULL;
+  if (reduction.compact) {
+    knapsack_item_t *reduced = (knapsack_item_t *)(void *)(arena + layout.reduced);
+    size_t *reduced_origin = (size_t *)(void *)(arena + layout.origin);
+    apply_reduction(&reduction, items, count, reduced, reduced_origin);
+    items = reduced;
+    origin = reduced_origin;
+  }
+  hirschberg_t h = {
+      .items = items,
+      .fwd_value = (int *)(void *)(arena + layout.fwd_value),
+      .fwd_weight = (uint32_t *)(void *)(arena + layout.fwd_weight),
+      .bwd_value = (int *)(void *)(arena + layout.bwd_value),
+      .bwd_weight = (uint32_t *)(void *)(arena + layout.bwd_weight),
+      .picked = (uint64_t *)(void *)(arena + layout.picked),
+      .selected = 0U,
+      .progress = {.cancel = cancel, .credit = 0U, .done = 0U, .cells = 0U},
+  };
+  if (!handle->arena_zeroed) {
+    memset(h.picked, 0, bitset_words(kept) * sizeof(uint64_t));
+  }
+  handle->arena_zeroed = false;
+
+  if (stats) {
+    mark = stats_clock(); /* leave the allocation out of the phases */
+  }
+  knapsack_status_t status = hirschberg_solve(&h, 0U, kept, (size_t)reduction.capacity);
+  if (stats) {
+    stats->dp_ns = stats_lap(&mark);
+    stats->engine = KNAPSACK_ENGINE_DENSE;
+    stats->kernel = knapsack_active_kernel();
+    stats->workers = 1U;
+    stats->cells = h.progress.cells;
+  }
+  if (status == KNAPSACK_OK) {
+    status = hirschberg_collect(&h, kept, handle->alloc, out_result);
+    if (stats) {
+      stats->reconstruct_ns = stats_lap(&mark);
+    }
+  } else if (status == KNAPSACK_ERR_CANCELLED && anytime) {
+    const suffix_bound_t rest = suffix_rate(items, 0U, kept);
+    status = complete_anytime(items, kept, 0U, reduction.capacity,
+                              suffix_gain(&rest, reduction.capacity), true, handle->alloc, NULL,
+                              out_result);
+  }
+  if (status == KNAPSACK_OK) {
+    restore_result(&reduction, origin, out_result);
+  }
+  return status;
+}
+/* NOLINTEND(bugprone-easily-swappable-parameters) */
+
+/* ------------------------------------------------------------------------- */
+/* Sparse engine                                                              */
+/* ------------------------------------------------------------------------- */
+
+/* The frontier DP itself lives in sparse_dp.c; this is its arena plumbing.
+ * A frontier is carved at some base offset: offset 0 of an arena of its own
+ * when the selector knows it fits, or over the rows and bitset of a dense
+ * arena when it is only tried first (those are zeroed again if the dense DP
+ * has to take over).
+ */
+
+/* A frontier must save at least this factor of arena bytes over the dense
+ * DP to be chosen outright; speculative runs get the same fraction of the
+ * dense arena as their budget.
+ */
+#define KNAPSACK_SPARSE_MIN_GAIN 8U
+
+typedef struct {
+  size_t weight;
+  size_t value;
+  size_t parent; /* only with history */
+  size_t layer_start;
+  size_t slots;
+  bool history; /* keep every layer for reconstruction */
+} frontier_layout_t;
+
+static size_t frontier_state_bytes(bool history) {
+  return sizeof(uint32_t) + sizeof(int) + (history ? sizeof(uint32_t) : 0U);
+}
+
+static bool plan_frontier(size_t *cursor, size_t slots, size_t count, bool history,
+                          frontier_layout_t *layout) {
+  layout->slots = slots;
+  layout->history = history;
+  const size_t parent_slots = history ? slots : 0U;
+  const size_t layer_count = history ? count + 1U : 0U;
+  return arena_push(cursor, slots, sizeof(uint32_t), &layout->weight) &&
+         arena_push(cursor, slots, sizeof(int), &layout->value) &&
+         arena_push(cursor, parent_slots, sizeof(uint32_t), &layout->parent) &&
+         arena_push(cursor, layer_count, sizeof(size_t), &layout->layer_start);
+}
+
+static sparse_frontier_t carve_frontier(unsigned char *base, const frontier_layout_t *layout) {
+  return (sparse_frontier_t){
+      .weight = (uint32_t *)(void *)(base + layout->weight),
+      .value = (int *)(void *)(base + layout->value),
+      .parent = layout->history ? (uint32_t *)(void *)(base + layout->parent) : NULL,
+      .layer_start = layout->history ? (size_t *)(void *)(base + layout->layer_start) : NULL,
+      .slots = layout->slots,
+      .first = 0U,
+      .best = 0U,
+      .layers = 0U,
+      .states = 0U,
+  };
+}
+
+/* Copy a finished frontier's optimum (and, with history, its selection)
+ * into out_result.
+ */
+static knapsack_status_t frontier_result(const sparse_frontier_t *f, size_t count,
+                                         const knapsack_allocator_t *alloc, size_t *index_storage,
+                                         knapsack_result_t *out_result) {
+  out_result->optimal_value = f->value[f->best];
+  out_result->total_weight = (int)f->weight[f->best];
+  if (!f->parent) {
+    return KNAPSACK_OK;
+  }
+  const size_t selected = sparse_walk(f, count, NULL);
+  if (selected == 0U) {
+    return KNAPSACK_OK;
+  }
+  size_t *indices =
+      index_storage ? index_storage : alloc->alloc_fn(selected * sizeof(size_t), alloc->user_data);
+  if (!indices) {
+    return KNAPSACK_ERR_ALLOC;
+  }
+  sparse_walk(f, count, indices);
+  out_result->selected_indices = indices;
+  out_result->selected_count = selected;
+  return KNAPSACK_OK;
+}
+
+/* row_bound over the last layer built: states [first, best]. */
+static long long layer_bound(const sparse_frontier_t *f, int capacity,
+                             const suffix_bound_t *rest) {
+  long long bound = 0;
+  for (size_t state = f->first; state <= f->best; ++state) {
+    const long long gain = suffix_gain(rest, (long long)capacity - f->weight[state]);
+    if (f->value[state] + gain > bound) {
+      bound = f->value[state] + gain;
+    }
+  }
+  return bound;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Branch-and-bound engine                                                    */
+/* ------------------------------------------------------------------------- */
+
+/* The search itself lives in branch_bound.c. Its arena holds only per-item
+ * arrays, so it is sized by the item count alone and any capacity fits.
+ */
+typedef struct {
+  size_t order;
+  size_t prefix_weight;
+  size_t prefix_value;
+  size_t path;
+  size_t best;
+  bool history; /* report the selection, not only the optimum */
+} search_layout_t;
+
+static bool plan_search(size_t *cursor, size_t count, bool history, search_layout_t *layout) {
+  layout->history = history;
+  const size_t prefix_count = count < SIZE_MAX ? count + 1U : SIZE_MAX;
+  return arena_push(cursor, count, sizeof(bb_item_t), &layout->order) &&
+         arena_push(cursor, prefix_count, sizeof(long long), &layout->prefix_weight) &&
+         arena_push(cursor, prefix_count, sizeof(long long), &layout->prefix_value) &&
+         arena_push(cursor, count, sizeof(unsigned char), &layout->path) &&
+         arena_push(cursor, count, sizeof(unsigned char), &layout->best);
+}
+
+static bb_search_t carve_search(unsigned char *base, const search_layout_t *layout) {
+  return (bb_search_t){
+      .order = (bb_item_t *)(void *)(base + layout->order),
+      .prefix_weight = (long long *)(void *)(base + layout->prefix_weight),
+      .prefix_value = (long long *)(void *)(base + layout->prefix_value),
+      .path = base + layout->path,
+      .best = base + layout->best,
+      .used = 0U,
+      .value = 0,
+      .weight = 0,
+      .nodes = 0U,
+  };
+}
+
+/* Copy a finished search's optimum (and, with history, its selection) into
+ * out_result.
+ */
+/* NOLINTBEGIN(bugprone-easily-swappable-parameters) -- internal helper, params are documented. */
+static knapsack_status_t search_result(bb_search_t *search, size_t count, bool history,
+                                       const knapsack_allocator_t *alloc, size_t *index_storage,
+                                       knapsack_result_t *out_result) {
+  out_result->optimal_value = (int)search->value;
+  out_result->total_weight = (int)search->weight;
+  const size_t selected = history ? bb_collect(search, count, NULL) : 0U;
+  if (selected == 0U) {
+    return KNAPSACK_OK;
+  }
+  size_t *indices =
+      index_storage ? index_storage : alloc->alloc_fn(selected * sizeof(size_t), alloc->user_data);
+  if (!indices) {
+    return KNAPSACK_ERR_ALLOC;
+  }
+  bb_collect(search, count, indices);
+  out_result->selected_indices = indices;
+  out_result->selected_count = selected;
+  return KNAPSACK_OK;
+}
+/* NOLINTEND(bugprone-easily-swappable-parameters) */
+
+/* ------------------------------------------------------------------------- */
+/* Public API                                                                 */
+/* ------------------------------------------------------------------------- */
+
+void knapsack_result_free(knapsack_result_t *result) { knapsack_result_free_ex(result, NULL); }
 
+void knapsack_result_free_ex(knapsack_result_t *result, const knapsack_allocator_t *allocator) {
+  if (!result) {
+    return;
+  }
   const knapsack_allocator_t *alloc = resolve_allocator(allocator);
+  alloc->free_fn(result->selected_indices, alloc->user_data);
+  result->selected_indices = NULL;
+  result->selected_count = 0;
+  result->optimal_value = 0;
+  result->total_weight = 0;
+  result->upper_bound = 0;
+}
 
+/* Derive (width, take_bit_count) for an already validated instance. */
+static knapsack_status_t compute_dimensions(size_t count, int capacity, size_t *width_out,
+                                            size_t *take_bit_count_out) {
   const size_t width = (size_t)capacity + 1U;
-  if (count != 0U && width > SIZE_MAX / count) {
+  const size_t row_bits = row_stride_bits(width);
+  if (count != 0U && row_bits > SIZE_MAX / count) {
     return KNAPSACK_ERR_DIMENSION_OVERFLOW;
   }
-  const size_t take_bit_count = width * count;
+  const size_t take_bit_count = row_bits * count;
   if (take_bit_count == 0U) {
     return KNAPSACK_ERR_DIMENSION_OVERFLOW;
   }
+  *width_out = width;
+  *take_bit_count_out = take_bit_count;
+  return KNAPSACK_OK;
+}
 
-  workspace_t ws = {
-      .width = width,
-      .take_bit_count = take_bit_count,
-      .prev_value = NULL,
-      .curr_value = NULL,
-      .prev_weight = NULL,
-      .curr_weight = NULL,
-      .take_bits = NULL,
-  };
+/* Bits of the trimmed decision rows of the reduced instance; at most the
+ * untrimmed count compute_dimensions checked.
+ */
+static size_t trimmed_take_bits(const knapsack_item_t *items, size_t count, const reduction_t *r,
+                                size_t width) {
+  size_t words = 0U;
+  for (size_t i = 0; i < count; ++i) {
+    if (items[i].weight <= r->limit) {
+      words += take_row_words(width, (size_t)(items[i].weight / r->scale));
+    }
+  }
+  return words * KNAPSACK_BITSET_WORD_BITS;
+}
 
-  if (!allocate_workspace(&ws, alloc)) {
-    return KNAPSACK_ERR_ALLOC;
+/* Arena for the unreduced instance plus room for a compacted copy: an upper
+ * bound on the plan of any solve over count items and capacity, whatever
+ * preprocessing keeps.
+ */
+static knapsack_status_t plan_worst_case(size_t count, int capacity, size_t index_count,
+                                         arena_layout_t *layout) {
+  size_t width = 0U;
+  size_t take_bit_count = 0U;
+  const knapsack_status_t dim_status =
+      compute_dimensions(count, capacity, &width, &take_bit_count);
+  if (dim_status != KNAPSACK_OK) {
+    return dim_status;
+  }
+  return plan_arena(width, take_bit_count, count, index_count, count, false, layout)
+             ? KNAPSACK_OK
+             : KNAPSACK_ERR_DIMENSION_OVERFLOW;
+}
+
+/* Per-call settings threaded from the public entry points down to the DP. */
+typedef struct {
+  const knapsack_limits_t *limits;
+  knapsack_thread_pool_t *pool; /* NULL: serial */
+  size_t parallel_min_width;
+  bool value_only; /* no take_bits, no reconstruction */
+  knapsack_engine_t engine;
+  cancel_t cancel;
+  bool anytime; /* answer a cancelled solve instead of failing it */
+  knapsack_stats_t *stats; /* NULL: not collected; read through config_stats */
+  size_t tile_cells;       /* KNAPSACK_ENGINE_TILED block; 0: knapsack_tile_cells() */
+} solve_config_t;
+
+static const solve_config_t k_default_config = {
+    &k_default_limits,
+    NULL,
+    KNAPSACK_PARALLEL_MIN_WIDTH,
+    false,
+    KNAPSACK_ENGINE_AUTO,
+    {NULL, NULL},
+    false,
+    NULL,
+    0U,
+};
+
+static knapsack_stats_t *config_stats(const solve_config_t *config) {
+  return KNAPSACK_STATS_ENABLED ? config->stats : NULL;
+}
+
+typedef enum {
+  PLAN_DENSE,
+  PLAN_SPARSE,      /* frontier at arena offset 0; the dense fields are unused */
+  PLAN_SPARSE_FIRST, /* frontier over the dense rows, dense DP if it fills up */
+  PLAN_BRANCH_BOUND, /* search arrays at arena offset 0 */
+  PLAN_TILED         /* dense rows over a weight-sorted copy, halos at the end */
+} plan_engine_t;
+
+/* Segments the tiled engine appends to a dense arena: two blocks of halo
+ * cells, and the scratch entries of tiled_sort.
+ */
+typedef struct {
+  size_t halo_value;
+  size_t halo_weight;
+  size_t order;
+  size_t block; /* capacity cells per block */
+} tiled_layout_t;
+
+/* Output of prepare_solve: everything needed to carve and run a solve. */
+typedef struct {
+  reduction_t reduction;
+  plan_engine_t engine;
+  size_t width;
+  size_t take_bit_count;
+  size_t workers; /* 1 for the serial in-place DP */
+  arena_layout_t layout;
+  frontier_layout_t frontier;
+  size_t frontier_base; /* arena offset the frontier layout is relative to */
+  search_layout_t search;
+  tiled_layout_t tiled;
+} solve_plan_t;
+
+/* Append the trailing segments every arena carries (result slots and the
+ * compacted instance) and record the total.
+ */
+static bool plan_trailing(size_t cursor, size_t index_count, size_t reduced_count,
+                          arena_layout_t *layout) {
+  if (!arena_push(&cursor, index_count, sizeof(size_t), &layout->indices) ||
+      !arena_push(&cursor, reduced_count, sizeof(knapsack_item_t), &layout->reduced) ||
+      !arena_push(&cursor, reduced_count, sizeof(size_t), &layout->origin)) {
+    return false;
+  }
+  layout->total = cursor;
+  return true;
+}
+
+/* Lay out an arena holding only a frontier plus the trailing segments. */
+/* NOLINTBEGIN(bugprone-easily-swappable-parameters) -- internal helper, params are documented. */
+static bool plan_sparse_arena(size_t slots, size_t count, bool history, size_t index_count,
+                              size_t reduced_count, solve_plan_t *plan) {
+  size_t cursor = 0U;
+  plan->layout = (arena_layout_t){0};
+  plan->frontier_base = 0U;
+  return plan_frontier(&cursor, slots, count, history, &plan->frontier) &&
+         plan_trailing(cursor, index_count, reduced_count, &plan->layout);
+}
+/* NOLINTEND(bugprone-easily-swappable-parameters) */
+
+/* Lay out an arena holding only the search arrays plus the trailing segments. */
+/* NOLINTBEGIN(bugprone-easily-swappable-parameters) -- internal helper, params are documented. */
+static bool plan_search_arena(size_t count, bool history, size_t index_count,
+                              size_t reduced_count, solve_plan_t *plan) {
+  size_t cursor = 0U;
+  plan->layout = (arena_layout_t){0};
+  return plan_search(&cursor, count, history, &plan->search) &&
+         plan_trailing(cursor, index_count, reduced_count, &plan->layout);
+}
+/* NOLINTEND(bugprone-easily-swappable-parameters) */
+
+/* Append the tiled engine's segments to a planned dense arena. */
+static bool plan_tiled_arena(size_t tile_cells, size_t count, solve_plan_t *plan) {
+  tiled_layout_t *tiled = &plan->tiled;
+  tiled->block = tile_cells != 0U ? tile_cells : knapsack_tile_cells();
+  if (tiled->block > plan->width) {
+    tiled->block = plan->width;
+  }
+  size_t cursor = plan->layout.total;
+  if (!arena_push(&cursor, 2U * tiled->block, sizeof(int), &tiled->halo_value) ||
+      !arena_push(&cursor, 2U * tiled->block, sizeof(uint32_t), &tiled->halo_weight) ||
+      !arena_push(&cursor, count, sizeof(tiled_item_t), &tiled->order)) {
+    return false;
+  }
+  plan->layout.total = cursor;
+  return true;
+}
+
+/* Slots a frontier needs in the worst case: every layer with history, two
+ * of the widest otherwise.
+ */
+static size_t frontier_bound(const knapsack_item_t *items, size_t count, const reduction_t *r,
+                             bool history) {
+  size_t bound_total = 0U;
+  size_t bound_widest = 0U;
+  sparse_bound(items, count, r->limit, r->scale, &bound_total, &bound_widest);
+  if (history) {
+    return bound_total;
+  }
+  return bound_widest > SIZE_MAX / 2U ? SIZE_MAX : 2U * bound_widest;
+}
+
+/* Engine choice for a reduced, non-trivial instance whose dense layout is
+ * already planned. The frontier bound depends on count, capacity and the
+ * prefix weight sums; if even that worst case is KNAPSACK_SPARSE_MIN_GAIN
+ * times smaller than the dense arena, the sparse engine runs on its own.
+ * Otherwise it may still be tried first in a budget carved from the dense
+ * rows, as long as the budget can hold a meaningful frontier.
+ */
+static void select_engine(const knapsack_item_t *items, size_t count, size_t index_count,
+                          bool history, solve_plan_t *plan) {
+  const reduction_t *r = &plan->reduction;
+  const solve_plan_t dense = *plan;
+  const size_t bound = frontier_bound(items, count, r, history);
+  if (plan_sparse_arena(bound, r->kept, history, index_count, r->compact ? r->kept : 0U, plan) &&
+      plan->layout.total <= dense.layout.total / KNAPSACK_SPARSE_MIN_GAIN) {
+    plan->engine = PLAN_SPARSE;
+    plan->workers = 1U;
+    return;
+  }
+  *plan = dense;
+
+  const size_t region = dense.layout.indices - dense.layout.value;
+  const size_t budget = region / KNAPSACK_SPARSE_MIN_GAIN;
+  const size_t fixed = (history ? (r->kept + 1U) * sizeof(size_t) : 0U) + 4U * KNAPSACK_ARENA_ALIGN;
+  if (budget <= fixed) {
+    return;
+  }
+  const size_t slots = (budget - fixed) / frontier_state_bytes(history);
+  size_t cursor = 0U;
+  if (slots < (r->kept + 1U) * 2U ||
+      !plan_frontier(&cursor, slots, r->kept, history, &plan->frontier) || cursor > region) {
+    return;
+  }
+  plan->engine = PLAN_SPARSE_FIRST;
+  plan->frontier_base = dense.layout.value;
+}
+
+/* Common prologue shared by every solve entry point: zero the result,
+ * validate, reduce the instance, pick serial or parallel, and derive the
+ * arena layout. index_count is the number of result slots to reserve inside
+ * the arena (0 when indices come from an allocator). A trivial reduction
+ * plans no rows, only those result slots.
+ */
+static knapsack_status_t prepare_solve(const knapsack_item_t *items, size_t count, int capacity,
+                                       const solve_config_t *config, size_t index_count,
+                                       knapsack_result_t *out_result, solve_plan_t *plan) {
+  if (!out_result) {
+    return KNAPSACK_ERR_NULL_RESULT;
+  }
+  *out_result = (knapsack_result_t){0};
+
+  const knapsack_status_t input_status = validate_inputs(items, count, capacity, config->limits);
+  if (input_status != KNAPSACK_OK) {
+    return input_status;
+  }
+  plan->reduction = plan_reduction(items, count, capacity);
+  const reduction_t *r = &plan->reduction;
+  plan->engine = PLAN_DENSE;
+  plan->workers = 1U;
+  if (r->trivial) {
+    plan->width = 0U;
+    plan->take_bit_count = 0U;
+    return plan_arena(0U, 0U, 0U, index_count, 0U, false, &plan->layout)
+               ? KNAPSACK_OK
+               : KNAPSACK_ERR_DIMENSION_OVERFLOW;
+  }
+  const bool history = !config->value_only;
+  if (config->engine == KNAPSACK_ENGINE_BRANCH_BOUND) {
+    plan->engine = PLAN_BRANCH_BOUND;
+    plan->width = 0U;
+    plan->take_bit_count = 0U;
+    return plan_search_arena(r->kept, history, index_count, r->compact ? r->kept : 0U, plan)
+               ? KNAPSACK_OK
+               : KNAPSACK_ERR_DIMENSION_OVERFLOW;
+  }
+  if (config->engine == KNAPSACK_ENGINE_SPARSE) {
+    plan->engine = PLAN_SPARSE;
+    plan->width = 0U;
+    plan->take_bit_count = 0U;
+    return plan_sparse_arena(frontier_bound(items, count, r, history), r->kept, history,
+                             index_count, r->compact ? r->kept : 0U, plan)
+               ? KNAPSACK_OK
+               : KNAPSACK_ERR_DIMENSION_OVERFLOW;
+  }
+  if (config->value_only) {
+    plan->width = (size_t)r->capacity + 1U;
+    plan->take_bit_count = 0U;
+  } else {
+    const knapsack_status_t dim_status =
+        compute_dimensions(r->kept, r->capacity, &plan->width, &plan->take_bit_count);
+    if (dim_status != KNAPSACK_OK) {
+      return dim_status;
+    }
+    plan->take_bit_count = trimmed_take_bits(items, count, r, plan->width);
+  }
+  if (config->engine == KNAPSACK_ENGINE_TILED) {
+    /* The sort needs the compacted copy even when nothing was reduced. */
+    plan->engine = PLAN_TILED;
+    plan->reduction.compact = true;
+    if (!plan_arena(plan->width, plan->take_bit_count, r->kept, index_count, r->kept, false,
+                    &plan->layout) ||
+        !plan_tiled_arena(config->tile_cells, r->kept, plan)) {
+      return KNAPSACK_ERR_DIMENSION_OVERFLOW;
+    }
+    return KNAPSACK_OK;
+  }
+  if (config->pool && plan->width >= config->parallel_min_width) {
+    const workspace_t dims = {.width = plan->width, .row_bits = row_stride_bits(plan->width)};
+    const size_t workers = parallel_workers(&dims, config->pool);
+    plan->workers = workers > 1U ? workers : 1U;
   }
+  if (!plan_arena(plan->width, plan->take_bit_count, r->kept, index_count,
+                  r->compact ? r->kept : 0U, plan->workers > 1U, &plan->layout)) {
+    return KNAPSACK_ERR_DIMENSION_OVERFLOW;
+  }
+  if (config->engine == KNAPSACK_ENGINE_AUTO) {
+    select_engine(items, count, index_count, history, plan);
+  }
+  return KNAPSACK_OK;
+}
 
+/* Run the DP over a carved view and reconstruct into out_result. A view
+ * without take_bits is value-only: the best cell is reported as is. A
+ * cancelled anytime solve reconstructs the prefix of items the rows cover.
+ * With tiled non-NULL the rows are filled by the tiled engine.
+ */
+/* NOLINTBEGIN(bugprone-easily-swappable-parameters) -- internal helper, params are documented. */
+static knapsack_status_t solve_with_view(workspace_t *ws, const knapsack_item_t *items,
+                                         size_t count, const knapsack_allocator_t *alloc,
+                                         size_t *index_storage, const solve_config_t *config,
+                                         size_t workers, tiled_dp_t *tiled,
+                                         knapsack_result_t *out_result) {
+  knapsack_stats_t *stats = config_stats(config);
+  uint64_t mark = stats ? stats_clock() : 0U;
+  dp_progress_t progress = {.cancel = &config->cancel, .credit = 0U, .done = 0U, .cells = 0U};
+  knapsack_status_t dp_status = KNAPSACK_OK;
+  if (tiled) {
+    dp_status = run_dp_tiled(items, count, ws, tiled, &progress);
+  } else if (workers > 1U) {
+    dp_status = run_dp_parallel(items, count, ws, config->pool, workers, &progress);
+  } else {
+    dp_status = run_dp(items, count, ws, &progress);
+  }
+  if (stats) {
+    stats->dp_ns += stats_lap(&mark);
+    stats->engine = tiled ? KNAPSACK_ENGINE_TILED : KNAPSACK_ENGINE_DENSE;
+    stats->kernel = knapsack_active_kernel();
+    stats->workers = workers;
+    stats->cells = progress.cells;
+    stats->cells_taken = ws->take_bits ? count_taken(ws, progress.done) : 0U;
+    mark = stats_clock();
+  }
+  if (dp_status == KNAPSACK_ERR_INT_OVERFLOW ||
+      (dp_status == KNAPSACK_ERR_CANCELLED && !config->anytime)) {
+    return dp_status;
+  }
+  const size_t best_cap = select_best_cap(ws);
+  if (stats) {
+    stats->select_ns = stats_lap(&mark);
+  }
   knapsack_status_t status = KNAPSACK_OK;
-  if (!run_dp(items, count, &ws)) {
-    status = KNAPSACK_ERR_INT_OVERFLOW;
+  if (!ws->take_bits) {
+    out_result->optimal_value = ws->value[best_cap];
+    out_result->total_weight = (int)ws->weight[best_cap];
+  } else {
+    status = reconstruct_solution(ws, items, progress.done, best_cap, alloc, index_storage,
+                                  out_result);
   }
+  if (stats) {
+    stats->reconstruct_ns = stats_lap(&mark);
+  }
+  if (status != KNAPSACK_OK || dp_status == KNAPSACK_OK) {
+    return status;
+  }
+  const suffix_bound_t rest = suffix_rate(items, progress.done, count);
+  return complete_anytime(items, count, progress.done, (int)(ws->width - 1U), row_bound(ws, &rest),
+                          ws->take_bits != NULL, alloc, index_storage, out_result);
+}
 
+/* Run a planned, non-trivial solve inside arena: compact the instance if the
+ * plan asks for it, solve the reduced instance, and map the result back.
+ */
+static knapsack_status_t solve_planned(const solve_plan_t *plan, unsigned char *arena,
+                                       bool already_zeroed, const knapsack_item_t *items,
+                                       size_t count, const knapsack_allocator_t *alloc,
+                                       size_t *index_storage, const solve_config_t *config,
+                                       knapsack_result_t *out_result) {
+  const reduction_t *r = &plan->reduction;
+  const size_t *origin = NULL;
+  if (r->compact) {
+    knapsack_item_t *reduced = (knapsack_item_t *)(void *)(arena + plan->layout.reduced);
+    size_t *reduced_origin = (size_t *)(void *)(arena + plan->layout.origin);
+    apply_reduction(r, items, count, reduced, reduced_origin);
+    if (plan->engine == PLAN_TILED) {
+      tiled_sort(reduced, reduced_origin, r->kept,
+                 (tiled_item_t *)(void *)(arena + plan->tiled.order));
+    }
+    items = reduced;
+    count = r->kept;
+    origin = reduced_origin;
+  }
+  knapsack_stats_t *stats = config_stats(config);
+  uint64_t mark = stats ? stats_clock() : 0U;
+  knapsack_status_t status = KNAPSACK_ERR_DIMENSION_OVERFLOW;
+  bool dense = plan->engine == PLAN_DENSE || plan->engine == PLAN_TILED;
+  if (plan->engine == PLAN_BRANCH_BOUND) {
+    bb_search_t search = carve_search(arena, &plan->search);
+    const bb_status_t bb_status = bb_run(items, count, r->capacity, &config->cancel, &search);
+    if (stats) {
+      stats->dp_ns = stats_lap(&mark);
+      stats->engine = KNAPSACK_ENGINE_BRANCH_BOUND;
+      stats->workers = 1U;
+      stats->cells = search.nodes;
+    }
+    status = bb_status == BB_OVERFLOW ? KNAPSACK_ERR_INT_OVERFLOW : KNAPSACK_OK;
+    if (bb_status == BB_CANCELLED && !config->anytime) {
+      status = KNAPSACK_ERR_CANCELLED;
+    }
+    if (status == KNAPSACK_OK) {
+      status = search_result(&search, count, plan->search.history, alloc, index_storage,
+                             out_result);
+      if (stats) {
+        stats->reconstruct_ns = stats_lap(&mark);
+      }
+    }
+    if (status == KNAPSACK_OK && bb_status == BB_CANCELLED) {
+      status = complete_anytime(items, count, count, r->capacity, search.root_bound,
+                                plan->search.history, alloc, index_storage, out_result);
+    }
+  } else if (!dense) {
+    sparse_frontier_t frontier = carve_frontier(arena + plan->frontier_base, &plan->frontier);
+    const sparse_status_t sparse_status =
+        sparse_run(items, count, r->capacity, &config->cancel, &frontier);
+    if (stats) {
+      /* A run that hands over to the dense DP leaves only its time. */
+      stats->dp_ns = stats_lap(&mark);
+      stats->engine = KNAPSACK_ENGINE_SPARSE;
+      stats->workers = 1U;
+      stats->cells = frontier.states;
+    }
+    switch (sparse_status) {
+    case SPARSE_DONE:
+      status = frontier_result(&frontier, count, alloc, index_storage, out_result);
+      if (stats) {
+        stats->reconstruct_ns = stats_lap(&mark);
+      }
+      break;
+    case SPARSE_OVERFLOW:
+      status = KNAPSACK_ERR_INT_OVERFLOW;
+      break;
+    case SPARSE_CANCELLED:
+      status = KNAPSACK_ERR_CANCELLED;
+      if (!config->anytime) {
+        break;
+      }
+      status = frontier_result(&frontier, frontier.layers, alloc, index_storage, out_result);
+      if (status == KNAPSACK_OK) {
+        const suffix_bound_t rest = suffix_rate(items, frontier.layers, count);
+        status = complete_anytime(items, count, frontier.layers, r->capacity,
+                                  layer_bound(&frontier, r->capacity, &rest),
+                                  frontier.parent != NULL, alloc, index_storage, out_result);
+      }
+      break;
+    case SPARSE_FULL:
+      /* Cannot happen within the worst-case bound; a budgeted run hands
+       * over to the dense DP over the rows it scribbled on.
+       */
+      dense = plan->engine == PLAN_SPARSE_FIRST;
+      already_zeroed = false;
+      break;
+    }
+  }
+  if (dense) {
+    workspace_t ws =
+        carve_workspace(arena, &plan->layout, plan->width, plan->take_bit_count, already_zeroed);
+    if (ws.row_word) {
+      index_take_rows(items, count, ws.width, ws.row_word);
+    }
+    tiled_dp_t tiled = {
+        .halo_value = (int *)(void *)(arena + plan->tiled.halo_value),
+        .halo_weight = (uint32_t *)(void *)(arena + plan->tiled.halo_weight),
+        .block = plan->tiled.block,
+    };
+    status = solve_with_view(&ws, items, count, alloc, index_storage, config, plan->workers,
+                             plan->engine == PLAN_TILED ? &tiled : NULL, out_result);
+  }
   if (status == KNAPSACK_OK) {
-    const size_t best_cap = select_best_cap(&ws);
-    status = reconstruct_solution(&ws, items, count, best_cap, alloc, out_result);
+    restore_result(r, origin, out_result);
+    if (plan->engine == PLAN_TILED) {
+      /* origin follows the weight order, not the caller's. */
+      qsort(out_result->selected_indices, out_result->selected_count, sizeof(size_t),
+            compare_size_t);
+    }
   }
-
-  free_workspace(&ws, alloc);
   return status;
 }
+/* NOLINTEND(bugprone-easily-swappable-parameters) */
+
+/* The arena segments of a planned solve, for knapsack_stats_t. */
+static void stats_layout(knapsack_stats_t *stats, const solve_plan_t *plan) {
+  const arena_layout_t *layout = &plan->layout;
+  size_t instance_end = layout->total;
+  if (plan->engine == PLAN_SPARSE || plan->engine == PLAN_BRANCH_BOUND) {
+    stats->engine_bytes = layout->indices; /* the engine's arrays start the arena */
+  } else {
+    stats->row_bytes = layout->take_bits - layout->value;
+    stats->take_bits_bytes = layout->indices - layout->take_bits;
+  }
+  if (plan->engine == PLAN_TILED) {
+    instance_end = plan->tiled.halo_value; /* its segments end the arena */
+    stats->engine_bytes = layout->total - instance_end;
+  }
+  stats->instance_bytes = instance_end - layout->reduced;
+  stats->arena_bytes = layout->total;
+}
+
+static knapsack_status_t solve_in_workspace(struct knapsack_workspace *handle,
+                                            const knapsack_item_t *items, size_t count,
+                                            int capacity, const solve_config_t *config,
+                                            knapsack_result_t *out_result) {
+  knapsack_stats_t *stats = config_stats(config);
+  uint64_t mark = stats ? stats_clock() : 0U;
+  solve_plan_t plan;
+  const knapsack_status_t status =
+      prepare_solve(items, count, capacity, config, 0U, out_result, &plan);
+  if (stats) {
+    stats->validate_ns = stats_lap(&mark);
+  }
+  if (status != KNAPSACK_OK) {
+    return status;
+  }
+  if (stats && !plan.reduction.trivial) {
+    stats_layout(stats, &plan);
+  }
+  if (plan.reduction.trivial) {
+    return solve_trivial(items, count, capacity, config->value_only, handle->alloc, NULL,
+                         out_result);
+  }
+  if (!reserve_buffers(handle, plan.layout.total)) {
+    return KNAPSACK_ERR_ALLOC;
+  }
+  const bool already_zeroed = handle->arena_zeroed;
+  handle->arena_zeroed = false;
+  return solve_planned(&plan, handle->arena, already_zeroed, items, count, handle->alloc, NULL,
+                       config, out_result);
+}
+
+knapsack_status_t knapsack_solve_status(const knapsack_item_t *items, size_t count, int capacity,
+                                        knapsack_result_t *out_result) {
+  return knapsack_solve_status_ex(items, count, capacity, NULL, out_result);
+}
+
+knapsack_status_t knapsack_solve_status_ex(const knapsack_item_t *items, size_t count, int capacity,
+                                           const knapsack_allocator_t *allocator,
+                                           knapsack_result_t *out_result) {
+  /* One-shot solve: a transient workspace that is released before returning. */
+  struct knapsack_workspace ws = {
+      .alloc = resolve_allocator(allocator),
+      .block = NULL,
+      .arena = NULL,
+      .arena_size = 0U,
+      .arena_zeroed = false,
+  };
+  const knapsack_status_t status =
+      solve_in_workspace(&ws, items, count, capacity, &k_default_config, out_result);
+  release_buffers(&ws);
+  return status;
+}
+
+const char *knapsack_engine_name(knapsack_engine_t engine) {
+  switch (engine) {
+  case KNAPSACK_ENGINE_AUTO:
+    return "auto";
+  case KNAPSACK_ENGINE_DENSE:
+    return "dense";
+  case KNAPSACK_ENGINE_SPARSE:
+    return "sparse";
+  case KNAPSACK_ENGINE_BRANCH_BOUND:
+    return "branch_bound";
+  case KNAPSACK_ENGINE_TILED:
+    return "tiled";
+  }
+  return "unknown";
+}
+
+void knapsack_options_init(knapsack_options_t *options) {
+  if (!options) {
+    return;
+  }
+  *options = (knapsack_options_t){
+      .allocator = NULL,
+      .reconstruct = KNAPSACK_RECONSTRUCT_BITSET,
+      .limits = k_default_limits,
+      .pool = NULL,
+      .parallel_min_width = KNAPSACK_PARALLEL_MIN_WIDTH,
+      .engine = KNAPSACK_ENGINE_AUTO,
+      .cancel = NULL,
+      .cancel_user_data = NULL,
+      .anytime = false,
+      .stats = NULL,
+      .device = KNAPSACK_DEVICE_CPU,
+      .tile_cells = 0U,
+  };
+}
+
+bool options_valid(const knapsack_options_t *options) {
+  const knapsack_limits_t *limits = &options->limits;
+  if (limits->max_items == 0U || limits->max_capacity < 0) {
+    return false;
+  }
+  if (options->device != KNAPSACK_DEVICE_CPU && options->device != KNAPSACK_DEVICE_GPU) {
+    return false;
+  }
+  switch (options->engine) {
+  case KNAPSACK_ENGINE_AUTO:
+  case KNAPSACK_ENGINE_DENSE:
+    break;
+  case KNAPSACK_ENGINE_TILED:
+    /* The dense rows and their limits, filled in blocks; not Hirschberg's. */
+    if (options->reconstruct == KNAPSACK_RECONSTRUCT_HIRSCHBERG) {
+      return false;
+    }
+    break;
+  case KNAPSACK_ENGINE_SPARSE:
+  case KNAPSACK_ENGINE_BRANCH_BOUND:
+    /* Neither engine's memory depends on the capacity; Hirschberg is an
+     * engine of its own.
+     */
+    return options->reconstruct == KNAPSACK_RECONSTRUCT_BITSET ||
+           options->reconstruct == KNAPSACK_RECONSTRUCT_NONE;
+  default:
+    return false;
+  }
+  switch (options->reconstruct) {
+  case KNAPSACK_RECONSTRUCT_BITSET:
+    /* The decision bitset is count * width bits: keep it within the
+     * compile-time bounds the header documents.
+     */
+    return limits->max_items <= KNAPSACK_MAX_ITEMS && limits->max_capacity <= KNAPSACK_MAX_CAPACITY;
+  case KNAPSACK_RECONSTRUCT_HIRSCHBERG:
+  case KNAPSACK_RECONSTRUCT_NONE:
+    return true;
+  default:
+    return false;
+  }
+}
+
+/* The engine configuration an options struct asks for; pool is passed
+ * separately because batches spread instances, not rows, over it.
+ */
+static solve_config_t options_config(const knapsack_options_t *options,
+                                     knapsack_thread_pool_t *pool) {
+  return (solve_config_t){
+      .limits = &options->limits,
+      .pool = pool,
+      .parallel_min_width = options->parallel_min_width,
+      .value_only = options->reconstruct == KNAPSACK_RECONSTRUCT_NONE,
+      .engine = options->engine,
+      .cancel = {options->cancel, options->cancel_user_data},
+      .anytime = options->anytime,
+      .stats = options->stats,
+      .tile_cells = options->tile_cells,
+  };
+}
+
+/* Solve one instance of an options-driven call inside handle. */
+static knapsack_status_t solve_with_options(struct knapsack_workspace *handle,
+                                            const knapsack_item_t *items, size_t count,
+                                            int capacity, const knapsack_options_t *options,
+                                            const solve_config_t *config,
+                                            knapsack_result_t *out_result) {
+  if (config->stats) {
+    *config->stats = (knapsack_stats_t){0};
+  }
+  if (options->reconstruct == KNAPSACK_RECONSTRUCT_HIRSCHBERG) {
+    return solve_hirschberg(handle, items, count, capacity, config->limits, &config->cancel,
+                            config->anytime, config_stats(config), out_result);
+  }
+  return solve_in_workspace(handle, items, count, capacity, config, out_result);
+}
+
+knapsack_status_t knapsack_solve_opts(const knapsack_item_t *items, size_t count, int capacity,
+                                      const knapsack_options_t *options,
+                                      knapsack_result_t *out_result) {
+  knapsack_options_t defaults;
+  if (!options) {
+    knapsack_options_init(&defaults);
+    options = &defaults;
+  }
+  if (!out_result) {
+    return KNAPSACK_ERR_NULL_RESULT;
+  }
+  if (!options_valid(options)) {
+    *out_result = (knapsack_result_t){0};
+    return KNAPSACK_ERR_INVALID_ARGUMENT;
+  }
+
+  const solve_config_t config = options_config(options, options->pool);
+  struct knapsack_workspace ws = {
+      .alloc = resolve_allocator(options->allocator),
+      .block = NULL,
+      .arena = NULL,
+      .arena_size = 0U,
+      .arena_zeroed = false,
+  };
+  const knapsack_status_t status =
+      solve_with_options(&ws, items, count, capacity, options, &config, out_result);
+  release_buffers(&ws);
+  return status;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Batch                                                                      */
+/* ------------------------------------------------------------------------- */
+
+/* Instances are handed out one at a time from a shared atomic cursor, so a
+ * worker that draws cheap instances simply comes back for more. Each worker
+ * owns one transient workspace that grows to the largest instance it sees,
+ * which makes the steady state allocation-free apart from result arrays.
+ */
+typedef struct {
+  const knapsack_instance_t *instances;
+  size_t instance_count;
+  const knapsack_options_t *options;
+  const solve_config_t *config;
+  knapsack_result_t *results;
+  knapsack_status_t *statuses;
+  bool *solved; /* instances the GPU finished, or NULL */
+  atomic_size_t next;
+} batch_job_t;
+
+void worker_arena_init(worker_arena_t *arena, const knapsack_allocator_t *alloc) {
+  *arena = (worker_arena_t){
+      .alloc = resolve_allocator(alloc),
+      .block = NULL,
+      .arena = NULL,
+      .arena_size = 0U,
+      .arena_zeroed = false,
+  };
+}
+
+/* NOLINTBEGIN(bugprone-easily-swappable-parameters) -- internal interface. */
+knapsack_status_t worker_arena_solve(worker_arena_t *arena, const knapsack_item_t *items,
+                                     size_t count, int capacity, const knapsack_options_t *options,
+                                     knapsack_thread_pool_t *pool, knapsack_stats_t *stats,
+                                     knapsack_result_t *out_result) {
+  solve_config_t config = options_config(options, pool);
+  config.stats = stats;
+  return solve_with_options(arena, items, count, capacity, options, &config, out_result);
+}
+/* NOLINTEND(bugprone-easily-swappable-parameters) */
+
+void worker_arena_release(worker_arena_t *arena) { release_buffers(arena); }
+
+static void batch_task(void *ctx, size_t worker, size_t workers) {
+  (void)worker;
+  (void)workers;
+  batch_job_t *job = ctx;
+  worker_arena_t ws;
+  worker_arena_init(&ws, job->options->allocator);
+  for (;;) {
+    const size_t i = atomic_fetch_add_explicit(&job->next, 1U, memory_order_relaxed);
+    if (i >= job->instance_count) {
+      break;
+    }
+    if (job->solved && job->solved[i]) {
+      continue;
+    }
+    const knapsack_instance_t *instance = &job->instances[i];
+    job->statuses[i] = solve_with_options(&ws, instance->items, instance->count,
+                                          instance->capacity, job->options, job->config,
+                                          &job->results[i]);
+  }
+  worker_arena_release(&ws);
+}
+
+#ifndef KNAPSACK_GPU
+/* Built without the CUDA backend (ENABLE_GPU=OFF): there is no device. */
+bool gpu_device_present(void) { return false; }
+
+/* NOLINTBEGIN(bugprone-easily-swappable-parameters) -- internal interface. */
+void gpu_solve_batch(const knapsack_instance_t *instances, const size_t *picked,
+                     size_t picked_count, bool value_only, const knapsack_allocator_t *alloc,
+                     const cancel_t *cancel, knapsack_result_t *results,
+                     knapsack_status_t *statuses, bool *solved) {
+  (void)instances;
+  (void)picked;
+  (void)picked_count;
+  (void)value_only;
+  (void)alloc;
+  (void)cancel;
+  (void)results;
+  (void)statuses;
+  (void)solved;
+}
+/* NOLINTEND(bugprone-easily-swappable-parameters) */
+#endif
+
+bool knapsack_gpu_available(void) { return gpu_device_present(); }
+
+/* Run the instances the dense engine would solve on the GPU, when the
+ * options ask for it and a device is present. Returns which instances it
+ * finished (allocated with alloc), or NULL when it ran nothing -- including
+ * when that array cannot be allocated, which leaves the batch to the CPU.
+ */
+/* NOLINTBEGIN(bugprone-easily-swappable-parameters) -- internal helper, params are documented. */
+static bool *batch_offload(const knapsack_instance_t *instances, size_t instance_count,
+                           const knapsack_options_t *options, const solve_config_t *config,
+                           knapsack_result_t *out_results, knapsack_status_t *out_statuses) {
+  if (options->device != KNAPSACK_DEVICE_GPU ||
+      options->reconstruct == KNAPSACK_RECONSTRUCT_HIRSCHBERG ||
+      (options->engine != KNAPSACK_ENGINE_AUTO && options->engine != KNAPSACK_ENGINE_DENSE) ||
+      instance_count > SIZE_MAX / sizeof(size_t) || !gpu_device_present()) {
+    return NULL;
+  }
+  const knapsack_allocator_t *alloc = resolve_allocator(options->allocator);
+  bool *solved = alloc->calloc_fn(instance_count, sizeof(bool), alloc->user_data);
+  size_t *picked = alloc->alloc_fn(instance_count * sizeof(size_t), alloc->user_data);
+  if (!solved || !picked) {
+    alloc->free_fn(solved, alloc->user_data);
+    alloc->free_fn(picked, alloc->user_data);
+    return NULL;
+  }
+  /* Invalid instances stay on the CPU, which reports them. */
+  size_t picked_count = 0U;
+  for (size_t i = 0; i < instance_count; ++i) {
+    const knapsack_instance_t *instance = &instances[i];
+    if (validate_inputs(instance->items, instance->count, instance->capacity, config->limits) ==
+        KNAPSACK_OK) {
+      picked[picked_count++] = i;
+    }
+  }
+  gpu_solve_batch(instances, picked, picked_count, config->value_only, alloc, &config->cancel,
+                  out_results, out_statuses, solved);
+  alloc->free_fn(picked, alloc->user_data);
+  return solved;
+}
+/* NOLINTEND(bugprone-easily-swappable-parameters) */
+
+knapsack_status_t knapsack_solve_batch(const knapsack_instance_t *instances,
+                                       size_t instance_count, const knapsack_options_t *options,
+                                       knapsack_result_t *out_results,
+                                       knapsack_status_t *out_statuses) {
+  knapsack_options_t defaults;
+  if (!options) {
+    knapsack_options_init(&defaults);
+    options = &defaults;
+  }
+  if (instance_count == 0U) {
+    return KNAPSACK_OK;
+  }
+  if (!instances || !out_results || !out_statuses || !options_valid(options)) {
+    return KNAPSACK_ERR_INVALID_ARGUMENT;
+  }
+
+  /* The pool spreads instances, so each one is solved serially. */
+  solve_config_t config = options_config(options, NULL);
+  config.stats = NULL; /* every instance would write it */
+  batch_job_t job = {
+      .instances = instances,
+      .instance_count = instance_count,
+      .options = options,
+      .config = &config,
+      .results = out_results,
+      .statuses = out_statuses,
+      .solved =
+          batch_offload(instances, instance_count, options, &config, out_results, out_statuses),
+  };
+  atomic_init(&job.next, 0U);
+  if (options->pool) {
+    const size_t workers = knapsack_thread_pool_size(options->pool);
+    pool_run(options->pool, workers < instance_count ? workers : instance_count, batch_task,
+             &job);
+  } else {
+    batch_task(&job, 0U, 1U);
+  }
+  if (job.solved) {
+    const knapsack_allocator_t *alloc = resolve_allocator(options->allocator);
+    alloc->free_fn(job.solved, alloc->user_data);
+  }
+  return KNAPSACK_OK;
+}
+
+knapsack_workspace_t *knapsack_workspace_create(const knapsack_allocator_t *allocator) {
+  const knapsack_allocator_t *alloc = resolve_allocator(allocator);
+  knapsack_workspace_t *ws = alloc->alloc_fn(sizeof(*ws), alloc->user_data);
+  if (!ws) {
+    return NULL;
+  }
+  *ws = (knapsack_workspace_t){
+      .alloc = alloc,
+      .block = NULL,
+      .arena = NULL,
+      .arena_size = 0U,
+      .arena_zeroed = false,
+  };
+  return ws;
+}
+
+knapsack_status_t knapsack_workspace_reserve(knapsack_workspace_t *workspace, size_t count,
+                                             int capacity) {
+  if (!workspace) {
+    return KNAPSACK_ERR_INVALID_ARGUMENT;
+  }
+  if (count == 0U) {
+    return KNAPSACK_ERR_INVALID_ITEMS;
+  }
+  if (count > KNAPSACK_MAX_ITEMS) {
+    return KNAPSACK_ERR_TOO_MANY_ITEMS;
+  }
+  if (capacity < 0 || capacity > KNAPSACK_MAX_CAPACITY) {
+    return KNAPSACK_ERR_INVALID_CAPACITY;
+  }
+  arena_layout_t layout;
+  const knapsack_status_t plan_status = plan_worst_case(count, capacity, 0U, &layout);
+  if (plan_status != KNAPSACK_OK) {
+    return plan_status;
+  }
+  return reserve_buffers(workspace, layout.total) ? KNAPSACK_OK : KNAPSACK_ERR_ALLOC;
+}
+
+knapsack_status_t knapsack_workspace_solve(knapsack_workspace_t *workspace,
+                                           const knapsack_item_t *items, size_t count, int capacity,
+                                           knapsack_result_t *out_result) {
+  if (!workspace) {
+    if (out_result) {
+      *out_result = (knapsack_result_t){0};
+    }
+    return KNAPSACK_ERR_INVALID_ARGUMENT;
+  }
+  return solve_in_workspace(workspace, items, count, capacity, &k_default_config, out_result);
+}
+
+knapsack_status_t knapsack_workspace_solve_opts(knapsack_workspace_t *workspace,
+                                                const knapsack_item_t *items, size_t count,
+                                                int capacity, const knapsack_options_t *options,
+                                                knapsack_result_t *out_result) {
+  knapsack_options_t defaults;
+  if (!options) {
+    knapsack_options_init(&defaults);
+    options = &defaults;
+  }
+  if (!out_result) {
+    return KNAPSACK_ERR_NULL_RESULT;
+  }
+  if (!workspace || !options_valid(options)) {
+    *out_result = (knapsack_result_t){0};
+    return KNAPSACK_ERR_INVALID_ARGUMENT;
+  }
+  const solve_config_t config = options_config(options, options->pool);
+  return solve_with_options(workspace, items, count, capacity, options, &config, out_result);
+}
+
+void knapsack_workspace_destroy(knapsack_workspace_t *workspace) {
+  if (!workspace) {
+    return;
+  }
+  const knapsack_allocator_t *alloc = workspace->alloc;
+  release_buffers(workspace);
+  alloc->free_fn(workspace, alloc->user_data);
+}
+
+size_t knapsack_workspace_size(size_t count, int capacity) {
+  if (count == 0U || count > KNAPSACK_MAX_ITEMS || capacity < 0 ||
+      capacity > KNAPSACK_MAX_CAPACITY) {
+    return 0U;
+  }
+  arena_layout_t layout;
+  if (plan_worst_case(count, capacity, count, &layout) != KNAPSACK_OK ||
+      layout.total > SIZE_MAX - (KNAPSACK_ARENA_ALIGN - 1U)) {
+    return 0U;
+  }
+  return layout.total + (KNAPSACK_ARENA_ALIGN - 1U);
+}
+
+knapsack_status_t knapsack_solve_with_buffer(const knapsack_item_t *items, size_t count,
+                                             int capacity, void *buffer, size_t buffer_size,
+                                             knapsack_result_t *out_result) {
+  solve_plan_t plan;
+  const knapsack_status_t status =
+      prepare_solve(items, count, capacity, &k_default_config, count, out_result, &plan);
+  if (status != KNAPSACK_OK) {
+    return status;
+  }
+  if (!buffer) {
+    return KNAPSACK_ERR_INVALID_ARGUMENT;
+  }
+  /* Checked against the unreduced instance, so whether a buffer is large
+   * enough never depends on what preprocessing happens to drop.
+   */
+  arena_layout_t required;
+  const knapsack_status_t size_status = plan_worst_case(count, capacity, count, &required);
+  if (size_status != KNAPSACK_OK) {
+    return size_status;
+  }
+  unsigned char *arena = align_arena(buffer);
+  const size_t slack = (size_t)(arena - (unsigned char *)buffer);
+  if (buffer_size < slack || buffer_size - slack < required.total) {
+    return KNAPSACK_ERR_INVALID_ARGUMENT;
+  }
+  size_t *index_storage = (size_t *)(void *)(arena + plan.layout.indices);
+  if (plan.reduction.trivial) {
+    return solve_trivial(items, count, capacity, false, NULL, index_storage, out_result);
+  }
+  return solve_planned(&plan, arena, false, items, count, NULL, index_storage, &k_default_config,
+                       out_result);
+}
+
+/* ------------------------------------------------------------------------- */
+/* Sessions                                                                   */
+/* ------------------------------------------------------------------------- */
+
+/* A session's arena holds one row pair of `width` cells, a decision bitset
+ * with one row per item slot, and a copy of the items (for reconstruction
+ * and rebuilds). Appending sweeps the new item over the row in place; a
+ * wider row is rebuilt in a fresh arena by sweeping every item again. No
+ * preprocessing runs: the items and capacity keep changing, and the results
+ * are the same without it.
+ */
+#define KNAPSACK_SESSION_MIN_ITEMS 8U
+
+typedef struct {
+  size_t value;
+  size_t weight;
+  size_t take_bits;
+  size_t items;
+  size_t total;
+} session_layout_t;
+
+struct knapsack_session {
+  struct knapsack_workspace storage;
+  session_layout_t layout;
+  knapsack_limits_t limits;
+  bool value_only;
+  size_t width; /* rows cover capacities 0 .. width - 1; 0 before the first arena */
+  size_t row_bits;
+  size_t item_room; /* items the arena has bitset rows and slots for */
+  size_t count;
+  int capacity;
+};
+
+static bool plan_session(size_t width, size_t item_room, bool value_only,
+                         session_layout_t *layout) {
+  const size_t row_bits = row_stride_bits(width);
+  const size_t rows = value_only ? 0U : item_room;
+  if (rows != 0U && row_bits > SIZE_MAX / rows) {
+    return false;
+  }
+  size_t cursor = 0U;
+  if (!arena_push(&cursor, width, sizeof(int), &layout->value) ||
+      !arena_push(&cursor, width, sizeof(uint32_t), &layout->weight) ||
+      !arena_push(&cursor, bitset_words(rows * row_bits), sizeof(uint64_t), &layout->take_bits) ||
+      !arena_push(&cursor, item_room, sizeof(knapsack_item_t), &layout->items)) {
+    return false;
+  }
+  layout->total = cursor;
+  return true;
+}
+
+/* DP view over the first width cells of the session's rows. */
+static workspace_t session_view(const struct knapsack_session *s, size_t width) {
+  unsigned char *arena = s->storage.arena;
+  return (workspace_t){
+      .width = width,
+      .row_bits = s->row_bits,
+      .take_bit_count = s->value_only ? 0U : s->count * s->row_bits,
+      .value = (int *)(void *)(arena + s->layout.value),
+      .weight = (uint32_t *)(void *)(arena + s->layout.weight),
+      .value_alt = NULL,
+      .weight_alt = NULL,
+      .take_bits = s->value_only ? NULL : (uint64_t *)(void *)(arena + s->layout.take_bits),
+      .row_word = NULL,
+  };
+}
+
+static knapsack_item_t *session_items(const struct knapsack_session *s) {
+  return (knapsack_item_t *)(void *)(s->storage.arena + s->layout.items);
+}
+
+/* Move the session to an arena for (width, item_room). At the same width
+ * the rows and decisions are copied over; a wider one is rebuilt from the
+ * items. The session only changes once the new arena is complete.
+ */
+static knapsack_status_t session_grow(struct knapsack_session *s, size_t width,
+                                      size_t item_room) {
+  session_layout_t layout;
+  if (!plan_session(width, item_room, s->value_only, &layout)) {
+    return KNAPSACK_ERR_DIMENSION_OVERFLOW;
+  }
+  struct knapsack_session grown = *s;
+  grown.storage = (struct knapsack_workspace){
+      .alloc = s->storage.alloc,
+      .block = NULL,
+      .arena = NULL,
+      .arena_size = 0U,
+      .arena_zeroed = false,
+  };
+  if (!reserve_buffers(&grown.storage, layout.total)) {
+    return KNAPSACK_ERR_ALLOC;
+  }
+  grown.layout = layout;
+  grown.width = width;
+  grown.row_bits = row_stride_bits(width);
+  grown.item_room = item_room;
+  if (s->count != 0U) {
+    memcpy(session_items(&grown), session_items(s), s->count * sizeof(knapsack_item_t));
+  }
+  workspace_t to = session_view(&grown, width);
+  if (width == s->width) {
+    const workspace_t from = session_view(s, width);
+    memcpy(to.value, from.value, width * sizeof(int));
+    memcpy(to.weight, from.weight, width * sizeof(uint32_t));
+    if (to.take_bits) {
+      memcpy(to.take_bits, from.take_bits,
+             bitset_words(s->count * s->row_bits) * sizeof(uint64_t));
+    }
+  } else if (run_dp(session_items(&grown), s->count, &to, NULL) != KNAPSACK_OK) {
+    release_buffers(&grown.storage);
+    return KNAPSACK_ERR_INT_OVERFLOW;
+  }
+  release_buffers(&s->storage);
+  *s = grown;
+  return KNAPSACK_OK;
+}
+
+/* Next size once `needed` exceeds `current`: at least double, within limit. */
+static size_t grow_size(size_t current, size_t needed, size_t limit) {
+  const size_t doubled = current > limit / 2U ? limit : current * 2U;
+  return doubled > needed ? doubled : needed;
+}
+
+static knapsack_status_t session_ensure(struct knapsack_session *s, size_t width,
+                                        size_t item_count) {
+  if (width <= s->width && item_count <= s->item_room && s->storage.arena) {
+    return KNAPSACK_OK;
+  }
+  const size_t width_limit = (size_t)s->limits.max_capacity + 1U;
+  const size_t room_floor =
+      s->limits.max_items < KNAPSACK_SESSION_MIN_ITEMS ? s->limits.max_items
+                                                       : KNAPSACK_SESSION_MIN_ITEMS;
+  const size_t new_width = width <= s->width ? s->width : grow_size(s->width, width, width_limit);
+  const size_t new_room =
+      item_count <= s->item_room
+          ? s->item_room
+          : grow_size(s->item_room, item_count > room_floor ? item_count : room_floor,
+                      s->limits.max_items);
+  return session_grow(s, new_width, new_room);
+}
+
+/* Recompute the rows of the current items in place, after an append
+ * overflowed half-way through its row. The same sweeps succeeded before.
+ */
+static void session_rebuild(struct knapsack_session *s) {
+  workspace_t ws = session_view(s, s->width);
+  memset(ws.value, 0, ws.width * sizeof(int));
+  memset(ws.weight, 0, ws.width * sizeof(uint32_t));
+  if (ws.take_bits) {
+    memset(ws.take_bits, 0, bitset_words((s->count + 1U) * ws.row_bits) * sizeof(uint64_t));
+  }
+  (void)run_dp(session_items(s), s->count, &ws, NULL);
+}
+
+knapsack_session_t *knapsack_session_create(const knapsack_options_t *options) {
+  knapsack_options_t defaults;
+  if (!options) {
+    knapsack_options_init(&defaults);
+    options = &defaults;
+  }
+  if (!options_valid(options) || options->reconstruct == KNAPSACK_RECONSTRUCT_HIRSCHBERG ||
+      (options->engine != KNAPSACK_ENGINE_AUTO && options->engine != KNAPSACK_ENGINE_DENSE)) {
+    return NULL;
+  }
+  const knapsack_allocator_t *alloc = resolve_allocator(options->allocator);
+  knapsack_session_t *session = alloc->alloc_fn(sizeof(*session), alloc->user_data);
+  if (!session) {
+    return NULL;
+  }
+  *session = (knapsack_session_t){
+      .storage = {.alloc = alloc,
+                  .block = NULL,
+                  .arena = NULL,
+                  .arena_size = 0U,
+                  .arena_zeroed = false},
+      .layout = {0},
+      .limits = options->limits,
+      .value_only = options->reconstruct == KNAPSACK_RECONSTRUCT_NONE,
+      .width = 0U,
+      .row_bits = 0U,
+      .item_room = 0U,
+      .count = 0U,
+      .capacity = 0,
+  };
+  return session;
+}
+
+knapsack_status_t knapsack_session_reserve(knapsack_session_t *session, size_t count,
+                                           int capacity) {
+  if (!session) {
+    return KNAPSACK_ERR_INVALID_ARGUMENT;
+  }
+  if (count > session->limits.max_items) {
+    return KNAPSACK_ERR_TOO_MANY_ITEMS;
+  }
+  if (capacity < 0 || capacity > session->limits.max_capacity) {
+    return KNAPSACK_ERR_INVALID_CAPACITY;
+  }
+  return session_ensure(session, (size_t)capacity + 1U, count);
+}
+
+knapsack_status_t knapsack_session_add_item(knapsack_session_t *session, knapsack_item_t item) {
+  if (!session) {
+    return KNAPSACK_ERR_INVALID_ARGUMENT;
+  }
+  if (item.weight <= 0 || item.value < 0) {
+    return KNAPSACK_ERR_INVALID_ITEMS;
+  }
+  if (session->count >= session->limits.max_items) {
+    return KNAPSACK_ERR_TOO_MANY_ITEMS;
+  }
+  const knapsack_status_t status =
+      session_ensure(session, (size_t)session->capacity + 1U, session->count + 1U);
+  if (status != KNAPSACK_OK) {
+    return status;
+  }
+  const workspace_t ws = session_view(session, session->width);
+  uint64_t *row_bits =
+      ws.take_bits ? ws.take_bits + session->count * (ws.row_bits / KNAPSACK_BITSET_WORD_BITS)
+                   : NULL;
+  if (sweep_items(&item, 1U, ws.width, ws.row_bits, NULL, ws.value, ws.weight, row_bits, NULL) !=
+      KNAPSACK_OK) {
+    session_rebuild(session);
+    return KNAPSACK_ERR_INT_OVERFLOW;
+  }
+  session_items(session)[session->count++] = item;
+  return KNAPSACK_OK;
+}
+
+knapsack_status_t knapsack_session_set_capacity(knapsack_session_t *session, int capacity) {
+  if (!session) {
+    return KNAPSACK_ERR_INVALID_ARGUMENT;
+  }
+  if (capacity < 0 || capacity > session->limits.max_capacity) {
+    return KNAPSACK_ERR_INVALID_CAPACITY;
+  }
+  /* Without items the rows are sized by the first append. */
+  if (session->count != 0U) {
+    const knapsack_status_t status =
+        session_ensure(session, (size_t)capacity + 1U, session->item_room);
+    if (status != KNAPSACK_OK) {
+      return status;
+    }
+  }
+  session->capacity = capacity;
+  return KNAPSACK_OK;
+}
+
+size_t knapsack_session_count(const knapsack_session_t *session) {
+  return session ? session->count : 0U;
+}
+
+knapsack_status_t knapsack_session_result(const knapsack_session_t *session,
+                                          knapsack_result_t *out_result) {
+  if (!out_result) {
+    return KNAPSACK_ERR_NULL_RESULT;
+  }
+  *out_result = (knapsack_result_t){0};
+  if (!session) {
+    return KNAPSACK_ERR_INVALID_ARGUMENT;
+  }
+  if (session->count == 0U) {
+    return KNAPSACK_OK;
+  }
+  /* Cell capacity holds the optimum. An earlier cell holding the same one,
+   * which select_best_cap would pick, leads to the same decisions.
+   */
+  const workspace_t ws = session_view(session, (size_t)session->capacity + 1U);
+  const size_t best_cap = (size_t)session->capacity;
+  out_result->upper_bound = ws.value[best_cap];
+  if (!ws.take_bits) {
+    out_result->optimal_value = ws.value[best_cap];
+    out_result->total_weight = (int)ws.weight[best_cap];
+    return KNAPSACK_OK;
+  }
+  return reconstruct_solution(&ws, session_items(session), session->count, best_cap,
+                              session->storage.alloc, NULL, out_result);
+}
+
+/* The appended item changes cell capacity only if its candidate there beats
+ * the cell, exactly as the kernel would decide. Every cell holds the best
+ * selection within its capacity, so that cell is the new optimum, and the
+ * rest of the selection is read from cell capacity - weight of the current
+ * decisions.
+ */
+knapsack_status_t knapsack_session_peek_item(const knapsack_session_t *session,
+                                             knapsack_item_t item,
+                                             knapsack_result_t *out_result) {
+  if (!out_result) {
+    return KNAPSACK_ERR_NULL_RESULT;
+  }
+  *out_result = (knapsack_result_t){0};
+  if (!session) {
+    return KNAPSACK_ERR_INVALID_ARGUMENT;
+  }
+  if (item.weight <= 0 || item.value < 0) {
+    return KNAPSACK_ERR_INVALID_ITEMS;
+  }
+  if (session->count >= session->limits.max_items) {
+    return KNAPSACK_ERR_TOO_MANY_ITEMS;
+  }
+  if (item.weight > session->capacity) {
+    return knapsack_session_result(session, out_result);
+  }
+  const size_t cap = (size_t)session->capacity;
+  const size_t rest = cap - (size_t)item.weight;
+  const bool has_rows = session->count != 0U;
+  const workspace_t ws = has_rows ? session_view(session, cap + 1U) : (workspace_t){0};
+  const int keep_value = has_rows ? ws.value[cap] : 0;
+  const uint32_t keep_weight = has_rows ? ws.weight[cap] : 0U;
+  const int rest_value = has_rows ? ws.value[rest] : 0;
+  if (rest_value > INT_MAX - item.value) {
+    return KNAPSACK_ERR_INT_OVERFLOW;
+  }
+  const int take_value = rest_value + item.value;
+  const uint32_t take_weight = (has_rows ? ws.weight[rest] : 0U) + (uint32_t)item.weight;
+  if (take_value < keep_value || (take_value == keep_value && take_weight >= keep_weight)) {
+    return knapsack_session_result(session, out_result);
+  }
+
+  out_result->optimal_value = take_value;
+  out_result->total_weight = (int)take_weight;
+  out_result->upper_bound = take_value;
+  if (session->value_only) {
+    return KNAPSACK_OK;
+  }
+  const knapsack_item_t *items = session_items(session);
+  const size_t selected = has_rows ? count_selected(&ws, items, session->count, rest) : 0U;
+  const knapsack_allocator_t *alloc = session->storage.alloc;
+  size_t *indices = alloc->alloc_fn((selected + 1U) * sizeof(size_t), alloc->user_data);
+  if (!indices) {
+    *out_result = (knapsack_result_t){0};
+    return KNAPSACK_ERR_ALLOC;
+  }
+  if (selected != 0U) {
+    knapsack_result_t rest_result = {0};
+    (void)reconstruct_solution(&ws, items, session->count, rest, NULL, indices, &rest_result);
+  }
+  indices[selected] = session->count;
+  out_result->selected_indices = indices;
+  out_result->selected_count = selected + 1U;
+  return KNAPSACK_OK;
+}
+
+void knapsack_session_destroy(knapsack_session_t *session) {
+  if (!session) {
+    return;
+  }
+  const knapsack_allocator_t *alloc = session->storage.alloc;
+  release_buffers(&session->storage);
+  alloc->free_fn(session, alloc->user_data);
+}
+
+/* ------------------------------------------------------------------------- */
+/* Bounded and unbounded items                                                */
+/* ------------------------------------------------------------------------- */
+
+/* Binary splitting: an item with k usable copies becomes 0/1 pieces of 1,
+ * 2, 4, ... copies and a remainder, floor(log2(k)) + 1 of them. Every
+ * quantity 0..k is the copy count of some subset of the pieces and no
+ * subset exceeds k, so the 0/1 optimum over the pieces is the bounded one,
+ * tie-break included. An unbounded item has capacity / weight usable copies,
+ * the most that fit; a zero-value item has none, since the tie-break never
+ * takes it. Pieces are emitted item by item, so ascending piece indices map
+ * to non-decreasing item indices.
+ */
+typedef struct {
+  size_t item; /* index of the bounded item */
+  int copies;  /* copies the piece stands for */
+} bounded_piece_t;
+
+/* NOLINTNEXTLINE(bugprone-easily-swappable-parameters) -- public API order. */
+static knapsack_status_t validate_bounded(const knapsack_bounded_item_t *items, size_t count,
+                                          int capacity, const knapsack_limits_t *limits) {
+  if (!items || count == 0U) {
+    return KNAPSACK_ERR_INVALID_ITEMS;
+  }
+  if (count > limits->max_items) {
+    return KNAPSACK_ERR_TOO_MANY_ITEMS;
+  }
+  if (capacity < 0 || capacity > limits->max_capacity) {
+    return KNAPSACK_ERR_INVALID_CAPACITY;
+  }
+  for (size_t i = 0; i < count; ++i) {
+    if (items[i].weight <= 0 || items[i].value < 0 || items[i].count < 0) {
+      return KNAPSACK_ERR_INVALID_ITEMS;
+    }
+  }
+  return KNAPSACK_OK;
+}
+
+static int usable_copies(const knapsack_bounded_item_t *item, int capacity) {
+  if (item->value == 0) {
+    return 0;
+  }
+  const int fit = capacity / item->weight;
+  return item->count < fit ? item->count : fit;
+}
+
+static size_t piece_count(int copies) {
+  size_t pieces = 0U;
+  for (long long size = 1; copies > 0; size *= 2) {
+    copies -= size < copies ? (int)size : copies;
+    ++pieces;
+  }
+  return pieces;
+}
+
+/* Write the pieces of every item. Returns false if one piece is worth more
+ * than INT_MAX: its copies fit together, so the optimum would be too.
+ */
+static bool split_items(const knapsack_bounded_item_t *items, size_t count, int capacity,
+                        knapsack_item_t *pieces, bounded_piece_t *origin) {
+  size_t write = 0U;
+  for (size_t i = 0; i < count; ++i) {
+    int left = usable_copies(&items[i], capacity);
+    for (long long size = 1; left > 0; size *= 2) {
+      const int copies = size < left ? (int)size : left;
+      const long long value = (long long)items[i].value * copies;
+      if (value > INT_MAX) {
+        return false;
+      }
+      pieces[write] = (knapsack_item_t){items[i].weight * copies, (int)value};
+      origin[write] = (bounded_piece_t){i, copies};
+      ++write;
+      left -= copies;
+    }
+  }
+  return true;
+}
+
+/* Sum the pieces a 0/1 result selected (ascending) into per-item quantities. */
+static knapsack_status_t fold_pieces(const knapsack_result_t *flat, const bounded_piece_t *origin,
+                                     const knapsack_allocator_t *alloc,
+                                     knapsack_bounded_result_t *out_result) {
+  out_result->optimal_value = flat->optimal_value;
+  out_result->total_weight = flat->total_weight;
+  out_result->upper_bound = flat->upper_bound;
+  size_t selected = 0U;
+  for (size_t k = 0; k < flat->selected_count; ++k) {
+    const size_t item = origin[flat->selected_indices[k]].item;
+    if (k == 0U || item != origin[flat->selected_indices[k - 1U]].item) {
+      ++selected;
+    }
+  }
+  if (selected == 0U) {
+    return KNAPSACK_OK;
+  }
+  size_t *indices = alloc->alloc_fn(selected * sizeof(size_t), alloc->user_data);
+  int *quantities = alloc->alloc_fn(selected * sizeof(int), alloc->user_data);
+  if (!indices || !quantities) {
+    alloc->free_fn(indices, alloc->user_data);
+    alloc->free_fn(quantities, alloc->user_data);
+    return KNAPSACK_ERR_ALLOC;
+  }
+  size_t write = 0U;
+  for (size_t k = 0; k < flat->selected_count; ++k) {
+    const bounded_piece_t *piece = &origin[flat->selected_indices[k]];
+    if (write == 0U || indices[write - 1U] != piece->item) {
+      indices[write] = piece->item;
+      quantities[write] = 0;
+      ++write;
+    }
+    quantities[write - 1U] += piece->copies;
+  }
+  out_result->selected_indices = indices;
+  out_result->quantities = quantities;
+  out_result->selected_count = selected;
+  return KNAPSACK_OK;
+}
+
+knapsack_status_t knapsack_solve_bounded(const knapsack_bounded_item_t *items, size_t count,
+                                         int capacity, const knapsack_options_t *options,
+                                         knapsack_bounded_result_t *out_result) {
+  knapsack_options_t defaults;
+  if (!options) {
+    knapsack_options_init(&defaults);
+    options = &defaults;
+  }
+  if (!out_result) {
+    return KNAPSACK_ERR_NULL_RESULT;
+  }
+  *out_result = (knapsack_bounded_result_t){0};
+  if (!options_valid(options)) {
+    return KNAPSACK_ERR_INVALID_ARGUMENT;
+  }
+  knapsack_status_t status = validate_bounded(items, count, capacity, &options->limits);
+  if (status != KNAPSACK_OK) {
+    return status;
+  }
+  size_t piece_total = 0U;
+  for (size_t i = 0; i < count; ++i) {
+    piece_total += piece_count(usable_copies(&items[i], capacity));
+  }
+  solve_config_t config = options_config(options, options->pool);
+  if (piece_total == 0U) {
+    /* Nothing both fits and is worth taking: the empty selection. */
+    if (config.stats) {
+      *config.stats = (knapsack_stats_t){0};
+    }
+    return KNAPSACK_OK;
+  }
+
+  const knapsack_allocator_t *alloc = resolve_allocator(options->allocator);
+  if (piece_total > SIZE_MAX / (sizeof(bounded_piece_t) + sizeof(knapsack_item_t))) {
+    return KNAPSACK_ERR_DIMENSION_OVERFLOW;
+  }
+  /* origin[] first: its alignment also suits the pieces behind it. */
+  bounded_piece_t *origin = alloc->alloc_fn(
+      piece_total * (sizeof(bounded_piece_t) + sizeof(knapsack_item_t)), alloc->user_data);
+  if (!origin) {
+    return KNAPSACK_ERR_ALLOC;
+  }
+  knapsack_item_t *pieces = (knapsack_item_t *)(void *)(origin + piece_total);
+  status = split_items(items, count, capacity, pieces, origin) ? KNAPSACK_OK
+                                                                : KNAPSACK_ERR_INT_OVERFLOW;
+  if (status == KNAPSACK_OK) {
+    /* The limits were checked on the caller's items; pieces are not counted. */
+    const knapsack_limits_t piece_limits = {piece_total, options->limits.max_capacity};
+    config.limits = &piece_limits;
+    struct knapsack_workspace ws = {
+        .alloc = alloc,
+        .block = NULL,
+        .arena = NULL,
+        .arena_size = 0U,
+        .arena_zeroed = false,
+    };
+    knapsack_result_t flat;
+    status = solve_with_options(&ws, pieces, piece_total, capacity, options, &config, &flat);
+    release_buffers(&ws);
+    if (status == KNAPSACK_OK) {
+      status = fold_pieces(&flat, origin, alloc, out_result);
+      knapsack_result_free_ex(&flat, alloc);
+    }
+  }
+  alloc->free_fn(origin, alloc->user_data);
+  if (status != KNAPSACK_OK) {
+    *out_result = (knapsack_bounded_result_t){0};
+  }
+  return status;
+}
+
+void knapsack_bounded_result_free_ex(knapsack_bounded_result_t *result,
+                                     const knapsack_allocator_t *allocator) {
+  if (!result) {
+    return;
+  }
+  const knapsack_allocator_t *alloc = resolve_allocator(allocator);
+  alloc->free_fn(result->selected_indices, alloc->user_data);
+  alloc->free_fn(result->quantities, alloc->user_data);
+  *result = (knapsack_bounded_result_t){0};
+}
+
+/* ------------------------------------------------------------------------- */
+/* Top-K selections                                                           */
+/* ------------------------------------------------------------------------- */
+
+/* The table DP and the search live in top_k.c; this is their memory
+ * plumbing. One block holds the table, the search nodes and the items that
+ * fit, compacted, with their original indices.
+ */
+typedef struct {
+  size_t value;
+  size_t weight;
+  size_t nodes;
+  size_t heap;
+  size_t items;
+  size_t origin;
+  size_t total;
+} topk_layout_t;
+
+/* NOLINTBEGIN(bugprone-easily-swappable-parameters) -- internal helper, params are documented. */
+static bool plan_top_k(size_t width, size_t rows, size_t slots, topk_layout_t *layout) {
+  size_t cursor = 0U;
+  if (width > SIZE_MAX / (rows + 1U)) {
+    return false;
+  }
+  const size_t cells = (rows + 1U) * width;
+  if (!arena_push(&cursor, cells, sizeof(int), &layout->value) ||
+      !arena_push(&cursor, cells, sizeof(uint32_t), &layout->weight) ||
+      !arena_push(&cursor, slots, sizeof(topk_node_t), &layout->nodes) ||
+      !arena_push(&cursor, slots, sizeof(size_t), &layout->heap) ||
+      !arena_push(&cursor, rows, sizeof(knapsack_item_t), &layout->items) ||
+      !arena_push(&cursor, rows, sizeof(size_t), &layout->origin)) {
+    return false;
+  }
+  layout->total = cursor;
+  return true;
+}
+/* NOLINTEND(bugprone-easily-swappable-parameters) */
+
+/* Pop up to k selections from a filled table into out_results; *found is
+ * how many there were.
+ */
+/* NOLINTBEGIN(bugprone-easily-swappable-parameters) -- internal helper, params are documented. */
+static knapsack_status_t top_k_results(topk_table_t *table, const knapsack_item_t *items,
+                                       const size_t *origin, size_t k, bool value_only,
+                                       const knapsack_allocator_t *alloc,
+                                       knapsack_result_t *out_results, size_t *found) {
+  size_t leaf = 0U;
+  for (*found = 0U; *found < k && topk_next(table, items, &leaf); ++*found) {
+    const topk_node_t *node = &table->nodes[leaf];
+    knapsack_result_t *result = &out_results[*found];
+    result->optimal_value = node->value;
+    result->total_weight = (int)node->weight;
+    result->upper_bound = node->value;
+    const size_t selected = value_only ? 0U : topk_collect(table, leaf, origin, NULL);
+    if (selected == 0U) {
+      continue;
+    }
+    size_t *indices = alloc->alloc_fn(selected * sizeof(size_t), alloc->user_data);
+    if (!indices) {
+      return KNAPSACK_ERR_ALLOC;
+    }
+    topk_collect(table, leaf, origin, indices);
+    result->selected_indices = indices;
+    result->selected_count = selected;
+  }
+  return KNAPSACK_OK;
+}
+/* NOLINTEND(bugprone-easily-swappable-parameters) */
+
+knapsack_status_t knapsack_solve_top_k(const knapsack_item_t *items, size_t count, int capacity,
+                                       size_t k, const knapsack_options_t *options,
+                                       knapsack_result_t *out_results, size_t *out_found) {
+  knapsack_options_t defaults;
+  if (!options) {
+    knapsack_options_init(&defaults);
+    options = &defaults;
+  }
+  if (!out_results || !out_found) {
+    return KNAPSACK_ERR_NULL_RESULT;
+  }
+  *out_found = 0U;
+  if (k == 0U || k > KNAPSACK_MAX_TOP_K) {
+    return KNAPSACK_ERR_INVALID_ARGUMENT;
+  }
+  for (size_t rank = 0; rank < k; ++rank) {
+    out_results[rank] = (knapsack_result_t){0};
+  }
+  if (!options_valid(options)) {
+    return KNAPSACK_ERR_INVALID_ARGUMENT;
+  }
+  knapsack_status_t status = validate_inputs(items, count, capacity, &options->limits);
+  if (status != KNAPSACK_OK) {
+    return status;
+  }
+  const solve_config_t config = options_config(options, NULL);
+  knapsack_stats_t *stats = config_stats(&config);
+  if (stats) {
+    *stats = (knapsack_stats_t){0};
+  }
+
+  /* Items heavier than the capacity are in no selection: no rows for them. */
+  size_t rows = 0U;
+  for (size_t i = 0; i < count; ++i) {
+    rows += items[i].weight <= capacity ? 1U : 0U;
+  }
+  const size_t width = (size_t)capacity + 1U;
+  topk_layout_t layout;
+  if (rows > (SIZE_MAX - 1U) / (2U * k)) {
+    return KNAPSACK_ERR_DIMENSION_OVERFLOW;
+  }
+  const size_t slots = 1U + 2U * k * rows;
+  if (!plan_top_k(width, rows, slots, &layout)) {
+    return KNAPSACK_ERR_DIMENSION_OVERFLOW;
+  }
+  /* Every row stays for the search: refuse, rather than try, a table that
+   * raised limits have made too large.
+   */
+  if (layout.total > KNAPSACK_TOP_K_MAX_BYTES) {
+    return KNAPSACK_ERR_LIMIT;
+  }
+  const knapsack_allocator_t *alloc = resolve_allocator(options->allocator);
+  unsigned char *block = alloc->alloc_fn(layout.total, alloc->user_data);
+  if (!block) {
+    return KNAPSACK_ERR_ALLOC;
+  }
+  knapsack_item_t *fit = (knapsack_item_t *)(void *)(block + layout.items);
+  size_t *origin = (size_t *)(void *)(block + layout.origin);
+  for (size_t i = 0, r = 0; i < count; ++i) {
+    if (items[i].weight <= capacity) {
+      fit[r] = items[i];
+      origin[r++] = i;
+    }
+  }
+  topk_table_t table = {
+      .value = (int *)(void *)(block + layout.value),
+      .weight = (uint32_t *)(void *)(block + layout.weight),
+      .nodes = (topk_node_t *)(void *)(block + layout.nodes),
+      .heap = (size_t *)(void *)(block + layout.heap),
+      .slots = slots,
+      .width = width,
+      .rows = rows,
+      .used = 0U,
+      .queued = 0U,
+      .cells = 0U,
+  };
+  switch (topk_run(fit, rows, capacity, &config.cancel, &table)) {
+  case TOPK_DONE:
+    break;
+  case TOPK_OVERFLOW:
+    status = KNAPSACK_ERR_INT_OVERFLOW;
+    break;
+  case TOPK_CANCELLED:
+    status = KNAPSACK_ERR_CANCELLED;
+    break;
+  }
+  size_t found = 0U;
+  if (status == KNAPSACK_OK) {
+    topk_start(&table, rows, capacity);
+    status = top_k_results(&table, fit, origin, k, config.value_only, alloc, out_results, &found);
+  }
+  if (stats) {
+    stats->engine = KNAPSACK_ENGINE_DENSE;
+    stats->kernel = knapsack_active_kernel();
+    stats->workers = 1U;
+    stats->cells = table.cells;
+    stats->row_bytes = (rows + 1U) * width * (sizeof(int) + sizeof(uint32_t));
+    stats->engine_bytes = table.used * (sizeof(topk_node_t) + sizeof(size_t));
+    stats->instance_bytes = rows * (sizeof(knapsack_item_t) + sizeof(size_t));
+    stats->arena_bytes = layout.total;
+  }
+  alloc->free_fn(block, alloc->user_data);
+  if (status != KNAPSACK_OK) {
+    for (size_t rank = 0; rank < k; ++rank) {
+      knapsack_result_free_ex(&out_results[rank], options->allocator);
+    }
+    return status;
+  }
+  *out_found = found;
+  return KNAPSACK_OK;
+}
+
+/* ------------------------------------------------------------------------- */
+/* 64-bit values                                                              */
+/* ------------------------------------------------------------------------- */
+
+/* The dense DP of sweep_items and reconstruct_solution over int64_t value
+ * rows, in one arena: value row, weight row, then take_bits with one row
+ * per item (heavier items included, so rows are addressed as in the int
+ * path). There is no preprocessing; the DP itself answers trivial cases.
+ */
+typedef struct {
+  size_t value;
+  size_t weight;
+  size_t take_bits;
+  size_t total;
+} dense64_layout_t;
+
+static knapsack_status_t validate_inputs64(const knapsack_item64_t *items, size_t count,
+                                           int capacity, const knapsack_limits_t *limits) {
+  if (!items || count == 0U) {
+    return KNAPSACK_ERR_INVALID_ITEMS;
+  }
+  if (count > limits->max_items) {
+    return KNAPSACK_ERR_TOO_MANY_ITEMS;
+  }
+  if (capacity < 0 || capacity > limits->max_capacity) {
+    return KNAPSACK_ERR_INVALID_CAPACITY;
+  }
+  for (size_t i = 0; i < count; ++i) {
+    if (items[i].weight <= 0 || items[i].value < 0) {
+      return KNAPSACK_ERR_INVALID_ITEMS;
+    }
+  }
+  return KNAPSACK_OK;
+}
+
+/* NOLINTBEGIN(bugprone-easily-swappable-parameters) -- internal helper, params are documented. */
+static bool plan_dense64(size_t width, size_t count, bool decisions, dense64_layout_t *layout) {
+  const size_t row_bits = row_stride_bits(width);
+  if (decisions && count != 0U && row_bits > SIZE_MAX / count) {
+    return false;
+  }
+  const size_t words = decisions ? row_bits / KNAPSACK_BITSET_WORD_BITS * count : 0U;
+  size_t cursor = 0U;
+  if (!arena_push(&cursor, width, sizeof(int64_t), &layout->value) ||
+      !arena_push(&cursor, width, sizeof(uint32_t), &layout->weight) ||
+      !arena_push(&cursor, words, sizeof(uint64_t), &layout->take_bits)) {
+    return false;
+  }
+  layout->total = cursor;
+  return true;
+}
+
+static knapsack_status_t sweep_items64(const knapsack_item64_t *items, size_t count, size_t width,
+                                       int64_t *value, uint32_t *weight, uint64_t *take_bits,
+                                       dp_progress_t *progress) {
+  const dp_kernel64_fn kernel = dp_active_kernel64();
+  const size_t row_bits = row_stride_bits(width);
+  for (size_t i = 0; i < count; ++i) {
+    const size_t item_weight = (size_t)items[i].weight;
+    if (item_weight >= width) {
+      continue;
+    }
+    const dp_span64_t span = {
+        .out_value = value + item_weight,
+        .out_weight = weight + item_weight,
+        .keep_value = value + item_weight,
+        .keep_weight = weight + item_weight,
+        .take_value = value,
+        .take_weight = weight,
+        .n = width - item_weight,
+        .item_value = items[i].value,
+        .item_weight = (uint32_t)item_weight,
+        .bits = take_bits,
+        .bit_offset = take_bits ? i * row_bits + item_weight : 0U,
+    };
+    if (!kernel(&span)) {
+      return KNAPSACK_ERR_INT_OVERFLOW;
+    }
+    progress->cells += span.n;
+    if (i + 1U < count && cancel_poll(progress->cancel, &progress->credit, span.n)) {
+      return KNAPSACK_ERR_CANCELLED;
+    }
+  }
+  return KNAPSACK_OK;
+}
+
+/* select_best_cap and reconstruct_solution for the 64-bit rows. */
+static knapsack_status_t result64(const knapsack_item64_t *items, size_t count, size_t width,
+                                  const int64_t *value, const uint32_t *weight,
+                                  const uint64_t *take_bits, const knapsack_allocator_t *alloc,
+                                  knapsack_result64_t *out_result) {
+  size_t best_cap = 0U;
+  for (size_t cap = 1U; cap < width; ++cap) {
+    if (value[cap] > value[best_cap] ||
+        (value[cap] == value[best_cap] && weight[cap] < weight[best_cap])) {
+      best_cap = cap;
+    }
+  }
+  out_result->optimal_value = value[best_cap];
+  out_result->upper_bound = value[best_cap];
+  out_result->total_weight = (int)weight[best_cap];
+  if (!take_bits) {
+    return KNAPSACK_OK;
+  }
+  const size_t row_bits = row_stride_bits(width);
+  size_t selected = 0U;
+  size_t cap = best_cap;
+  for (size_t i = count; i-- > 0;) {
+    if (bitset_test(take_bits, i * row_bits + cap)) {
+      ++selected;
+      cap -= (size_t)items[i].weight;
+    }
+  }
+  if (selected == 0U) {
+    return KNAPSACK_OK;
+  }
+  size_t *indices = alloc->alloc_fn(selected * sizeof(size_t), alloc->user_data);
+  if (!indices) {
+    return KNAPSACK_ERR_ALLOC;
+  }
+  /* Walking back visits items in descending order: fill back-to-front. */
+  size_t write = selected;
+  cap = best_cap;
+  for (size_t i = count; i-- > 0;) {
+    if (bitset_test(take_bits, i * row_bits + cap)) {
+      indices[--write] = i;
+      cap -= (size_t)items[i].weight;
+    }
+  }
+  out_result->selected_indices = indices;
+  out_result->selected_count = selected;
+  return KNAPSACK_OK;
+}
+/* NOLINTEND(bugprone-easily-swappable-parameters) */
+
+knapsack_status_t knapsack_solve64(const knapsack_item64_t *items, size_t count, int capacity,
+                                   const knapsack_options_t *options,
+                                   knapsack_result64_t *out_result) {
+  knapsack_options_t defaults;
+  if (!options) {
+    knapsack_options_init(&defaults);
+    options = &defaults;
+  }
+  if (!out_result) {
+    return KNAPSACK_ERR_NULL_RESULT;
+  }
+  *out_result = (knapsack_result64_t){0};
+  if (!options_valid(options) || options->reconstruct == KNAPSACK_RECONSTRUCT_HIRSCHBERG ||
+      (options->engine != KNAPSACK_ENGINE_AUTO && options->engine != KNAPSACK_ENGINE_DENSE)) {
+    return KNAPSACK_ERR_INVALID_ARGUMENT;
+  }
+  knapsack_status_t status = validate_inputs64(items, count, capacity, &options->limits);
+  if (status != KNAPSACK_OK) {
+    return status;
+  }
+  const solve_config_t config = options_config(options, NULL);
+  knapsack_stats_t *stats = config_stats(&config);
+  uint64_t mark = stats ? stats_clock() : 0U;
+  if (stats) {
+    *stats = (knapsack_stats_t){0};
+  }
+
+  const size_t width = (size_t)capacity + 1U;
+  const bool decisions = !config.value_only;
+  dense64_layout_t layout;
+  if (!plan_dense64(width, count, decisions, &layout)) {
+    return KNAPSACK_ERR_DIMENSION_OVERFLOW;
+  }
+  const knapsack_allocator_t *alloc = resolve_allocator(options->allocator);
+  /* Zeroed: row 0 of the DP, and take_bits rows that only get ORed into. */
+  unsigned char *block = alloc->calloc_fn(1U, layout.total, alloc->user_data);
+  if (!block) {
+    return KNAPSACK_ERR_ALLOC;
+  }
+  int64_t *value = (int64_t *)(void *)(block + layout.value);
+  uint32_t *weight = (uint32_t *)(void *)(block + layout.weight);
+  uint64_t *take_bits = decisions ? (uint64_t *)(void *)(block + layout.take_bits) : NULL;
+  if (stats) {
+    stats->validate_ns = stats_lap(&mark);
+  }
+  dp_progress_t progress = {.cancel = &config.cancel, .credit = 0U, .done = 0U, .cells = 0U};
+  status = sweep_items64(items, count, width, value, weight, take_bits, &progress);
+  if (stats) {
+    stats->dp_ns = stats_lap(&mark);
+  }
+  if (status == KNAPSACK_OK) {
+    status = result64(items, count, width, value, weight, take_bits, alloc, out_result);
+  }
+  if (stats) {
+    stats->reconstruct_ns = stats_lap(&mark);
+    stats->engine = KNAPSACK_ENGINE_DENSE;
+    stats->kernel = knapsack_active_kernel();
+    stats->workers = 1U;
+    stats->cells = progress.cells;
+    stats->row_bytes = width * (sizeof(int64_t) + sizeof(uint32_t));
+    stats->take_bits_bytes = decisions ? layout.total - layout.take_bits : 0U;
+    stats->arena_bytes = layout.total;
+  }
+  alloc->free_fn(block, alloc->user_data);
+  if (status != KNAPSACK_OK) {
+    *out_result = (knapsack_result64_t){0};
+  }
+  return status;
+}
+
+void knapsack_result64_free_ex(knapsack_result64_t *result, const knapsack_allocator_t *allocator) {
+  if (!result) {
+    return;
+  }
+  const knapsack_allocator_t *alloc = resolve_allocator(allocator);
+  alloc->free_fn(result->selected_indices, alloc->user_data);
+  *result = (knapsack_result64_t){0};
+}
+
+/* ------------------------------------------------------------------------- */
+/* Multiple capacity dimensions                                               */
+/* ------------------------------------------------------------------------- */
+
+/* The table DP lives in multi_dim.c; this is its validation and memory
+ * plumbing. One zeroed block holds the value and key cells, the decision
+ * bitset (one row per kept item), the kept positions and the halos.
+ */
+typedef struct {
+  size_t value;
+  size_t key;
+  size_t take_bits;
+  size_t kept;
+  size_t halo_value;
+  size_t halo_key;
+  size_t total;
+} multi_layout_t;
+
+static knapsack_status_t validate_multi(const knapsack_multi_item_t *items, size_t count,
+                                        size_t dims, const int *capacities,
+                                        const knapsack_limits_t *limits) {
+  if (!items || count == 0U) {
+    return KNAPSACK_ERR_INVALID_ITEMS;
+  }
+  if (count > limits->max_items) {
+    return KNAPSACK_ERR_TOO_MANY_ITEMS;
+  }
+  if (!capacities) {
+    return KNAPSACK_ERR_INVALID_CAPACITY;
+  }
+  for (size_t d = 0; d < dims; ++d) {
+    if (capacities[d] < 0 || capacities[d] > limits->max_capacity) {
+      return KNAPSACK_ERR_INVALID_CAPACITY;
+    }
+  }
+  for (size_t i = 0; i < count; ++i) {
+    bool weighs = false;
+    for (size_t d = 0; d < dims; ++d) {
+      if (items[i].weights[d] < 0) {
+        return KNAPSACK_ERR_INVALID_ITEMS;
+      }
+      weighs = weighs || items[i].weights[d] > 0;
+    }
+    if (!weighs || items[i].value < 0) {
+      return KNAPSACK_ERR_INVALID_ITEMS;
+    }
+  }
+  return KNAPSACK_OK;
+}
+
+/* NOLINTBEGIN(bugprone-easily-swappable-parameters) -- internal helper, params are documented. */
+static bool plan_multi(const multi_table_t *table, size_t count, bool decisions,
+                       multi_layout_t *layout) {
+  if (decisions && table->row_bits > SIZE_MAX / count) {
+    return false;
+  }
+  const size_t words = decisions ? table->row_bits / KNAPSACK_BITSET_WORD_BITS * count : 0U;
+  /* block < extent[0], so the two halos are smaller than the table. */
+  const size_t halo = 2U * table->block * table->stride[0];
+  size_t cursor = 0U;
+  if (!arena_push(&cursor, table->cells, sizeof(int), &layout->value) ||
+      !arena_push(&cursor, table->cells, sizeof(uint32_t), &layout->key) ||
+      !arena_push(&cursor, words, sizeof(uint64_t), &layout->take_bits) ||
+      !arena_push(&cursor, count, sizeof(size_t), &layout->kept) ||
+      !arena_push(&cursor, halo, sizeof(int), &layout->halo_value) ||
+      !arena_push(&cursor, halo, sizeof(uint32_t), &layout->halo_key)) {
+    return false;
+  }
+  layout->total = cursor;
+  return true;
+}
+
+static knapsack_status_t multi_result(const multi_table_t *table,
+                                      const knapsack_multi_item_t *items, const size_t *kept,
+                                      size_t rows, const knapsack_allocator_t *alloc,
+                                      knapsack_multi_result_t *out_result) {
+  const size_t best = multi_best(table);
+  out_result->optimal_value = table->value[best];
+  for (size_t d = 0; d < table->dims; ++d) {
+    out_result->total_weights[d] = multi_weight(table, table->key[best], d);
+  }
+  if (!table->take_bits) {
+    return KNAPSACK_OK;
+  }
+  const size_t selected = multi_collect(table, items, kept, rows, best, NULL);
+  if (selected == 0U) {
+    return KNAPSACK_OK;
+  }
+  size_t *indices = alloc->alloc_fn(selected * sizeof(size_t), alloc->user_data);
+  if (!indices) {
+    return KNAPSACK_ERR_ALLOC;
+  }
+  multi_collect(table, items, kept, rows, best, indices);
+  out_result->selected_indices = indices;
+  out_result->selected_count = selected;
+  return KNAPSACK_OK;
+}
+/* NOLINTEND(bugprone-easily-swappable-parameters) */
+
+knapsack_status_t knapsack_solve_multi(const knapsack_multi_item_t *items, size_t count,
+                                       size_t dims, const int *capacities,
+                                       const knapsack_options_t *options,
+                                       knapsack_multi_result_t *out_result) {
+  knapsack_options_t defaults;
+  if (!options) {
+    knapsack_options_init(&defaults);
+    options = &defaults;
+  }
+  if (!out_result) {
+    return KNAPSACK_ERR_NULL_RESULT;
+  }
+  *out_result = (knapsack_multi_result_t){0};
+  if (dims == 0U || dims > KNAPSACK_MAX_DIMENSIONS || !options_valid(options) ||
+      options->reconstruct == KNAPSACK_RECONSTRUCT_HIRSCHBERG ||
+      (options->engine != KNAPSACK_ENGINE_AUTO && options->engine != KNAPSACK_ENGINE_DENSE)) {
+    return KNAPSACK_ERR_INVALID_ARGUMENT;
+  }
+  knapsack_status_t status = validate_multi(items, count, dims, capacities, &options->limits);
+  if (status != KNAPSACK_OK) {
+    return status;
+  }
+  multi_table_t table = {0};
+  if (!multi_shape(&table, dims, capacities)) {
+    return KNAPSACK_ERR_INVALID_CAPACITY;
+  }
+  const solve_config_t config = options_config(options, NULL);
+  knapsack_stats_t *stats = config_stats(&config);
+  uint64_t mark = stats ? stats_clock() : 0U;
+  if (stats) {
+    *stats = (knapsack_stats_t){0};
+  }
+
+  const bool decisions = !config.value_only;
+  multi_tile(&table, config.tile_cells != 0U ? config.tile_cells : knapsack_tile_cells());
+  multi_layout_t layout;
+  if (!plan_multi(&table, count, decisions, &layout)) {
+    return KNAPSACK_ERR_DIMENSION_OVERFLOW;
+  }
+  const knapsack_allocator_t *alloc = resolve_allocator(options->allocator);
+  /* Zeroed: the table starts as the empty selection everywhere, and the
+   * decision bits are only ever ORed in.
+   */
+  unsigned char *block = alloc->calloc_fn(1U, layout.total, alloc->user_data);
+  if (!block) {
+    return KNAPSACK_ERR_ALLOC;
+  }
+  table.value = (int *)(void *)(block + layout.value);
+  table.key = (uint32_t *)(void *)(block + layout.key);
+  table.take_bits = decisions ? (uint64_t *)(void *)(block + layout.take_bits) : NULL;
+  size_t *kept = (size_t *)(void *)(block + layout.kept);
+  table.halo_value = (int *)(void *)(block + layout.halo_value);
+  table.halo_key = (uint32_t *)(void *)(block + layout.halo_key);
+  const size_t rows = multi_prune(items, count, &table, kept);
+  if (stats) {
+    stats->validate_ns = stats_lap(&mark);
+  }
+  switch (multi_run(items, kept, rows, &config.cancel, &table)) {
+  case MULTI_DONE:
+    break;
+  case MULTI_OVERFLOW:
+    status = KNAPSACK_ERR_INT_OVERFLOW;
+    break;
+  case MULTI_CANCELLED:
+    status = KNAPSACK_ERR_CANCELLED;
+    break;
+  }
+  if (stats) {
+    stats->dp_ns = stats_lap(&mark);
+  }
+  if (status == KNAPSACK_OK) {
+    status = multi_result(&table, items, kept, rows, alloc, out_result);
+    out_result->pruned_count = count - rows;
+  }
+  if (stats) {
+    stats->reconstruct_ns = stats_lap(&mark);
+    stats->engine = KNAPSACK_ENGINE_DENSE;
+    stats->kernel = knapsack_active_kernel();
+    stats->workers = 1U;
+    stats->cells = table.filled;
+    if (decisions) {
+      const size_t words = rows * table.row_bits / KNAPSACK_BITSET_WORD_BITS;
+      for (size_t i = 0; i < words; ++i) {
+        stats->cells_taken += popcount64(table.take_bits[i]);
+      }
+    }
+    stats->row_bytes = table.cells * (sizeof(int) + sizeof(uint32_t));
+    stats->take_bits_bytes = decisions ? layout.kept - layout.take_bits : 0U;
+    stats->instance_bytes = count * sizeof(size_t);
+    stats->arena_bytes = layout.total;
+  }
+  alloc->free_fn(block, alloc->user_data);
+  if (status != KNAPSACK_OK) {
+    knapsack_multi_result_free_ex(out_result, options->allocator);
+  }
+  return status;
+}
+
+void knapsack_multi_result_free_ex(knapsack_multi_result_t *result,
+                                   const knapsack_allocator_t *allocator) {
+  if (!result) {
+    return;
+  }
+  const knapsack_allocator_t *alloc = resolve_allocator(allocator);
+  alloc->free_fn(result->selected_indices, alloc->user_data);
+  *result = (knapsack_multi_result_t){0};
+}
@@ -0,0 +1,419 @@
+/* Internal interface shared between the solver translation units under src/.
+ * NOT part of the public knapsack library API.
+ */
+#ifndef KNAPSACK_INTERNAL_H
+#define KNAPSACK_INTERNAL_H
+
+#include "knapsack/knapsack.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Decision bitsets (take_bits, kernel bits) are arrays of uint64_t words;
+ * bit i lives in word i / KNAPSACK_BITSET_WORD_BITS.
+ */
+#define KNAPSACK_BITSET_WORD_BITS 64U
+
+/* One item's update over a contiguous run of capacity cells. For every
+ * j in [0, n):
+ *
+ *   candidate   = take_value[j] + item_value, take_weight[j] + item_weight
+ *   out[j]      = candidate if it beats keep[j] (higher value, or equal
+ *                 value and lower weight), otherwise keep[j]
+ *   bit (bit_offset + j) of bits is set when the candidate wins (bits may
+ *                 be NULL when decisions are not needed)
+ *
+ * Cells are processed from high j to low j, so the update may run in place
+ * (out == keep, take == out - item_weight). The kernel returns false if any
+ * candidate value in the span overflows int; out is then unspecified.
+ *
+ * Weights are 32-bit: a total weight never exceeds the capacity, which is an
+ * int, so every weight (and every candidate weight) is at most INT_MAX.
+ */
+typedef struct {
+  int *out_value;
+  uint32_t *out_weight;
+  const int *keep_value;
+  const uint32_t *keep_weight;
+  const int *take_value;
+  const uint32_t *take_weight;
+  size_t n;
+  int item_value;
+  uint32_t item_weight;
+  uint64_t *bits;
+  size_t bit_offset;
+} dp_span_t;
+
+/* The same update with 64-bit values (knapsack_solve64). Weights, bits and
+ * the in-place contract are unchanged; overflow means exceeding INT64_MAX.
+ */
+typedef struct {
+  int64_t *out_value;
+  uint32_t *out_weight;
+  const int64_t *keep_value;
+  const uint32_t *keep_weight;
+  const int64_t *take_value;
+  const uint32_t *take_weight;
+  size_t n;
+  int64_t item_value;
+  uint32_t item_weight;
+  uint64_t *bits;
+  size_t bit_offset;
+} dp_span64_t;
+
+/* allocator, or the malloc/calloc/free fallback when it is NULL. */
+const knapsack_allocator_t *resolve_allocator(const knapsack_allocator_t *user);
+
+/* Whether knapsack_solve_opts would accept @p options (limits, engine,
+ * reconstruction mode and device are known and compatible).
+ */
+bool options_valid(const knapsack_options_t *options);
+
+/* Cancellation polling shared by the engines. Each engine adds the work it
+ * did since the last call (cells, states or nodes) to *credit; the callback
+ * runs once KNAPSACK_CANCEL_POLL_CELLS has accumulated, and the result is
+ * true if it asked to stop. A NULL cancel, or a NULL fn, never stops.
+ */
+typedef struct {
+  knapsack_cancel_fn fn;
+  void *user_data;
+} cancel_t;
+
+bool cancel_poll(const cancel_t *cancel, size_t *credit, size_t work);
+
+/* Trimmed decision rows (knapsack.c). A dense solve's take_bits keeps, for
+ * each item, only the words from the one holding the cell of its weight to
+ * the end of the row: no cell below an item's weight can take it, and an
+ * item too heavy for the row keeps no words at all. Row i spans words
+ * [row_word[i], row_word[i + 1]). Rows are zeroed by the engine that fills
+ * them, just before it does, rather than all at once up front.
+ */
+
+/* Bit of take_bits holding row's decision at cap; cap >= item_weight. */
+size_t take_row_bit(const size_t *row_word, size_t row, size_t item_weight, size_t cap);
+
+/* Zero the words of rows [first, last). */
+void take_rows_clear(uint64_t *take_bits, const size_t *row_word, size_t first, size_t last);
+
+typedef bool (*dp_kernel_fn)(const dp_span_t *span);
+
+/* Kernel the solver should use right now: the knapsack_set_kernel override,
+ * or the best kernel detected for this CPU at load time.
+ */
+dp_kernel_fn dp_active_kernel(void);
+
+typedef bool (*dp_kernel64_fn)(const dp_span64_t *span);
+
+/* 64-bit counterpart of the active kernel: the same instruction set where
+ * it has 64-bit compares (AVX2, AVX-512F), the scalar kernel otherwise.
+ */
+dp_kernel64_fn dp_active_kernel64(void);
+
+/* Pareto-frontier DP (sparse_dp.c). States live in struct-of-arrays slots.
+ * With parent != NULL every layer is kept (layer_start[i] is where layer i,
+ * the frontier over the first i items, begins; count + 1 entries) so that
+ * sparse_walk can recover the selection; without it only two layers are
+ * kept, in the two halves of the slots.
+ */
+typedef struct {
+  uint32_t *weight;
+  int *value;
+  uint32_t *parent;    /* index within the previous layer, or NULL */
+  size_t *layer_start; /* only with parent */
+  size_t slots;
+  size_t first;  /* first slot of the last layer built */
+  size_t best;   /* its last slot: the optimum once sparse_run is done */
+  size_t layers; /* items whose layers were built: count, unless cancelled */
+  size_t states; /* states the layers were built from, for knapsack_stats_t */
+} sparse_frontier_t;
+
+typedef enum {
+  SPARSE_DONE,
+  SPARSE_OVERFLOW, /* a candidate value exceeds INT_MAX, as the dense DP reports */
+  SPARSE_FULL,     /* the frontier outgrew the slots */
+  SPARSE_CANCELLED /* first, best and layers describe the last complete layer */
+} sparse_status_t;
+
+/* Upper bounds on the states of all layers together (total) and of the
+ * largest layer (widest), from the count, capacity and prefix weight sums:
+ * a layer at most doubles, and holds at most one state per reachable weight
+ * and per capacity cell. The bound is for the instance as preprocessing
+ * reduces it -- items heavier than capacity skipped, weights and capacity
+ * divided by scale -- without building it. Saturates at SIZE_MAX.
+ */
+void sparse_bound(const knapsack_item_t *items, size_t count, int capacity, int scale,
+                  size_t *total_out, size_t *widest_out);
+
+/* Build the frontiers of items (all weights must be within capacity),
+ * polling cancel between layers.
+ */
+sparse_status_t sparse_run(const knapsack_item_t *items, size_t count, int capacity,
+                           const cancel_t *cancel, sparse_frontier_t *frontier);
+
+/* Walk parents back from best over the first `count` layers: returns the
+ * number of items taken and, unless indices is NULL, writes them in
+ * ascending order.
+ */
+size_t sparse_walk(const sparse_frontier_t *frontier, size_t count, size_t *indices);
+
+/* Branch and bound (branch_bound.c) over a validated instance whose weights
+ * are all within capacity. The caller provides the arrays; all of them are
+ * written by bb_run.
+ */
+typedef struct {
+  int weight;
+  int value;
+  size_t index; /* position in the instance */
+} bb_item_t;
+
+typedef struct {
+  bb_item_t *order;         /* count entries: positive-value items by ratio */
+  long long *prefix_weight; /* count + 1 sums over order */
+  long long *prefix_value;  /* count + 1 */
+  unsigned char *path;      /* count: decisions along the current branch */
+  unsigned char *best;      /* count: decisions of the incumbent, by order */
+  size_t used;              /* items in order */
+  long long value;          /* incumbent, the optimum once bb_run is done */
+  long long weight;
+  long long root_bound;     /* U2 bound over all items */
+  size_t nodes;             /* nodes visited, for knapsack_stats_t */
+} bb_search_t;
+
+typedef enum {
+  BB_DONE,
+  BB_OVERFLOW, /* a selection worth more than INT_MAX fits, as the dense DP reports */
+  BB_CANCELLED /* the incumbent is the best selection found so far */
+} bb_status_t;
+
+/* Search for the (max value, min weight) optimum, polling cancel once per
+ * node.
+ */
+bb_status_t bb_run(const knapsack_item_t *items, size_t count, int capacity,
+                   const cancel_t *cancel, bb_search_t *search);
+
+/* Number of items the optimum takes and, unless indices is NULL, their
+ * instance positions in ascending order. Clobbers path.
+ */
+size_t bb_collect(bb_search_t *search, size_t count, size_t *indices);
+
+/* Cache-blocked dense DP (tiled_dp.c). Fills the zeroed rows and the
+ * decision rows exactly as the item-by-item sweep over the same items does,
+ * applying tiles of consecutive items whose weights add up to at most block
+ * cells to one block of the row at a time. The halo buffers hold 2 * block
+ * cells.
+ */
+typedef struct {
+  int *value;
+  uint32_t *weight;
+  uint64_t *take_bits; /* NULL: value only */
+  const size_t *row_word; /* trimmed rows of take_bits */
+  size_t width;
+  int *halo_value;
+  uint32_t *halo_weight;
+  size_t block;  /* capacity cells per block, 1 .. width */
+  size_t done;   /* items whose rows are complete: count, unless cancelled */
+  uint64_t cells; /* cells updated, for knapsack_stats_t */
+} tiled_dp_t;
+
+typedef enum {
+  TILED_DONE,
+  TILED_OVERFLOW, /* a candidate value exceeds INT_MAX, as the dense DP reports */
+  TILED_CANCELLED /* the rows hold the exact DP over the first done items */
+} tiled_status_t;
+
+/* An item and its position before tiled_sort. */
+typedef struct {
+  knapsack_item_t item;
+  size_t origin;
+} tiled_item_t;
+
+/* Sort items, and origin along with them, by weight, lightest first and
+ * stable among equal weights. scratch holds count entries.
+ */
+void tiled_sort(knapsack_item_t *items, size_t *origin, size_t count, tiled_item_t *scratch);
+
+/* Run the DP over items, polling cancel between tiles. */
+tiled_status_t tiled_run(const knapsack_item_t *items, size_t count, const cancel_t *cancel,
+                         tiled_dp_t *dp);
+
+/* K best selections (top_k.c). The dense DP runs with every row kept, over
+ * items that all fit within capacity, and a best-first search then pops
+ * complete selections from the table in rank order. The caller provides
+ * the arrays.
+ */
+typedef struct {
+  size_t parent;         /* node this one was expanded from */
+  size_t item;           /* item this step took, or SIZE_MAX */
+  size_t row;            /* items [0, row) are still undecided */
+  uint32_t cell;         /* capacity left for them */
+  uint32_t weight;       /* of the items decided so far */
+  int value;             /* likewise */
+  int bound_value;       /* best completion: value plus cell (row, cell) */
+  uint32_t bound_weight; /* its weight */
+} topk_node_t;
+
+typedef struct {
+  int *value;         /* (rows + 1) * width: row r, cell j at r * width + j */
+  uint32_t *weight;   /* (rows + 1) * width */
+  topk_node_t *nodes; /* slots, in creation order */
+  size_t *heap;       /* slots: queued node indices */
+  size_t slots;       /* 1 + 2 * k * rows suffice for k selections */
+  size_t width;
+  size_t rows;
+  size_t used;   /* nodes created */
+  size_t queued; /* nodes in the heap */
+  size_t cells;  /* cells the DP filled, for knapsack_stats_t */
+} topk_table_t;
+
+typedef enum {
+  TOPK_DONE,
+  TOPK_OVERFLOW, /* a selection worth more than INT_MAX fits, as the dense DP reports */
+  TOPK_CANCELLED
+} topk_status_t;
+
+/* Fill rows 0 .. rows of the table, polling cancel between rows. */
+topk_status_t topk_run(const knapsack_item_t *items, size_t rows, int capacity,
+                       const cancel_t *cancel, topk_table_t *table);
+
+/* Queue the root of the search over a filled table. */
+void topk_start(topk_table_t *table, size_t rows, int capacity);
+
+/* Pop the next selection in rank order into *leaf; false when there are no
+ * more.
+ */
+bool topk_next(topk_table_t *table, const knapsack_item_t *items, size_t *leaf);
+
+/* Number of items the selection ending at leaf takes and, unless indices is
+ * NULL, their origin[] positions in ascending order.
+ */
+size_t topk_collect(const topk_table_t *table, size_t leaf, const size_t *origin,
+                    size_t *indices);
+
+/* Multi-dimensional DP (multi_dim.c). The table is flattened over the
+ * capacity vectors, dimension 0 most significant, so a cell's index is the
+ * weight vector it stands for and a selection's weights pack into a single
+ * key: the index of its weight vector. Keys compare like weight vectors
+ * (dimension 0 first) and add without carries while they stay within the
+ * capacities, so an item's update is the 1D kernel's over each contiguous
+ * run of the last dimension, with the item's key as its weight.
+ */
+typedef struct {
+  int *value;          /* cells */
+  uint32_t *key;       /* cells: weights of the cell's best selection */
+  uint64_t *take_bits; /* rows * row_bits, or NULL */
+  size_t extent[KNAPSACK_MAX_DIMENSIONS]; /* capacity + 1 */
+  size_t stride[KNAPSACK_MAX_DIMENSIONS]; /* cells per step in the dimension */
+  size_t dims;
+  size_t cells;
+  size_t row_bits;
+  size_t block;       /* dimension-0 coordinates per block; 0: no blocking */
+  int *halo_value;    /* 2 * block * stride[0] cells, when blocking */
+  uint32_t *halo_key; /* likewise */
+  size_t filled;      /* cells updated, for knapsack_stats_t */
+} multi_table_t;
+
+typedef enum {
+  MULTI_DONE,
+  MULTI_OVERFLOW, /* a selection worth more than INT_MAX fits, as the dense DP reports */
+  MULTI_CANCELLED
+} multi_status_t;
+
+/* Set dims, extent, stride, cells and row_bits for the capacities; false
+ * when the table would exceed KNAPSACK_MAX_MULTI_CELLS.
+ */
+bool multi_shape(multi_table_t *table, size_t dims, const int *capacities);
+
+/* Set block for blocks of about tile_cells cells: whole dimension-0
+ * coordinates, or 0 when one block would hold the whole table (or less than
+ * one coordinate of it) or there is only one dimension.
+ */
+void multi_tile(multi_table_t *table, size_t tile_cells);
+
+/* Write the positions of the items the DP needs to kept, lightest first in
+ * dimension 0 and equal weights in order, and return how many there are:
+ * items that fit, are worth something and are not pruned by dominance (see
+ * knapsack_solve_multi).
+ */
+size_t multi_prune(const knapsack_multi_item_t *items, size_t count, const multi_table_t *table,
+                   size_t *kept);
+
+/* Fill the zeroed table with the kept items, polling cancel between tiles.
+ * With a block, consecutive items whose dimension-0 weights add up to at
+ * most block form a tile, and all of a tile's items update one block of the
+ * table before the next: the halos carry what each item reads from the
+ * block below.
+ */
+multi_status_t multi_run(const knapsack_multi_item_t *items, const size_t *kept, size_t rows,
+                         const cancel_t *cancel, multi_table_t *table);
+
+/* Best cell of a filled table: maximal value, then minimal key. */
+size_t multi_best(const multi_table_t *table);
+
+/* Number of kept items the selection of cell takes and, unless indices is
+ * NULL, their positions in ascending order. Needs take_bits.
+ */
+size_t multi_collect(const multi_table_t *table, const knapsack_multi_item_t *items,
+                     const size_t *kept, size_t rows, size_t cell, size_t *indices);
+
+/* Weight of a key in one dimension. */
+int multi_weight(const multi_table_t *table, uint32_t key, size_t dim);
+
+/* GPU batch backend (gpu_batch.cu, built with ENABLE_GPU). The caller picks
+ * the instances the dense engine would solve and has validated them;
+ * gpu_solve_batch runs picked[0 .. picked_count) on the device and, for
+ * each one it finishes, fills results[i] and statuses[i] exactly as the CPU
+ * would and sets solved[i]. Anything else -- an overflow, a device error,
+ * the instances left when cancel asks to stop between chunks -- is left
+ * for the CPU. Without ENABLE_GPU there is never a device.
+ */
+bool gpu_device_present(void);
+void gpu_solve_batch(const knapsack_instance_t *instances, const size_t *picked,
+                     size_t picked_count, bool value_only, const knapsack_allocator_t *alloc,
+                     const cancel_t *cancel, knapsack_result_t *results,
+                     knapsack_status_t *statuses, bool *solved);
+
+/* Worker pool (thread_pool.c). pool_run executes task once on each of the
+ * first `workers` pool threads (worker 0 is the calling thread) and returns
+ * when all of them have finished. Inside a task, pool_barrier_wait blocks
+ * until all `workers` participants of the current run have reached it.
+ */
+typedef void (*pool_task_fn)(void *ctx, size_t worker, size_t workers);
+
+void pool_run(knapsack_thread_pool_t *pool, size_t workers, pool_task_fn task, void *ctx);
+void pool_barrier_wait(knapsack_thread_pool_t *pool);
+
+/* Reusable arena behind the public knapsack_workspace_t handle (knapsack.c).
+ * The workers of knapsack_solve_batch and of the executor each keep one
+ * by value, as a worker_arena_t, for as long as they run: it starts empty,
+ * grows to the largest instance the worker has solved and is released when
+ * the worker is done. worker_arena_solve runs one instance as
+ * knapsack_solve_opts would, on pool (NULL: serially) and writing stats
+ * (NULL: none) in place of the options' own.
+ */
+struct knapsack_workspace {
+  const knapsack_allocator_t *alloc;
+  void *block;          /* as returned by calloc_fn; NULL when empty */
+  unsigned char *arena; /* block rounded up to KNAPSACK_ARENA_ALIGN */
+  size_t arena_size;    /* usable bytes from arena onwards */
+  bool arena_zeroed;    /* arena untouched since calloc_fn */
+};
+
+typedef struct knapsack_workspace worker_arena_t;
+
+void worker_arena_init(worker_arena_t *arena, const knapsack_allocator_t *alloc);
+knapsack_status_t worker_arena_solve(worker_arena_t *arena, const knapsack_item_t *items,
+                                     size_t count, int capacity, const knapsack_options_t *options,
+                                     knapsack_thread_pool_t *pool, knapsack_stats_t *stats,
+                                     knapsack_result_t *out_result);
+void worker_arena_release(worker_arena_t *arena);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* KNAPSACK_INTERNAL_H */
@@ -3,26 +3,50 @@
 #include "cli/cli_internal.h"
 #include "knapsack/knapsack.h"
 
+#include <errno.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+typedef enum { INPUT_TEXT, INPUT_BIN } input_format_t;
+typedef enum { OUTPUT_TEXT, OUTPUT_JSON, OUTPUT_BIN } output_format_t;
+
 static void print_usage(FILE *stream, const char *prog) {
   fprintf(stream,
-          "Usage: %s [--json] <input_file>\n"
+          "Usage: %s [--json] [--value-only] [--stats] [--input-format=F] [--output-format=F]\n"
+          "       %*s <input_file>\n"
+          "       %s --stream [--threads=N] [--value-only] [--output-format=F]\n"
+          "       %*s [input_file]\n"
           "       %s --help | -h\n"
           "       %s --version\n"
           "\n"
           "Options:\n"
-          "  --json       Emit machine-readable JSON output.\n"
-          "  -h, --help   Show this help message and exit.\n"
-          "  --version    Print version and exit.\n"
+          "  --json               Emit machine-readable JSON output\n"
+          "                       (same as --output-format=json).\n"
+          "  --value-only         Report the optimal value and total weight only;\n"
+          "                       skips the selected indices and uses O(capacity)\n"
+          "                       memory.\n"
+          "  --stats              With JSON output, add a \"stats\" object: engine,\n"
+          "                       kernel, cells, buffer bytes and phase timings.\n"
+          "  --input-format=F     text (default) or bin (binary columnar instance).\n"
+          "  --output-format=F    text (default), json or bin (binary result record,\n"
+          "                       written for errors too).\n"
+          "  --stream             Solve every record of the input (default: standard\n"
+          "                       input) and write one JSON line per record, or one\n"
+          "                       binary result record with --output-format=bin.\n"
+          "                       Failed records get an error result in place.\n"
+          "  --threads=N          With --stream, solve up to %d buffered records at\n"
+          "                       once on N threads (0 = one per CPU).\n"
+          "  -h, --help           Show this help message and exit.\n"
+          "  --version            Print version and exit.\n"
           "\n"
-          "Input file format:\n"
+          "Input file format (\"-\" reads standard input):\n"
           "  line 1: capacity (integer >= 0)\n"
-          "  line 2: whitespace/comma-separated weight:value pairs\n",
-          prog, prog, prog);
+          "  line 2: whitespace/comma-separated weight:value pairs\n"
+          "  (with --stream, any number of such line pairs)\n",
+          prog, (int)strlen(prog), "", prog, (int)strlen(prog), "", prog, prog,
+          KNAPSACK_CLI_STREAM_BATCH);
 }
 
 static void print_version(void) {
@@ -30,21 +54,101 @@ static void print_version(void) {
          KNAPSACK_VERSION_PATCH);
 }
 
-static void emit_error(bool json_mode, const char *message, knapsack_status_t status) {
-  if (json_mode) {
+static void emit_error(output_format_t output, const char *message, knapsack_status_t status) {
+  switch (output) {
+  case OUTPUT_JSON:
     cli_print_error_json(stdout, message, status);
-  } else {
+    break;
+  case OUTPUT_BIN:
+    (void)cli_print_result_binary(stdout, status, NULL);
     cli_print_error_text(stderr, message);
+    break;
+  case OUTPUT_TEXT:
+    cli_print_error_text(stderr, message);
+    break;
+  }
+}
+
+/* "--name=value" -> value, or NULL if arg is not that option. */
+static const char *option_value(const char *arg, const char *name) {
+  const size_t length = strlen(name);
+  if (strncmp(arg, name, length) != 0 || arg[length] != '=') {
+    return NULL;
+  }
+  return arg + length + 1U;
+}
+
+/* Parse a --threads value: a decimal count, 0 meaning one per CPU. */
+static bool parse_threads(const char *text, size_t *threads) {
+  char *end = NULL;
+  errno = 0;
+  const long parsed = strtol(text, &end, 10);
+  if (end == text || *end != '\0' || errno != 0 || parsed < 0 || parsed > 4096) {
+    return false;
+  }
+  *threads = (size_t)parsed;
+  return true;
+}
+
+static int run_stream(const char *path, output_format_t output, bool value_only,
+                      bool use_pool, size_t threads) {
+  cli_stream_t input;
+  if (cli_stream_open(path, &input) != 0) {
+    perror("Failed to open input file");
+    return EXIT_FAILURE;
+  }
+  cli_stream_config_t config = {
+      .value_only = value_only,
+      .binary = output == OUTPUT_BIN,
+      .pool = NULL,
+  };
+  if (use_pool && threads != 1U) {
+    config.pool = knapsack_thread_pool_create(threads, NULL);
+    if (!config.pool) {
+      cli_print_error_text(stderr, "Failed to start the thread pool");
+      cli_stream_close(&input);
+      return EXIT_FAILURE;
+    }
+  }
+  const int rc = cli_stream_run(&input, &config);
+  if (rc != 0) {
+    perror("Stream failed");
+  }
+  knapsack_thread_pool_destroy(config.pool);
+  cli_stream_close(&input);
+  return rc == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static int parse_text(const cli_input_t *input, output_format_t output, int *capacity,
+                      knapsack_item_t **items, size_t *count) {
+  /* Both lines are parsed straight out of the mapped (or read) input. */
+  const char *cursor = input->data;
+  const char *end = input->data + input->length;
+  if (cli_parse_capacity_line(&cursor, end, capacity) != 0) {
+    emit_error(output, "Failed to parse capacity", KNAPSACK_ERR_INVALID_CAPACITY);
+    return -1;
+  }
+  if (cli_parse_items_line(&cursor, end, items, count) != 0) {
+    emit_error(output, "Failed to parse items", KNAPSACK_ERR_INVALID_ITEMS);
+    return -1;
   }
+  return 0;
 }
 
 int main(int argc, char **argv) {
-  bool json_mode = false;
+  output_format_t output = OUTPUT_TEXT;
+  input_format_t input_format = INPUT_TEXT;
+  bool value_only = false;
+  bool want_stats = false;
+  bool stream = false;
+  bool use_pool = false;
+  size_t threads = 0U;
   const char *path = NULL;
   const char *prog = (argc > 0 && argv[0]) ? argv[0] : "knapsack_demo";
 
   for (int i = 1; i < argc; ++i) {
     const char *arg = argv[i];
+    const char *value = NULL;
     if (strcmp(arg, "--help") == 0 || strcmp(arg, "-h") == 0) {
       print_usage(stdout, prog);
       return EXIT_SUCCESS;
@@ -54,7 +158,54 @@ int main(int argc, char **argv) {
       return EXIT_SUCCESS;
     }
     if (strcmp(arg, "--json") == 0) {
-      json_mode = true;
+      output = OUTPUT_JSON;
+      continue;
+    }
+    if (strcmp(arg, "--value-only") == 0) {
+      value_only = true;
+      continue;
+    }
+    if (strcmp(arg, "--stats") == 0) {
+      want_stats = true;
+      continue;
+    }
+    if (strcmp(arg, "--stream") == 0) {
+      stream = true;
+      continue;
+    }
+    if ((value = option_value(arg, "--threads")) != NULL) {
+      if (!parse_threads(value, &threads)) {
+        fprintf(stderr, "Invalid thread count: %s\n", value);
+        print_usage(stderr, prog);
+        return EXIT_FAILURE;
+      }
+      use_pool = true;
+      continue;
+    }
+    if ((value = option_value(arg, "--input-format")) != NULL) {
+      if (strcmp(value, "text") == 0) {
+        input_format = INPUT_TEXT;
+      } else if (strcmp(value, "bin") == 0) {
+        input_format = INPUT_BIN;
+      } else {
+        fprintf(stderr, "Unknown input format: %s\n", value);
+        print_usage(stderr, prog);
+        return EXIT_FAILURE;
+      }
+      continue;
+    }
+    if ((value = option_value(arg, "--output-format")) != NULL) {
+      if (strcmp(value, "text") == 0) {
+        output = OUTPUT_TEXT;
+      } else if (strcmp(value, "json") == 0) {
+        output = OUTPUT_JSON;
+      } else if (strcmp(value, "bin") == 0) {
+        output = OUTPUT_BIN;
+      } else {
+        fprintf(stderr, "Unknown output format: %s\n", value);
+        print_usage(stderr, prog);
+        return EXIT_FAILURE;
+      }
       continue;
     }
     if (arg[0] == '-' && arg[1] != '\0') {
@@ -70,52 +221,91 @@ int main(int argc, char **argv) {
     path = arg;
   }
 
+  if (want_stats && (stream || output != OUTPUT_JSON)) {
+    fprintf(stderr, "--stats requires --json and a single instance\n");
+    print_usage(stderr, prog);
+    return EXIT_FAILURE;
+  }
+  if (stream) {
+    if (input_format != INPUT_TEXT) {
+      fprintf(stderr, "--stream reads text records only\n");
+      return EXIT_FAILURE;
+    }
+    return run_stream(path ? path : "-", output, value_only, use_pool, threads);
+  }
+  if (use_pool) {
+    fprintf(stderr, "--threads requires --stream\n");
+    print_usage(stderr, prog);
+    return EXIT_FAILURE;
+  }
   if (!path) {
     print_usage(stderr, prog);
     return EXIT_FAILURE;
   }
 
-  FILE *file = fopen(path, "r");
-  if (!file) {
-    if (json_mode) {
-      cli_print_error_json(stdout, "Failed to open input file", KNAPSACK_ERR_INVALID_ITEMS);
-    } else {
+  cli_input_t input;
+  if (cli_input_open(path, &input) != 0) {
+    if (output == OUTPUT_TEXT) {
       perror("Failed to open input file");
+    } else {
+      emit_error(output, "Failed to open input file", KNAPSACK_ERR_INVALID_ITEMS);
     }
     return EXIT_FAILURE;
   }
 
   int capacity = 0;
-  if (cli_parse_capacity(file, &capacity) != 0) {
-    emit_error(json_mode, "Failed to parse capacity", KNAPSACK_ERR_INVALID_CAPACITY);
-    fclose(file);
-    return EXIT_FAILURE;
-  }
-
   knapsack_item_t *items = NULL;
   size_t count = 0;
-  if (cli_parse_items(file, &items, &count) != 0) {
-    emit_error(json_mode, "Failed to parse items", KNAPSACK_ERR_INVALID_ITEMS);
-    fclose(file);
+  int parsed = 0;
+  if (input_format == INPUT_BIN) {
+    parsed = cli_parse_binary(input.data, input.length, &capacity, &items, &count);
+    if (parsed != 0) {
+      emit_error(output, "Failed to parse binary input", KNAPSACK_ERR_INVALID_FORMAT);
+    }
+  } else {
+    parsed = parse_text(&input, output, &capacity, &items, &count);
+  }
+  cli_input_close(&input);
+  if (parsed != 0) {
     return EXIT_FAILURE;
   }
-  fclose(file);
 
+  knapsack_options_t options;
+  knapsack_options_init(&options);
+  if (value_only) {
+    options.reconstruct = KNAPSACK_RECONSTRUCT_NONE;
+  }
+  knapsack_stats_t stats;
+  if (want_stats) {
+    options.stats = &stats;
+  }
   knapsack_result_t result;
-  const knapsack_status_t status = knapsack_solve_status(items, count, capacity, &result);
+  const knapsack_status_t status = knapsack_solve_opts(items, count, capacity, &options, &result);
   if (status != KNAPSACK_OK) {
-    emit_error(json_mode, "Knapsack solve failed", status);
+    emit_error(output, "Knapsack solve failed", status);
     free(items);
     return EXIT_FAILURE;
   }
 
-  if (json_mode) {
-    cli_print_result_json(&result);
+  int rc = EXIT_SUCCESS;
+  if (output == OUTPUT_BIN) {
+    if (cli_print_result_binary(stdout, status, &result) != 0) {
+      cli_print_error_text(stderr, "Failed to write binary result");
+      rc = EXIT_FAILURE;
+    }
+  } else if (value_only) {
+    if (output == OUTPUT_JSON) {
+      cli_print_value_json(&result, options.stats);
+    } else {
+      cli_print_value_text(&result);
+    }
+  } else if (output == OUTPUT_JSON) {
+    cli_print_result_json(&result, options.stats);
   } else {
     cli_print_result_text(&result);
   }
 
   knapsack_result_free(&result);
   free(items);
-  return EXIT_SUCCESS;
+  return rc;
 }
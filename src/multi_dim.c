@@ -0,0 +1,334 @@
+/* Multi-dimensional 0/1 DP over a flattened capacity table.
+ *
+ * Cell c of the table is the best (value, then key) selection whose weight
+ * vector fits within the capacity vector c. Indices are row-major over the
+ * dimensions, so taking an item moves a cell down by the item's key (the
+ * index of its weight vector), and the cells that can take it are, for
+ * every prefix of coordinates that covers the item, one contiguous run of
+ * the last dimension. Runs are visited from the highest index down, which
+ * keeps the update in place exactly as in the 1D reverse sweep: every cell
+ * a run reads lies below it and still holds the previous row.
+ *
+ * Once the table outgrows a block (knapsack_tile_cells(), or the caller's
+ * tile_cells), the items go in tiles as in tiled_dp.c, only in whole
+ * coordinates of dimension 0: items are taken lightest first in dimension
+ * 0, consecutive ones whose dimension-0 weights add up to at most the block
+ * height share a tile, and the tile's items all update one block of
+ * coordinates, low to high, before the next. An item's runs whose
+ * candidates lie in the block below read them from a halo, saved from the
+ * top of that block just before the item updated it.
+ *
+ * A selection's key is the index of its weight vector, so the 1D kernel's
+ * "lower weight wins a value tie" compares weight vectors dimension by
+ * dimension, and cell (value, key) pairs are the tie-break the API
+ * documents.
+ */
+#include "knapsack_internal.h"
+
+#include "knapsack/knapsack.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+bool multi_shape(multi_table_t *t, size_t dims, const int *capacities) {
+  t->dims = dims;
+  t->cells = 1U;
+  for (size_t d = dims; d-- > 0;) {
+    t->stride[d] = t->cells;
+    t->extent[d] = (size_t)capacities[d] + 1U;
+    if (t->extent[d] > KNAPSACK_MAX_MULTI_CELLS / t->cells) {
+      return false;
+    }
+    t->cells *= t->extent[d];
+  }
+  t->row_bits = (t->cells + KNAPSACK_BITSET_WORD_BITS - 1U) / KNAPSACK_BITSET_WORD_BITS *
+                KNAPSACK_BITSET_WORD_BITS;
+  return true;
+}
+
+static size_t item_key(const multi_table_t *t, const knapsack_multi_item_t *item) {
+  size_t key = 0U;
+  for (size_t d = 0; d < t->dims; ++d) {
+    key += (size_t)item->weights[d] * t->stride[d];
+  }
+  return key;
+}
+
+static bool item_fits(const multi_table_t *t, const knapsack_multi_item_t *item) {
+  for (size_t d = 0; d < t->dims; ++d) {
+    if ((size_t)item->weights[d] >= t->extent[d]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/* Whether item b (at position ib) dominates item a (at ia): worth at least
+ * as much, no heavier anywhere, and strictly better somewhere -- or else
+ * earlier, so that of two equal items only the later one can be dropped.
+ */
+/* NOLINTBEGIN(bugprone-easily-swappable-parameters) -- internal helper, params are documented. */
+static bool dominates(const multi_table_t *t, const knapsack_multi_item_t *b, size_t ib,
+                      const knapsack_multi_item_t *a, size_t ia) {
+  if (b->value < a->value) {
+    return false;
+  }
+  bool strict = b->value > a->value || ib < ia;
+  for (size_t d = 0; d < t->dims; ++d) {
+    if (b->weights[d] > a->weights[d]) {
+      return false;
+    }
+    strict = strict || b->weights[d] < a->weights[d];
+  }
+  return strict;
+}
+/* NOLINTEND(bugprone-easily-swappable-parameters) */
+
+size_t multi_prune(const knapsack_multi_item_t *items, size_t count, const multi_table_t *t,
+                   size_t *kept) {
+  size_t rows = 0U;
+  for (size_t a = 0; a < count; ++a) {
+    /* A worthless item only adds weight: no optimum takes it. */
+    if (items[a].value == 0 || !item_fits(t, &items[a])) {
+      continue;
+    }
+    /* An optimum that takes a takes every item dominating it too (or it
+     * could swap a for a missing one and lose nothing), so a goes when
+     * they cannot all fit. The dominance order is transitive and acyclic,
+     * which makes dropping every such item at once safe.
+     */
+    long long load[KNAPSACK_MAX_DIMENSIONS] = {0};
+    for (size_t d = 0; d < t->dims; ++d) {
+      load[d] = items[a].weights[d];
+    }
+    bool fits = true;
+    for (size_t b = 0; b < count && fits; ++b) {
+      if (b == a || !dominates(t, &items[b], b, &items[a], a)) {
+        continue;
+      }
+      for (size_t d = 0; d < t->dims; ++d) {
+        load[d] += items[b].weights[d];
+        fits = fits && load[d] < (long long)t->extent[d];
+      }
+    }
+    if (fits) {
+      /* Lightest first in dimension 0, equal weights in order. */
+      size_t at = rows++;
+      while (at > 0U && items[kept[at - 1U]].weights[0] > items[a].weights[0]) {
+        kept[at] = kept[at - 1U];
+        --at;
+      }
+      kept[at] = a;
+    }
+  }
+  return rows;
+}
+
+void multi_tile(multi_table_t *t, size_t tile_cells) {
+  const size_t planes = tile_cells / t->stride[0];
+  t->block = t->dims > 1U && planes < t->extent[0] ? planes : 0U;
+}
+
+/* Apply item row r to the cells whose dimension-0 coordinate lies in
+ * [lo, hi). Runs whose candidates lie below lo read them from the halo,
+ * which holds dimension-0 coordinates [lo - w_0, lo) as the previous item
+ * left them; with lo == 0 there are none.
+ */
+/* NOLINTBEGIN(bugprone-easily-swappable-parameters) -- internal helper, params are documented. */
+static bool sweep_item(multi_table_t *t, dp_kernel_fn kernel, const knapsack_multi_item_t *item,
+                       size_t r, size_t lo, size_t hi, const int *halo_value,
+                       const uint32_t *halo_key) {
+  const size_t last = t->dims - 1U;
+  const size_t key = item_key(t, item);
+  const size_t low = (size_t)item->weights[last];
+  const size_t n = t->extent[last] - low;
+  const size_t w0 = (size_t)item->weights[0];
+  /* Coordinates of the leading dimensions, from the top of their range
+   * down to its bottom; base is the index of the run's cell 0.
+   */
+  size_t top[KNAPSACK_MAX_DIMENSIONS];
+  size_t bottom[KNAPSACK_MAX_DIMENSIONS];
+  size_t at[KNAPSACK_MAX_DIMENSIONS];
+  size_t base = 0U;
+  for (size_t d = 0; d < last; ++d) {
+    top[d] = t->extent[d] - 1U;
+    bottom[d] = (size_t)item->weights[d];
+  }
+  if (last > 0U) {
+    top[0] = hi - 1U;
+    bottom[0] = lo > w0 ? lo : w0;
+    if (bottom[0] >= hi) {
+      return true;
+    }
+  }
+  for (size_t d = 0; d < last; ++d) {
+    at[d] = top[d];
+    base += at[d] * t->stride[d];
+  }
+  for (;;) {
+    const size_t start = base + low;
+    const int *take_value = t->value + start - key;
+    const uint32_t *take_key = t->key + start - key;
+    if (last > 0U && at[0] < lo + w0) {
+      const size_t offset = start - key - (lo - w0) * t->stride[0];
+      take_value = halo_value + offset;
+      take_key = halo_key + offset;
+    }
+    const dp_span_t span = {
+        .out_value = t->value + start,
+        .out_weight = t->key + start,
+        .keep_value = t->value + start,
+        .keep_weight = t->key + start,
+        .take_value = take_value,
+        .take_weight = take_key,
+        .n = n,
+        .item_value = item->value,
+        .item_weight = (uint32_t)key,
+        .bits = t->take_bits,
+        .bit_offset = t->take_bits ? r * t->row_bits + start : 0U,
+    };
+    if (!kernel(&span)) {
+      return false;
+    }
+    t->filled += n;
+    /* Previous prefix: the lowest dimension still above its bottom steps
+     * down, the ones after it wrap to the top.
+     */
+    size_t d = last;
+    while (d > 0U && at[d - 1U] == bottom[d - 1U]) {
+      --d;
+      at[d] = top[d];
+      base += (top[d] - bottom[d]) * t->stride[d];
+    }
+    if (d == 0U) {
+      return true;
+    }
+    --at[d - 1U];
+    base -= t->stride[d - 1U];
+  }
+}
+/* NOLINTEND(bugprone-easily-swappable-parameters) */
+
+/* Rows [first, end), whose dimension-0 weights add up to at most
+ * t->block, block by block.
+ */
+static bool run_tile(multi_table_t *t, dp_kernel_fn kernel, const knapsack_multi_item_t *items,
+                     const size_t *kept, size_t first, size_t end) {
+  const size_t extent = t->extent[0];
+  const size_t plane = t->stride[0];
+  const size_t halo_cells = t->block * plane;
+  int *read_value = t->halo_value;
+  uint32_t *read_key = t->halo_key;
+  int *write_value = t->halo_value + halo_cells;
+  uint32_t *write_key = t->halo_key + halo_cells;
+  for (size_t lo = 0; lo < extent; lo += t->block) {
+    const size_t hi = lo + t->block < extent ? lo + t->block : extent;
+    size_t halo = 0U;
+    for (size_t r = first; r < end; ++r) {
+      const knapsack_multi_item_t *item = &items[kept[r]];
+      const size_t w0 = (size_t)item->weights[0];
+      if (hi < extent) {
+        memcpy(write_value + halo * plane, t->value + (hi - w0) * plane,
+               w0 * plane * sizeof(int));
+        memcpy(write_key + halo * plane, t->key + (hi - w0) * plane,
+               w0 * plane * sizeof(uint32_t));
+      }
+      if (!sweep_item(t, kernel, item, r, lo, hi, read_value + halo * plane,
+                      read_key + halo * plane)) {
+        return false;
+      }
+      halo += w0;
+    }
+    int *const value_swap = read_value;
+    uint32_t *const key_swap = read_key;
+    read_value = write_value;
+    read_key = write_key;
+    write_value = value_swap;
+    write_key = key_swap;
+  }
+  return true;
+}
+
+multi_status_t multi_run(const knapsack_multi_item_t *items, const size_t *kept, size_t rows,
+                         const cancel_t *cancel, multi_table_t *t) {
+  const dp_kernel_fn kernel = dp_active_kernel();
+  size_t credit = 0U;
+  t->filled = 0U;
+  size_t first = 0U;
+  while (first < rows) {
+    /* Rows are lightest first in dimension 0, so light items share tiles. */
+    size_t end = first + 1U;
+    size_t height = (size_t)items[kept[first]].weights[0];
+    while (t->block != 0U && end < rows &&
+           height + (size_t)items[kept[end]].weights[0] <= t->block) {
+      height += (size_t)items[kept[end]].weights[0];
+      ++end;
+    }
+    const size_t before = t->filled;
+    if (end - first == 1U) {
+      /* Alone in its tile: every run of the table, top down. */
+      if (!sweep_item(t, kernel, &items[kept[first]], first, 0U, t->extent[0], NULL, NULL)) {
+        return MULTI_OVERFLOW;
+      }
+    } else if (!run_tile(t, kernel, items, kept, first, end)) {
+      return MULTI_OVERFLOW;
+    }
+    first = end;
+    if (first < rows && cancel_poll(cancel, &credit, t->filled - before)) {
+      return MULTI_CANCELLED;
+    }
+  }
+  return MULTI_DONE;
+}
+
+size_t multi_best(const multi_table_t *t) {
+  size_t best = 0U;
+  for (size_t cell = 1U; cell < t->cells; ++cell) {
+    if (t->value[cell] > t->value[best] ||
+        (t->value[cell] == t->value[best] && t->key[cell] < t->key[best])) {
+      best = cell;
+    }
+  }
+  return best;
+}
+
+static bool taken(const multi_table_t *t, size_t row, size_t cell) {
+  const size_t bit = row * t->row_bits + cell;
+  return (t->take_bits[bit / KNAPSACK_BITSET_WORD_BITS] >> (bit % KNAPSACK_BITSET_WORD_BITS)) & 1U;
+}
+
+size_t multi_collect(const multi_table_t *t, const knapsack_multi_item_t *items,
+                     const size_t *kept, size_t rows, size_t cell, size_t *indices) {
+  size_t selected = 0U;
+  size_t at = cell;
+  for (size_t r = rows; r-- > 0;) {
+    if (taken(t, r, at)) {
+      ++selected;
+      at -= item_key(t, &items[kept[r]]);
+    }
+  }
+  if (!indices) {
+    return selected;
+  }
+  /* Rows are in weight order, not position order: insert each one. */
+  size_t write = 0U;
+  at = cell;
+  for (size_t r = rows; r-- > 0;) {
+    if (taken(t, r, at)) {
+      size_t slot = write++;
+      while (slot > 0U && indices[slot - 1U] > kept[r]) {
+        indices[slot] = indices[slot - 1U];
+        --slot;
+      }
+      indices[slot] = kept[r];
+      at -= item_key(t, &items[kept[r]]);
+    }
+  }
+  return selected;
+}
+
+int multi_weight(const multi_table_t *t, uint32_t key, size_t dim) {
+  return (int)((key / t->stride[dim]) % t->extent[dim]);
+}
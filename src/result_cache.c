@@ -0,0 +1,298 @@
+/* LRU cache of solve results behind knapsack_cache_t.
+ *
+ * Entries live in a chained hash table (a power-of-two bucket count of at
+ * least max_entries, so chains stay short) and on a doubly linked recency
+ * list, most recently used first. Each entry is one allocation: the header,
+ * then the selected indices, then the instance's items, which a lookup
+ * compares in full before calling it a hit.
+ *
+ * The mutex only guards the table, the list and the counters. A miss drops
+ * it while the solver runs and takes it again to insert, re-checking for an
+ * entry another thread may have inserted meanwhile.
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include "knapsack_internal.h"
+
+#include "knapsack/knapsack.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+typedef struct cache_entry {
+  struct cache_entry *chain; /* next in the bucket */
+  struct cache_entry *newer; /* recency list neighbours */
+  struct cache_entry *older;
+  uint64_t hash;
+  size_t count;
+  int capacity;
+  int optimal_value;
+  int total_weight;
+  int upper_bound;
+  size_t selected_count;
+  size_t *selected_indices; /* inside the entry's block */
+  knapsack_item_t *items;   /* likewise */
+} cache_entry_t;
+
+struct knapsack_cache {
+  const knapsack_allocator_t *alloc;
+  pthread_mutex_t lock;
+  cache_entry_t **buckets;
+  size_t bucket_mask;
+  size_t max_entries;
+  size_t entries;
+  cache_entry_t *newest;
+  cache_entry_t *oldest;
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t evictions;
+};
+
+/* One multiply-xorshift round per item over its (weight, value) pair. */
+static uint64_t hash_instance(const knapsack_item_t *items, size_t count, int capacity) {
+  uint64_t h =
+      UINT64_C(0x9E3779B97F4A7C15) ^ (uint64_t)(uint32_t)capacity ^ ((uint64_t)count << 32U);
+  for (size_t i = 0; i < count; ++i) {
+    const uint64_t pair = ((uint64_t)(uint32_t)items[i].weight << 32U) | (uint32_t)items[i].value;
+    h = (h ^ pair) * UINT64_C(0xFF51AFD7ED558CCD);
+    h ^= h >> 32U;
+  }
+  return h;
+}
+
+knapsack_cache_t *knapsack_cache_create(size_t max_entries, const knapsack_allocator_t *allocator) {
+  if (max_entries == 0U || max_entries > SIZE_MAX / 2U / sizeof(cache_entry_t *)) {
+    return NULL;
+  }
+  const knapsack_allocator_t *alloc = resolve_allocator(allocator);
+  size_t buckets = 1U;
+  while (buckets < max_entries) {
+    buckets *= 2U;
+  }
+  knapsack_cache_t *cache = alloc->alloc_fn(sizeof(*cache), alloc->user_data);
+  if (!cache) {
+    return NULL;
+  }
+  cache_entry_t **table = alloc->calloc_fn(buckets, sizeof(*table), alloc->user_data);
+  if (!table) {
+    alloc->free_fn(cache, alloc->user_data);
+    return NULL;
+  }
+  *cache = (knapsack_cache_t){
+      .alloc = alloc,
+      .buckets = table,
+      .bucket_mask = buckets - 1U,
+      .max_entries = max_entries,
+      .entries = 0U,
+      .newest = NULL,
+      .oldest = NULL,
+      .hits = 0U,
+      .misses = 0U,
+      .evictions = 0U,
+  };
+  pthread_mutex_init(&cache->lock, NULL);
+  return cache;
+}
+
+/* Caller holds the lock. */
+static cache_entry_t *find_entry(const knapsack_cache_t *cache, uint64_t hash,
+                                 const knapsack_item_t *items, size_t count, int capacity) {
+  for (cache_entry_t *e = cache->buckets[hash & cache->bucket_mask]; e; e = e->chain) {
+    if (e->hash == hash && e->count == count && e->capacity == capacity &&
+        memcmp(e->items, items, count * sizeof(knapsack_item_t)) == 0) {
+      return e;
+    }
+  }
+  return NULL;
+}
+
+static void unlink_recency(knapsack_cache_t *cache, cache_entry_t *e) {
+  if (e->newer) {
+    e->newer->older = e->older;
+  } else {
+    cache->newest = e->older;
+  }
+  if (e->older) {
+    e->older->newer = e->newer;
+  } else {
+    cache->oldest = e->newer;
+  }
+}
+
+static void push_newest(knapsack_cache_t *cache, cache_entry_t *e) {
+  e->newer = NULL;
+  e->older = cache->newest;
+  if (cache->newest) {
+    cache->newest->newer = e;
+  } else {
+    cache->oldest = e;
+  }
+  cache->newest = e;
+}
+
+static void remove_entry(knapsack_cache_t *cache, cache_entry_t *e) {
+  cache_entry_t **link = &cache->buckets[e->hash & cache->bucket_mask];
+  while (*link != e) {
+    link = &(*link)->chain;
+  }
+  *link = e->chain;
+  unlink_recency(cache, e);
+  --cache->entries;
+  cache->alloc->free_fn(e, cache->alloc->user_data);
+}
+
+/* Copy a cached result out with the caller's allocator. */
+static knapsack_status_t copy_result(const cache_entry_t *e, const knapsack_allocator_t *alloc,
+                                     knapsack_result_t *out_result) {
+  *out_result = (knapsack_result_t){
+      .optimal_value = e->optimal_value,
+      .total_weight = e->total_weight,
+      .upper_bound = e->upper_bound,
+      .selected_count = 0U,
+      .selected_indices = NULL,
+  };
+  if (e->selected_count == 0U) {
+    return KNAPSACK_OK;
+  }
+  size_t *indices = alloc->alloc_fn(e->selected_count * sizeof(size_t), alloc->user_data);
+  if (!indices) {
+    *out_result = (knapsack_result_t){0};
+    return KNAPSACK_ERR_ALLOC;
+  }
+  memcpy(indices, e->selected_indices, e->selected_count * sizeof(size_t));
+  out_result->selected_indices = indices;
+  out_result->selected_count = e->selected_count;
+  return KNAPSACK_OK;
+}
+
+/* Caller holds the lock and has checked that the instance is not cached. */
+/* NOLINTBEGIN(bugprone-easily-swappable-parameters) -- internal helper, params are documented. */
+static void insert_entry(knapsack_cache_t *cache, uint64_t hash, const knapsack_item_t *items,
+                         size_t count, int capacity, const knapsack_result_t *result) {
+  const size_t selected = result->selected_count;
+  /* Header, indices, items: each part's alignment divides the size before it. */
+  if (selected > (SIZE_MAX - sizeof(cache_entry_t)) / sizeof(size_t) ||
+      count > (SIZE_MAX - sizeof(cache_entry_t) - selected * sizeof(size_t)) /
+                  sizeof(knapsack_item_t)) {
+    return;
+  }
+  const size_t bytes =
+      sizeof(cache_entry_t) + selected * sizeof(size_t) + count * sizeof(knapsack_item_t);
+  unsigned char *block = cache->alloc->alloc_fn(bytes, cache->alloc->user_data);
+  if (!block) {
+    return;
+  }
+  if (cache->entries == cache->max_entries) {
+    remove_entry(cache, cache->oldest);
+    ++cache->evictions;
+  }
+  cache_entry_t *e = (cache_entry_t *)(void *)block;
+  *e = (cache_entry_t){
+      .chain = cache->buckets[hash & cache->bucket_mask],
+      .newer = NULL,
+      .older = NULL,
+      .hash = hash,
+      .count = count,
+      .capacity = capacity,
+      .optimal_value = result->optimal_value,
+      .total_weight = result->total_weight,
+      .upper_bound = result->upper_bound,
+      .selected_count = selected,
+      .selected_indices = (size_t *)(void *)(block + sizeof(cache_entry_t)),
+      .items = (knapsack_item_t *)(void *)(block + sizeof(cache_entry_t) +
+                                           selected * sizeof(size_t)),
+  };
+  if (selected != 0U) {
+    memcpy(e->selected_indices, result->selected_indices, selected * sizeof(size_t));
+  }
+  memcpy(e->items, items, count * sizeof(knapsack_item_t));
+  cache->buckets[hash & cache->bucket_mask] = e;
+  push_newest(cache, e);
+  ++cache->entries;
+}
+/* NOLINTEND(bugprone-easily-swappable-parameters) */
+
+knapsack_status_t knapsack_cache_solve(knapsack_cache_t *cache, const knapsack_item_t *items,
+                                       size_t count, int capacity,
+                                       const knapsack_allocator_t *allocator,
+                                       knapsack_result_t *out_result) {
+  if (!out_result) {
+    return KNAPSACK_ERR_NULL_RESULT;
+  }
+  if (!cache) {
+    *out_result = (knapsack_result_t){0};
+    return KNAPSACK_ERR_INVALID_ARGUMENT;
+  }
+  /* Malformed instances are the solver's to reject; there is nothing to hash. */
+  if (!items || count == 0U || count > KNAPSACK_MAX_ITEMS) {
+    return knapsack_solve_status_ex(items, count, capacity, allocator, out_result);
+  }
+  const uint64_t hash = hash_instance(items, count, capacity);
+  pthread_mutex_lock(&cache->lock);
+  cache_entry_t *hit = find_entry(cache, hash, items, count, capacity);
+  if (hit) {
+    ++cache->hits;
+    unlink_recency(cache, hit);
+    push_newest(cache, hit);
+    const knapsack_status_t status = copy_result(hit, resolve_allocator(allocator), out_result);
+    pthread_mutex_unlock(&cache->lock);
+    return status;
+  }
+  ++cache->misses;
+  pthread_mutex_unlock(&cache->lock);
+
+  const knapsack_status_t status =
+      knapsack_solve_status_ex(items, count, capacity, allocator, out_result);
+  if (status != KNAPSACK_OK) {
+    return status;
+  }
+  pthread_mutex_lock(&cache->lock);
+  if (!find_entry(cache, hash, items, count, capacity)) {
+    insert_entry(cache, hash, items, count, capacity, out_result);
+  }
+  pthread_mutex_unlock(&cache->lock);
+  return KNAPSACK_OK;
+}
+
+void knapsack_cache_get_stats(knapsack_cache_t *cache, knapsack_cache_stats_t *out_stats) {
+  if (!out_stats) {
+    return;
+  }
+  *out_stats = (knapsack_cache_stats_t){0};
+  if (!cache) {
+    return;
+  }
+  pthread_mutex_lock(&cache->lock);
+  *out_stats = (knapsack_cache_stats_t){
+      .hits = cache->hits,
+      .misses = cache->misses,
+      .evictions = cache->evictions,
+      .entries = cache->entries,
+  };
+  pthread_mutex_unlock(&cache->lock);
+}
+
+void knapsack_cache_clear(knapsack_cache_t *cache) {
+  if (!cache) {
+    return;
+  }
+  pthread_mutex_lock(&cache->lock);
+  while (cache->oldest) {
+    remove_entry(cache, cache->oldest);
+  }
+  pthread_mutex_unlock(&cache->lock);
+}
+
+void knapsack_cache_destroy(knapsack_cache_t *cache) {
+  if (!cache) {
+    return;
+  }
+  knapsack_cache_clear(cache);
+  pthread_mutex_destroy(&cache->lock);
+  const knapsack_allocator_t *alloc = cache->alloc;
+  alloc->free_fn(cache->buckets, alloc->user_data);
+  alloc->free_fn(cache, alloc->user_data);
+}
@@ -0,0 +1,190 @@
+/* Sparse 0/1 DP over Pareto frontiers.
+ *
+ * Layer i is the list of states (weight, value) reachable with the first i
+ * items that no other such state dominates -- none is at most as heavy and
+ * at least as valuable -- sorted by weight, so values strictly increase too.
+ * Layer i + 1 is the merge of layer i with layer i shifted by item i, and
+ * dominated states are dropped in the same pass. When a kept state and a
+ * taken state tie, the kept one wins. A frontier state (w, v) is exactly
+ * the dense engine's cell w, and ties are broken the same way, so both
+ * engines make identical decisions.
+ *
+ * The work and memory are proportional to the number of frontier states,
+ * which for a few items over a wide capacity is a small fraction of the
+ * count * width cells of the dense DP.
+ */
+#include "knapsack_internal.h"
+
+#include "knapsack/knapsack.h"
+
+#include <limits.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+static size_t add_saturated(size_t a, size_t b) { return a > SIZE_MAX - b ? SIZE_MAX : a + b; }
+
+void sparse_bound(const knapsack_item_t *items, size_t count, int capacity, int scale,
+                  size_t *total_out, size_t *widest_out) {
+  const size_t width = (size_t)(capacity / scale) + 1U;
+  size_t layer = 1U; /* the empty selection */
+  size_t total = 1U;
+  size_t widest = 1U;
+  size_t reachable = 1U; /* distinct weights 0..prefix sum */
+  for (size_t i = 0; i < count; ++i) {
+    if (items[i].weight > capacity) {
+      continue;
+    }
+    reachable = add_saturated(reachable, (size_t)(items[i].weight / scale));
+    layer = add_saturated(layer, layer);
+    if (layer > reachable) {
+      layer = reachable;
+    }
+    if (layer > width) {
+      layer = width;
+    }
+    total = add_saturated(total, layer);
+    if (layer > widest) {
+      widest = layer;
+    }
+  }
+  *total_out = total;
+  *widest_out = widest;
+}
+
+/* Append (weight, value) to the layer being built at out[0, *len), which
+ * has room for `room` states. A candidate no more valuable than the last
+ * state is dominated by it; one of equal weight but higher value replaces
+ * it. Returns false if a new slot was needed but there is none.
+ */
+/* NOLINTBEGIN(bugprone-easily-swappable-parameters) -- internal helper, params are documented. */
+static bool frontier_push(const sparse_frontier_t *f, size_t out, size_t room, size_t *len,
+                          uint32_t weight, int value, uint32_t parent) {
+  if (*len > 0U) {
+    const size_t last = out + *len - 1U;
+    if (value <= f->value[last]) {
+      return true;
+    }
+    if (f->weight[last] == weight) {
+      --*len;
+    }
+  }
+  if (*len >= room) {
+    return false;
+  }
+  const size_t slot = out + *len;
+  f->weight[slot] = weight;
+  f->value[slot] = value;
+  if (f->parent) {
+    f->parent[slot] = parent;
+  }
+  ++*len;
+  return true;
+}
+/* NOLINTEND(bugprone-easily-swappable-parameters) */
+
+sparse_status_t sparse_run(const knapsack_item_t *items, size_t count, int capacity,
+                           const cancel_t *cancel, sparse_frontier_t *f) {
+  /* With history every layer is kept back to back and layer_start records
+   * where each begins; without it two halves of the slots ping-pong.
+   */
+  const size_t half = f->slots / 2U;
+  size_t prev = 0U;
+  size_t prev_len = 1U;
+  size_t credit = 0U;
+  if (f->slots < (f->parent ? 1U : 2U)) {
+    return SPARSE_FULL;
+  }
+  f->weight[0] = 0U;
+  f->value[0] = 0;
+  if (f->parent) {
+    f->parent[0] = 0U;
+    f->layer_start[0] = 0U;
+  }
+
+  f->states = 0U;
+  for (size_t i = 0; i < count; ++i) {
+    f->states += prev_len;
+    if (cancel_poll(cancel, &credit, prev_len)) {
+      f->first = prev;
+      f->best = prev + prev_len - 1U;
+      f->layers = i;
+      return SPARSE_CANCELLED;
+    }
+    const uint32_t item_weight = (uint32_t)items[i].weight;
+    const int item_value = items[i].value;
+    const size_t out = f->parent ? prev + prev_len : (prev == 0U ? half : 0U);
+    const size_t room = f->parent ? f->slots - out : half;
+
+    /* Shifted states stay within capacity up to take_end (weights sorted).
+     * Every one of them is a candidate the dense DP would check as well.
+     */
+    const uint32_t take_limit =
+        item_weight <= (uint32_t)capacity ? (uint32_t)capacity - item_weight : 0U;
+    size_t take_end = 0U;
+    while (item_weight <= (uint32_t)capacity && take_end < prev_len &&
+           f->weight[prev + take_end] <= take_limit) {
+      if (f->value[prev + take_end] > INT_MAX - item_value) {
+        return SPARSE_OVERFLOW;
+      }
+      ++take_end;
+    }
+
+    size_t len = 0U;
+    size_t keep = 0U;
+    size_t take = 0U;
+    while (keep < prev_len || take < take_end) {
+      const bool from_keep =
+          take == take_end ||
+          (keep < prev_len && f->weight[prev + keep] <= f->weight[prev + take] + item_weight);
+      const bool stored =
+          from_keep ? frontier_push(f, out, room, &len, f->weight[prev + keep],
+                                    f->value[prev + keep], (uint32_t)keep)
+                    : frontier_push(f, out, room, &len, f->weight[prev + take] + item_weight,
+                                    f->value[prev + take] + item_value, (uint32_t)take);
+      if (!stored) {
+        return SPARSE_FULL;
+      }
+      if (from_keep) {
+        ++keep;
+      } else {
+        ++take;
+      }
+    }
+    prev = out;
+    prev_len = len;
+    if (f->parent) {
+      f->layer_start[i + 1U] = out;
+    }
+  }
+  f->first = prev;
+  f->best = prev + prev_len - 1U;
+  f->layers = count;
+  return SPARSE_DONE;
+}
+
+size_t sparse_walk(const sparse_frontier_t *f, size_t count, size_t *indices) {
+  size_t selected = 0U;
+  size_t state = f->best;
+  for (size_t i = count; i-- > 0;) {
+    const size_t parent = f->layer_start[i] + f->parent[state];
+    if (f->weight[parent] != f->weight[state]) {
+      ++selected;
+    }
+    state = parent;
+  }
+  if (!indices) {
+    return selected;
+  }
+
+  size_t write = selected;
+  state = f->best;
+  for (size_t i = count; i-- > 0;) {
+    const size_t parent = f->layer_start[i] + f->parent[state];
+    if (f->weight[parent] != f->weight[state]) {
+      indices[--write] = i;
+    }
+    state = parent;
+  }
+  return selected;
+}
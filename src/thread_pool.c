@@ -0,0 +1,259 @@
+/* Persistent worker pool behind knapsack_thread_pool_t.
+ *
+ * Workers are started once and sleep on a condition variable between runs.
+ * pool_run publishes a task under the pool lock, bumps the run generation
+ * and wakes the workers; the caller takes part as worker 0 and then waits
+ * for the others to check in.
+ *
+ * The barrier is what a parallel DP hits once per item, so it spins for a
+ * short while before falling back to the condition variable: when every
+ * worker has a core of its own the wait is usually a few hundred cycles.
+ * A pool with more workers than online CPUs skips the spin entirely: there
+ * the thread being waited for may need the very core that would spin.
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include "knapsack_internal.h"
+
+#include "knapsack/knapsack.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#define KNAPSACK_BARRIER_SPINS 2000U
+
+typedef struct {
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  size_t parties;
+  size_t arrived;
+  unsigned spins; /* busy-wait budget before sleeping */
+  atomic_uint generation;
+} pool_barrier_t;
+
+typedef struct {
+  struct knapsack_thread_pool *pool;
+  size_t index;
+} worker_arg_t;
+
+struct knapsack_thread_pool {
+  const knapsack_allocator_t *alloc;
+  size_t size; /* workers, including the calling thread */
+  pthread_t *threads;    /* size - 1 helpers */
+  worker_arg_t *args;    /* one per helper */
+  size_t started;        /* helpers successfully created */
+
+  pthread_mutex_t run_lock; /* serializes pool_run callers */
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+  pthread_cond_t done;
+  unsigned long run; /* bumped for every pool_run */
+  size_t active;     /* workers taking part in the current run */
+  size_t pending;    /* helper workers that have not finished yet */
+  pool_task_fn task;
+  void *ctx;
+  bool stop;
+
+  pool_barrier_t barrier;
+};
+
+static void cpu_relax(void) {
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__) && defined(__GNUC__)
+  __asm__ __volatile__("yield");
+#endif
+}
+
+void pool_barrier_wait(knapsack_thread_pool_t *pool) {
+  pool_barrier_t *b = &pool->barrier;
+  pthread_mutex_lock(&b->lock);
+  const unsigned gen = atomic_load_explicit(&b->generation, memory_order_relaxed);
+  if (++b->arrived == b->parties) {
+    b->arrived = 0U;
+    atomic_store_explicit(&b->generation, gen + 1U, memory_order_release);
+    pthread_cond_broadcast(&b->cond);
+    pthread_mutex_unlock(&b->lock);
+    return;
+  }
+  pthread_mutex_unlock(&b->lock);
+
+  for (unsigned spin = 0; spin < b->spins; ++spin) {
+    if (atomic_load_explicit(&b->generation, memory_order_acquire) != gen) {
+      return;
+    }
+    cpu_relax();
+  }
+  pthread_mutex_lock(&b->lock);
+  while (atomic_load_explicit(&b->generation, memory_order_relaxed) == gen) {
+    pthread_cond_wait(&b->cond, &b->lock);
+  }
+  pthread_mutex_unlock(&b->lock);
+}
+
+static void *worker_main(void *arg) {
+  const worker_arg_t *self = arg;
+  knapsack_thread_pool_t *pool = self->pool;
+  const size_t index = self->index;
+  unsigned long seen = 0U;
+
+  pthread_mutex_lock(&pool->lock);
+  for (;;) {
+    while (!pool->stop && (pool->run == seen || index >= pool->active)) {
+      if (pool->run != seen) {
+        seen = pool->run; /* a run this worker sits out */
+      }
+      pthread_cond_wait(&pool->wake, &pool->lock);
+    }
+    if (pool->stop) {
+      break;
+    }
+    seen = pool->run;
+    const pool_task_fn task = pool->task;
+    void *const ctx = pool->ctx;
+    const size_t workers = pool->active;
+    pthread_mutex_unlock(&pool->lock);
+
+    task(ctx, index, workers);
+
+    pthread_mutex_lock(&pool->lock);
+    if (--pool->pending == 0U) {
+      pthread_cond_signal(&pool->done);
+    }
+  }
+  pthread_mutex_unlock(&pool->lock);
+  return NULL;
+}
+
+void pool_run(knapsack_thread_pool_t *pool, size_t workers, pool_task_fn task, void *ctx) {
+  if (workers > pool->size) {
+    workers = pool->size;
+  }
+  if (workers <= 1U) {
+    task(ctx, 0U, 1U);
+    return;
+  }
+
+  pthread_mutex_lock(&pool->run_lock);
+  pool->barrier.parties = workers;
+  pool->barrier.arrived = 0U;
+
+  pthread_mutex_lock(&pool->lock);
+  pool->task = task;
+  pool->ctx = ctx;
+  pool->active = workers;
+  pool->pending = workers - 1U;
+  ++pool->run;
+  pthread_cond_broadcast(&pool->wake);
+  pthread_mutex_unlock(&pool->lock);
+
+  task(ctx, 0U, workers);
+
+  pthread_mutex_lock(&pool->lock);
+  while (pool->pending != 0U) {
+    pthread_cond_wait(&pool->done, &pool->lock);
+  }
+  pool->task = NULL;
+  pool->ctx = NULL;
+  pthread_mutex_unlock(&pool->lock);
+  pthread_mutex_unlock(&pool->run_lock);
+}
+
+/* Stop and join the first pool->started helpers, then free everything. */
+static void pool_teardown(knapsack_thread_pool_t *pool) {
+  pthread_mutex_lock(&pool->lock);
+  pool->stop = true;
+  pthread_cond_broadcast(&pool->wake);
+  pthread_mutex_unlock(&pool->lock);
+  for (size_t i = 0; i < pool->started; ++i) {
+    pthread_join(pool->threads[i], NULL);
+  }
+
+  pthread_cond_destroy(&pool->barrier.cond);
+  pthread_mutex_destroy(&pool->barrier.lock);
+  pthread_cond_destroy(&pool->done);
+  pthread_cond_destroy(&pool->wake);
+  pthread_mutex_destroy(&pool->lock);
+  pthread_mutex_destroy(&pool->run_lock);
+
+  const knapsack_allocator_t *alloc = pool->alloc;
+  alloc->free_fn(pool->args, alloc->user_data);
+  alloc->free_fn(pool->threads, alloc->user_data);
+  alloc->free_fn(pool, alloc->user_data);
+}
+
+static size_t online_cpus(void) {
+  const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  return cpus > 0 ? (size_t)cpus : 1U;
+}
+
+knapsack_thread_pool_t *knapsack_thread_pool_create(size_t threads,
+                                                    const knapsack_allocator_t *allocator) {
+  const knapsack_allocator_t *alloc = resolve_allocator(allocator);
+  const size_t size = threads == 0U ? online_cpus() : threads;
+  const size_t helpers = size - 1U;
+  if (helpers > SIZE_MAX / sizeof(pthread_t) || helpers > SIZE_MAX / sizeof(worker_arg_t)) {
+    return NULL;
+  }
+
+  knapsack_thread_pool_t *pool = alloc->alloc_fn(sizeof(*pool), alloc->user_data);
+  if (!pool) {
+    return NULL;
+  }
+  *pool = (knapsack_thread_pool_t){
+      .alloc = alloc,
+      .size = size,
+      .threads = NULL,
+      .args = NULL,
+      .started = 0U,
+      .run = 0U,
+      .active = 0U,
+      .pending = 0U,
+      .task = NULL,
+      .ctx = NULL,
+      .stop = false,
+  };
+  pthread_mutex_init(&pool->run_lock, NULL);
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->wake, NULL);
+  pthread_cond_init(&pool->done, NULL);
+  pthread_mutex_init(&pool->barrier.lock, NULL);
+  pthread_cond_init(&pool->barrier.cond, NULL);
+  pool->barrier.parties = 1U;
+  pool->barrier.arrived = 0U;
+  pool->barrier.spins = size <= online_cpus() ? KNAPSACK_BARRIER_SPINS : 0U;
+  atomic_init(&pool->barrier.generation, 0U);
+
+  if (helpers != 0U) {
+    pool->threads = alloc->alloc_fn(helpers * sizeof(pthread_t), alloc->user_data);
+    pool->args = alloc->alloc_fn(helpers * sizeof(worker_arg_t), alloc->user_data);
+    if (!pool->threads || !pool->args) {
+      pool_teardown(pool);
+      return NULL;
+    }
+  }
+  for (size_t i = 0; i < helpers; ++i) {
+    pool->args[i] = (worker_arg_t){pool, i + 1U};
+    if (pthread_create(&pool->threads[i], NULL, worker_main, &pool->args[i]) != 0) {
+      pool_teardown(pool);
+      return NULL;
+    }
+    ++pool->started;
+  }
+  return pool;
+}
+
+size_t knapsack_thread_pool_size(const knapsack_thread_pool_t *pool) {
+  return pool ? pool->size : 0U;
+}
+
+void knapsack_thread_pool_destroy(knapsack_thread_pool_t *pool) {
+  if (!pool) {
+    return;
+  }
+  pool_teardown(pool);
+}
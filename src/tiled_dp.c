@@ -0,0 +1,205 @@
+/* Cache-blocked dense DP behind KNAPSACK_ENGINE_TILED.
+ *
+ * The item-by-item sweep streams the whole value/weight row once per item,
+ * so once the row outgrows L2 every item goes out to L3 or DRAM. Here a
+ * tile of consecutive items is applied to one block of capacity cells
+ * before moving on to the next block, and the block stays in L2 while all
+ * of the tile's items pass over it.
+ *
+ * Blocks go low to high. Within a block the tile's items go in order, each
+ * with the sweep's in-place high-to-low update, so cell j of item i reads
+ * cell j - w_i as item i - 1 left it -- unless j - w_i falls in the block
+ * below, which has been through the whole tile by then. Those w_i cells
+ * are saved for item i from the top of each block just before item i
+ * updates it (its halo), and the lowest w_i cells of the next block take
+ * their candidates from there. A tile's weights add up to at most the block
+ * size, so all halos of a block fit in one block-sized buffer; two of them
+ * alternate, the one being read and the one being written.
+ *
+ * The rows and decision bits come out exactly as the sweep over the same
+ * item order leaves them. The caller sorts items by weight so that light
+ * items share tiles; an item too heavy to share one is swept on its own.
+ */
+#define _GNU_SOURCE /* sysconf(_SC_LEVEL2_CACHE_SIZE) */
+
+#include "knapsack_internal.h"
+
+#include "knapsack/knapsack.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* L2 size assumed when the system does not report one. */
+#define TILED_FALLBACK_L2_BYTES (256U * 1024U)
+
+/* A block's working set is its cells plus, at worst, two halos as large:
+ * three value/weight pairs per cell. It is sized to half of L2, leaving the
+ * rest to the decision bits and whatever else is resident.
+ */
+#define TILED_CELL_BYTES (3U * (sizeof(int) + sizeof(uint32_t)))
+#define TILED_L2_SHARE 2U
+
+/* Blocks are whole take_bits words. */
+#define TILED_BLOCK_ALIGN 64U
+
+static size_t l2_cache_bytes(void) {
+#ifdef _SC_LEVEL2_CACHE_SIZE
+  const long bytes = sysconf(_SC_LEVEL2_CACHE_SIZE);
+  if (bytes > 0) {
+    return (size_t)bytes;
+  }
+#endif
+  return TILED_FALLBACK_L2_BYTES;
+}
+
+static atomic_size_t g_auto_block = 0U;
+
+size_t knapsack_tile_cells(void) {
+  size_t cells = atomic_load_explicit(&g_auto_block, memory_order_relaxed);
+  if (cells == 0U) {
+    cells = l2_cache_bytes() / TILED_L2_SHARE / TILED_CELL_BYTES;
+    cells -= cells % TILED_BLOCK_ALIGN;
+    if (cells < TILED_BLOCK_ALIGN) {
+      cells = TILED_BLOCK_ALIGN;
+    }
+    atomic_store_explicit(&g_auto_block, cells, memory_order_relaxed);
+  }
+  return cells;
+}
+
+/* Lighter first; equal weights keep their order, so the sort is stable. */
+static int compare_weight(const void *lhs, const void *rhs) {
+  const tiled_item_t *a = lhs;
+  const tiled_item_t *b = rhs;
+  if (a->item.weight != b->item.weight) {
+    return a->item.weight < b->item.weight ? -1 : 1;
+  }
+  return (a->origin > b->origin) - (a->origin < b->origin);
+}
+
+void tiled_sort(knapsack_item_t *items, size_t *origin, size_t count, tiled_item_t *scratch) {
+  for (size_t i = 0; i < count; ++i) {
+    scratch[i] = (tiled_item_t){items[i], origin[i]};
+  }
+  qsort(scratch, count, sizeof(tiled_item_t), compare_weight);
+  for (size_t i = 0; i < count; ++i) {
+    items[i] = scratch[i].item;
+    origin[i] = scratch[i].origin;
+  }
+}
+
+/* Update cells [first, end) of the row for item `row`, whose candidates
+ * start at take_value/take_weight (in the row itself, or in a halo).
+ */
+/* NOLINTBEGIN(bugprone-easily-swappable-parameters) -- internal helper, params are documented. */
+static bool update_cells(const tiled_dp_t *dp, dp_kernel_fn kernel, const knapsack_item_t *item,
+                         size_t row, size_t first, size_t end, const int *take_value,
+                         const uint32_t *take_weight) {
+  const dp_span_t span = {
+      .out_value = dp->value + first,
+      .out_weight = dp->weight + first,
+      .keep_value = dp->value + first,
+      .keep_weight = dp->weight + first,
+      .take_value = take_value,
+      .take_weight = take_weight,
+      .n = end - first,
+      .item_value = item->value,
+      .item_weight = (uint32_t)item->weight,
+      .bits = dp->take_bits,
+      .bit_offset =
+          dp->take_bits ? take_row_bit(dp->row_word, row, (size_t)item->weight, first) : 0U,
+  };
+  return kernel(&span);
+}
+/* NOLINTEND(bugprone-easily-swappable-parameters) */
+
+/* Items [first, last), whose weights add up to at most dp->block, block by
+ * block.
+ */
+static bool run_tile(const tiled_dp_t *dp, dp_kernel_fn kernel, const knapsack_item_t *items,
+                     size_t first, size_t last) {
+  const size_t block = dp->block;
+  int *read_value = dp->halo_value;
+  uint32_t *read_weight = dp->halo_weight;
+  int *write_value = dp->halo_value + block;
+  uint32_t *write_weight = dp->halo_weight + block;
+  for (size_t lo = 0; lo < dp->width; lo += block) {
+    const size_t hi = lo + block < dp->width ? lo + block : dp->width;
+    const bool save = hi < dp->width;
+    size_t halo = 0U;
+    for (size_t i = first; i < last; ++i) {
+      const size_t w = (size_t)items[i].weight;
+      if (save) {
+        memcpy(write_value + halo, dp->value + hi - w, w * sizeof(int));
+        memcpy(write_weight + halo, dp->weight + hi - w, w * sizeof(uint32_t));
+      }
+      /* Cells whose candidate lies in the block: the sweep's in-place update. */
+      if (lo + w < hi &&
+          !update_cells(dp, kernel, &items[i], i, lo + w, hi, dp->value + lo, dp->weight + lo)) {
+        return false;
+      }
+      /* The lowest w cells take theirs from the block below, through the halo.
+       * w <= block <= lo here, so none of them is below w.
+       */
+      const size_t end = lo + w < hi ? lo + w : hi;
+      if (lo != 0U && end > lo &&
+          !update_cells(dp, kernel, &items[i], i, lo, end, read_value + halo, read_weight + halo)) {
+        return false;
+      }
+      halo += w;
+    }
+    int *const value_swap = read_value;
+    uint32_t *const weight_swap = read_weight;
+    read_value = write_value;
+    read_weight = write_weight;
+    write_value = value_swap;
+    write_weight = weight_swap;
+  }
+  return true;
+}
+
+tiled_status_t tiled_run(const knapsack_item_t *items, size_t count, const cancel_t *cancel,
+                         tiled_dp_t *dp) {
+  const dp_kernel_fn kernel = dp_active_kernel();
+  size_t credit = 0U;
+  dp->done = 0U;
+  dp->cells = 0U;
+  size_t first = 0U;
+  while (first < count) {
+    size_t last = first + 1U;
+    size_t weight_sum = (size_t)items[first].weight;
+    while (last < count && weight_sum + (size_t)items[last].weight <= dp->block) {
+      weight_sum += (size_t)items[last].weight;
+      ++last;
+    }
+    size_t work = 0U;
+    for (size_t i = first; i < last; ++i) {
+      work += (size_t)items[i].weight < dp->width ? dp->width - (size_t)items[i].weight : 0U;
+    }
+    if (dp->take_bits) {
+      take_rows_clear(dp->take_bits, dp->row_word, first, last);
+    }
+    if (last - first == 1U) {
+      /* Alone in its tile: one span over the whole row, as the sweep does. */
+      const size_t w = (size_t)items[first].weight;
+      if (w < dp->width && !update_cells(dp, kernel, &items[first], first, w, dp->width,
+                                         dp->value, dp->weight)) {
+        return TILED_OVERFLOW;
+      }
+    } else if (!run_tile(dp, kernel, items, first, last)) {
+      return TILED_OVERFLOW;
+    }
+    dp->cells += work;
+    dp->done = last;
+    first = last;
+    if (first < count && cancel_poll(cancel, &credit, work)) {
+      return TILED_CANCELLED;
+    }
+  }
+  return TILED_DONE;
+}
@@ -0,0 +1,181 @@
+/* K best selections: the dense DP with every row kept, then a best-first
+ * search over the table.
+ *
+ * Row r, cell j of the table is the best (value, then weight) selection of
+ * the first r items within capacity j, filled by the active DP kernel. A
+ * search node fixes the decisions for items [r, rows) and leaves capacity
+ * j for the rest, so its best completion is exactly what it has plus cell
+ * (r, j): that pair is its priority. Expanding a node decides item r - 1
+ * both ways, and one of the two children always has the parent's priority.
+ * Nodes at row 0 are complete selections, and every selection is the leaf
+ * of exactly one path, so leaves leave the queue in rank order and are
+ * distinct.
+ *
+ * Ties go to the deeper node, then to the node created first (skip before
+ * take). A node's best child is therefore popped right after it, so each
+ * selection costs at most rows + 1 pops and the queue never holds more than
+ * 1 + 2 * k * rows nodes. Rank 0 follows the dense DP's own tie-break:
+ * take only when strictly better.
+ */
+#include "knapsack_internal.h"
+
+#include "knapsack/knapsack.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+topk_status_t topk_run(const knapsack_item_t *items, size_t rows, int capacity,
+                       const cancel_t *cancel, topk_table_t *t) {
+  const size_t width = (size_t)capacity + 1U;
+  const dp_kernel_fn kernel = dp_active_kernel();
+  memset(t->value, 0, width * sizeof(int));
+  memset(t->weight, 0, width * sizeof(uint32_t));
+  size_t credit = 0U;
+  t->cells = 0U;
+  for (size_t r = 0; r < rows; ++r) {
+    const size_t item_weight = (size_t)items[r].weight;
+    if (cancel_poll(cancel, &credit, width - item_weight)) {
+      return TOPK_CANCELLED;
+    }
+    const int *keep_value = t->value + r * width;
+    const uint32_t *keep_weight = t->weight + r * width;
+    int *out_value = t->value + (r + 1U) * width;
+    uint32_t *out_weight = t->weight + (r + 1U) * width;
+    /* Cells below the item's weight cannot take it. */
+    memcpy(out_value, keep_value, item_weight * sizeof(int));
+    memcpy(out_weight, keep_weight, item_weight * sizeof(uint32_t));
+    const dp_span_t span = {
+        .out_value = out_value + item_weight,
+        .out_weight = out_weight + item_weight,
+        .keep_value = keep_value + item_weight,
+        .keep_weight = keep_weight + item_weight,
+        .take_value = keep_value,
+        .take_weight = keep_weight,
+        .n = width - item_weight,
+        .item_value = items[r].value,
+        .item_weight = (uint32_t)item_weight,
+        .bits = NULL,
+        .bit_offset = 0U,
+    };
+    if (!kernel(&span)) {
+      return TOPK_OVERFLOW;
+    }
+    t->cells += width - item_weight;
+  }
+  return TOPK_DONE;
+}
+
+static bool node_before(const topk_node_t *a, size_t ia, const topk_node_t *b, size_t ib) {
+  if (a->bound_value != b->bound_value) {
+    return a->bound_value > b->bound_value;
+  }
+  if (a->bound_weight != b->bound_weight) {
+    return a->bound_weight < b->bound_weight;
+  }
+  if (a->row != b->row) {
+    return a->row < b->row;
+  }
+  return ia < ib;
+}
+
+static bool heap_before(const topk_table_t *t, size_t a, size_t b) {
+  return node_before(&t->nodes[t->heap[a]], t->heap[a], &t->nodes[t->heap[b]], t->heap[b]);
+}
+
+static void heap_swap(topk_table_t *t, size_t a, size_t b) {
+  const size_t swap = t->heap[a];
+  t->heap[a] = t->heap[b];
+  t->heap[b] = swap;
+}
+
+/* Create a node and queue it; the caller guarantees a free slot. */
+/* NOLINTBEGIN(bugprone-easily-swappable-parameters) -- internal helper, params are documented. */
+static void push_node(topk_table_t *t, size_t parent, size_t item, size_t row, uint32_t cell,
+                      int value, uint32_t weight) {
+  const size_t cell_index = row * t->width + cell;
+  const size_t index = t->used++;
+  t->nodes[index] = (topk_node_t){
+      .parent = parent,
+      .item = item,
+      .row = row,
+      .cell = cell,
+      .value = value,
+      .weight = weight,
+      .bound_value = value + t->value[cell_index],
+      .bound_weight = weight + t->weight[cell_index],
+  };
+  size_t at = t->queued++;
+  t->heap[at] = index;
+  while (at > 0U && heap_before(t, at, (at - 1U) / 2U)) {
+    heap_swap(t, at, (at - 1U) / 2U);
+    at = (at - 1U) / 2U;
+  }
+}
+/* NOLINTEND(bugprone-easily-swappable-parameters) */
+
+static size_t pop_node(topk_table_t *t) {
+  const size_t top = t->heap[0];
+  t->heap[0] = t->heap[--t->queued];
+  size_t at = 0U;
+  for (;;) {
+    const size_t left = 2U * at + 1U;
+    size_t best = at;
+    if (left < t->queued && heap_before(t, left, best)) {
+      best = left;
+    }
+    if (left + 1U < t->queued && heap_before(t, left + 1U, best)) {
+      best = left + 1U;
+    }
+    if (best == at) {
+      return top;
+    }
+    heap_swap(t, at, best);
+    at = best;
+  }
+}
+
+void topk_start(topk_table_t *t, size_t rows, int capacity) {
+  t->rows = rows;
+  t->used = 0U;
+  t->queued = 0U;
+  push_node(t, 0U, SIZE_MAX, rows, (uint32_t)capacity, 0, 0U);
+}
+
+bool topk_next(topk_table_t *t, const knapsack_item_t *items, size_t *leaf) {
+  while (t->queued > 0U) {
+    const size_t top = pop_node(t);
+    const topk_node_t node = t->nodes[top];
+    if (node.row == 0U) {
+      *leaf = top;
+      return true;
+    }
+    if (t->used + 2U > t->slots) {
+      return false; /* unreachable with 1 + 2 * k * rows slots */
+    }
+    const size_t item = node.row - 1U;
+    const uint32_t item_weight = (uint32_t)items[item].weight;
+    push_node(t, top, SIZE_MAX, item, node.cell, node.value, node.weight);
+    if (item_weight <= node.cell) {
+      push_node(t, top, item, item, node.cell - item_weight, node.value + items[item].value,
+                node.weight + item_weight);
+    }
+  }
+  return false;
+}
+
+size_t topk_collect(const topk_table_t *t, size_t leaf, const size_t *origin, size_t *indices) {
+  size_t taken = 0U;
+  /* Upwards from the leaf, the decided items come in ascending order. */
+  for (size_t n = leaf; t->nodes[n].row != t->rows; n = t->nodes[n].parent) {
+    const size_t item = t->nodes[n].item;
+    if (item != SIZE_MAX) {
+      if (indices) {
+        indices[taken] = origin[item];
+      }
+      ++taken;
+    }
+  }
+  return taken;
+}
@@ -2,13 +2,22 @@ extern "C" {
 #include "cli_internal.h"
 }
 
+#include <cerrno>
 #include <cstdio>
 #include <cstdlib>
+#include <climits>
 #include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <gtest/gtest.h>
+#include <iterator>
+#include <random>
+#include <sstream>
 #include <string>
 #include <vector>
 
+#include <unistd.h>
+
 namespace {
 
 // RAII helper to wrap a string as a FILE* via fmemopen.
@@ -177,6 +186,12 @@ TEST(CliStatusToString, MapsAllCodes) {
   EXPECT_STREQ(cli_status_to_string(KNAPSACK_ERR_DIMENSION_OVERFLOW), "DIMENSION_OVERFLOW");
   EXPECT_STREQ(cli_status_to_string(KNAPSACK_ERR_INT_OVERFLOW), "INT_OVERFLOW");
   EXPECT_STREQ(cli_status_to_string(KNAPSACK_ERR_ALLOC), "ALLOC");
+  EXPECT_STREQ(cli_status_to_string(KNAPSACK_ERR_INVALID_ARGUMENT), "INVALID_ARGUMENT");
+  EXPECT_STREQ(cli_status_to_string(KNAPSACK_ERR_CANCELLED), "CANCELLED");
+  EXPECT_STREQ(cli_status_to_string(KNAPSACK_ERR_INVALID_FORMAT), "INVALID_FORMAT");
+  EXPECT_STREQ(cli_status_to_string(KNAPSACK_ERR_IO), "IO");
+  EXPECT_STREQ(cli_status_to_string(KNAPSACK_ERR_QUEUE_FULL), "QUEUE_FULL");
+  EXPECT_STREQ(cli_status_to_string(KNAPSACK_ERR_LIMIT), "LIMIT");
 }
 
 TEST(CliJsonQuote, EscapesQuotesAndBackslashes) {
@@ -243,7 +258,7 @@ TEST(CliParseItems, RejectsNonNumericValue) {
 }
 
 TEST(CliParseItems, RejectsTokenLongerThanInternalBuffer) {
-  // parse_item_token uses a 64-byte local buffer; a token of 70+ chars must be rejected.
+  // Tokens of KNAPSACK_CLI_TOKEN_MAX (64) characters or more are rejected.
   std::string long_token(70, '1');
   long_token += ":2\n";
   StringFile sf(long_token);
@@ -274,16 +289,47 @@ TEST(CliParseBuffer, RejectsOversizedCapacityLine) {
   EXPECT_EQ(cli_parse_buffer(input.data(), input.size(), &cap, &items, &count), -1);
 }
 
-TEST(CliParseBuffer, RejectsOversizedItemsLine) {
-  // KNAPSACK_CLI_ITEM_LINE_MAX == 8192; build an items line larger than that.
+TEST(CliParseBuffer, AcceptsItemsLineLongerThanAnyFixedBuffer) {
+  // Items lines have no length limit: this one is far beyond the 8 KiB the
+  // parser used to copy lines into.
   std::string input = "10\n";
-  while (input.size() < 8200U) {
+  while (input.size() < 40000U) {
     input += "1:1 ";
   }
+  input += "2:5\n";
   int cap = 0;
   knapsack_item_t *items = nullptr;
   size_t count = 0;
-  EXPECT_EQ(cli_parse_buffer(input.data(), input.size(), &cap, &items, &count), -1);
+  ASSERT_EQ(cli_parse_buffer(input.data(), input.size(), &cap, &items, &count), 0);
+  EXPECT_EQ(count, (input.size() - 3U) / 4U);
+  EXPECT_EQ(items[count - 1U].weight, 2);
+  EXPECT_EQ(items[count - 1U].value, 5);
+  std::free(items);
+}
+
+TEST(CliParseItems, ReadsLinesLongerThanAnyFixedBuffer) {
+  std::string line;
+  for (int i = 0; i < 4000; ++i) {
+    line += "3:7,";
+  }
+  line += "4:9\n";
+  StringFile sf(line);
+  knapsack_item_t *items = nullptr;
+  size_t count = 0;
+  ASSERT_EQ(cli_parse_items(sf.get(), &items, &count), 0);
+  EXPECT_EQ(count, 4001U);
+  EXPECT_EQ(items[4000].value, 9);
+  std::free(items);
+}
+
+TEST(CliParseBuffer, IgnoresLinesAfterTheItems) {
+  const char input[] = "10\n1:2 3:4\n5:6\n";
+  int cap = 0;
+  knapsack_item_t *items = nullptr;
+  size_t count = 0;
+  ASSERT_EQ(cli_parse_buffer(input, sizeof input - 1, &cap, &items, &count), 0);
+  EXPECT_EQ(count, 2U);
+  std::free(items);
 }
 
 TEST(CliParseBuffer, RejectsNegativeCapacity) {
@@ -301,3 +347,452 @@ TEST(CliParseBuffer, RejectsTrailingGarbageInCapacity) {
   size_t count = 0;
   EXPECT_EQ(cli_parse_buffer(input, sizeof input - 1, &cap, &items, &count), -1);
 }
+
+TEST(CliParseLine, AdvancesCursorPastEachLine) {
+  const std::string input = "10\n1:2,3:4\nrest";
+  const char *cursor = input.data();
+  const char *end = input.data() + input.size();
+  int cap = 0;
+  ASSERT_EQ(cli_parse_capacity_line(&cursor, end, &cap), 0);
+  EXPECT_EQ(cap, 10);
+  EXPECT_EQ(cursor, input.data() + 3);
+  knapsack_item_t *items = nullptr;
+  size_t count = 0;
+  ASSERT_EQ(cli_parse_items_line(&cursor, end, &items, &count), 0);
+  ASSERT_EQ(count, 2U);
+  EXPECT_EQ(items[1].weight, 3);
+  EXPECT_EQ(items[1].value, 4);
+  EXPECT_EQ(std::string(cursor, end), "rest");
+  std::free(items);
+}
+
+TEST(CliParseLine, ParsesLastLineWithoutNewline) {
+  const std::string input = "7\r\n2:3 4:5";
+  const char *cursor = input.data();
+  const char *end = input.data() + input.size();
+  int cap = 0;
+  ASSERT_EQ(cli_parse_capacity_line(&cursor, end, &cap), 0);
+  EXPECT_EQ(cap, 7);
+  knapsack_item_t *items = nullptr;
+  size_t count = 0;
+  ASSERT_EQ(cli_parse_items_line(&cursor, end, &items, &count), 0);
+  EXPECT_EQ(count, 2U);
+  EXPECT_EQ(cursor, end);
+  std::free(items);
+}
+
+TEST(CliParseLine, MatchesStrtolEdgeCases) {
+  struct Case {
+    const char *line;
+    int rc;
+  };
+  const Case cases[] = {
+      {"+3:4", 0},
+      {"3:+4", 0},
+      {"2147483647:0", 0},
+      {"1:1,,2:2 \t3:3", 0},
+      {"2147483648:0", -1},
+      {"3:99999999999999999999", -1},
+      {"3:-1", -1},
+      {"0:1", -1},
+      {"3:", -1},
+      {":3", -1},
+      {"-:4", -1},
+      {"3:4:5", -1},
+      {"3:4x", -1},
+      {"", -1},
+      {" , ", -1},
+  };
+  for (const Case &c : cases) {
+    const char *cursor = c.line;
+    knapsack_item_t *items = nullptr;
+    size_t count = 0;
+    EXPECT_EQ(cli_parse_items_line(&cursor, c.line + std::strlen(c.line), &items, &count), c.rc)
+        << c.line;
+    std::free(items);
+  }
+}
+
+TEST(CliParseLine, RejectsNullArguments) {
+  const char line[] = "1:2";
+  const char *cursor = line;
+  const char *null_cursor = nullptr;
+  int cap = 0;
+  knapsack_item_t *items = nullptr;
+  size_t count = 0;
+  EXPECT_EQ(cli_parse_capacity_line(nullptr, line + 3, &cap), -1);
+  EXPECT_EQ(cli_parse_capacity_line(&null_cursor, line + 3, &cap), -1);
+  EXPECT_EQ(cli_parse_capacity_line(&cursor, line + 3, nullptr), -1);
+  EXPECT_EQ(cli_parse_items_line(&cursor, line + 3, nullptr, &count), -1);
+  EXPECT_EQ(cli_parse_items_line(&cursor, line + 3, &items, nullptr), -1);
+  EXPECT_EQ(items, nullptr);
+  EXPECT_EQ(cursor, line);
+}
+
+namespace {
+
+// RAII temp file holding the given bytes.
+class InputFile {
+public:
+  explicit InputFile(const std::string &content) {
+    char tmpl[] = "/tmp/knapsack_cli_XXXXXX";
+    const int fd = mkstemp(tmpl);
+    if (fd != -1) {
+      path_ = tmpl;
+      ok_ = write(fd, content.data(), content.size()) == static_cast<ssize_t>(content.size());
+      close(fd);
+    }
+  }
+  ~InputFile() {
+    if (!path_.empty()) {
+      std::remove(path_.c_str());
+    }
+  }
+  InputFile(const InputFile &) = delete;
+  InputFile &operator=(const InputFile &) = delete;
+  bool ok() const { return ok_; }
+  const char *path() const { return path_.c_str(); }
+
+private:
+  std::string path_;
+  bool ok_ = false;
+};
+
+} // namespace
+
+TEST(CliInput, MapsRegularFiles) {
+  std::string content = "50\n";
+  for (int i = 0; i < 5000; ++i) {
+    content += std::to_string(i % 9 + 1) + ":" + std::to_string(i) + " ";
+  }
+  InputFile file(content);
+  ASSERT_TRUE(file.ok());
+  cli_input_t input;
+  ASSERT_EQ(cli_input_open(file.path(), &input), 0);
+  EXPECT_NE(input.mapping, nullptr);
+  ASSERT_EQ(input.length, content.size());
+  EXPECT_EQ(std::memcmp(input.data, content.data(), content.size()), 0);
+
+  const char *cursor = input.data;
+  const char *end = input.data + input.length;
+  int cap = 0;
+  knapsack_item_t *items = nullptr;
+  size_t count = 0;
+  ASSERT_EQ(cli_parse_capacity_line(&cursor, end, &cap), 0);
+  ASSERT_EQ(cli_parse_items_line(&cursor, end, &items, &count), 0);
+  EXPECT_EQ(cap, 50);
+  EXPECT_EQ(count, 5000U);
+  EXPECT_EQ(items[4999].value, 4999);
+  std::free(items);
+  cli_input_close(&input);
+  EXPECT_EQ(input.data, nullptr);
+}
+
+TEST(CliInput, ReadsEmptyFilesWithoutMapping) {
+  InputFile file("");
+  ASSERT_TRUE(file.ok());
+  cli_input_t input;
+  ASSERT_EQ(cli_input_open(file.path(), &input), 0);
+  EXPECT_EQ(input.mapping, nullptr);
+  EXPECT_EQ(input.length, 0U);
+  cli_input_close(&input);
+}
+
+TEST(CliInput, ReadsPipesInChunks) {
+  int fds[2];
+  ASSERT_EQ(pipe(fds), 0);
+  const std::string content = "10\n2:3 3:4\n";
+  ASSERT_EQ(write(fds[1], content.data(), content.size()),
+            static_cast<ssize_t>(content.size()));
+  close(fds[1]);
+  const std::string path = "/proc/self/fd/" + std::to_string(fds[0]);
+  cli_input_t input;
+  ASSERT_EQ(cli_input_open(path.c_str(), &input), 0);
+  close(fds[0]);
+  EXPECT_EQ(input.mapping, nullptr);
+  EXPECT_EQ(std::string(input.data, input.length), content);
+  cli_input_close(&input);
+}
+
+TEST(CliInput, MissingFileSetsErrno) {
+  cli_input_t input;
+  errno = 0;
+  EXPECT_EQ(cli_input_open("/nonexistent/knapsack/input.txt", &input), -1);
+  EXPECT_EQ(errno, ENOENT);
+  cli_input_close(&input);
+  EXPECT_EQ(cli_input_open(nullptr, &input), -1);
+}
+
+namespace {
+
+std::vector<std::string> ReadAllLines(cli_stream_t *stream) {
+  std::vector<std::string> lines;
+  const char *line = nullptr;
+  size_t length = 0;
+  while (cli_stream_next_line(stream, &line, &length) == 1) {
+    lines.emplace_back(line, length);
+  }
+  return lines;
+}
+
+} // namespace
+
+TEST(CliStream, SplitsLinesAcrossReads) {
+  // A line much longer than one read chunk, and a final line with no newline.
+  const std::string long_line(3 * KNAPSACK_CLI_READ_CHUNK + 17, 'x');
+  InputFile file("10\n" + long_line + "\n\n2:3 4:5\r\nlast");
+  ASSERT_TRUE(file.ok());
+  cli_stream_t stream;
+  ASSERT_EQ(cli_stream_open(file.path(), &stream), 0);
+  const std::vector<std::string> lines = ReadAllLines(&stream);
+  ASSERT_EQ(lines.size(), 5U);
+  EXPECT_EQ(lines[0], "10");
+  EXPECT_EQ(lines[1], long_line);
+  EXPECT_EQ(lines[2], "");
+  EXPECT_EQ(lines[3], "2:3 4:5\r");
+  EXPECT_EQ(lines[4], "last");
+  EXPECT_TRUE(cli_stream_ready(&stream));
+  const char *line = nullptr;
+  size_t length = 0;
+  EXPECT_EQ(cli_stream_next_line(&stream, &line, &length), 0);
+  cli_stream_close(&stream);
+}
+
+TEST(CliStream, ReadyReflectsWhatThePipeHolds) {
+  int fds[2];
+  ASSERT_EQ(pipe(fds), 0);
+  const std::string path = "/proc/self/fd/" + std::to_string(fds[0]);
+  cli_stream_t stream;
+  ASSERT_EQ(cli_stream_open(path.c_str(), &stream), 0);
+  close(fds[0]);
+  EXPECT_FALSE(cli_stream_ready(&stream));
+
+  ASSERT_EQ(write(fds[1], "1\n2\n", 4), 4);
+  EXPECT_TRUE(cli_stream_ready(&stream));
+  const char *line = nullptr;
+  size_t length = 0;
+  ASSERT_EQ(cli_stream_next_line(&stream, &line, &length), 1);
+  EXPECT_EQ(std::string(line, length), "1");
+  // The second line came in with the first read, so no poll is needed.
+  EXPECT_TRUE(cli_stream_ready(&stream));
+  ASSERT_EQ(cli_stream_next_line(&stream, &line, &length), 1);
+  EXPECT_EQ(std::string(line, length), "2");
+  EXPECT_FALSE(cli_stream_ready(&stream));
+
+  close(fds[1]);
+  EXPECT_TRUE(cli_stream_ready(&stream));
+  EXPECT_EQ(cli_stream_next_line(&stream, &line, &length), 0);
+  cli_stream_close(&stream);
+}
+
+TEST(CliStream, MissingFileSetsErrno) {
+  cli_stream_t stream;
+  errno = 0;
+  EXPECT_EQ(cli_stream_open("/nonexistent/knapsack/input.txt", &stream), -1);
+  EXPECT_EQ(errno, ENOENT);
+  EXPECT_EQ(cli_stream_open(nullptr, &stream), -1);
+}
+
+namespace {
+
+// Reference for the current grammar: the capacity on line 1 and the items
+// on line 2 only, so a blank items line is an error and later lines are
+// never read. It tokenizes with strtok_r over a copy of the items line and
+// strtol on each side of every token. The single-pass scanner must accept
+// exactly the inputs this accepts, with the same items. This is not the
+// older parser the scanner replaced, which took items from every line after
+// the first (it accepted "10\n1:2\n3:4\n" as two items).
+bool ReferenceToken(const char *token, knapsack_item_t *item) {
+  const char *colon = std::strchr(token, ':');
+  if (colon == nullptr || colon == token || colon[1] == '\0' || std::strlen(token) >= 64U) {
+    return false;
+  }
+  const std::string weight_str(token, colon);
+  const char *value_str = colon + 1;
+  errno = 0;
+  char *endptr = nullptr;
+  const long weight = std::strtol(weight_str.c_str(), &endptr, 10);
+  if (errno != 0 || endptr == weight_str.c_str() || *endptr != '\0' || weight <= 0 ||
+      weight > INT_MAX) {
+    return false;
+  }
+  errno = 0;
+  const long value = std::strtol(value_str, &endptr, 10);
+  if (errno != 0 || endptr == value_str || *endptr != '\0' || value < 0 || value > INT_MAX) {
+    return false;
+  }
+  item->weight = static_cast<int>(weight);
+  item->value = static_cast<int>(value);
+  return true;
+}
+
+bool ReferenceParse(const std::string &input, int *capacity, std::vector<knapsack_item_t> *items) {
+  const size_t newline = input.find('\n');
+  if (newline == std::string::npos || newline + 1U >= 256U) {
+    return false;
+  }
+  const std::string cap_line = input.substr(0, newline);
+  errno = 0;
+  char *endptr = nullptr;
+  const long parsed = std::strtol(cap_line.c_str(), &endptr, 10);
+  if (errno != 0 || endptr == cap_line.c_str() ||
+      std::strspn(endptr, " \t\r\n") != std::strlen(endptr) || parsed < 0 || parsed > INT_MAX) {
+    return false;
+  }
+  *capacity = static_cast<int>(parsed);
+
+  const size_t items_end = input.find('\n', newline + 1U);
+  std::string line = input.substr(newline + 1U, items_end == std::string::npos
+                                                    ? std::string::npos
+                                                    : items_end - newline - 1U);
+  items->clear();
+  char *saveptr = nullptr;
+  for (char *token = strtok_r(line.data(), " ,\t\r\n", &saveptr); token != nullptr;
+       token = strtok_r(nullptr, " ,\t\r\n", &saveptr)) {
+    knapsack_item_t item{};
+    if (!ReferenceToken(token, &item)) {
+      return false;
+    }
+    items->push_back(item);
+  }
+  return !items->empty();
+}
+
+void ExpectMatchesReference(const std::string &input) {
+  int expected_cap = 0;
+  std::vector<knapsack_item_t> expected;
+  const bool expected_ok = ReferenceParse(input, &expected_cap, &expected);
+
+  int cap = 0;
+  knapsack_item_t *items = nullptr;
+  size_t count = 0;
+  const int rc = cli_parse_buffer(input.data(), input.size(), &cap, &items, &count);
+  ASSERT_EQ(rc == 0, expected_ok) << '"' << input << '"';
+  if (expected_ok) {
+    EXPECT_EQ(cap, expected_cap) << input;
+    ASSERT_EQ(count, expected.size()) << input;
+    for (size_t i = 0; i < count; ++i) {
+      EXPECT_EQ(items[i].weight, expected[i].weight) << input;
+      EXPECT_EQ(items[i].value, expected[i].value) << input;
+    }
+  }
+  std::free(items);
+}
+
+// A number as the scanner sees it at a word boundary: optional sign and
+// white space, leading zeros, lengths around 8 and 10 digits, INT_MAX.
+std::string RandomNumber(std::mt19937 &rng) {
+  static const char *const k_prefixes[] = {"", "", "", "+", "-", "\v", "\f+"};
+  static const char *const k_specials[] = {"2147483647", "2147483648", "4294967296", "0",
+                                           "99999999",   "100000000",  "12345678",   ""};
+  std::string out = k_prefixes[rng() % std::size(k_prefixes)];
+  out.append(rng() % 4U == 0U ? rng() % 12U : 0U, '0');
+  if (rng() % 3U == 0U) {
+    out += k_specials[rng() % std::size(k_specials)];
+  } else {
+    const size_t digits = 1U + rng() % 11U;
+    for (size_t i = 0; i < digits; ++i) {
+      out.push_back(static_cast<char>('0' + rng() % 10U));
+    }
+  }
+  return out;
+}
+
+std::string RandomItemsInput(std::mt19937 &rng) {
+  static const char *const k_delims[] = {" ", ",", "\t", " , ", "\r", "  "};
+  static const char *const k_junk[] = {"x", ":", "\v", "-", "\n", ""};
+  std::string input = RandomNumber(rng) + (rng() % 4U == 0U ? " \r" : "") + "\n";
+  const size_t tokens = rng() % 12U;
+  for (size_t t = 0; t < tokens; ++t) {
+    input += k_delims[rng() % std::size(k_delims)];
+    input += RandomNumber(rng) + ":" + RandomNumber(rng);
+    if (rng() % 8U == 0U) {
+      input += k_junk[rng() % std::size(k_junk)];
+    }
+  }
+  if (rng() % 2U == 0U) {
+    input += "\n";
+  }
+  return input;
+}
+
+} // namespace
+
+TEST(CliParseBinary, DecodesSavedInstance) {
+  const knapsack_item_t saved[] = {{2, 3}, {3, 4}, {4, 5}};
+  std::vector<char> bytes(knapsack_binary_instance_size(3));
+  ASSERT_EQ(knapsack_binary_save_instance(saved, 3, 9, bytes.data(), bytes.size(), nullptr),
+            KNAPSACK_OK);
+  int cap = 0;
+  knapsack_item_t *items = nullptr;
+  size_t count = 0;
+  ASSERT_EQ(cli_parse_binary(bytes.data(), bytes.size(), &cap, &items, &count), 0);
+  EXPECT_EQ(cap, 9);
+  ASSERT_EQ(count, 3U);
+  EXPECT_EQ(items[2].weight, 4);
+  EXPECT_EQ(items[2].value, 5);
+  std::free(items);
+
+  EXPECT_EQ(cli_parse_binary(bytes.data(), bytes.size() - 1U, &cap, &items, &count), -1);
+  EXPECT_EQ(items, nullptr);
+  const std::string text = "10\n1:2\n";
+  EXPECT_EQ(cli_parse_binary(text.data(), text.size(), &cap, &items, &count), -1);
+}
+
+TEST(CliPrintResultBinary, WritesTheLibraryRecord) {
+  size_t indices[] = {0, 2};
+  knapsack_result_t result = {7, 2, indices, 5, 7};
+  CapturedStream cs;
+  ASSERT_EQ(cli_print_result_binary(cs.get(), KNAPSACK_OK, &result), 0);
+  const std::string out = cs.read_all();
+  knapsack_status_t status = KNAPSACK_ERR_ALLOC;
+  knapsack_result_t loaded;
+  ASSERT_EQ(knapsack_binary_load_result(out.data(), out.size(), nullptr, &status, &loaded),
+            KNAPSACK_OK);
+  EXPECT_EQ(status, KNAPSACK_OK);
+  EXPECT_EQ(loaded.optimal_value, 7);
+  EXPECT_EQ(loaded.total_weight, 5);
+  ASSERT_EQ(loaded.selected_count, 2U);
+  EXPECT_EQ(loaded.selected_indices[1], 2U);
+  knapsack_result_free(&loaded);
+}
+
+TEST(CliParseOracle, MatchesReferenceOnFuzzCorpus) {
+  size_t files = 0;
+  for (const auto &entry : std::filesystem::directory_iterator(KNAPSACK_FUZZ_CORPUS_DIR)) {
+    std::ifstream stream(entry.path(), std::ios::binary);
+    std::ostringstream contents;
+    contents << stream.rdbuf();
+    ExpectMatchesReference(contents.str());
+    ++files;
+  }
+  EXPECT_GT(files, 0U);
+}
+
+TEST(CliParseOracle, MatchesReferenceOnGeneratedInputs) {
+  std::mt19937 rng(20261014U);
+  for (int trial = 0; trial < 20000; ++trial) {
+    ExpectMatchesReference(RandomItemsInput(rng));
+  }
+}
+
+TEST(CliParseOracle, MatchesReferenceAroundTokenLimit) {
+  for (size_t zeros = 55; zeros < 70; ++zeros) {
+    ExpectMatchesReference("5\n" + std::string(zeros, '0') + "1:2");
+    ExpectMatchesReference("5\n1:" + std::string(zeros, '0') + "2 3:4\n");
+    ExpectMatchesReference("5\n3:4," + std::string(zeros, '0') + "1:" + "0002");
+  }
+}
+
+TEST(CliParseOracle, MatchesReferenceOnRandomBytes) {
+  static const char k_alphabet[] = "0123456789::  ,\t\v\r\n+-x";
+  std::mt19937 rng(7U);
+  for (int trial = 0; trial < 20000; ++trial) {
+    std::string input = std::to_string(rng() % 100U) + "\n";
+    const size_t length = rng() % 40U;
+    for (size_t i = 0; i < length; ++i) {
+      input.push_back(k_alphabet[rng() % (sizeof k_alphabet - 1U)]);
+    }
+    ExpectMatchesReference(input);
+  }
+}
@@ -7,6 +7,8 @@
 #include <cstring>
 #include <filesystem>
 #include <map>
+#include <random>
+#include <sstream>
 #include <stdexcept>
 #include <string>
 #include <system_error>
@@ -14,6 +16,7 @@
 #include <vector>
 
 #include <fcntl.h>
+#include <poll.h>
 #include <spawn.h>
 #include <sys/wait.h>
 #include <unistd.h>
@@ -259,6 +262,39 @@ std::string drain_fd(int fd) {
   return out;
 }
 
+// Little-endian int32 fields, as the binary format stores them.
+void append_i32(std::string *out, long long value) {
+  const auto bits = static_cast<unsigned long long>(value);
+  for (int shift = 0; shift < 32; shift += 8) {
+    out->push_back(static_cast<char>((bits >> shift) & 0xFFU));
+  }
+}
+
+long long read_i32(const std::string &bytes, size_t offset) {
+  unsigned long long bits = 0;
+  for (size_t i = 0; i < 4; ++i) {
+    bits |= static_cast<unsigned long long>(static_cast<unsigned char>(bytes.at(offset + i)))
+            << (8 * i);
+  }
+  return bits >= 0x80000000ULL ? static_cast<long long>(bits) - 0x100000000LL
+                               : static_cast<long long>(bits);
+}
+
+// A binary columnar instance built by hand from the documented layout.
+std::string binary_instance(int capacity, const std::vector<std::pair<int, int>> &items) {
+  std::string out = "KNSI";
+  append_i32(&out, 1);
+  append_i32(&out, static_cast<long long>(items.size()));
+  append_i32(&out, capacity);
+  for (const auto &item : items) {
+    append_i32(&out, item.first);
+  }
+  for (const auto &item : items) {
+    append_i32(&out, item.second);
+  }
+  return out;
+}
+
 CommandResult run_demo(const std::vector<std::string> &args) {
   int out_pipe[2];
   int err_pipe[2];
@@ -317,6 +353,110 @@ CommandResult run_demo(const std::vector<std::string> &args) {
   return result;
 }
 
+std::vector<std::string> split_lines(const std::string &text) {
+  std::vector<std::string> lines;
+  std::istringstream in(text);
+  for (std::string line; std::getline(in, line);) {
+    lines.push_back(line);
+  }
+  return lines;
+}
+
+// knapsack_demo --stream on the far end of a pair of pipes, fed one record
+// at a time the way a long-lived sidecar would be.
+class StreamProcess {
+public:
+  explicit StreamProcess(const std::vector<std::string> &args) {
+    int in_pipe[2];
+    int out_pipe[2];
+    if (pipe(in_pipe) == -1 || pipe(out_pipe) == -1) {
+      throw std::system_error(errno, std::generic_category(), "pipe");
+    }
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addclose(&actions, in_pipe[1]);
+    posix_spawn_file_actions_addclose(&actions, out_pipe[0]);
+    posix_spawn_file_actions_adddup2(&actions, in_pipe[0], STDIN_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, out_pipe[1], STDOUT_FILENO);
+    posix_spawn_file_actions_addclose(&actions, in_pipe[0]);
+    posix_spawn_file_actions_addclose(&actions, out_pipe[1]);
+
+    std::vector<std::string> storage = args;
+    std::string prog = KNAPSACK_DEMO_PATH;
+    std::vector<char *> argv{prog.data()};
+    for (auto &a : storage) {
+      argv.push_back(a.data());
+    }
+    argv.push_back(nullptr);
+    const int rc = posix_spawn(&pid_, KNAPSACK_DEMO_PATH, &actions, nullptr, argv.data(), environ);
+    posix_spawn_file_actions_destroy(&actions);
+    close(in_pipe[0]);
+    close(out_pipe[1]);
+    to_child_ = in_pipe[1];
+    from_child_ = out_pipe[0];
+    if (rc != 0) {
+      throw std::system_error(rc, std::generic_category(), "posix_spawn");
+    }
+  }
+  ~StreamProcess() {
+    finish();
+    if (from_child_ != -1) {
+      close(from_child_);
+    }
+  }
+  StreamProcess(const StreamProcess &) = delete;
+  StreamProcess &operator=(const StreamProcess &) = delete;
+
+  void send(const std::string &text) const {
+    ASSERT_EQ(write(to_child_, text.data(), text.size()), static_cast<ssize_t>(text.size()));
+  }
+
+  // Next output line, or "<timeout>" if none arrives within five seconds.
+  std::string read_line() {
+    for (;;) {
+      const size_t newline = pending_.find('\n');
+      if (newline != std::string::npos) {
+        std::string line = pending_.substr(0, newline);
+        pending_.erase(0, newline + 1);
+        return line;
+      }
+      struct pollfd pfd = {from_child_, POLLIN, 0};
+      if (poll(&pfd, 1, 5000) <= 0) {
+        return "<timeout>";
+      }
+      char buf[256];
+      const ssize_t n = read(from_child_, buf, sizeof buf);
+      if (n <= 0) {
+        return "<eof>";
+      }
+      pending_.append(buf, static_cast<size_t>(n));
+    }
+  }
+
+  // Close the child's input and wait for it; returns its exit code.
+  int finish() {
+    if (to_child_ != -1) {
+      close(to_child_);
+      to_child_ = -1;
+    }
+    if (pid_ > 0) {
+      int status = 0;
+      while (waitpid(pid_, &status, 0) == -1 && errno == EINTR) {
+      }
+      pid_ = -1;
+      exit_code_ = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+    }
+    return exit_code_;
+  }
+
+private:
+  pid_t pid_ = -1;
+  int to_child_ = -1;
+  int from_child_ = -1;
+  int exit_code_ = -1;
+  std::string pending_;
+};
+
 } // namespace
 
 TEST(KnapsackIntegrationTest, RunsDemoAndPrintsSelection) {
@@ -354,6 +494,222 @@ TEST(KnapsackIntegrationTest, JsonFlagAcceptedAfterPath) {
   EXPECT_EQ(v.as_obj().at("status").as_str(), "ok");
 }
 
+TEST(KnapsackIntegrationTest, ValueOnlyPrintsValueAndWeight) {
+  TempFile input("10\n2:3 3:4 4:5 5:6\n");
+  CommandResult r = run_demo({"--value-only", input.path()});
+  EXPECT_EQ(r.exit_code, 0);
+  EXPECT_NE(r.stdout_text.find("Optimal value: 13"), std::string::npos);
+  EXPECT_NE(r.stdout_text.find("Total weight: 10"), std::string::npos);
+  EXPECT_EQ(r.stdout_text.find("Selected indices"), std::string::npos);
+}
+
+TEST(KnapsackIntegrationTest, ValueOnlyJsonOmitsIndices) {
+  TempFile input("10\n2:3 3:4 4:5 5:6\n");
+  CommandResult r = run_demo({input.path(), "--value-only", "--json"});
+  ASSERT_EQ(r.exit_code, 0) << r.stderr_text;
+  JsonValue v = parse_json(r.stdout_text);
+  ASSERT_TRUE(v.is_obj());
+  const auto &o = v.as_obj();
+  EXPECT_EQ(o.at("status").as_str(), "ok");
+  EXPECT_EQ(o.at("optimal_value").as_int(), 13);
+  EXPECT_EQ(o.at("total_weight").as_int(), 10);
+  EXPECT_EQ(o.count("selected_indices"), 0U);
+}
+
+TEST(KnapsackIntegrationTest, StatsAddJsonMember) {
+  TempFile input("10\n2:3 3:4 4:5 5:6\n");
+  for (const char *mode : {"--json", "--value-only"}) {
+    SCOPED_TRACE(mode);
+    CommandResult r = run_demo({"--stats", "--output-format=json", mode, input.path()});
+    ASSERT_EQ(r.exit_code, 0) << r.stderr_text;
+    JsonValue v = parse_json(r.stdout_text);
+    ASSERT_TRUE(v.is_obj());
+    const auto &o = v.as_obj();
+    EXPECT_EQ(o.at("optimal_value").as_int(), 13);
+    const auto &stats = o.at("stats").as_obj();
+    EXPECT_FALSE(stats.at("engine").as_str().empty());
+    EXPECT_FALSE(stats.at("kernel").as_str().empty());
+    EXPECT_GE(stats.at("cells").as_int(), 0);
+    for (const char *key : {"rows", "take_bits", "engine", "instance", "arena"}) {
+      EXPECT_GE(stats.at("bytes").as_obj().at(key).as_int(), 0) << key;
+    }
+    for (const char *key : {"validate", "dp", "select", "reconstruct"}) {
+      EXPECT_GE(stats.at("ns").as_obj().at(key).as_int(), 0) << key;
+    }
+  }
+}
+
+TEST(KnapsackIntegrationTest, StatsRequireSingleJsonSolve) {
+  TempFile input("10\n2:3 3:4 4:5 5:6\n");
+  for (const std::vector<std::string> &args :
+       {std::vector<std::string>{"--stats", input.path()},
+        std::vector<std::string>{"--stats", "--output-format=bin", input.path()},
+        std::vector<std::string>{"--stats", "--json", "--stream", input.path()}}) {
+    CommandResult r = run_demo(args);
+    EXPECT_NE(r.exit_code, 0);
+    EXPECT_NE(r.stderr_text.find("--stats requires --json"), std::string::npos);
+  }
+}
+
+TEST(KnapsackIntegrationTest, AcceptsVeryLongItemsLine) {
+  // The solver caps the item count, so the length comes from padding.
+  std::string content = "100\n";
+  for (int i = 0; i < 90; ++i) {
+    content += "50:1," + std::string(500, ' ');
+  }
+  content += "100:1000\n";
+  TempFile input(content);
+  CommandResult r = run_demo({"--value-only", input.path()});
+  ASSERT_EQ(r.exit_code, 0) << r.stderr_text;
+  EXPECT_NE(r.stdout_text.find("Optimal value: 1000"), std::string::npos);
+}
+
+TEST(KnapsackIntegrationTest, BinaryInputGivesSameAnswerAsText) {
+  TempFile input(binary_instance(10, {{2, 3}, {3, 4}, {4, 5}, {5, 6}}));
+  CommandResult r = run_demo({"--input-format=bin", input.path()});
+  ASSERT_EQ(r.exit_code, 0) << r.stderr_text;
+  EXPECT_NE(r.stdout_text.find("Optimal value: 13"), std::string::npos);
+  EXPECT_NE(r.stdout_text.find("Selected indices (3): 0 1 3"), std::string::npos);
+}
+
+TEST(KnapsackIntegrationTest, BinaryOutputIsResultRecord) {
+  TempFile input("10\n2:3 3:4 4:5 5:6\n");
+  CommandResult r = run_demo({"--output-format=bin", input.path()});
+  ASSERT_EQ(r.exit_code, 0) << r.stderr_text;
+  ASSERT_EQ(r.stdout_text.size(), 32U + 3U * 4U);
+  EXPECT_EQ(r.stdout_text.substr(0, 4), "KNSR");
+  EXPECT_EQ(read_i32(r.stdout_text, 4), 1);   // version
+  EXPECT_EQ(read_i32(r.stdout_text, 8), 0);   // status OK
+  EXPECT_EQ(read_i32(r.stdout_text, 12), 13); // optimal value
+  EXPECT_EQ(read_i32(r.stdout_text, 16), 10); // total weight
+  EXPECT_EQ(read_i32(r.stdout_text, 24), 3);  // selected count
+  EXPECT_EQ(read_i32(r.stdout_text, 32), 0);
+  EXPECT_EQ(read_i32(r.stdout_text, 36), 1);
+  EXPECT_EQ(read_i32(r.stdout_text, 40), 3);
+}
+
+TEST(KnapsackIntegrationTest, BinaryRoundTripValueOnly) {
+  TempFile input(binary_instance(10, {{2, 3}, {3, 4}, {4, 5}, {5, 6}}));
+  CommandResult r =
+      run_demo({"--input-format=bin", "--output-format=bin", "--value-only", input.path()});
+  ASSERT_EQ(r.exit_code, 0) << r.stderr_text;
+  ASSERT_EQ(r.stdout_text.size(), 32U);
+  EXPECT_EQ(read_i32(r.stdout_text, 12), 13);
+  EXPECT_EQ(read_i32(r.stdout_text, 24), 0);
+}
+
+TEST(KnapsackIntegrationTest, MalformedBinaryInputFails) {
+  std::string bytes = binary_instance(10, {{2, 3}});
+  bytes.pop_back();
+  TempFile input(bytes);
+  CommandResult r = run_demo({"--input-format=bin", "--json", input.path()});
+  EXPECT_NE(r.exit_code, 0);
+  JsonValue v = parse_json(r.stdout_text);
+  EXPECT_EQ(v.as_obj().at("code").as_str(), "INVALID_FORMAT");
+}
+
+TEST(KnapsackIntegrationTest, BinaryOutputReportsSolveErrors) {
+  TempFile input(binary_instance(10, {{0, 3}}));
+  CommandResult r = run_demo({"--input-format=bin", "--output-format=bin", input.path()});
+  EXPECT_NE(r.exit_code, 0);
+  ASSERT_EQ(r.stdout_text.size(), 32U);
+  EXPECT_EQ(read_i32(r.stdout_text, 8), 2); // KNAPSACK_ERR_INVALID_ITEMS
+  EXPECT_NE(r.stderr_text.find("Knapsack solve failed"), std::string::npos);
+}
+
+TEST(KnapsackIntegrationTest, UnknownFormatFails) {
+  TempFile input("10\n1:2\n");
+  CommandResult r = run_demo({"--input-format=csv", input.path()});
+  EXPECT_NE(r.exit_code, 0);
+  EXPECT_NE(r.stderr_text.find("Unknown input format: csv"), std::string::npos);
+  r = run_demo({"--output-format=xml", input.path()});
+  EXPECT_NE(r.exit_code, 0);
+  EXPECT_NE(r.stderr_text.find("Unknown output format: xml"), std::string::npos);
+}
+
+TEST(KnapsackIntegrationTest, StreamAnswersEveryRecordInOrder) {
+  TempFile input("10\n2:3 3:4 4:5 5:6\n\n5\n1:1,2:5\nabc\n1:2\n7\n3:x\n0\n1:0\n3\n");
+  for (const char *threads : {"--threads=1", "--threads=3"}) {
+    CommandResult r = run_demo({"--stream", threads, input.path()});
+    ASSERT_EQ(r.exit_code, 0) << r.stderr_text;
+    const std::vector<std::string> lines = split_lines(r.stdout_text);
+    ASSERT_EQ(lines.size(), 6U) << r.stdout_text;
+    EXPECT_EQ(lines[0], R"({"status":"ok","optimal_value":13,"selected_indices":[0,1,3]})");
+    EXPECT_EQ(lines[1], R"({"status":"ok","optimal_value":6,"selected_indices":[0,1]})");
+    EXPECT_EQ(parse_json(lines[2]).as_obj().at("code").as_str(), "INVALID_CAPACITY");
+    EXPECT_EQ(parse_json(lines[3]).as_obj().at("code").as_str(), "INVALID_ITEMS");
+    EXPECT_EQ(lines[4], R"({"status":"ok","optimal_value":0,"selected_indices":[]})");
+    // The last record has no items line.
+    EXPECT_EQ(parse_json(lines[5]).as_obj().at("code").as_str(), "INVALID_ITEMS");
+  }
+}
+
+TEST(KnapsackIntegrationTest, StreamWithPoolMatchesSerial) {
+  // More records than one pool batch, with some solve errors mixed in.
+  std::mt19937 rng(2024);
+  std::uniform_int_distribution<int> count_dist(1, 30);
+  std::uniform_int_distribution<int> weight_dist(0, 40);
+  std::uniform_int_distribution<int> value_dist(0, 100);
+  std::string content;
+  for (int record = 0; record < 700; ++record) {
+    content += std::to_string(record % 300) + "\n";
+    const int count = count_dist(rng);
+    for (int i = 0; i < count; ++i) {
+      content += std::to_string(weight_dist(rng)) + ":" + std::to_string(value_dist(rng)) + " ";
+    }
+    content += "\n";
+  }
+  TempFile input(content);
+  for (const char *extra : {"--json", "--value-only"}) {
+    CommandResult serial = run_demo({"--stream", extra, input.path()});
+    CommandResult pooled = run_demo({"--stream", "--threads=4", extra, input.path()});
+    ASSERT_EQ(serial.exit_code, 0) << serial.stderr_text;
+    ASSERT_EQ(pooled.exit_code, 0) << pooled.stderr_text;
+    EXPECT_EQ(split_lines(serial.stdout_text).size(), 700U);
+    EXPECT_EQ(pooled.stdout_text, serial.stdout_text);
+  }
+}
+
+TEST(KnapsackIntegrationTest, StreamAnswersBeforeInputEnds) {
+  for (const char *threads : {"--threads=1", "--threads=2"}) {
+    StreamProcess demo({"--stream", threads, "--value-only"});
+    demo.send("10\n2:3 3:4 4:5 5:6\n");
+    EXPECT_EQ(demo.read_line(), R"({"status":"ok","optimal_value":13,"total_weight":10})");
+    demo.send("5\n1:1,2:5\n");
+    EXPECT_EQ(demo.read_line(), R"({"status":"ok","optimal_value":6,"total_weight":3})");
+    EXPECT_EQ(demo.finish(), 0);
+    EXPECT_EQ(demo.read_line(), "<eof>");
+  }
+}
+
+TEST(KnapsackIntegrationTest, StreamWritesBinaryRecords) {
+  TempFile input("10\n2:3 3:4 4:5 5:6\nx\n\n");
+  CommandResult r = run_demo({"--stream", "--output-format=bin", "--value-only", input.path()});
+  ASSERT_EQ(r.exit_code, 0) << r.stderr_text;
+  ASSERT_EQ(r.stdout_text.size(), 64U);
+  EXPECT_EQ(read_i32(r.stdout_text, 8), 0);
+  EXPECT_EQ(read_i32(r.stdout_text, 12), 13);
+  EXPECT_EQ(r.stdout_text.substr(32, 4), "KNSR");
+  EXPECT_EQ(read_i32(r.stdout_text, 40), 4); // KNAPSACK_ERR_INVALID_CAPACITY
+  EXPECT_NE(r.stderr_text.find("Failed to parse capacity"), std::string::npos);
+}
+
+TEST(KnapsackIntegrationTest, StreamOptionsAreValidated) {
+  TempFile input("10\n1:2\n");
+  CommandResult r = run_demo({"--stream", "--input-format=bin", input.path()});
+  EXPECT_NE(r.exit_code, 0);
+  EXPECT_NE(r.stderr_text.find("--stream reads text records only"), std::string::npos);
+  r = run_demo({"--threads=2", input.path()});
+  EXPECT_NE(r.exit_code, 0);
+  EXPECT_NE(r.stderr_text.find("--threads requires --stream"), std::string::npos);
+  r = run_demo({"--stream", "--threads=many", input.path()});
+  EXPECT_NE(r.exit_code, 0);
+  EXPECT_NE(r.stderr_text.find("Invalid thread count: many"), std::string::npos);
+  r = run_demo({"--stream", "/nonexistent/knapsack/input.txt"});
+  EXPECT_NE(r.exit_code, 0);
+  EXPECT_NE(r.stderr_text.find("Failed to open input file"), std::string::npos);
+}
+
 TEST(KnapsackIntegrationTest, FailsGracefullyOnBadCapacity) {
   TempFile input("abc\n1:2\n");
   CommandResult r = run_demo({input.path()});
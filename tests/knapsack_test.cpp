@@ -1,10 +1,17 @@
 #include "knapsack/knapsack.h"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <climits>
 #include <cstdlib>
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
+#include <memory>
+#include <mutex>
 #include <random>
+#include <thread>
+#include <utility>
 #include <vector>
 
 using ::testing::ElementsAre;
@@ -242,7 +249,7 @@ TEST(KnapsackAllocatorTest, CustomAllocatorIsUsed) {
   knapsack_allocator_t alloc = {CountAlloc, CountCalloc, CountFree, &data};
   std::vector<knapsack_item_t> items = {{2, 3}, {3, 4}, {4, 8}};
   knapsack_result_t result;
-  ASSERT_EQ(knapsack_solve_status_ex(items.data(), items.size(), 10, &alloc, &result), KNAPSACK_OK);
+  ASSERT_EQ(knapsack_solve_status_ex(items.data(), items.size(), 6, &alloc, &result), KNAPSACK_OK);
   EXPECT_GT(data.calloc_calls, 0);
   knapsack_result_free_ex(&result, &alloc);
   EXPECT_GT(data.free_calls, 0);
@@ -251,7 +258,7 @@ TEST(KnapsackAllocatorTest, CustomAllocatorIsUsed) {
 TEST(KnapsackAllocatorTest, FirstCallocFailureReturnsAllocError) {
   CountingAllocator data{0, 0, 0, -1, 0};
   knapsack_allocator_t alloc = {CountAlloc, CountCalloc, CountFree, &data};
-  std::vector<knapsack_item_t> items = {{1, 1}};
+  std::vector<knapsack_item_t> items = {{3, 1}, {3, 2}};
   knapsack_result_t result;
   EXPECT_EQ(knapsack_solve_status_ex(items.data(), items.size(), 5, &alloc, &result),
             KNAPSACK_ERR_ALLOC);
@@ -267,6 +274,229 @@ TEST(KnapsackAllocatorTest, ReconstructionAllocFailureReturnsAllocError) {
             KNAPSACK_ERR_ALLOC);
 }
 
+// --- Reusable workspace -------------------------------------------------------
+
+TEST(KnapsackWorkspaceTest, MatchesOneShotSolveAcrossSizes) {
+  knapsack_workspace_t *ws = knapsack_workspace_create(nullptr);
+  ASSERT_NE(ws, nullptr);
+  std::mt19937 rng(777);
+  std::uniform_int_distribution<int> count_dist(1, 20);
+  std::uniform_int_distribution<int> weight_dist(1, 30);
+  std::uniform_int_distribution<int> value_dist(0, 50);
+  std::uniform_int_distribution<int> capacity_dist(0, 200);
+
+  for (int trial = 0; trial < 50; ++trial) {
+    std::vector<knapsack_item_t> items(static_cast<size_t>(count_dist(rng)));
+    for (auto &item : items) {
+      item = {weight_dist(rng), value_dist(rng)};
+    }
+    const int capacity = capacity_dist(rng);
+
+    knapsack_result_t expected;
+    knapsack_result_t observed;
+    SolveOk(items, capacity, &expected);
+    ASSERT_EQ(knapsack_workspace_solve(ws, items.data(), items.size(), capacity, &observed),
+              KNAPSACK_OK);
+    EXPECT_EQ(observed.optimal_value, expected.optimal_value);
+    EXPECT_EQ(std::vector<size_t>(observed.selected_indices,
+                                  observed.selected_indices + observed.selected_count),
+              std::vector<size_t>(expected.selected_indices,
+                                  expected.selected_indices + expected.selected_count));
+    knapsack_result_free(&observed);
+    knapsack_result_free(&expected);
+  }
+  knapsack_workspace_destroy(ws);
+}
+
+TEST(KnapsackWorkspaceTest, ReservedWorkspaceDoesNotReallocate) {
+  CountingAllocator data{0, 0, 0, -1, -1};
+  knapsack_allocator_t alloc = {CountAlloc, CountCalloc, CountFree, &data};
+  knapsack_workspace_t *ws = knapsack_workspace_create(&alloc);
+  ASSERT_NE(ws, nullptr);
+  ASSERT_EQ(knapsack_workspace_reserve(ws, 10U, 100), KNAPSACK_OK);
+  const int reserved_callocs = data.calloc_calls;
+  EXPECT_GT(reserved_callocs, 0);
+
+  std::vector<knapsack_item_t> items = {{2, 3}, {3, 4}, {4, 8}};
+  for (int capacity : {100, 10, 50, 0}) {
+    knapsack_result_t result;
+    ASSERT_EQ(knapsack_workspace_solve(ws, items.data(), items.size(), capacity, &result),
+              KNAPSACK_OK);
+    knapsack_result_free_ex(&result, &alloc);
+  }
+  EXPECT_EQ(data.calloc_calls, reserved_callocs);
+
+  // A larger instance grows the buffers once, then they are reused again.
+  // Weights are mixed so preprocessing can neither rescale nor skip the DP.
+  std::vector<knapsack_item_t> bigger;
+  for (int i = 0; i < 20; ++i) {
+    bigger.push_back({30 + i % 2, 1});
+  }
+  knapsack_result_t result;
+  ASSERT_EQ(knapsack_workspace_solve(ws, bigger.data(), bigger.size(), 500, &result), KNAPSACK_OK);
+  EXPECT_EQ(result.optimal_value, 16);
+  knapsack_result_free_ex(&result, &alloc);
+  const int grown_callocs = data.calloc_calls;
+  EXPECT_GT(grown_callocs, reserved_callocs);
+  ASSERT_EQ(knapsack_workspace_solve(ws, bigger.data(), bigger.size(), 500, &result), KNAPSACK_OK);
+  knapsack_result_free_ex(&result, &alloc);
+  EXPECT_EQ(data.calloc_calls, grown_callocs);
+
+  knapsack_workspace_destroy(ws);
+}
+
+TEST(KnapsackWorkspaceTest, ReserveUsesSingleArenaAllocation) {
+  CountingAllocator data{0, 0, 0, -1, -1};
+  knapsack_allocator_t alloc = {CountAlloc, CountCalloc, CountFree, &data};
+  knapsack_workspace_t *ws = knapsack_workspace_create(&alloc);
+  ASSERT_NE(ws, nullptr);
+  ASSERT_EQ(knapsack_workspace_reserve(ws, 100U, 100000), KNAPSACK_OK);
+  EXPECT_EQ(data.calloc_calls, 1);
+  knapsack_workspace_destroy(ws);
+}
+
+TEST(KnapsackWorkspaceTest, ReserveValidatesDimensions) {
+  knapsack_workspace_t *ws = knapsack_workspace_create(nullptr);
+  ASSERT_NE(ws, nullptr);
+  EXPECT_EQ(knapsack_workspace_reserve(ws, 0U, 10), KNAPSACK_ERR_INVALID_ITEMS);
+  EXPECT_EQ(knapsack_workspace_reserve(ws, 101U, 10), KNAPSACK_ERR_TOO_MANY_ITEMS);
+  EXPECT_EQ(knapsack_workspace_reserve(ws, 1U, -1), KNAPSACK_ERR_INVALID_CAPACITY);
+  EXPECT_EQ(knapsack_workspace_reserve(ws, 1U, 100001), KNAPSACK_ERR_INVALID_CAPACITY);
+  EXPECT_EQ(knapsack_workspace_reserve(nullptr, 1U, 1), KNAPSACK_ERR_INVALID_ARGUMENT);
+  knapsack_workspace_destroy(ws);
+}
+
+TEST(KnapsackWorkspaceTest, NullWorkspaceIsRejected) {
+  knapsack_item_t item = {1, 1};
+  knapsack_result_t result;
+  EXPECT_EQ(knapsack_workspace_solve(nullptr, &item, 1U, 1, &result),
+            KNAPSACK_ERR_INVALID_ARGUMENT);
+  EXPECT_EQ(result.selected_indices, nullptr);
+  knapsack_workspace_destroy(nullptr);
+}
+
+TEST(KnapsackWorkspaceTest, CreateFailureReturnsNull) {
+  CountingAllocator data{0, 0, 0, 0, -1};
+  knapsack_allocator_t alloc = {CountAlloc, CountCalloc, CountFree, &data};
+  EXPECT_EQ(knapsack_workspace_create(&alloc), nullptr);
+}
+
+TEST(KnapsackWorkspaceTest, GrowthFailureLeavesUsableWorkspace) {
+  CountingAllocator data{0, 0, 0, -1, 0};
+  knapsack_allocator_t alloc = {CountAlloc, CountCalloc, CountFree, &data};
+  knapsack_workspace_t *ws = knapsack_workspace_create(&alloc);
+  ASSERT_NE(ws, nullptr);
+  std::vector<knapsack_item_t> items = {{3, 7}, {4, 2}};
+  knapsack_result_t result;
+  EXPECT_EQ(knapsack_workspace_solve(ws, items.data(), items.size(), 5, &result),
+            KNAPSACK_ERR_ALLOC);
+
+  data.calloc_fail_after = -1;
+  ASSERT_EQ(knapsack_workspace_solve(ws, items.data(), items.size(), 5, &result), KNAPSACK_OK);
+  EXPECT_EQ(result.optimal_value, 7);
+  knapsack_result_free_ex(&result, &alloc);
+  knapsack_workspace_destroy(ws);
+}
+
+TEST(KnapsackWorkspaceTest, SolveOptsHonoursOptionsAndKeepsBuffers) {
+  CountingAllocator data{0, 0, 0, -1, -1};
+  knapsack_allocator_t alloc = {CountAlloc, CountCalloc, CountFree, &data};
+  knapsack_workspace_t *ws = knapsack_workspace_create(&alloc);
+  ASSERT_NE(ws, nullptr);
+  std::vector<knapsack_item_t> items = {{2, 3}, {3, 4}, {4, 8}, {5, 8}, {9, 10}};
+
+  knapsack_options_t options;
+  knapsack_options_init(&options);
+  options.reconstruct = KNAPSACK_RECONSTRUCT_NONE;
+  knapsack_result_t result;
+  ASSERT_EQ(knapsack_workspace_solve_opts(ws, items.data(), items.size(), 20, &options, &result),
+            KNAPSACK_OK);
+  EXPECT_EQ(result.optimal_value, 29);
+  EXPECT_EQ(result.selected_count, 0U);
+  EXPECT_EQ(result.selected_indices, nullptr);
+
+  // Defaults reconstruct the selection; a repeat solve reuses the buffers.
+  ASSERT_EQ(knapsack_workspace_solve_opts(ws, items.data(), items.size(), 10, nullptr, &result),
+            KNAPSACK_OK);
+  EXPECT_EQ(result.optimal_value, 16);
+  EXPECT_GT(result.selected_count, 0U);
+  knapsack_result_free_ex(&result, &alloc);
+  const int callocs = data.calloc_calls;
+  ASSERT_EQ(knapsack_workspace_solve_opts(ws, items.data(), items.size(), 10, nullptr, &result),
+            KNAPSACK_OK);
+  knapsack_result_free_ex(&result, &alloc);
+  EXPECT_EQ(data.calloc_calls, callocs);
+  knapsack_workspace_destroy(ws);
+}
+
+TEST(KnapsackWorkspaceTest, SolveOptsValidatesArguments) {
+  knapsack_workspace_t *ws = knapsack_workspace_create(nullptr);
+  ASSERT_NE(ws, nullptr);
+  knapsack_item_t item = {1, 1};
+  knapsack_result_t result;
+  EXPECT_EQ(knapsack_workspace_solve_opts(ws, &item, 1U, 1, nullptr, nullptr),
+            KNAPSACK_ERR_NULL_RESULT);
+  EXPECT_EQ(knapsack_workspace_solve_opts(nullptr, &item, 1U, 1, nullptr, &result),
+            KNAPSACK_ERR_INVALID_ARGUMENT);
+  EXPECT_EQ(result.selected_indices, nullptr);
+  knapsack_options_t options;
+  knapsack_options_init(&options);
+  options.limits.max_items = 0U;
+  EXPECT_EQ(knapsack_workspace_solve_opts(ws, &item, 1U, 1, &options, &result),
+            KNAPSACK_ERR_INVALID_ARGUMENT);
+  knapsack_workspace_destroy(ws);
+}
+
+// --- Caller-supplied buffer ---------------------------------------------------
+
+TEST(KnapsackBufferTest, MatchesOneShotSolveWithUnalignedBuffer) {
+  std::vector<knapsack_item_t> items = {{2, 3}, {3, 4}, {4, 8}, {5, 8}, {9, 10}};
+  const size_t needed = knapsack_workspace_size(items.size(), 20);
+  ASSERT_GT(needed, 0U);
+  std::vector<unsigned char> slab(needed + 1U, 0xAB);
+
+  knapsack_result_t result;
+  ASSERT_EQ(knapsack_solve_with_buffer(items.data(), items.size(), 20, slab.data() + 1, needed,
+                                       &result),
+            KNAPSACK_OK);
+  EXPECT_EQ(result.optimal_value, 29);
+  EXPECT_THAT(
+      std::vector<size_t>(result.selected_indices, result.selected_indices + result.selected_count),
+      ElementsAre(0U, 2U, 3U, 4U));
+  EXPECT_GE(reinterpret_cast<unsigned char *>(result.selected_indices), slab.data() + 1);
+  EXPECT_LT(reinterpret_cast<unsigned char *>(result.selected_indices), slab.data() + 1 + needed);
+
+  // Reusing the same (now dirty) slab yields the same answer.
+  ASSERT_EQ(knapsack_solve_with_buffer(items.data(), items.size(), 20, slab.data() + 1, needed,
+                                       &result),
+            KNAPSACK_OK);
+  EXPECT_EQ(result.optimal_value, 29);
+  EXPECT_EQ(result.selected_count, 4U);
+}
+
+TEST(KnapsackBufferTest, RejectsMissingOrUndersizedBuffer) {
+  knapsack_item_t item = {1, 1};
+  const size_t needed = knapsack_workspace_size(1U, 10);
+  std::vector<unsigned char> slab(needed);
+  knapsack_result_t result;
+  EXPECT_EQ(knapsack_solve_with_buffer(&item, 1U, 10, nullptr, needed, &result),
+            KNAPSACK_ERR_INVALID_ARGUMENT);
+  EXPECT_EQ(knapsack_solve_with_buffer(&item, 1U, 10, slab.data(), needed / 2U, &result),
+            KNAPSACK_ERR_INVALID_ARGUMENT);
+  EXPECT_EQ(knapsack_solve_with_buffer(&item, 1U, 10, slab.data(), needed, nullptr),
+            KNAPSACK_ERR_NULL_RESULT);
+  EXPECT_EQ(knapsack_solve_with_buffer(&item, 1U, -1, slab.data(), needed, &result),
+            KNAPSACK_ERR_INVALID_CAPACITY);
+}
+
+TEST(KnapsackBufferTest, WorkspaceSizeRejectsOutOfRangeDimensions) {
+  EXPECT_EQ(knapsack_workspace_size(0U, 10), 0U);
+  EXPECT_EQ(knapsack_workspace_size(101U, 10), 0U);
+  EXPECT_EQ(knapsack_workspace_size(1U, -1), 0U);
+  EXPECT_EQ(knapsack_workspace_size(1U, 100001), 0U);
+  EXPECT_GT(knapsack_workspace_size(100U, 100000), knapsack_workspace_size(100U, 1000));
+}
+
 // --- Property test -----------------------------------------------------------
 
 namespace {
@@ -329,6 +559,4171 @@ TEST(KnapsackSolverTest, FuzzMatchesBruteForceForSmallInstances) {
   }
 }
 
+namespace {
+// The classic two-row DP (copy prev into curr, then update ascending) that the
+// in-place solver replaced. Returns the selection reconstructed the same way.
+std::vector<size_t> ReferenceTwoRowSelection(const std::vector<knapsack_item_t> &items,
+                                             int capacity, int *optimal_value) {
+  const size_t width = static_cast<size_t>(capacity) + 1U;
+  std::vector<int> prev_value(width, 0);
+  std::vector<size_t> prev_weight(width, 0U);
+  std::vector<std::vector<bool>> take(items.size(), std::vector<bool>(width, false));
+  for (size_t i = 0; i < items.size(); ++i) {
+    std::vector<int> curr_value = prev_value;
+    std::vector<size_t> curr_weight = prev_weight;
+    const auto w = static_cast<size_t>(items[i].weight);
+    for (size_t cap = w; cap < width; ++cap) {
+      const int cand_val = prev_value[cap - w] + items[i].value;
+      const size_t cand_weight = prev_weight[cap - w] + w;
+      if (cand_val > curr_value[cap] ||
+          (cand_val == curr_value[cap] && cand_weight < curr_weight[cap])) {
+        curr_value[cap] = cand_val;
+        curr_weight[cap] = cand_weight;
+        take[i][cap] = true;
+      }
+    }
+    prev_value.swap(curr_value);
+    prev_weight.swap(curr_weight);
+  }
+  size_t best_cap = 0U;
+  for (size_t cap = 1U; cap < width; ++cap) {
+    if (prev_value[cap] > prev_value[best_cap] ||
+        (prev_value[cap] == prev_value[best_cap] && prev_weight[cap] < prev_weight[best_cap])) {
+      best_cap = cap;
+    }
+  }
+  *optimal_value = prev_value[best_cap];
+  std::vector<size_t> selected;
+  size_t cap = best_cap;
+  for (size_t i = items.size(); i-- > 0;) {
+    if (take[i][cap]) {
+      selected.insert(selected.begin(), i);
+      cap -= static_cast<size_t>(items[i].weight);
+    }
+  }
+  return selected;
+}
+} // namespace
+
+TEST(KnapsackSolverTest, InPlaceSweepMatchesTwoRowReference) {
+  std::mt19937 rng(4242);
+  std::uniform_int_distribution<int> count_dist(1, 40);
+  std::uniform_int_distribution<int> weight_dist(1, 60);
+  std::uniform_int_distribution<int> value_dist(0, 30); // small range => many ties
+  std::uniform_int_distribution<int> capacity_dist(0, 400);
+
+  for (int trial = 0; trial < 200; ++trial) {
+    std::vector<knapsack_item_t> items(static_cast<size_t>(count_dist(rng)));
+    for (auto &item : items) {
+      item = {weight_dist(rng), value_dist(rng)};
+    }
+    const int capacity = capacity_dist(rng);
+    int expected_value = 0;
+    const std::vector<size_t> expected = ReferenceTwoRowSelection(items, capacity, &expected_value);
+
+    knapsack_result_t result;
+    SolveOk(items, capacity, &result);
+    EXPECT_EQ(result.optimal_value, expected_value);
+    EXPECT_EQ(std::vector<size_t>(result.selected_indices,
+                                  result.selected_indices + result.selected_count),
+              expected);
+    knapsack_result_free(&result);
+  }
+}
+
+// --- DP kernels ---------------------------------------------------------------
+
+namespace {
+// Restores automatic kernel selection when a test ends.
+class KernelOverride {
+public:
+  explicit KernelOverride(knapsack_kernel_t kernel) : ok_(knapsack_set_kernel(kernel)) {}
+  ~KernelOverride() { knapsack_set_kernel(KNAPSACK_KERNEL_AUTO); }
+  KernelOverride(const KernelOverride &) = delete;
+  KernelOverride &operator=(const KernelOverride &) = delete;
+  knapsack_status_t status() const { return ok_; }
+
+private:
+  knapsack_status_t ok_;
+};
+
+const knapsack_kernel_t kSimdKernels[] = {KNAPSACK_KERNEL_SSE41, KNAPSACK_KERNEL_AVX2,
+                                          KNAPSACK_KERNEL_AVX512, KNAPSACK_KERNEL_NEON};
+
+struct Solution {
+  knapsack_status_t status;
+  int value;
+  std::vector<size_t> indices;
+};
+
+Solution SolveWithKernel(knapsack_kernel_t kernel, const std::vector<knapsack_item_t> &items,
+                         int capacity) {
+  KernelOverride guard(kernel);
+  EXPECT_EQ(guard.status(), KNAPSACK_OK);
+  // Kernels only run in the dense engine.
+  knapsack_options_t options;
+  knapsack_options_init(&options);
+  options.engine = KNAPSACK_ENGINE_DENSE;
+  knapsack_result_t result;
+  Solution out{knapsack_solve_opts(items.data(), items.size(), capacity, &options, &result), 0,
+               {}};
+  if (out.status == KNAPSACK_OK) {
+    out.value = result.optimal_value;
+    out.indices.assign(result.selected_indices, result.selected_indices + result.selected_count);
+    knapsack_result_free(&result);
+  }
+  return out;
+}
+} // namespace
+
+TEST(KnapsackKernelTest, AutoResolvesToSupportedKernel) {
+  const knapsack_kernel_t active = knapsack_active_kernel();
+  EXPECT_NE(active, KNAPSACK_KERNEL_AUTO);
+  EXPECT_TRUE(knapsack_kernel_supported(active));
+  EXPECT_TRUE(knapsack_kernel_supported(KNAPSACK_KERNEL_SCALAR));
+  EXPECT_STREQ(knapsack_kernel_name(KNAPSACK_KERNEL_SCALAR), "scalar");
+}
+
+TEST(KnapsackKernelTest, UnsupportedKernelIsRejected) {
+  for (knapsack_kernel_t kernel : kSimdKernels) {
+    if (!knapsack_kernel_supported(kernel)) {
+      const knapsack_kernel_t before = knapsack_active_kernel();
+      EXPECT_EQ(knapsack_set_kernel(kernel), KNAPSACK_ERR_INVALID_ARGUMENT);
+      EXPECT_EQ(knapsack_active_kernel(), before);
+    }
+  }
+}
+
+// NOLINTNEXTLINE(readability-function-cognitive-complexity)
+TEST(KnapsackKernelTest, SimdKernelsMatchScalarReference) {
+  std::mt19937 rng(9001);
+  std::uniform_int_distribution<int> count_dist(1, 30);
+  std::uniform_int_distribution<int> capacity_dist(0, 300);
+  std::uniform_int_distribution<int> value_dist(0, 40);
+
+  for (knapsack_kernel_t kernel : kSimdKernels) {
+    if (!knapsack_kernel_supported(kernel)) {
+      continue;
+    }
+    SCOPED_TRACE(knapsack_kernel_name(kernel));
+    for (int trial = 0; trial < 150; ++trial) {
+      const int capacity = capacity_dist(rng);
+      // Mix tiny weights (spans overlapping their own source) with large ones.
+      std::uniform_int_distribution<int> weight_dist(1, trial % 2 == 0 ? 5 : capacity + 2);
+      std::vector<knapsack_item_t> items(static_cast<size_t>(count_dist(rng)));
+      for (auto &item : items) {
+        item = {weight_dist(rng), value_dist(rng)};
+      }
+      const Solution expected = SolveWithKernel(KNAPSACK_KERNEL_SCALAR, items, capacity);
+      const Solution observed = SolveWithKernel(kernel, items, capacity);
+      ASSERT_EQ(observed.status, expected.status);
+      EXPECT_EQ(observed.value, expected.value);
+      EXPECT_EQ(observed.indices, expected.indices);
+    }
+  }
+}
+
+TEST(KnapsackKernelTest, SimdKernelsDetectOverflowInAnyLane) {
+  for (knapsack_kernel_t kernel : kSimdKernels) {
+    if (!knapsack_kernel_supported(kernel)) {
+      continue;
+    }
+    SCOPED_TRACE(knapsack_kernel_name(kernel));
+    // The overflowing cell sits at every possible lane position across trials.
+    for (int capacity = 2; capacity < 40; ++capacity) {
+      std::vector<knapsack_item_t> items = {{capacity - 1, INT_MAX}, {1, 1}};
+      EXPECT_EQ(SolveWithKernel(kernel, items, capacity).status, KNAPSACK_ERR_INT_OVERFLOW);
+    }
+    std::vector<knapsack_item_t> near_max = {{1, INT_MAX - 1}, {1, 1}};
+    const Solution ok = SolveWithKernel(kernel, near_max, 2);
+    ASSERT_EQ(ok.status, KNAPSACK_OK);
+    EXPECT_EQ(ok.value, INT_MAX);
+  }
+}
+
+// --- Options and Hirschberg reconstruction ------------------------------------
+
+namespace {
+knapsack_options_t HirschbergOptions() {
+  knapsack_options_t options;
+  knapsack_options_init(&options);
+  options.reconstruct = KNAPSACK_RECONSTRUCT_HIRSCHBERG;
+  return options;
+}
+
+long long SelectedWeight(const std::vector<knapsack_item_t> &items,
+                         const knapsack_result_t &result) {
+  long long total = 0;
+  for (size_t i = 0; i < result.selected_count; ++i) {
+    total += items[result.selected_indices[i]].weight;
+  }
+  return total;
+}
+
+long long SelectedValue(const std::vector<knapsack_item_t> &items,
+                        const knapsack_result_t &result) {
+  long long total = 0;
+  for (size_t i = 0; i < result.selected_count; ++i) {
+    total += items[result.selected_indices[i]].value;
+  }
+  return total;
+}
+
+// Records the largest single request so tests can bound peak scratch memory.
+struct PeakAllocator {
+  size_t largest;
+};
+
+void *PeakAlloc(size_t size, void *ud) {
+  auto *a = static_cast<PeakAllocator *>(ud);
+  a->largest = std::max(a->largest, size);
+  return std::malloc(size);
+}
+void *PeakCalloc(size_t n, size_t s, void *ud) {
+  auto *a = static_cast<PeakAllocator *>(ud);
+  a->largest = std::max(a->largest, n * s);
+  return std::calloc(n, s);
+}
+void PeakFree(void *p, void *ud) {
+  (void)ud;
+  std::free(p);
+}
+} // namespace
+
+TEST(KnapsackOptionsTest, InitSetsDefaults) {
+  knapsack_options_t options;
+  knapsack_options_init(&options);
+  EXPECT_EQ(options.allocator, nullptr);
+  EXPECT_EQ(options.reconstruct, KNAPSACK_RECONSTRUCT_BITSET);
+  EXPECT_EQ(options.limits.max_items, KNAPSACK_MAX_ITEMS);
+  EXPECT_EQ(options.limits.max_capacity, KNAPSACK_MAX_CAPACITY);
+  EXPECT_EQ(options.engine, KNAPSACK_ENGINE_AUTO);
+  EXPECT_EQ(options.cancel, nullptr);
+  EXPECT_EQ(options.cancel_user_data, nullptr);
+  EXPECT_FALSE(options.anytime);
+  EXPECT_EQ(options.device, KNAPSACK_DEVICE_CPU);
+  EXPECT_EQ(options.tile_cells, 0U);
+  knapsack_options_init(nullptr); // no-op
+}
+
+TEST(KnapsackOptionsTest, NullOptionsMatchDefaultSolve) {
+  std::vector<knapsack_item_t> items = {{2, 3}, {3, 4}, {4, 5}, {5, 6}};
+  knapsack_result_t result;
+  ASSERT_EQ(knapsack_solve_opts(items.data(), items.size(), 5, nullptr, &result), KNAPSACK_OK);
+  EXPECT_EQ(result.optimal_value, 7);
+  EXPECT_THAT(std::vector<size_t>(result.selected_indices,
+                                  result.selected_indices + result.selected_count),
+              ElementsAre(0U, 1U));
+  knapsack_result_free(&result);
+  EXPECT_EQ(knapsack_solve_opts(items.data(), items.size(), 5, nullptr, nullptr),
+            KNAPSACK_ERR_NULL_RESULT);
+}
+
+TEST(KnapsackOptionsTest, RejectsMalformedOptions) {
+  std::vector<knapsack_item_t> items = {{1, 1}};
+  knapsack_result_t result;
+  knapsack_options_t options;
+
+  knapsack_options_init(&options);
+  options.limits.max_items = 0U;
+  EXPECT_EQ(knapsack_solve_opts(items.data(), items.size(), 1, &options, &result),
+            KNAPSACK_ERR_INVALID_ARGUMENT);
+
+  knapsack_options_init(&options);
+  options.limits.max_capacity = -1;
+  EXPECT_EQ(knapsack_solve_opts(items.data(), items.size(), 1, &options, &result),
+            KNAPSACK_ERR_INVALID_ARGUMENT);
+
+  knapsack_options_init(&options);
+  const int bogus_mode = 42;
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wconversion"
+#endif
+  // NOLINTNEXTLINE(clang-analyzer-optin.core.EnumCastOutOfRange)
+  options.reconstruct = static_cast<knapsack_reconstruct_t>(bogus_mode);
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+  EXPECT_EQ(knapsack_solve_opts(items.data(), items.size(), 1, &options, &result),
+            KNAPSACK_ERR_INVALID_ARGUMENT);
+
+  // The bitset engine cannot raise the limits: its memory is count * capacity.
+  knapsack_options_init(&options);
+  options.limits.max_capacity = KNAPSACK_MAX_CAPACITY + 1;
+  EXPECT_EQ(knapsack_solve_opts(items.data(), items.size(), 1, &options, &result),
+            KNAPSACK_ERR_INVALID_ARGUMENT);
+  EXPECT_EQ(result.selected_indices, nullptr);
+  options.engine = KNAPSACK_ENGINE_DENSE;
+  EXPECT_EQ(knapsack_solve_opts(items.data(), items.size(), 1, &options, &result),
+            KNAPSACK_ERR_INVALID_ARGUMENT);
+
+  knapsack_options_init(&options);
+  options.reconstruct = KNAPSACK_RECONSTRUCT_HIRSCHBERG;
+  for (knapsack_engine_t engine :
+       {KNAPSACK_ENGINE_SPARSE, KNAPSACK_ENGINE_BRANCH_BOUND, KNAPSACK_ENGINE_TILED}) {
+    options.engine = engine;
+    EXPECT_EQ(knapsack_solve_opts(items.data(), items.size(), 1, &options, &result),
+              KNAPSACK_ERR_INVALID_ARGUMENT);
+  }
+
+  knapsack_options_init(&options);
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wconversion"
+#endif
+  // NOLINTNEXTLINE(clang-analyzer-optin.core.EnumCastOutOfRange)
+  options.engine = static_cast<knapsack_engine_t>(bogus_mode);
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+  EXPECT_EQ(knapsack_solve_opts(items.data(), items.size(), 1, &options, &result),
+            KNAPSACK_ERR_INVALID_ARGUMENT);
+
+  knapsack_options_init(&options);
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wconversion"
+#endif
+  // NOLINTNEXTLINE(clang-analyzer-optin.core.EnumCastOutOfRange)
+  options.device = static_cast<knapsack_device_t>(bogus_mode);
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+  EXPECT_EQ(knapsack_solve_opts(items.data(), items.size(), 1, &options, &result),
+            KNAPSACK_ERR_INVALID_ARGUMENT);
+}
+
+TEST(KnapsackOptionsTest, LoweredLimitsApplyToEveryMode) {
+  std::vector<knapsack_item_t> items = {{1, 1}, {1, 1}, {1, 1}};
+  for (knapsack_reconstruct_t mode :
+       {KNAPSACK_RECONSTRUCT_BITSET, KNAPSACK_RECONSTRUCT_HIRSCHBERG, KNAPSACK_RECONSTRUCT_NONE}) {
+    knapsack_options_t options;
+    knapsack_options_init(&options);
+    options.reconstruct = mode;
+    options.limits = {2U, 5};
+    knapsack_result_t result;
+    EXPECT_EQ(knapsack_solve_opts(items.data(), 3U, 5, &options, &result),
+              KNAPSACK_ERR_TOO_MANY_ITEMS);
+    EXPECT_EQ(knapsack_solve_opts(items.data(), 2U, 6, &options, &result),
+              KNAPSACK_ERR_INVALID_CAPACITY);
+    ASSERT_EQ(knapsack_solve_opts(items.data(), 2U, 5, &options, &result), KNAPSACK_OK);
+    EXPECT_EQ(result.optimal_value, 2);
+    knapsack_result_free(&result);
+  }
+}
+
+// NOLINTNEXTLINE(readability-function-cognitive-complexity)
+TEST(KnapsackHirschbergTest, MatchesBitsetValueAndWeight) {
+  const knapsack_options_t options = HirschbergOptions();
+  std::mt19937 rng(606);
+  std::uniform_int_distribution<int> count_dist(1, 60);
+  std::uniform_int_distribution<int> value_dist(0, 25); // small range => many ties
+  std::uniform_int_distribution<int> capacity_dist(0, 500);
+
+  for (int trial = 0; trial < 200; ++trial) {
+    const int capacity = capacity_dist(rng);
+    std::uniform_int_distribution<int> weight_dist(1, trial % 2 == 0 ? 8 : capacity + 2);
+    std::vector<knapsack_item_t> items(static_cast<size_t>(count_dist(rng)));
+    for (auto &item : items) {
+      item = {weight_dist(rng), value_dist(rng)};
+    }
+
+    knapsack_result_t expected;
+    SolveOk(items, capacity, &expected);
+    knapsack_result_t observed;
+    ASSERT_EQ(knapsack_solve_opts(items.data(), items.size(), capacity, &options, &observed),
+              KNAPSACK_OK);
+    EXPECT_EQ(observed.optimal_value, expected.optimal_value);
+    EXPECT_EQ(SelectedValue(items, observed), observed.optimal_value);
+    EXPECT_EQ(SelectedWeight(items, observed), SelectedWeight(items, expected));
+    for (size_t i = 1; i < observed.selected_count; ++i) {
+      EXPECT_LT(observed.selected_indices[i - 1], observed.selected_indices[i]);
+    }
+    knapsack_result_free(&expected);
+    knapsack_result_free(&observed);
+  }
+}
+
+TEST(KnapsackHirschbergTest, SolvesBeyondDefaultLimitsInLinearMemory) {
+  knapsack_options_t options = HirschbergOptions();
+  PeakAllocator peak{0U};
+  knapsack_allocator_t alloc = {PeakAlloc, PeakCalloc, PeakFree, &peak};
+  options.allocator = &alloc;
+  options.limits = {2000U, 1000000};
+
+  const size_t count = 2 * KNAPSACK_MAX_ITEMS;
+  const int capacity = 2 * KNAPSACK_MAX_CAPACITY;
+  std::mt19937 rng(31337);
+  std::uniform_int_distribution<int> weight_dist(1, capacity / 20);
+  std::uniform_int_distribution<int> value_dist(1, 1000);
+  std::vector<knapsack_item_t> items(count);
+  for (auto &item : items) {
+    item = {weight_dist(rng), value_dist(rng)};
+  }
+
+  // Value-only reference DP.
+  std::vector<int> best(static_cast<size_t>(capacity) + 1U, 0);
+  for (const auto &item : items) {
+    for (int cap = capacity; cap >= item.weight; --cap) {
+      best[static_cast<size_t>(cap)] =
+          std::max(best[static_cast<size_t>(cap)],
+                   best[static_cast<size_t>(cap - item.weight)] + item.value);
+    }
+  }
+
+  knapsack_result_t result;
+  ASSERT_EQ(knapsack_solve_opts(items.data(), count, capacity, &options, &result), KNAPSACK_OK);
+  EXPECT_EQ(result.optimal_value, best[static_cast<size_t>(capacity)]);
+  EXPECT_EQ(SelectedValue(items, result), result.optimal_value);
+  EXPECT_LE(SelectedWeight(items, result), capacity);
+  // Four value/weight rows plus slack; a decision bitset alone would be
+  // count * (capacity + 1) / 8 = 5 MB.
+  EXPECT_LT(peak.largest, 20U * (static_cast<size_t>(capacity) + 1U));
+  knapsack_result_free_ex(&result, &alloc);
+}
+
+TEST(KnapsackHirschbergTest, DetectsValueOverflow) {
+  const knapsack_options_t options = HirschbergOptions();
+  std::vector<knapsack_item_t> items = {{1, INT_MAX}, {1, 1}};
+  knapsack_result_t result;
+  EXPECT_EQ(knapsack_solve_opts(items.data(), items.size(), 2, &options, &result),
+            KNAPSACK_ERR_INT_OVERFLOW);
+  EXPECT_EQ(result.selected_indices, nullptr);
+  ASSERT_EQ(knapsack_solve_opts(items.data(), items.size(), 1, &options, &result), KNAPSACK_OK);
+  EXPECT_EQ(result.optimal_value, INT_MAX);
+  knapsack_result_free(&result);
+}
+
+TEST(KnapsackHirschbergTest, HandlesEmptySelections) {
+  const knapsack_options_t options = HirschbergOptions();
+  std::vector<knapsack_item_t> items = {{5, 3}, {2, 0}, {7, 9}};
+  knapsack_result_t result;
+  ASSERT_EQ(knapsack_solve_opts(items.data(), items.size(), 0, &options, &result), KNAPSACK_OK);
+  EXPECT_EQ(result.optimal_value, 0);
+  EXPECT_EQ(result.selected_count, 0U);
+  EXPECT_EQ(result.selected_indices, nullptr);
+  ASSERT_EQ(knapsack_solve_opts(items.data(), items.size(), 4, &options, &result), KNAPSACK_OK);
+  EXPECT_EQ(result.optimal_value, 0); // only the zero-value item fits; it is not taken
+  EXPECT_EQ(result.selected_count, 0U);
+}
+
+TEST(KnapsackHirschbergTest, AllocationFailuresReturnAllocError) {
+  std::vector<knapsack_item_t> items = {{1, 1}, {2, 3}, {3, 2}};
+  knapsack_options_t options = HirschbergOptions();
+
+  CountingAllocator arena_fails{0, 0, 0, -1, 0};
+  knapsack_allocator_t alloc = {CountAlloc, CountCalloc, CountFree, &arena_fails};
+  options.allocator = &alloc;
+  knapsack_result_t result;
+  EXPECT_EQ(knapsack_solve_opts(items.data(), items.size(), 5, &options, &result),
+            KNAPSACK_ERR_ALLOC);
+
+  CountingAllocator indices_fail{0, 0, 0, 0, -1};
+  alloc.user_data = &indices_fail;
+  EXPECT_EQ(knapsack_solve_opts(items.data(), items.size(), 5, &options, &result),
+            KNAPSACK_ERR_ALLOC);
+  EXPECT_EQ(indices_fail.calloc_calls, 1); // one arena for the whole recursion
+}
+
+// --- Parallel DP ----------------------------------------------------------------
+
+namespace {
+// Destroys the pool when a test ends.
+struct PoolDeleter {
+  void operator()(knapsack_thread_pool_t *pool) const { knapsack_thread_pool_destroy(pool); }
+};
+using PoolPtr = std::unique_ptr<knapsack_thread_pool_t, PoolDeleter>;
+
+Solution SolveWithOptions(const std::vector<knapsack_item_t> &items, int capacity,
+                          const knapsack_options_t &options) {
+  knapsack_result_t result;
+  Solution out{knapsack_solve_opts(items.data(), items.size(), capacity, &options, &result), 0, {}};
+  if (out.status == KNAPSACK_OK) {
+    out.value = result.optimal_value;
+    out.indices.assign(result.selected_indices, result.selected_indices + result.selected_count);
+    knapsack_result_free_ex(&result, options.allocator);
+  }
+  return out;
+}
+
+knapsack_options_t ParallelOptions(knapsack_thread_pool_t *pool) {
+  knapsack_options_t options;
+  knapsack_options_init(&options);
+  options.pool = pool;
+  options.parallel_min_width = 0U; // split every row the pool can
+  options.engine = KNAPSACK_ENGINE_DENSE;
+  return options;
+}
+} // namespace
+
+TEST(KnapsackThreadPoolTest, ReportsSize) {
+  PoolPtr pool(knapsack_thread_pool_create(3U, nullptr));
+  ASSERT_NE(pool, nullptr);
+  EXPECT_EQ(knapsack_thread_pool_size(pool.get()), 3U);
+  PoolPtr automatic(knapsack_thread_pool_create(0U, nullptr));
+  ASSERT_NE(automatic, nullptr);
+  EXPECT_GE(knapsack_thread_pool_size(automatic.get()), 1U);
+  EXPECT_EQ(knapsack_thread_pool_size(nullptr), 0U);
+  knapsack_thread_pool_destroy(nullptr);
+}
+
+TEST(KnapsackThreadPoolTest, CreateFailureReturnsNull) {
+  for (int fail_after = 0; fail_after < 3; ++fail_after) {
+    CountingAllocator data{0, 0, 0, fail_after, -1};
+    knapsack_allocator_t alloc = {CountAlloc, CountCalloc, CountFree, &data};
+    EXPECT_EQ(knapsack_thread_pool_create(4U, &alloc), nullptr);
+  }
+}
+
+// NOLINTNEXTLINE(readability-function-cognitive-complexity)
+TEST(KnapsackParallelTest, MatchesSerialSelection) {
+  std::mt19937 rng(2718);
+  std::uniform_int_distribution<int> count_dist(1, 40);
+  std::uniform_int_distribution<int> capacity_dist(0, 20000);
+  std::uniform_int_distribution<int> value_dist(0, 50);
+
+  for (size_t threads : {2U, 3U, 4U, 7U}) {
+    SCOPED_TRACE(threads);
+    PoolPtr pool(knapsack_thread_pool_create(threads, nullptr));
+    ASSERT_NE(pool, nullptr);
+    const knapsack_options_t options = ParallelOptions(pool.get());
+    for (int trial = 0; trial < 25; ++trial) {
+      const int capacity = capacity_dist(rng);
+      // Small weights keep most cells live; large ones make spans start
+      // inside a later worker's chunk.
+      std::uniform_int_distribution<int> weight_dist(1, trial % 2 == 0 ? 300 : capacity + 2);
+      std::vector<knapsack_item_t> items(static_cast<size_t>(count_dist(rng)));
+      for (auto &item : items) {
+        item = {weight_dist(rng), value_dist(rng)};
+      }
+      const Solution expected = SolveWithKernel(knapsack_active_kernel(), items, capacity);
+      const Solution observed = SolveWithOptions(items, capacity, options);
+      ASSERT_EQ(observed.status, expected.status);
+      EXPECT_EQ(observed.value, expected.value);
+      EXPECT_EQ(observed.indices, expected.indices);
+    }
+  }
+}
+
+TEST(KnapsackParallelTest, DetectsOverflowInAnyChunk) {
+  PoolPtr pool(knapsack_thread_pool_create(4U, nullptr));
+  ASSERT_NE(pool, nullptr);
+  const knapsack_options_t options = ParallelOptions(pool.get());
+  for (int capacity : {1023, 1024, 2047, 2048, 3000, 4095, 4096, 5000}) {
+    SCOPED_TRACE(capacity);
+    std::vector<knapsack_item_t> items = {{3, 1}, {capacity - 1, INT_MAX}, {1, 1}, {2, 2}};
+    EXPECT_EQ(SolveWithOptions(items, capacity, options).status, KNAPSACK_ERR_INT_OVERFLOW);
+  }
+}
+
+TEST(KnapsackParallelTest, NarrowRowsStaySerial) {
+  PoolPtr pool(knapsack_thread_pool_create(4U, nullptr));
+  ASSERT_NE(pool, nullptr);
+  std::vector<knapsack_item_t> items = {{2, 3}, {3, 4}, {4, 8}, {5000, 9}, {4000, 6}};
+  const int capacity = 8191;
+
+  knapsack_options_t serial;
+  knapsack_options_init(&serial);
+  serial.engine = KNAPSACK_ENGINE_DENSE;
+  PeakAllocator serial_peak{0U};
+  knapsack_allocator_t serial_alloc = {PeakAlloc, PeakCalloc, PeakFree, &serial_peak};
+  serial.allocator = &serial_alloc;
+  const Solution expected = SolveWithOptions(items, capacity, serial);
+
+  // Below parallel_min_width the pool is ignored: same arena as serial.
+  knapsack_options_t below = serial;
+  PeakAllocator below_peak{0U};
+  knapsack_allocator_t below_alloc = {PeakAlloc, PeakCalloc, PeakFree, &below_peak};
+  below.allocator = &below_alloc;
+  below.pool = pool.get();
+  below.parallel_min_width = static_cast<size_t>(capacity) + 2U;
+  EXPECT_EQ(SolveWithOptions(items, capacity, below).indices, expected.indices);
+  EXPECT_EQ(below_peak.largest, serial_peak.largest);
+
+  // At the threshold the parallel DP runs and needs its second row pair.
+  knapsack_options_t at = below;
+  PeakAllocator at_peak{0U};
+  knapsack_allocator_t at_alloc = {PeakAlloc, PeakCalloc, PeakFree, &at_peak};
+  at.allocator = &at_alloc;
+  at.parallel_min_width = static_cast<size_t>(capacity) + 1U;
+  EXPECT_EQ(SolveWithOptions(items, capacity, at).indices, expected.indices);
+  EXPECT_GT(at_peak.largest, serial_peak.largest);
+}
+
+TEST(KnapsackParallelTest, PoolIsSharedAcrossThreads) {
+  PoolPtr pool(knapsack_thread_pool_create(3U, nullptr));
+  ASSERT_NE(pool, nullptr);
+  const knapsack_options_t options = ParallelOptions(pool.get());
+  std::vector<knapsack_item_t> items;
+  for (int i = 1; i <= 30; ++i) {
+    items.push_back({37 * i % 211 + 1, 53 * i % 97});
+  }
+  const Solution expected = SolveWithKernel(knapsack_active_kernel(), items, 4000);
+
+  std::vector<Solution> observed(4);
+  std::vector<std::thread> callers;
+  for (auto &slot : observed) {
+    callers.emplace_back([&slot, &items, &options] {
+      for (int round = 0; round < 5; ++round) {
+        slot = SolveWithOptions(items, 4000, options);
+      }
+    });
+  }
+  for (auto &caller : callers) {
+    caller.join();
+  }
+  for (const auto &solution : observed) {
+    EXPECT_EQ(solution.status, KNAPSACK_OK);
+    EXPECT_EQ(solution.indices, expected.indices);
+  }
+}
+
+// --- Value-only solves --------------------------------------------------------
+
+namespace {
+knapsack_options_t ValueOnlyOptions() {
+  knapsack_options_t options;
+  knapsack_options_init(&options);
+  options.reconstruct = KNAPSACK_RECONSTRUCT_NONE;
+  return options;
+}
+} // namespace
+
+// NOLINTNEXTLINE(readability-function-cognitive-complexity)
+TEST(KnapsackValueOnlyTest, MatchesFullSolveValueAndWeight) {
+  const knapsack_options_t options = ValueOnlyOptions();
+  const knapsack_options_t hirschberg = HirschbergOptions();
+  std::mt19937 rng(909);
+  std::uniform_int_distribution<int> count_dist(1, 60);
+  std::uniform_int_distribution<int> value_dist(0, 25); // small range => many ties
+  std::uniform_int_distribution<int> capacity_dist(0, 500);
+
+  for (int trial = 0; trial < 200; ++trial) {
+    const int capacity = capacity_dist(rng);
+    std::uniform_int_distribution<int> weight_dist(1, trial % 2 == 0 ? 8 : capacity + 2);
+    std::vector<knapsack_item_t> items(static_cast<size_t>(count_dist(rng)));
+    for (auto &item : items) {
+      item = {weight_dist(rng), value_dist(rng)};
+    }
+
+    knapsack_result_t expected;
+    SolveOk(items, capacity, &expected);
+    EXPECT_EQ(expected.total_weight, SelectedWeight(items, expected));
+    knapsack_result_t recovered;
+    ASSERT_EQ(knapsack_solve_opts(items.data(), items.size(), capacity, &hirschberg, &recovered),
+              KNAPSACK_OK);
+    EXPECT_EQ(recovered.total_weight, expected.total_weight);
+    knapsack_result_t observed;
+    ASSERT_EQ(knapsack_solve_opts(items.data(), items.size(), capacity, &options, &observed),
+              KNAPSACK_OK);
+    EXPECT_EQ(observed.optimal_value, expected.optimal_value);
+    EXPECT_EQ(observed.total_weight, expected.total_weight);
+    EXPECT_EQ(observed.selected_count, 0U);
+    EXPECT_EQ(observed.selected_indices, nullptr);
+    knapsack_result_free(&expected);
+    knapsack_result_free(&recovered);
+    knapsack_result_free(&observed);
+  }
+}
+
+TEST(KnapsackValueOnlyTest, UsesOneRowBeyondDefaultLimits) {
+  knapsack_options_t options = ValueOnlyOptions();
+  PeakAllocator peak{0U};
+  knapsack_allocator_t alloc = {PeakAlloc, PeakCalloc, PeakFree, &peak};
+  options.allocator = &alloc;
+  options.limits = {2000U, 1000000};
+
+  const size_t count = 2 * KNAPSACK_MAX_ITEMS;
+  const int capacity = 2 * KNAPSACK_MAX_CAPACITY;
+  std::mt19937 rng(4242);
+  std::uniform_int_distribution<int> weight_dist(1, capacity / 20);
+  std::uniform_int_distribution<int> value_dist(1, 1000);
+  std::vector<knapsack_item_t> items(count);
+  for (auto &item : items) {
+    item = {weight_dist(rng), value_dist(rng)};
+  }
+
+  knapsack_options_t reference = HirschbergOptions();
+  reference.limits = options.limits;
+  knapsack_result_t expected;
+  ASSERT_EQ(knapsack_solve_opts(items.data(), count, capacity, &reference, &expected),
+            KNAPSACK_OK);
+
+  knapsack_result_t result;
+  ASSERT_EQ(knapsack_solve_opts(items.data(), count, capacity, &options, &result), KNAPSACK_OK);
+  EXPECT_EQ(result.optimal_value, expected.optimal_value);
+  EXPECT_EQ(result.total_weight, expected.total_weight);
+  // One value/weight row pair plus alignment padding.
+  EXPECT_LT(peak.largest, 9U * (static_cast<size_t>(capacity) + 1U));
+  knapsack_result_free(&expected);
+  knapsack_result_free_ex(&result, &alloc);
+}
+
+TEST(KnapsackValueOnlyTest, SingleArenaAllocation) {
+  std::vector<knapsack_item_t> items = {{2, 3}, {3, 4}, {4, 5}, {5, 6}};
+  knapsack_options_t options = ValueOnlyOptions();
+  CountingAllocator data{0, 0, 0, -1, -1};
+  knapsack_allocator_t alloc = {CountAlloc, CountCalloc, CountFree, &data};
+  options.allocator = &alloc;
+
+  knapsack_result_t result;
+  ASSERT_EQ(knapsack_solve_opts(items.data(), items.size(), 5, &options, &result), KNAPSACK_OK);
+  EXPECT_EQ(result.optimal_value, 7);
+  EXPECT_EQ(result.total_weight, 5);
+  EXPECT_EQ(data.alloc_calls, 0);
+  EXPECT_EQ(data.calloc_calls, 1);
+  knapsack_result_free_ex(&result, &alloc);
+  EXPECT_EQ(result.total_weight, 0);
+
+  data = {0, 0, 0, -1, 0};
+  EXPECT_EQ(knapsack_solve_opts(items.data(), items.size(), 5, &options, &result),
+            KNAPSACK_ERR_ALLOC);
+}
+
+TEST(KnapsackValueOnlyTest, DetectsValueOverflow) {
+  const knapsack_options_t options = ValueOnlyOptions();
+  std::vector<knapsack_item_t> items = {{1, INT_MAX}, {1, 1}};
+  knapsack_result_t result;
+  EXPECT_EQ(knapsack_solve_opts(items.data(), items.size(), 2, &options, &result),
+            KNAPSACK_ERR_INT_OVERFLOW);
+  ASSERT_EQ(knapsack_solve_opts(items.data(), items.size(), 1, &options, &result), KNAPSACK_OK);
+  EXPECT_EQ(result.optimal_value, INT_MAX);
+  EXPECT_EQ(result.total_weight, 1);
+}
+
+TEST(KnapsackValueOnlyTest, ParallelMatchesSerial) {
+  PoolPtr pool(knapsack_thread_pool_create(4U, nullptr));
+  ASSERT_NE(pool, nullptr);
+  knapsack_options_t parallel = ParallelOptions(pool.get());
+  parallel.reconstruct = KNAPSACK_RECONSTRUCT_NONE;
+  const knapsack_options_t serial = ValueOnlyOptions();
+  std::mt19937 rng(5150);
+  std::uniform_int_distribution<int> capacity_dist(1000, 20000);
+  std::uniform_int_distribution<int> value_dist(0, 50);
+
+  for (int trial = 0; trial < 20; ++trial) {
+    const int capacity = capacity_dist(rng);
+    std::uniform_int_distribution<int> weight_dist(1, trial % 2 == 0 ? 300 : capacity + 2);
+    std::vector<knapsack_item_t> items(30);
+    for (auto &item : items) {
+      item = {weight_dist(rng), value_dist(rng)};
+    }
+    knapsack_result_t expected;
+    ASSERT_EQ(knapsack_solve_opts(items.data(), items.size(), capacity, &serial, &expected),
+              KNAPSACK_OK);
+    knapsack_result_t observed;
+    ASSERT_EQ(knapsack_solve_opts(items.data(), items.size(), capacity, &parallel, &observed),
+              KNAPSACK_OK);
+    EXPECT_EQ(observed.optimal_value, expected.optimal_value);
+    EXPECT_EQ(observed.total_weight, expected.total_weight);
+  }
+}
+
+// --- Preprocessing -------------------------------------------------------------
+
+namespace {
+// Best (value, minimal weight) over all subsets that fit.
+std::pair<long long, long long> BruteForceBest(const std::vector<knapsack_item_t> &items,
+                                               int capacity) {
+  std::pair<long long, long long> best{0, 0};
+  const size_t total = 1ULL << items.size();
+  for (size_t mask = 0; mask < total; ++mask) {
+    long long weight = 0;
+    long long value = 0;
+    for (size_t i = 0; i < items.size(); ++i) {
+      if ((mask & (1ULL << i)) != 0U) {
+        weight += items[i].weight;
+        value += items[i].value;
+      }
+    }
+    if (weight <= capacity &&
+        (value > best.first || (value == best.first && weight < best.second))) {
+      best = {value, weight};
+    }
+  }
+  return best;
+}
+} // namespace
+
+// NOLINTNEXTLINE(readability-function-cognitive-complexity)
+TEST(KnapsackPreprocessTest, MatchesBruteForceAcrossReductions) {
+  knapsack_options_t modes[3];
+  for (auto &mode : modes) {
+    knapsack_options_init(&mode);
+  }
+  modes[1].reconstruct = KNAPSACK_RECONSTRUCT_HIRSCHBERG;
+  modes[2].reconstruct = KNAPSACK_RECONSTRUCT_NONE;
+  std::mt19937 rng(1010);
+  std::uniform_int_distribution<int> count_dist(1, 12);
+  std::uniform_int_distribution<int> value_dist(0, 20);
+  std::uniform_int_distribution<int> capacity_dist(0, 90);
+  std::uniform_int_distribution<int> scale_dist(1, 4);
+
+  for (int trial = 0; trial < 300; ++trial) {
+    // A shared factor exercises GCD scaling; wide weights drop items and
+    // small capacities relative to the total exercise the all-fit path.
+    const int scale = scale_dist(rng);
+    std::uniform_int_distribution<int> weight_dist(1, trial % 3 == 0 ? 40 : 12);
+    std::vector<knapsack_item_t> items(static_cast<size_t>(count_dist(rng)));
+    for (auto &item : items) {
+      item = {scale * weight_dist(rng), value_dist(rng)};
+    }
+    const int capacity = capacity_dist(rng) * (trial % 2 == 0 ? 1 : 4);
+    const auto expected = BruteForceBest(items, capacity);
+
+    for (const auto &options : modes) {
+      SCOPED_TRACE(static_cast<int>(options.reconstruct));
+      knapsack_result_t result;
+      ASSERT_EQ(knapsack_solve_opts(items.data(), items.size(), capacity, &options, &result),
+                KNAPSACK_OK);
+      EXPECT_EQ(result.optimal_value, expected.first);
+      EXPECT_EQ(result.total_weight, expected.second);
+      if (options.reconstruct != KNAPSACK_RECONSTRUCT_NONE) {
+        EXPECT_EQ(SelectedValue(items, result), expected.first);
+        EXPECT_EQ(SelectedWeight(items, result), expected.second);
+        for (size_t i = 1; i < result.selected_count; ++i) {
+          EXPECT_LT(result.selected_indices[i - 1], result.selected_indices[i]);
+        }
+      }
+      knapsack_result_free(&result);
+    }
+  }
+}
+
+TEST(KnapsackPreprocessTest, HeavyItemsKeepOriginalIndices) {
+  std::vector<knapsack_item_t> items = {{50, 99}, {2, 3}, {60, 99}, {3, 4}, {4, 8}, {70, 1}};
+  std::vector<unsigned char> slab(knapsack_workspace_size(items.size(), 7));
+  knapsack_result_t results[2];
+  ASSERT_EQ(knapsack_solve_status(items.data(), items.size(), 7, &results[0]), KNAPSACK_OK);
+  ASSERT_EQ(knapsack_solve_with_buffer(items.data(), items.size(), 7, slab.data(), slab.size(),
+                                       &results[1]),
+            KNAPSACK_OK);
+  for (const auto &result : results) {
+    EXPECT_EQ(result.optimal_value, 12);
+    EXPECT_EQ(result.total_weight, 7);
+    EXPECT_THAT(std::vector<size_t>(result.selected_indices,
+                                    result.selected_indices + result.selected_count),
+                ElementsAre(3U, 4U));
+  }
+  knapsack_result_free(&results[0]);
+}
+
+TEST(KnapsackPreprocessTest, EverythingFitsSkipsTheArena) {
+  CountingAllocator data{0, 0, 0, -1, -1};
+  knapsack_allocator_t alloc = {CountAlloc, CountCalloc, CountFree, &data};
+  std::vector<knapsack_item_t> items = {{2, 3}, {3, 0}, {40, 9}, {4, 8}};
+  knapsack_result_t result;
+  ASSERT_EQ(knapsack_solve_status_ex(items.data(), items.size(), 30, &alloc, &result),
+            KNAPSACK_OK);
+  EXPECT_EQ(result.optimal_value, 11);
+  EXPECT_EQ(result.total_weight, 6); // the zero-value item only adds weight
+  EXPECT_THAT(
+      std::vector<size_t>(result.selected_indices, result.selected_indices + result.selected_count),
+      ElementsAre(0U, 3U));
+  EXPECT_EQ(data.calloc_calls, 0);
+  EXPECT_EQ(data.alloc_calls, 1); // the index array
+  knapsack_result_free_ex(&result, &alloc);
+
+  // Nothing fits at all: no allocation either.
+  ASSERT_EQ(knapsack_solve_status_ex(items.data(), items.size(), 1, &alloc, &result),
+            KNAPSACK_OK);
+  EXPECT_EQ(result.optimal_value, 0);
+  EXPECT_EQ(result.selected_indices, nullptr);
+  EXPECT_EQ(data.calloc_calls, 0);
+  EXPECT_EQ(data.alloc_calls, 1);
+}
+
+TEST(KnapsackPreprocessTest, EverythingFitsStillDetectsOverflow) {
+  std::vector<knapsack_item_t> items = {{1, INT_MAX}, {1, 1}, {100, 5}};
+  knapsack_result_t result;
+  EXPECT_EQ(knapsack_solve_status(items.data(), items.size(), 10, &result),
+            KNAPSACK_ERR_INT_OVERFLOW);
+  EXPECT_EQ(result.selected_indices, nullptr);
+  const knapsack_options_t options = HirschbergOptions();
+  EXPECT_EQ(knapsack_solve_opts(items.data(), items.size(), 10, &options, &result),
+            KNAPSACK_ERR_INT_OVERFLOW);
+  // The heavy item never counts towards the total.
+  items[1].weight = 200;
+  ASSERT_EQ(knapsack_solve_status(items.data(), items.size(), 10, &result), KNAPSACK_OK);
+  EXPECT_EQ(result.optimal_value, INT_MAX);
+  knapsack_result_free(&result);
+}
+
+TEST(KnapsackPreprocessTest, CommonWeightFactorShrinksRows) {
+  std::mt19937 rng(77);
+  std::uniform_int_distribution<int> weight_dist(1, 40);
+  std::uniform_int_distribution<int> value_dist(1, 1000);
+  const int factor = 20;
+  std::vector<knapsack_item_t> scaled(100);
+  std::vector<knapsack_item_t> unit(scaled.size());
+  for (size_t i = 0; i < scaled.size(); ++i) {
+    unit[i] = {weight_dist(rng), value_dist(rng)};
+    scaled[i] = {unit[i].weight * factor, unit[i].value};
+  }
+
+  PeakAllocator peak{0U};
+  knapsack_allocator_t alloc = {PeakAlloc, PeakCalloc, PeakFree, &peak};
+  knapsack_result_t expected;
+  SolveOk(unit, 800, &expected);
+  knapsack_result_t observed;
+  // Capacity rounds down to a whole number of units.
+  ASSERT_EQ(knapsack_solve_status_ex(scaled.data(), scaled.size(), 800 * factor + factor - 1,
+                                     &alloc, &observed),
+            KNAPSACK_OK);
+  EXPECT_EQ(observed.optimal_value, expected.optimal_value);
+  EXPECT_EQ(observed.total_weight, expected.total_weight * factor);
+  EXPECT_EQ(std::vector<size_t>(observed.selected_indices,
+                                observed.selected_indices + observed.selected_count),
+            std::vector<size_t>(expected.selected_indices,
+                                expected.selected_indices + expected.selected_count));
+  // 801-cell rows and a 100 x 832-bit bitset (about 17 KB), instead of the
+  // roughly 330 KB of the unscaled instance.
+  EXPECT_LT(peak.largest, 32U * 1024U);
+  knapsack_result_free(&expected);
+  knapsack_result_free_ex(&observed, &alloc);
+}
+
+// --- Sparse engine --------------------------------------------------------------
+
+namespace {
+knapsack_options_t EngineOptions(knapsack_engine_t engine,
+                                 knapsack_reconstruct_t reconstruct = KNAPSACK_RECONSTRUCT_BITSET) {
+  knapsack_options_t options;
+  knapsack_options_init(&options);
+  options.engine = engine;
+  options.reconstruct = reconstruct;
+  return options;
+}
+
+struct FullSolution {
+  knapsack_status_t status;
+  int value;
+  int weight;
+  std::vector<size_t> indices;
+  bool operator==(const FullSolution &other) const {
+    return status == other.status && value == other.value && weight == other.weight &&
+           indices == other.indices;
+  }
+};
+
+FullSolution SolveFull(const std::vector<knapsack_item_t> &items, int capacity,
+                       const knapsack_options_t &options) {
+  knapsack_result_t result;
+  FullSolution out{knapsack_solve_opts(items.data(), items.size(), capacity, &options, &result), 0,
+                   0, {}};
+  if (out.status == KNAPSACK_OK) {
+    out.value = result.optimal_value;
+    out.weight = result.total_weight;
+    out.indices.assign(result.selected_indices, result.selected_indices + result.selected_count);
+    knapsack_result_free_ex(&result, options.allocator);
+  }
+  return out;
+}
+} // namespace
+
+TEST(KnapsackSparseTest, MatchesDenseSelection) {
+  std::mt19937 rng(1111);
+  std::uniform_int_distribution<int> count_dist(1, 30);
+  std::uniform_int_distribution<int> value_dist(0, 40); // small range => many ties
+  std::uniform_int_distribution<int> capacity_dist(0, 100000);
+
+  for (knapsack_reconstruct_t reconstruct :
+       {KNAPSACK_RECONSTRUCT_BITSET, KNAPSACK_RECONSTRUCT_NONE}) {
+    const knapsack_options_t dense = EngineOptions(KNAPSACK_ENGINE_DENSE, reconstruct);
+    const knapsack_options_t sparse = EngineOptions(KNAPSACK_ENGINE_SPARSE, reconstruct);
+    const knapsack_options_t automatic = EngineOptions(KNAPSACK_ENGINE_AUTO, reconstruct);
+    for (int trial = 0; trial < 60; ++trial) {
+      const int capacity = capacity_dist(rng);
+      std::uniform_int_distribution<int> weight_dist(1, trial % 2 == 0 ? 60 : capacity / 4 + 1);
+      std::vector<knapsack_item_t> items(static_cast<size_t>(count_dist(rng) % 18 + 1));
+      for (auto &item : items) {
+        item = {weight_dist(rng), value_dist(rng)};
+      }
+      const FullSolution expected = SolveFull(items, capacity, dense);
+      EXPECT_EQ(SolveFull(items, capacity, sparse), expected) << trial;
+      EXPECT_EQ(SolveFull(items, capacity, automatic), expected) << trial;
+    }
+  }
+}
+
+TEST(KnapsackSparseTest, DetectsValueOverflow) {
+  const knapsack_options_t options = EngineOptions(KNAPSACK_ENGINE_SPARSE);
+  std::vector<knapsack_item_t> items = {{1, INT_MAX}, {1, 1}, {2, 0}};
+  EXPECT_EQ(SolveFull(items, 2, options).status, KNAPSACK_ERR_INT_OVERFLOW);
+  const FullSolution fits = SolveFull(items, 1, options);
+  ASSERT_EQ(fits.status, KNAPSACK_OK);
+  EXPECT_EQ(fits.value, INT_MAX);
+  EXPECT_THAT(fits.indices, ElementsAre(0U));
+}
+
+TEST(KnapsackSparseTest, AutoPicksSparseForFewWideItems) {
+  std::mt19937 rng(2222);
+  std::uniform_int_distribution<int> weight_dist(1, 30000);
+  std::uniform_int_distribution<int> value_dist(1, 1000);
+  std::vector<knapsack_item_t> items(12);
+  for (auto &item : items) {
+    item = {weight_dist(rng), value_dist(rng)};
+  }
+  const int capacity = KNAPSACK_MAX_CAPACITY;
+
+  CountingAllocator counts{0, 0, 0, -1, -1};
+  knapsack_allocator_t counting = {CountAlloc, CountCalloc, CountFree, &counts};
+  knapsack_options_t automatic = EngineOptions(KNAPSACK_ENGINE_AUTO);
+  automatic.allocator = &counting;
+  const FullSolution observed = SolveFull(items, capacity, automatic);
+  EXPECT_EQ(observed, SolveFull(items, capacity, EngineOptions(KNAPSACK_ENGINE_DENSE)));
+  EXPECT_EQ(counts.calloc_calls, 1);
+
+  PeakAllocator peak{0U};
+  knapsack_allocator_t peaked = {PeakAlloc, PeakCalloc, PeakFree, &peak};
+  automatic.allocator = &peaked;
+  SolveFull(items, capacity, automatic);
+  // At most 2^13 states of 12 bytes, against ~1 MB of dense rows and bits.
+  EXPECT_LT(peak.largest, 128U * 1024U);
+}
+
+TEST(KnapsackSparseTest, AutoFallsBackToDenseInOneArena) {
+  std::mt19937 rng(3333);
+  std::uniform_int_distribution<int> weight_dist(1, 5000);
+  std::uniform_int_distribution<int> value_dist(0, 100000);
+  for (size_t count : {20U, 30U, 100U}) {
+    SCOPED_TRACE(count);
+    std::vector<knapsack_item_t> items(count);
+    for (auto &item : items) {
+      item = {weight_dist(rng) * 7 + 1, value_dist(rng)};
+    }
+    const int capacity = KNAPSACK_MAX_CAPACITY / 2;
+    CountingAllocator counts{0, 0, 0, -1, -1};
+    knapsack_allocator_t alloc = {CountAlloc, CountCalloc, CountFree, &counts};
+    knapsack_options_t automatic = EngineOptions(KNAPSACK_ENGINE_AUTO);
+    automatic.allocator = &alloc;
+    // Whether the budgeted frontier finishes or the dense DP takes over in
+    // the same arena, the answer matches and there is one arena allocation.
+    EXPECT_EQ(SolveFull(items, capacity, automatic),
+              SolveFull(items, capacity, EngineOptions(KNAPSACK_ENGINE_DENSE)));
+    EXPECT_EQ(counts.calloc_calls, 1);
+  }
+}
+
+TEST(KnapsackSparseTest, LiftsCapacityLimit) {
+  knapsack_options_t options = EngineOptions(KNAPSACK_ENGINE_SPARSE);
+  options.limits.max_capacity = INT_MAX;
+  std::mt19937 rng(4444);
+  std::uniform_int_distribution<int> weight_dist(1, 200000000);
+  std::uniform_int_distribution<int> value_dist(0, 1000000);
+  std::vector<knapsack_item_t> items(16);
+  for (auto &item : items) {
+    item = {weight_dist(rng), value_dist(rng)};
+  }
+  const int capacity = 900000000;
+
+  const auto expected = BruteForceBest(items, capacity);
+  const FullSolution observed = SolveFull(items, capacity, options);
+  ASSERT_EQ(observed.status, KNAPSACK_OK);
+  EXPECT_EQ(observed.value, expected.first);
+  EXPECT_EQ(observed.weight, expected.second);
+  long long weight = 0;
+  for (size_t index : observed.indices) {
+    weight += items[index].weight;
+  }
+  EXPECT_EQ(weight, expected.second);
+
+  options.reconstruct = KNAPSACK_RECONSTRUCT_NONE;
+  const FullSolution value_only = SolveFull(items, capacity, options);
+  EXPECT_EQ(value_only.value, expected.first);
+  EXPECT_TRUE(value_only.indices.empty());
+}
+
+// --- Branch and bound -----------------------------------------------------------
+
+namespace {
+// Value, weight and ordering of a reported selection.
+void ExpectConsistent(const std::vector<knapsack_item_t> &items, const FullSolution &solution) {
+  long long value = 0;
+  long long weight = 0;
+  for (size_t k = 0; k < solution.indices.size(); ++k) {
+    ASSERT_LT(solution.indices[k], items.size());
+    if (k > 0) {
+      EXPECT_LT(solution.indices[k - 1], solution.indices[k]);
+    }
+    value += items[solution.indices[k]].value;
+    weight += items[solution.indices[k]].weight;
+  }
+  EXPECT_EQ(value, solution.value);
+  EXPECT_EQ(weight, solution.weight);
+}
+
+// CountFree also counts free(NULL); balancing blocks needs only the real ones.
+void CountBlockFree(void *p, void *ud) {
+  if (p) {
+    CountFree(p, ud);
+  }
+}
+} // namespace
+
+TEST(KnapsackBranchBoundTest, MatchesDenseOptimum) {
+  std::mt19937 rng(5555);
+  std::uniform_int_distribution<int> count_dist(1, 60);
+  std::uniform_int_distribution<int> capacity_dist(0, 5000);
+  const knapsack_options_t dense = EngineOptions(KNAPSACK_ENGINE_DENSE);
+  const knapsack_options_t search = EngineOptions(KNAPSACK_ENGINE_BRANCH_BOUND);
+  const knapsack_options_t value_only =
+      EngineOptions(KNAPSACK_ENGINE_BRANCH_BOUND, KNAPSACK_RECONSTRUCT_NONE);
+
+  for (int trial = 0; trial < 300; ++trial) {
+    SCOPED_TRACE(trial);
+    const int capacity = capacity_dist(rng);
+    std::uniform_int_distribution<int> weight_dist(1, capacity / 3 + 1);
+    // Alternate wide values with a tiny range and values tied to weights,
+    // which make for many equal ratios and equal-value selections.
+    std::uniform_int_distribution<int> value_dist(0, trial % 3 == 0 ? 3 : 1000);
+    std::vector<knapsack_item_t> items(static_cast<size_t>(count_dist(rng)));
+    for (auto &item : items) {
+      item.weight = weight_dist(rng);
+      item.value = trial % 3 == 1 ? item.weight + value_dist(rng) % 5 : value_dist(rng);
+    }
+    const FullSolution expected = SolveFull(items, capacity, dense);
+    const FullSolution observed = SolveFull(items, capacity, search);
+    ASSERT_EQ(observed.status, expected.status);
+    EXPECT_EQ(observed.value, expected.value);
+    EXPECT_EQ(observed.weight, expected.weight);
+    ExpectConsistent(items, observed);
+
+    const FullSolution bare = SolveFull(items, capacity, value_only);
+    EXPECT_EQ(bare.value, expected.value);
+    EXPECT_EQ(bare.weight, expected.weight);
+    EXPECT_TRUE(bare.indices.empty());
+  }
+}
+
+TEST(KnapsackBranchBoundTest, SolvesHugeCapacities) {
+  knapsack_options_t options = EngineOptions(KNAPSACK_ENGINE_BRANCH_BOUND);
+  options.limits.max_capacity = INT_MAX;
+  std::mt19937 rng(6666);
+  std::uniform_int_distribution<int> weight_dist(1, 100000000);
+  std::uniform_int_distribution<int> value_dist(1, 1000000);
+  std::vector<knapsack_item_t> items(18);
+  for (auto &item : items) {
+    item = {weight_dist(rng), value_dist(rng)};
+  }
+  for (int capacity : {0, 30000000, 400000000, 1000000000}) {
+    SCOPED_TRACE(capacity);
+    const auto expected = BruteForceBest(items, capacity);
+    const FullSolution observed = SolveFull(items, capacity, options);
+    ASSERT_EQ(observed.status, KNAPSACK_OK);
+    EXPECT_EQ(observed.value, expected.first);
+    EXPECT_EQ(observed.weight, expected.second);
+    ExpectConsistent(items, observed);
+  }
+}
+
+TEST(KnapsackBranchBoundTest, ManyItemsAtTensOfMillions) {
+  // Far beyond the dense limits; the search arrays are all it allocates.
+  knapsack_options_t options = EngineOptions(KNAPSACK_ENGINE_BRANCH_BOUND);
+  options.limits = {100000, INT_MAX};
+  PeakAllocator peak{0U};
+  knapsack_allocator_t alloc = {PeakAlloc, PeakCalloc, PeakFree, &peak};
+  options.allocator = &alloc;
+  std::mt19937 rng(7777);
+  std::uniform_int_distribution<int> weight_dist(1, 1000000);
+  std::uniform_int_distribution<int> value_dist(1, 1000);
+  std::vector<knapsack_item_t> items(2000);
+  for (auto &item : items) {
+    item = {weight_dist(rng), value_dist(rng)};
+  }
+  const FullSolution observed = SolveFull(items, 50000000, options);
+  ASSERT_EQ(observed.status, KNAPSACK_OK);
+  EXPECT_GT(observed.value, 0);
+  EXPECT_LE(observed.weight, 50000000);
+  ExpectConsistent(items, observed);
+  EXPECT_LT(peak.largest, 2000U * 64U);
+}
+
+TEST(KnapsackBranchBoundTest, SkipsZeroValueItems) {
+  const knapsack_options_t options = EngineOptions(KNAPSACK_ENGINE_BRANCH_BOUND);
+  std::vector<knapsack_item_t> items = {{2, 0}, {3, 5}, {1, 0}, {4, 5}};
+  const FullSolution observed = SolveFull(items, 8, options);
+  ASSERT_EQ(observed.status, KNAPSACK_OK);
+  EXPECT_EQ(observed.value, 10);
+  EXPECT_EQ(observed.weight, 7);
+  EXPECT_THAT(observed.indices, ElementsAre(1U, 3U));
+
+  std::vector<knapsack_item_t> worthless = {{2, 0}, {3, 0}, {9, 0}};
+  const FullSolution empty = SolveFull(worthless, 4, options);
+  ASSERT_EQ(empty.status, KNAPSACK_OK);
+  EXPECT_EQ(empty.value, 0);
+  EXPECT_EQ(empty.weight, 0);
+  EXPECT_TRUE(empty.indices.empty());
+}
+
+TEST(KnapsackBranchBoundTest, DetectsValueOverflow) {
+  const knapsack_options_t options = EngineOptions(KNAPSACK_ENGINE_BRANCH_BOUND);
+  std::vector<knapsack_item_t> items = {{1, INT_MAX}, {1, 1}, {2, 0}};
+  EXPECT_EQ(SolveFull(items, 2, options).status, KNAPSACK_ERR_INT_OVERFLOW);
+  const FullSolution fits = SolveFull(items, 1, options);
+  ASSERT_EQ(fits.status, KNAPSACK_OK);
+  EXPECT_EQ(fits.value, INT_MAX);
+  EXPECT_THAT(fits.indices, ElementsAre(0U));
+}
+
+// --- Tiled engine ----------------------------------------------------------------
+
+namespace {
+knapsack_options_t TiledOptions(size_t tile_cells,
+                                knapsack_reconstruct_t reconstruct = KNAPSACK_RECONSTRUCT_BITSET) {
+  knapsack_options_t options = EngineOptions(KNAPSACK_ENGINE_TILED, reconstruct);
+  options.tile_cells = tile_cells;
+  return options;
+}
+
+// The dense engine over the items stably sorted by weight, indices mapped
+// back: the tiled engine fills exactly those rows and decisions.
+FullSolution SolveDenseSorted(const std::vector<knapsack_item_t> &items, int capacity,
+                              knapsack_reconstruct_t reconstruct) {
+  std::vector<size_t> order(items.size());
+  for (size_t i = 0; i < order.size(); ++i) {
+    order[i] = i;
+  }
+  std::stable_sort(order.begin(), order.end(),
+                   [&items](size_t a, size_t b) { return items[a].weight < items[b].weight; });
+  std::vector<knapsack_item_t> sorted;
+  sorted.reserve(items.size());
+  for (size_t i : order) {
+    sorted.push_back(items[i]);
+  }
+  FullSolution out =
+      SolveFull(sorted, capacity, EngineOptions(KNAPSACK_ENGINE_DENSE, reconstruct));
+  for (size_t &index : out.indices) {
+    index = order[index];
+  }
+  std::sort(out.indices.begin(), out.indices.end());
+  return out;
+}
+} // namespace
+
+// NOLINTNEXTLINE(readability-function-cognitive-complexity)
+TEST(KnapsackTiledTest, MatchesDenseOverWeightSortedItems) {
+  std::mt19937 rng(2828);
+  std::uniform_int_distribution<int> count_dist(1, 40);
+  std::uniform_int_distribution<int> capacity_dist(0, 3000);
+  std::uniform_int_distribution<int> value_dist(0, 40); // small range => many ties
+  std::vector<knapsack_kernel_t> kernels = {KNAPSACK_KERNEL_SCALAR};
+  kernels.insert(kernels.end(), std::begin(kSimdKernels), std::end(kSimdKernels));
+
+  for (knapsack_kernel_t kernel : kernels) {
+    if (!knapsack_kernel_supported(kernel)) {
+      continue;
+    }
+    SCOPED_TRACE(knapsack_kernel_name(kernel));
+    KernelOverride guard(kernel);
+    for (int trial = 0; trial < 40; ++trial) {
+      SCOPED_TRACE(trial);
+      const int capacity = capacity_dist(rng);
+      // Light items share tiles; the heavier mix also leaves items alone in theirs.
+      std::uniform_int_distribution<int> weight_dist(1, trial % 2 == 0 ? 12 : capacity / 3 + 1);
+      std::vector<knapsack_item_t> items(static_cast<size_t>(count_dist(rng)));
+      for (auto &item : items) {
+        item = {weight_dist(rng), value_dist(rng)};
+      }
+      for (knapsack_reconstruct_t reconstruct :
+           {KNAPSACK_RECONSTRUCT_BITSET, KNAPSACK_RECONSTRUCT_NONE}) {
+        const FullSolution expected = SolveDenseSorted(items, capacity, reconstruct);
+        const FullSolution dense =
+            SolveFull(items, capacity, EngineOptions(KNAPSACK_ENGINE_DENSE, reconstruct));
+        for (size_t tile_cells : {size_t{1}, size_t{7}, size_t{64}, size_t{500}, size_t{0}}) {
+          SCOPED_TRACE(tile_cells);
+          const FullSolution observed =
+              SolveFull(items, capacity, TiledOptions(tile_cells, reconstruct));
+          EXPECT_EQ(observed, expected);
+          EXPECT_EQ(observed.value, dense.value);
+          EXPECT_EQ(observed.weight, dense.weight);
+        }
+      }
+    }
+  }
+}
+
+TEST(KnapsackTiledTest, AutomaticTileIsWholeWords) {
+  const size_t cells = knapsack_tile_cells();
+  EXPECT_GE(cells, 64U);
+  EXPECT_EQ(cells % 64U, 0U);
+  EXPECT_EQ(knapsack_tile_cells(), cells);
+}
+
+TEST(KnapsackTiledTest, DetectsValueOverflow) {
+  std::vector<knapsack_item_t> items = {{1, INT_MAX}, {1, 1}, {2, 0}};
+  EXPECT_EQ(SolveFull(items, 2, TiledOptions(64U)).status, KNAPSACK_ERR_INT_OVERFLOW);
+  // Overflowing candidates in a block's halo cells as well as inside it.
+  items = {{3, INT_MAX / 2 + 1}, {5, INT_MAX / 2 + 1}, {4, 1}};
+  for (size_t tile_cells : {size_t{8}, size_t{16}, size_t{0}}) {
+    EXPECT_EQ(SolveFull(items, 200, TiledOptions(tile_cells)).status, KNAPSACK_ERR_INT_OVERFLOW)
+        << tile_cells;
+  }
+}
+
+// --- Trimmed decision rows -------------------------------------------------------
+
+namespace {
+// Items heavier than most of the capacity, whose decision rows are mostly
+// trimmed away; two adjacent weights keep the GCD at 1.
+std::vector<knapsack_item_t> HeavyItems(std::mt19937 &rng, size_t count, int capacity) {
+  std::uniform_int_distribution<int> weight_dist(capacity * 4 / 5, capacity);
+  std::uniform_int_distribution<int> value_dist(1, 1000);
+  std::vector<knapsack_item_t> items(count);
+  for (auto &item : items) {
+    item = {weight_dist(rng), value_dist(rng)};
+  }
+  items[0].weight = capacity - 1;
+  items[1].weight = capacity;
+  return items;
+}
+} // namespace
+
+// NOLINTNEXTLINE(readability-function-cognitive-complexity)
+TEST(KnapsackTrimmedRowsTest, ReusedArenaIgnoresStaleDecisions) {
+  // Light items leave decisions all over the arena; the heavy instance after
+  // them must only read the rows it zeroed and filled itself.
+  PoolPtr pool(knapsack_thread_pool_create(2U, nullptr));
+  ASSERT_NE(pool, nullptr);
+  std::vector<knapsack_options_t> modes(3);
+  knapsack_options_init(&modes[0]);
+  modes[0].engine = KNAPSACK_ENGINE_DENSE;
+  modes[1] = ParallelOptions(pool.get());
+  modes[2] = TiledOptions(1024U);
+  knapsack_workspace_t *ws = knapsack_workspace_create(nullptr);
+  ASSERT_NE(ws, nullptr);
+  std::mt19937 rng(2929);
+  std::uniform_int_distribution<int> light_dist(1, 100);
+  const int capacity = 4000;
+  for (int trial = 0; trial < 10; ++trial) {
+    std::vector<knapsack_item_t> light(90);
+    for (auto &item : light) {
+      item = {light_dist(rng), light_dist(rng)};
+    }
+    light[0].weight = 1;
+    const std::vector<knapsack_item_t> heavy = HeavyItems(rng, 12U, capacity);
+    const auto expected = BruteForceBest(heavy, capacity);
+    for (const auto &options : modes) {
+      SCOPED_TRACE(static_cast<int>(options.engine));
+      knapsack_result_t result;
+      ASSERT_EQ(knapsack_workspace_solve_opts(ws, light.data(), light.size(), capacity, &options,
+                                              &result),
+                KNAPSACK_OK);
+      knapsack_result_free(&result);
+      ASSERT_EQ(knapsack_workspace_solve_opts(ws, heavy.data(), heavy.size(), capacity, &options,
+                                              &result),
+                KNAPSACK_OK);
+      EXPECT_EQ(result.optimal_value, expected.first);
+      EXPECT_EQ(result.total_weight, expected.second);
+      EXPECT_EQ(SelectedValue(heavy, result), expected.first);
+      EXPECT_EQ(SelectedWeight(heavy, result), expected.second);
+      knapsack_result_free(&result);
+    }
+  }
+  knapsack_workspace_destroy(ws);
+}
+
+// --- Sessions -------------------------------------------------------------------
+
+namespace {
+FullSolution SessionResult(const knapsack_session_t *session) {
+  knapsack_result_t result;
+  FullSolution out{knapsack_session_result(session, &result), 0, 0, {}};
+  if (out.status == KNAPSACK_OK) {
+    out.value = result.optimal_value;
+    out.weight = result.total_weight;
+    out.indices.assign(result.selected_indices, result.selected_indices + result.selected_count);
+    knapsack_result_free(&result);
+  }
+  return out;
+}
+
+FullSolution SessionPeek(const knapsack_session_t *session, knapsack_item_t item) {
+  knapsack_result_t result;
+  FullSolution out{knapsack_session_peek_item(session, item, &result), 0, 0, {}};
+  if (out.status == KNAPSACK_OK) {
+    out.value = result.optimal_value;
+    out.weight = result.total_weight;
+    out.indices.assign(result.selected_indices, result.selected_indices + result.selected_count);
+    knapsack_result_free(&result);
+  }
+  return out;
+}
+
+FullSolution OneShot(const std::vector<knapsack_item_t> &items, int capacity,
+                     knapsack_reconstruct_t reconstruct) {
+  if (items.empty()) {
+    return {KNAPSACK_OK, 0, 0, {}};
+  }
+  return SolveFull(items, capacity, EngineOptions(KNAPSACK_ENGINE_DENSE, reconstruct));
+}
+} // namespace
+
+// NOLINTNEXTLINE(readability-function-cognitive-complexity)
+TEST(KnapsackSessionTest, MatchesOneShotSolves) {
+  std::mt19937 rng(8888);
+  std::uniform_int_distribution<int> op_dist(0, 9);
+  std::uniform_int_distribution<int> weight_dist(1, 300);
+  std::uniform_int_distribution<int> value_dist(0, 50); // ties on purpose
+  std::uniform_int_distribution<int> capacity_dist(0, 3000);
+
+  for (knapsack_reconstruct_t reconstruct :
+       {KNAPSACK_RECONSTRUCT_BITSET, KNAPSACK_RECONSTRUCT_NONE}) {
+    SCOPED_TRACE(static_cast<int>(reconstruct));
+    const knapsack_options_t options = EngineOptions(KNAPSACK_ENGINE_AUTO, reconstruct);
+    knapsack_session_t *session = knapsack_session_create(&options);
+    ASSERT_NE(session, nullptr);
+    std::vector<knapsack_item_t> items;
+    int capacity = 0;
+    for (int step = 0; step < 200; ++step) {
+      SCOPED_TRACE(step);
+      const knapsack_item_t item = {weight_dist(rng), value_dist(rng)};
+      const int op = op_dist(rng);
+      if (op < 6 && items.size() < KNAPSACK_MAX_ITEMS) {
+        ASSERT_EQ(knapsack_session_add_item(session, item), KNAPSACK_OK);
+        items.push_back(item);
+      } else if (op < 8) {
+        capacity = capacity_dist(rng);
+        ASSERT_EQ(knapsack_session_set_capacity(session, capacity), KNAPSACK_OK);
+      } else {
+        std::vector<knapsack_item_t> with_item = items;
+        with_item.push_back(item);
+        EXPECT_EQ(SessionPeek(session, item), OneShot(with_item, capacity, reconstruct));
+      }
+      ASSERT_EQ(knapsack_session_count(session), items.size());
+      EXPECT_EQ(SessionResult(session), OneShot(items, capacity, reconstruct));
+    }
+    knapsack_session_destroy(session);
+  }
+}
+
+TEST(KnapsackSessionTest, ReservedSessionDoesNotReallocate) {
+  CountingAllocator counts{0, 0, 0, -1, -1};
+  knapsack_allocator_t alloc = {CountAlloc, CountCalloc, CountFree, &counts};
+  knapsack_options_t options = EngineOptions(KNAPSACK_ENGINE_AUTO);
+  options.allocator = &alloc;
+  knapsack_session_t *session = knapsack_session_create(&options);
+  ASSERT_NE(session, nullptr);
+  ASSERT_EQ(knapsack_session_reserve(session, 100, 10000), KNAPSACK_OK);
+  EXPECT_EQ(counts.calloc_calls, 1);
+
+  std::mt19937 rng(9999);
+  std::uniform_int_distribution<int> weight_dist(1, 500);
+  for (int i = 0; i < 100; ++i) {
+    ASSERT_EQ(knapsack_session_add_item(session, {weight_dist(rng), i % 17}), KNAPSACK_OK);
+    ASSERT_EQ(knapsack_session_set_capacity(session, (i * 97) % 10001), KNAPSACK_OK);
+  }
+  EXPECT_EQ(counts.calloc_calls, 1);
+  knapsack_session_destroy(session);
+}
+
+TEST(KnapsackSessionTest, CapacityGrowthRebuildsGeometrically) {
+  CountingAllocator counts{0, 0, 0, -1, -1};
+  knapsack_allocator_t alloc = {CountAlloc, CountCalloc, CountFree, &counts};
+  knapsack_options_t options = EngineOptions(KNAPSACK_ENGINE_AUTO);
+  options.allocator = &alloc;
+  knapsack_session_t *session = knapsack_session_create(&options);
+  ASSERT_NE(session, nullptr);
+  std::vector<knapsack_item_t> items = {{3, 4}, {40, 41}, {500, 600}, {7000, 7100}};
+  for (const auto &item : items) {
+    ASSERT_EQ(knapsack_session_add_item(session, item), KNAPSACK_OK);
+  }
+  for (int capacity = 0; capacity <= 10000; ++capacity) {
+    ASSERT_EQ(knapsack_session_set_capacity(session, capacity), KNAPSACK_OK);
+  }
+  // One arena per doubling of the width, starting at 1 cell.
+  EXPECT_LE(counts.calloc_calls, 16);
+  EXPECT_EQ(SessionResult(session), OneShot(items, 10000, KNAPSACK_RECONSTRUCT_BITSET));
+  knapsack_session_destroy(session);
+}
+
+TEST(KnapsackSessionTest, FailuresLeaveSessionUnchanged) {
+  knapsack_session_t *session = knapsack_session_create(nullptr);
+  ASSERT_NE(session, nullptr);
+  ASSERT_EQ(knapsack_session_set_capacity(session, 1), KNAPSACK_OK);
+  ASSERT_EQ(knapsack_session_add_item(session, {1, INT_MAX}), KNAPSACK_OK);
+  ASSERT_EQ(knapsack_session_add_item(session, {1, 1}), KNAPSACK_OK);
+  const FullSolution before = SessionResult(session);
+  EXPECT_EQ(before.value, INT_MAX);
+
+  // Wider rows would let both items fit together.
+  EXPECT_EQ(knapsack_session_set_capacity(session, 2), KNAPSACK_ERR_INT_OVERFLOW);
+  EXPECT_EQ(SessionPeek(session, {1, 0}), SessionResult(session));
+  EXPECT_EQ(SessionResult(session), before);
+  EXPECT_EQ(knapsack_session_add_item(session, {1, 5}), KNAPSACK_OK);
+  EXPECT_EQ(knapsack_session_count(session), 3U);
+  knapsack_session_destroy(session);
+
+  session = knapsack_session_create(nullptr);
+  ASSERT_NE(session, nullptr);
+  ASSERT_EQ(knapsack_session_set_capacity(session, 4), KNAPSACK_OK);
+  ASSERT_EQ(knapsack_session_add_item(session, {2, INT_MAX - 1}), KNAPSACK_OK);
+  EXPECT_EQ(SessionPeek(session, {2, 2}).status, KNAPSACK_ERR_INT_OVERFLOW);
+  EXPECT_EQ(knapsack_session_add_item(session, {2, 2}), KNAPSACK_ERR_INT_OVERFLOW);
+  EXPECT_EQ(knapsack_session_count(session), 1U);
+  EXPECT_EQ(SessionResult(session).value, INT_MAX - 1);
+  ASSERT_EQ(knapsack_session_add_item(session, {2, 1}), KNAPSACK_OK);
+  EXPECT_EQ(SessionResult(session), OneShot({{2, INT_MAX - 1}, {2, 1}}, 4,
+                                            KNAPSACK_RECONSTRUCT_BITSET));
+  knapsack_session_destroy(session);
+}
+
+TEST(KnapsackSessionTest, AllocationFailureKeepsItems) {
+  CountingAllocator counts{0, 0, 0, -1, 1};
+  knapsack_allocator_t alloc = {CountAlloc, CountCalloc, CountFree, &counts};
+  knapsack_options_t options = EngineOptions(KNAPSACK_ENGINE_AUTO);
+  options.allocator = &alloc;
+  knapsack_session_t *session = knapsack_session_create(&options);
+  ASSERT_NE(session, nullptr);
+  ASSERT_EQ(knapsack_session_set_capacity(session, 10), KNAPSACK_OK);
+  ASSERT_EQ(knapsack_session_add_item(session, {4, 5}), KNAPSACK_OK); // the one calloc
+  EXPECT_EQ(knapsack_session_set_capacity(session, 100), KNAPSACK_ERR_ALLOC);
+  EXPECT_EQ(knapsack_session_count(session), 1U);
+  FullSolution result = SessionResult(session);
+  EXPECT_EQ(result.value, 5);
+  EXPECT_THAT(result.indices, ElementsAre(0U));
+  knapsack_session_destroy(session);
+}
+
+TEST(KnapsackSessionTest, RejectsInvalidArguments) {
+  knapsack_options_t options = EngineOptions(KNAPSACK_ENGINE_SPARSE);
+  EXPECT_EQ(knapsack_session_create(&options), nullptr);
+  options = EngineOptions(KNAPSACK_ENGINE_AUTO, KNAPSACK_RECONSTRUCT_HIRSCHBERG);
+  EXPECT_EQ(knapsack_session_create(&options), nullptr);
+
+  knapsack_result_t result;
+  EXPECT_EQ(knapsack_session_add_item(nullptr, {1, 1}), KNAPSACK_ERR_INVALID_ARGUMENT);
+  EXPECT_EQ(knapsack_session_set_capacity(nullptr, 1), KNAPSACK_ERR_INVALID_ARGUMENT);
+  EXPECT_EQ(knapsack_session_reserve(nullptr, 1, 1), KNAPSACK_ERR_INVALID_ARGUMENT);
+  EXPECT_EQ(knapsack_session_result(nullptr, &result), KNAPSACK_ERR_INVALID_ARGUMENT);
+  EXPECT_EQ(knapsack_session_peek_item(nullptr, {1, 1}, &result), KNAPSACK_ERR_INVALID_ARGUMENT);
+  EXPECT_EQ(knapsack_session_count(nullptr), 0U);
+  knapsack_session_destroy(nullptr); // no-op
+
+  options = EngineOptions(KNAPSACK_ENGINE_AUTO);
+  options.limits = {2, 100};
+  knapsack_session_t *session = knapsack_session_create(&options);
+  ASSERT_NE(session, nullptr);
+  EXPECT_EQ(knapsack_session_result(session, nullptr), KNAPSACK_ERR_NULL_RESULT);
+  EXPECT_EQ(knapsack_session_add_item(session, {0, 1}), KNAPSACK_ERR_INVALID_ITEMS);
+  EXPECT_EQ(knapsack_session_add_item(session, {1, -1}), KNAPSACK_ERR_INVALID_ITEMS);
+  EXPECT_EQ(knapsack_session_set_capacity(session, 101), KNAPSACK_ERR_INVALID_CAPACITY);
+  EXPECT_EQ(knapsack_session_set_capacity(session, -1), KNAPSACK_ERR_INVALID_CAPACITY);
+  EXPECT_EQ(knapsack_session_reserve(session, 3, 10), KNAPSACK_ERR_TOO_MANY_ITEMS);
+  EXPECT_EQ(SessionResult(session), (FullSolution{KNAPSACK_OK, 0, 0, {}}));
+  ASSERT_EQ(knapsack_session_add_item(session, {1, 1}), KNAPSACK_OK);
+  ASSERT_EQ(knapsack_session_add_item(session, {1, 1}), KNAPSACK_OK);
+  EXPECT_EQ(knapsack_session_add_item(session, {1, 1}), KNAPSACK_ERR_TOO_MANY_ITEMS);
+  EXPECT_EQ(SessionPeek(session, {1, 1}).status, KNAPSACK_ERR_TOO_MANY_ITEMS);
+  knapsack_session_destroy(session);
+}
+
+// --- Batch --------------------------------------------------------------------
+
+namespace {
+struct BatchFixture {
+  std::vector<std::vector<knapsack_item_t>> item_sets;
+  std::vector<knapsack_instance_t> instances;
+};
+
+BatchFixture MakeBatch(size_t instance_count, unsigned seed) {
+  std::mt19937 rng(seed);
+  std::uniform_int_distribution<int> count_dist(1, 50);
+  std::uniform_int_distribution<int> weight_dist(1, 120);
+  std::uniform_int_distribution<int> value_dist(0, 100);
+  std::uniform_int_distribution<int> capacity_dist(0, 1000);
+  BatchFixture batch;
+  batch.item_sets.resize(instance_count);
+  for (auto &items : batch.item_sets) {
+    items.resize(static_cast<size_t>(count_dist(rng)));
+    for (auto &item : items) {
+      item = {weight_dist(rng), value_dist(rng)};
+    }
+    batch.instances.push_back({items.data(), items.size(), capacity_dist(rng)});
+  }
+  return batch;
+}
+} // namespace
+
+// NOLINTNEXTLINE(readability-function-cognitive-complexity)
+TEST(KnapsackBatchTest, MatchesIndividualSolves) {
+  BatchFixture batch = MakeBatch(300U, 8080U);
+  // Invalid instances fail on their own without affecting the rest.
+  const std::vector<knapsack_item_t> bad_items = {{0, 1}};
+  batch.instances[7] = {bad_items.data(), bad_items.size(), 10};
+  batch.instances[8].capacity = -1;
+  batch.instances[9].items = nullptr;
+
+  PoolPtr pool(knapsack_thread_pool_create(4U, nullptr));
+  ASSERT_NE(pool, nullptr);
+  for (knapsack_thread_pool_t *maybe_pool : {static_cast<knapsack_thread_pool_t *>(nullptr),
+                                             pool.get()}) {
+    knapsack_options_t options;
+    knapsack_options_init(&options);
+    options.pool = maybe_pool;
+    std::vector<knapsack_result_t> results(batch.instances.size());
+    std::vector<knapsack_status_t> statuses(batch.instances.size(), KNAPSACK_ERR_ALLOC);
+    ASSERT_EQ(knapsack_solve_batch(batch.instances.data(), batch.instances.size(), &options,
+                                   results.data(), statuses.data()),
+              KNAPSACK_OK);
+
+    for (size_t i = 0; i < batch.instances.size(); ++i) {
+      const knapsack_instance_t &instance = batch.instances[i];
+      knapsack_result_t expected;
+      const knapsack_status_t expected_status =
+          knapsack_solve_status(instance.items, instance.count, instance.capacity, &expected);
+      ASSERT_EQ(statuses[i], expected_status) << "instance " << i;
+      EXPECT_EQ(results[i].optimal_value, expected.optimal_value);
+      EXPECT_EQ(std::vector<size_t>(results[i].selected_indices,
+                                    results[i].selected_indices + results[i].selected_count),
+                std::vector<size_t>(expected.selected_indices,
+                                    expected.selected_indices + expected.selected_count));
+      knapsack_result_free(&expected);
+      knapsack_result_free(&results[i]);
+    }
+    EXPECT_EQ(statuses[7], KNAPSACK_ERR_INVALID_ITEMS);
+    EXPECT_EQ(statuses[8], KNAPSACK_ERR_INVALID_CAPACITY);
+    EXPECT_EQ(statuses[9], KNAPSACK_ERR_INVALID_ITEMS);
+  }
+}
+
+TEST(KnapsackBatchTest, HonoursReconstructionMode) {
+  const BatchFixture batch = MakeBatch(40U, 99U);
+  knapsack_options_t options = HirschbergOptions();
+  std::vector<knapsack_result_t> results(batch.instances.size());
+  std::vector<knapsack_status_t> statuses(batch.instances.size());
+  ASSERT_EQ(knapsack_solve_batch(batch.instances.data(), batch.instances.size(), &options,
+                                 results.data(), statuses.data()),
+            KNAPSACK_OK);
+  for (size_t i = 0; i < batch.instances.size(); ++i) {
+    ASSERT_EQ(statuses[i], KNAPSACK_OK);
+    knapsack_result_t expected;
+    SolveOk(batch.item_sets[i], batch.instances[i].capacity, &expected);
+    EXPECT_EQ(results[i].optimal_value, expected.optimal_value);
+    EXPECT_EQ(SelectedWeight(batch.item_sets[i], results[i]),
+              SelectedWeight(batch.item_sets[i], expected));
+    knapsack_result_free(&expected);
+    knapsack_result_free(&results[i]);
+  }
+}
+
+TEST(KnapsackBatchTest, ReusesOneWorkspacePerWorker) {
+  const BatchFixture batch = MakeBatch(200U, 5U);
+  CountingAllocator data{0, 0, 0, -1, -1};
+  knapsack_allocator_t alloc = {CountAlloc, CountCalloc, CountFree, &data};
+  knapsack_options_t options;
+  knapsack_options_init(&options);
+  options.allocator = &alloc;
+  std::vector<knapsack_result_t> results(batch.instances.size());
+  std::vector<knapsack_status_t> statuses(batch.instances.size());
+  ASSERT_EQ(knapsack_solve_batch(batch.instances.data(), batch.instances.size(), &options,
+                                 results.data(), statuses.data()),
+            KNAPSACK_OK);
+  // The arena only grows, so it is allocated far fewer times than once per
+  // instance.
+  EXPECT_LT(data.calloc_calls, 40);
+  for (auto &result : results) {
+    knapsack_result_free_ex(&result, &alloc);
+  }
+}
+
+TEST(KnapsackBatchTest, AllocationFailureIsPerInstance) {
+  const BatchFixture batch = MakeBatch(5U, 6U);
+  CountingAllocator data{0, 0, 0, -1, 0};
+  knapsack_allocator_t alloc = {CountAlloc, CountCalloc, CountFree, &data};
+  knapsack_options_t options;
+  knapsack_options_init(&options);
+  options.allocator = &alloc;
+  std::vector<knapsack_result_t> results(batch.instances.size());
+  std::vector<knapsack_status_t> statuses(batch.instances.size());
+  ASSERT_EQ(knapsack_solve_batch(batch.instances.data(), batch.instances.size(), &options,
+                                 results.data(), statuses.data()),
+            KNAPSACK_OK);
+  // Each instance fails (or, when preprocessing needs no arena, succeeds)
+  // exactly as it would on its own.
+  size_t failures = 0U;
+  for (size_t i = 0; i < batch.instances.size(); ++i) {
+    const knapsack_instance_t &instance = batch.instances[i];
+    data.calloc_fail_after = 0;
+    knapsack_result_t alone;
+    EXPECT_EQ(statuses[i], knapsack_solve_status_ex(instance.items, instance.count,
+                                                    instance.capacity, &alloc, &alone));
+    failures += statuses[i] == KNAPSACK_ERR_ALLOC ? 1U : 0U;
+    knapsack_result_free_ex(&alone, &alloc);
+    knapsack_result_free_ex(&results[i], &alloc);
+  }
+  EXPECT_GT(failures, 0U);
+}
+
+// With a device the GPU takes the dense-engine instances; without one (as in
+// any build configured without ENABLE_GPU) the whole batch falls back to the
+// CPU. Either way every status and result is the CPU's.
+// NOLINTNEXTLINE(readability-function-cognitive-complexity)
+TEST(KnapsackBatchTest, GpuDeviceMatchesCpu) {
+  EXPECT_EQ(knapsack_gpu_available(), knapsack_gpu_available());
+  BatchFixture batch = MakeBatch(120U, 2026U);
+  const std::vector<knapsack_item_t> bad_items = {{0, 1}};
+  batch.instances[3] = {bad_items.data(), bad_items.size(), 10};
+  const std::vector<knapsack_item_t> overflow_items = {{1, INT_MAX}, {1, 1}};
+  batch.instances[4] = {overflow_items.data(), overflow_items.size(), 2};
+
+  for (knapsack_reconstruct_t mode :
+       {KNAPSACK_RECONSTRUCT_BITSET, KNAPSACK_RECONSTRUCT_NONE, KNAPSACK_RECONSTRUCT_HIRSCHBERG}) {
+    knapsack_options_t cpu;
+    knapsack_options_init(&cpu);
+    cpu.reconstruct = mode;
+    knapsack_options_t gpu = cpu;
+    gpu.device = KNAPSACK_DEVICE_GPU;
+    std::vector<knapsack_result_t> expected(batch.instances.size());
+    std::vector<knapsack_status_t> expected_statuses(batch.instances.size());
+    std::vector<knapsack_result_t> results(batch.instances.size());
+    std::vector<knapsack_status_t> statuses(batch.instances.size());
+    ASSERT_EQ(knapsack_solve_batch(batch.instances.data(), batch.instances.size(), &cpu,
+                                   expected.data(), expected_statuses.data()),
+              KNAPSACK_OK);
+    ASSERT_EQ(knapsack_solve_batch(batch.instances.data(), batch.instances.size(), &gpu,
+                                   results.data(), statuses.data()),
+              KNAPSACK_OK);
+    for (size_t i = 0; i < batch.instances.size(); ++i) {
+      ASSERT_EQ(statuses[i], expected_statuses[i]) << "instance " << i;
+      EXPECT_EQ(results[i].optimal_value, expected[i].optimal_value);
+      EXPECT_EQ(results[i].total_weight, expected[i].total_weight);
+      EXPECT_EQ(std::vector<size_t>(results[i].selected_indices,
+                                    results[i].selected_indices + results[i].selected_count),
+                std::vector<size_t>(expected[i].selected_indices,
+                                    expected[i].selected_indices + expected[i].selected_count));
+      knapsack_result_free(&expected[i]);
+      knapsack_result_free(&results[i]);
+    }
+    EXPECT_EQ(statuses[3], KNAPSACK_ERR_INVALID_ITEMS);
+    EXPECT_EQ(statuses[4], KNAPSACK_ERR_INT_OVERFLOW);
+  }
+}
+
+TEST(KnapsackBatchTest, RejectsMissingArrays) {
+  const BatchFixture batch = MakeBatch(2U, 1U);
+  std::vector<knapsack_result_t> results(2);
+  std::vector<knapsack_status_t> statuses(2);
+  EXPECT_EQ(knapsack_solve_batch(nullptr, 2U, nullptr, results.data(), statuses.data()),
+            KNAPSACK_ERR_INVALID_ARGUMENT);
+  EXPECT_EQ(knapsack_solve_batch(batch.instances.data(), 2U, nullptr, nullptr, statuses.data()),
+            KNAPSACK_ERR_INVALID_ARGUMENT);
+  EXPECT_EQ(knapsack_solve_batch(batch.instances.data(), 2U, nullptr, results.data(), nullptr),
+            KNAPSACK_ERR_INVALID_ARGUMENT);
+  EXPECT_EQ(knapsack_solve_batch(nullptr, 0U, nullptr, nullptr, nullptr), KNAPSACK_OK);
+}
+
+namespace {
+// Cancels from the `after`-th poll on and counts polls.
+struct CancelAfter {
+  int after;
+  int polls;
+};
+
+bool CountedCancel(void *user_data) {
+  auto *cancel = static_cast<CancelAfter *>(user_data);
+  return ++cancel->polls >= cancel->after;
+}
+
+knapsack_options_t CancelOptions(knapsack_options_t options, CancelAfter *cancel, bool anytime) {
+  options.cancel = CountedCancel;
+  options.cancel_user_data = cancel;
+  options.anytime = anytime;
+  return options;
+}
+
+struct AnytimeSolution {
+  FullSolution solution;
+  int bound;
+};
+
+AnytimeSolution SolveAnytime(const std::vector<knapsack_item_t> &items, int capacity,
+                             const knapsack_options_t &options) {
+  knapsack_result_t result;
+  AnytimeSolution out{
+      {knapsack_solve_opts(items.data(), items.size(), capacity, &options, &result), 0, 0, {}},
+      0};
+  if (out.solution.status == KNAPSACK_OK) {
+    out.solution.value = result.optimal_value;
+    out.solution.weight = result.total_weight;
+    out.solution.indices.assign(result.selected_indices,
+                                result.selected_indices + result.selected_count);
+    out.bound = result.upper_bound;
+    knapsack_result_free_ex(&result, options.allocator);
+  } else {
+    EXPECT_EQ(result.optimal_value, 0);
+    EXPECT_EQ(result.selected_indices, nullptr);
+    EXPECT_EQ(result.upper_bound, 0);
+  }
+  return out;
+}
+
+// Rows wider than KNAPSACK_CANCEL_POLL_CELLS, so the dense DP polls after
+// every item, and more total weight than capacity, so no reduction applies.
+constexpr int kWideCapacity = 100000;
+
+std::vector<knapsack_item_t> WideItems(size_t count, unsigned seed) {
+  std::mt19937 rng(seed);
+  std::uniform_int_distribution<int> weight_dist(1000, 9000);
+  std::uniform_int_distribution<int> value_dist(0, 1000);
+  std::vector<knapsack_item_t> items(count);
+  for (auto &item : items) {
+    item = {weight_dist(rng), value_dist(rng)};
+  }
+  return items;
+}
+} // namespace
+
+TEST(KnapsackCancelTest, CancelledSolveFailsWithoutAnytime) {
+  const std::vector<knapsack_item_t> items = WideItems(40U, 41U);
+  PoolPtr pool(knapsack_thread_pool_create(3U, nullptr));
+  ASSERT_NE(pool, nullptr);
+  for (const knapsack_options_t &base :
+       {EngineOptions(KNAPSACK_ENGINE_DENSE),
+        EngineOptions(KNAPSACK_ENGINE_DENSE, KNAPSACK_RECONSTRUCT_NONE), HirschbergOptions(),
+        ParallelOptions(pool.get())}) {
+    CancelAfter cancel{1, 0};
+    const AnytimeSolution observed =
+        SolveAnytime(items, kWideCapacity, CancelOptions(base, &cancel, false));
+    EXPECT_EQ(observed.solution.status, KNAPSACK_ERR_CANCELLED);
+    EXPECT_EQ(cancel.polls, 1); // never called again once it asked to stop
+  }
+}
+
+TEST(KnapsackCancelTest, NeverFiringCallbackKeepsExactResult) {
+  const std::vector<knapsack_item_t> items = WideItems(40U, 42U);
+  for (knapsack_engine_t engine : {KNAPSACK_ENGINE_DENSE, KNAPSACK_ENGINE_SPARSE,
+                                   KNAPSACK_ENGINE_BRANCH_BOUND, KNAPSACK_ENGINE_TILED}) {
+    const knapsack_options_t base = EngineOptions(engine);
+    CancelAfter cancel{INT_MAX, 0};
+    const AnytimeSolution observed =
+        SolveAnytime(items, kWideCapacity, CancelOptions(base, &cancel, true));
+    const FullSolution expected = SolveFull(items, kWideCapacity, base);
+    EXPECT_EQ(observed.solution.value, expected.value) << engine;
+    EXPECT_EQ(observed.solution.weight, expected.weight) << engine;
+    EXPECT_EQ(observed.bound, expected.value) << engine;
+  }
+  CancelAfter cancel{INT_MAX, 0};
+  (void)SolveAnytime(items, kWideCapacity,
+                     CancelOptions(EngineOptions(KNAPSACK_ENGINE_DENSE), &cancel, true));
+  EXPECT_EQ(cancel.polls, 39); // between every two items
+}
+
+// NOLINTNEXTLINE(readability-function-cognitive-complexity)
+TEST(KnapsackCancelTest, AnytimeDenseIsPrefixOptimumPlusFirstFit) {
+  const std::vector<knapsack_item_t> items = WideItems(40U, 43U);
+  const FullSolution exact = SolveFull(items, kWideCapacity, EngineOptions(KNAPSACK_ENGINE_DENSE));
+  PoolPtr pool(knapsack_thread_pool_create(3U, nullptr));
+  ASSERT_NE(pool, nullptr);
+  for (int after : {1, 5, 20}) {
+    SCOPED_TRACE(after);
+    // The rows cover the first `after` items when the callback fires.
+    const std::vector<knapsack_item_t> prefix(items.begin(), items.begin() + after);
+    FullSolution expected = SolveFull(prefix, kWideCapacity, EngineOptions(KNAPSACK_ENGINE_DENSE));
+    ASSERT_EQ(expected.status, KNAPSACK_OK);
+    for (size_t i = prefix.size(); i < items.size(); ++i) {
+      if (items[i].value > 0 && expected.weight + items[i].weight <= kWideCapacity) {
+        expected.value += items[i].value;
+        expected.weight += items[i].weight;
+        expected.indices.push_back(i);
+      }
+    }
+
+    CancelAfter serial_cancel{after, 0};
+    const AnytimeSolution serial = SolveAnytime(
+        items, kWideCapacity,
+        CancelOptions(EngineOptions(KNAPSACK_ENGINE_DENSE), &serial_cancel, true));
+    EXPECT_EQ(serial.solution, expected);
+    EXPECT_GE(serial.bound, exact.value);
+    EXPECT_LE(serial.solution.value, exact.value);
+
+    CancelAfter parallel_cancel{after, 0};
+    const AnytimeSolution parallel = SolveAnytime(
+        items, kWideCapacity, CancelOptions(ParallelOptions(pool.get()), &parallel_cancel, true));
+    EXPECT_EQ(parallel.solution, expected);
+    EXPECT_EQ(parallel.bound, serial.bound);
+
+    CancelAfter bare_cancel{after, 0};
+    const AnytimeSolution bare = SolveAnytime(
+        items, kWideCapacity,
+        CancelOptions(EngineOptions(KNAPSACK_ENGINE_DENSE, KNAPSACK_RECONSTRUCT_NONE),
+                      &bare_cancel, true));
+    EXPECT_EQ(bare.solution.value, expected.value);
+    EXPECT_EQ(bare.solution.weight, expected.weight);
+    EXPECT_TRUE(bare.solution.indices.empty());
+    EXPECT_EQ(bare.bound, serial.bound);
+  }
+}
+
+// NOLINTNEXTLINE(readability-function-cognitive-complexity)
+TEST(KnapsackCancelTest, AnytimeAnswersAreFeasibleAndBounded) {
+  std::mt19937 rng(4444);
+  std::uniform_int_distribution<int> after_dist(1, 4);
+  // Ratios of nearly 1 with a third of the items slightly worse keep the
+  // frontiers large and make the search prove optimality very slowly.
+  std::uniform_int_distribution<int> value_dist(500, 4500);
+  for (int trial = 0; trial < 8; ++trial) {
+    SCOPED_TRACE(trial);
+    std::vector<knapsack_item_t> items(60U);
+    for (auto &item : items) {
+      item.value = 2 * value_dist(rng);
+      item.weight = item.value + (item.value % 3 == 0 ? 1 : 0);
+    }
+    const int capacity = kWideCapacity - 1 - trial * 1994; // odd: no even subset fits exactly
+    const FullSolution exact = SolveFull(items, capacity, EngineOptions(KNAPSACK_ENGINE_DENSE));
+    for (const knapsack_options_t &base :
+         {EngineOptions(KNAPSACK_ENGINE_DENSE), EngineOptions(KNAPSACK_ENGINE_SPARSE),
+          EngineOptions(KNAPSACK_ENGINE_BRANCH_BOUND), EngineOptions(KNAPSACK_ENGINE_TILED),
+          HirschbergOptions()}) {
+      SCOPED_TRACE(base.engine);
+      CancelAfter cancel{after_dist(rng), 0};
+      const AnytimeSolution observed =
+          SolveAnytime(items, capacity, CancelOptions(base, &cancel, true));
+      ASSERT_EQ(observed.solution.status, KNAPSACK_OK);
+      EXPECT_EQ(cancel.polls, cancel.after); // the callback did fire
+      ExpectConsistent(items, observed.solution);
+      EXPECT_LE(observed.solution.weight, capacity);
+      EXPECT_LE(observed.solution.value, exact.value);
+      EXPECT_GE(observed.bound, exact.value);
+    }
+  }
+}
+
+// --- Binary columnar format ---------------------------------------------------
+
+namespace {
+
+std::vector<unsigned char> SaveInstance(const std::vector<knapsack_item_t> &items, int capacity) {
+  std::vector<unsigned char> buffer(knapsack_binary_instance_size(items.size()));
+  size_t written = 0;
+  EXPECT_EQ(knapsack_binary_save_instance(items.data(), items.size(), capacity, buffer.data(),
+                                          buffer.size(), &written),
+            KNAPSACK_OK);
+  EXPECT_EQ(written, buffer.size());
+  return buffer;
+}
+
+} // namespace
+
+TEST(KnapsackBinaryTest, InstanceLayoutIsLittleEndianColumns) {
+  const std::vector<unsigned char> bytes = SaveInstance({{2, 3}, {0x01020304, 0x7FFFFFFF}}, 10);
+  const std::vector<unsigned char> expected = {
+      'K', 'N', 'S', 'I',     // magic
+      1,   0,   0,   0,       // version
+      2,   0,   0,   0,       // count
+      10,  0,   0,   0,       // capacity
+      2,   0,   0,   0,       // weights
+      4,   3,   2,   1,       //
+      3,   0,   0,   0,       // values
+      255, 255, 255, 127,     //
+  };
+  EXPECT_EQ(bytes, expected);
+  EXPECT_EQ(knapsack_binary_instance_size(2), KNAPSACK_BINARY_INSTANCE_HEADER_SIZE + 16U);
+}
+
+TEST(KnapsackBinaryTest, InstanceRoundTripsThroughTheSolver) {
+  const std::vector<knapsack_item_t> items = {{2, 3}, {3, 4}, {4, 5}, {5, 6}};
+  std::vector<unsigned char> bytes = SaveInstance(items, 10);
+  bytes.push_back(0xAB); // trailing bytes are ignored
+
+  size_t count = 0;
+  int capacity = 0;
+  ASSERT_EQ(knapsack_binary_instance_header(bytes.data(), bytes.size(), &count, &capacity),
+            KNAPSACK_OK);
+  EXPECT_EQ(count, 4U);
+  EXPECT_EQ(capacity, 10);
+  std::vector<knapsack_item_t> loaded(count);
+  ASSERT_EQ(knapsack_binary_load_instance(bytes.data(), bytes.size(), loaded.data(), count),
+            KNAPSACK_OK);
+  for (size_t i = 0; i < count; ++i) {
+    EXPECT_EQ(loaded[i].weight, items[i].weight);
+    EXPECT_EQ(loaded[i].value, items[i].value);
+  }
+  knapsack_result_t result;
+  SolveOk(loaded, capacity, &result);
+  EXPECT_EQ(result.optimal_value, 13);
+  knapsack_result_free(&result);
+}
+
+TEST(KnapsackBinaryTest, LoadingChecksLayoutNotItems) {
+  // Negative fields decode as stored; the solver rejects them later.
+  const std::vector<unsigned char> bytes = SaveInstance({{-5, -1}}, -3);
+  size_t count = 0;
+  int capacity = 0;
+  ASSERT_EQ(knapsack_binary_instance_header(bytes.data(), bytes.size(), &count, &capacity),
+            KNAPSACK_OK);
+  EXPECT_EQ(capacity, -3);
+  knapsack_item_t item{};
+  ASSERT_EQ(knapsack_binary_load_instance(bytes.data(), bytes.size(), &item, 1), KNAPSACK_OK);
+  EXPECT_EQ(item.weight, -5);
+  EXPECT_EQ(item.value, -1);
+}
+
+TEST(KnapsackBinaryTest, RejectsMalformedInstances) {
+  const std::vector<unsigned char> good = SaveInstance({{1, 1}, {2, 2}}, 5);
+  size_t count = 0;
+  int capacity = 0;
+  for (size_t size = 0; size < good.size(); ++size) {
+    EXPECT_EQ(knapsack_binary_instance_header(good.data(), size, &count, &capacity),
+              KNAPSACK_ERR_INVALID_FORMAT)
+        << size;
+  }
+  std::vector<unsigned char> bad_magic = good;
+  bad_magic[0] = 'X';
+  EXPECT_EQ(knapsack_binary_instance_header(bad_magic.data(), bad_magic.size(), &count, &capacity),
+            KNAPSACK_ERR_INVALID_FORMAT);
+  std::vector<unsigned char> bad_version = good;
+  bad_version[4] = 2;
+  EXPECT_EQ(
+      knapsack_binary_instance_header(bad_version.data(), bad_version.size(), &count, &capacity),
+      KNAPSACK_ERR_INVALID_FORMAT);
+  std::vector<unsigned char> huge_count = good;
+  huge_count[11] = 0xFF;
+  EXPECT_EQ(
+      knapsack_binary_instance_header(huge_count.data(), huge_count.size(), &count, &capacity),
+      KNAPSACK_ERR_INVALID_FORMAT);
+  knapsack_item_t one{};
+  EXPECT_EQ(knapsack_binary_load_instance(good.data(), good.size(), &one, 1),
+            KNAPSACK_ERR_INVALID_ARGUMENT);
+  EXPECT_EQ(knapsack_binary_instance_header(nullptr, 16, &count, &capacity),
+            KNAPSACK_ERR_INVALID_ARGUMENT);
+}
+
+TEST(KnapsackBinaryTest, SaveInstanceChecksArguments) {
+  const knapsack_item_t item = {1, 1};
+  unsigned char buffer[24];
+  EXPECT_EQ(knapsack_binary_save_instance(&item, 1, 1, buffer, sizeof buffer - 1, nullptr),
+            KNAPSACK_ERR_INVALID_ARGUMENT);
+  EXPECT_EQ(knapsack_binary_save_instance(nullptr, 1, 1, buffer, sizeof buffer, nullptr),
+            KNAPSACK_ERR_INVALID_ARGUMENT);
+  EXPECT_EQ(knapsack_binary_save_instance(&item, 1, 1, nullptr, sizeof buffer, nullptr),
+            KNAPSACK_ERR_INVALID_ARGUMENT);
+  EXPECT_EQ(knapsack_binary_save_instance(nullptr, 0, 7, buffer, sizeof buffer, nullptr),
+            KNAPSACK_OK);
+  EXPECT_EQ(knapsack_binary_instance_size(SIZE_MAX), 0U);
+  EXPECT_EQ(knapsack_binary_save_instance(&item, static_cast<size_t>(UINT32_MAX) + 1U, 1, buffer,
+                                          sizeof buffer, nullptr),
+            KNAPSACK_ERR_DIMENSION_OVERFLOW);
+}
+
+TEST(KnapsackBinaryTest, ResultRoundTripsWithAllocator) {
+  knapsack_result_t result;
+  SolveOk({{2, 3}, {3, 4}, {4, 5}, {5, 6}}, 10, &result);
+  std::vector<unsigned char> bytes(knapsack_binary_result_size(&result));
+  ASSERT_EQ(bytes.size(), KNAPSACK_BINARY_RESULT_HEADER_SIZE + 3U * 4U);
+  size_t written = 0;
+  ASSERT_EQ(knapsack_binary_save_result(KNAPSACK_OK, &result, bytes.data(), bytes.size(), &written),
+            KNAPSACK_OK);
+  EXPECT_EQ(written, bytes.size());
+  EXPECT_EQ(bytes[12], 13);    // optimal_value, little-endian
+  EXPECT_EQ(bytes[32 + 8], 3); // last selected index
+
+  CountingAllocator data{0, 0, 0, -1, -1};
+  knapsack_allocator_t alloc = {CountAlloc, CountCalloc, CountFree, &data};
+  knapsack_status_t stored = KNAPSACK_ERR_ALLOC;
+  knapsack_result_t loaded;
+  ASSERT_EQ(knapsack_binary_load_result(bytes.data(), bytes.size(), &alloc, &stored, &loaded),
+            KNAPSACK_OK);
+  EXPECT_EQ(stored, KNAPSACK_OK);
+  EXPECT_EQ(loaded.optimal_value, result.optimal_value);
+  EXPECT_EQ(loaded.total_weight, result.total_weight);
+  EXPECT_EQ(loaded.upper_bound, result.upper_bound);
+  EXPECT_THAT(std::vector<size_t>(loaded.selected_indices,
+                                  loaded.selected_indices + loaded.selected_count),
+              ElementsAre(0U, 1U, 3U));
+  EXPECT_EQ(data.alloc_calls, 1);
+  knapsack_result_free_ex(&loaded, &alloc);
+  EXPECT_EQ(data.free_calls, 1);
+  knapsack_result_free(&result);
+}
+
+TEST(KnapsackBinaryTest, ErrorRecordCarriesOnlyTheStatus) {
+  std::vector<unsigned char> bytes(knapsack_binary_result_size(nullptr));
+  ASSERT_EQ(bytes.size(), KNAPSACK_BINARY_RESULT_HEADER_SIZE);
+  ASSERT_EQ(knapsack_binary_save_result(KNAPSACK_ERR_TOO_MANY_ITEMS, nullptr, bytes.data(),
+                                        bytes.size(), nullptr),
+            KNAPSACK_OK);
+  knapsack_status_t stored = KNAPSACK_OK;
+  knapsack_result_t loaded;
+  ASSERT_EQ(knapsack_binary_load_result(bytes.data(), bytes.size(), nullptr, &stored, &loaded),
+            KNAPSACK_OK);
+  EXPECT_EQ(stored, KNAPSACK_ERR_TOO_MANY_ITEMS);
+  EXPECT_EQ(loaded.selected_count, 0U);
+  EXPECT_EQ(loaded.selected_indices, nullptr);
+}
+
+TEST(KnapsackBinaryTest, RejectsMalformedResults) {
+  knapsack_result_t result;
+  SolveOk({{1, 1}, {1, 2}}, 2, &result);
+  std::vector<unsigned char> bytes(knapsack_binary_result_size(&result));
+  ASSERT_EQ(knapsack_binary_save_result(KNAPSACK_OK, &result, bytes.data(), bytes.size(), nullptr),
+            KNAPSACK_OK);
+  EXPECT_EQ(knapsack_binary_save_result(KNAPSACK_OK, &result, bytes.data(), bytes.size() - 1U,
+                                        nullptr),
+            KNAPSACK_ERR_INVALID_ARGUMENT);
+  knapsack_result_free(&result);
+
+  knapsack_status_t stored = KNAPSACK_OK;
+  knapsack_result_t loaded;
+  EXPECT_EQ(knapsack_binary_load_result(bytes.data(), bytes.size() - 1U, nullptr, &stored,
+                                        &loaded),
+            KNAPSACK_ERR_INVALID_FORMAT);
+  EXPECT_EQ(loaded.selected_indices, nullptr);
+  bytes[3] = 'I';
+  EXPECT_EQ(knapsack_binary_load_result(bytes.data(), bytes.size(), nullptr, &stored, &loaded),
+            KNAPSACK_ERR_INVALID_FORMAT);
+  EXPECT_EQ(knapsack_binary_load_result(bytes.data(), bytes.size(), nullptr, &stored, nullptr),
+            KNAPSACK_ERR_NULL_RESULT);
+}
+
+// --- JSON writer --------------------------------------------------------------
+
+// The objects knapsack_demo has always printed, built with snprintf.
+std::string ReferenceResultJson(const knapsack_result_t &result) {
+  std::string out = "{\"status\":\"ok\",\"optimal_value\":" +
+                    std::to_string(result.optimal_value) + ",\"selected_indices\":[";
+  for (size_t i = 0; i < result.selected_count; ++i) {
+    out += (i > 0U ? "," : "") + std::to_string(result.selected_indices[i]);
+  }
+  return out + "]}\n";
+}
+
+std::string Written(const knapsack_writer_t &writer) {
+  return writer.length == 0U ? std::string() : std::string(writer.data, writer.length);
+}
+
+int AppendToString(const void *data, size_t size, void *user_data) {
+  auto *sink = static_cast<std::vector<std::string> *>(user_data);
+  sink->emplace_back(static_cast<const char *>(data), size);
+  return 0;
+}
+
+int FailWrite(const void *, size_t, void *) { return -1; }
+
+TEST(KnapsackJsonWriterTest, MatchesReferenceFormat) {
+  std::mt19937_64 rng(99U);
+  knapsack_writer_t writer;
+  knapsack_writer_init_growable(&writer, nullptr);
+  std::string expected;
+  const int values[] = {0, 7, -1, 99, 100, INT_MAX, INT_MIN, 123456789};
+  for (int trial = 0; trial < 200; ++trial) {
+    std::vector<size_t> indices(rng() % 40U);
+    for (auto &index : indices) {
+      // Uniform over digit counts 1 to 20 rather than over values.
+      const unsigned digits = 1U + static_cast<unsigned>(rng() % 20U);
+      unsigned long long low = 1U;
+      for (unsigned d = 1U; d < digits; ++d) {
+        low *= 10U;
+      }
+      const unsigned long long span = digits == 20U ? ULLONG_MAX - low : low * 9U;
+      index = static_cast<size_t>(low + rng() % span);
+    }
+    if (trial == 0) {
+      indices = {0U, 9U, 10U, 99U, 100U, SIZE_MAX};
+    }
+    knapsack_result_t result{};
+    result.optimal_value = values[trial % 8];
+    result.total_weight = values[(trial + 3) % 8];
+    result.selected_indices = indices.empty() ? nullptr : indices.data();
+    result.selected_count = indices.size();
+    ASSERT_EQ(knapsack_json_write_result(&writer, &result), KNAPSACK_OK);
+    expected += ReferenceResultJson(result);
+    ASSERT_EQ(knapsack_json_write_value(&writer, &result), KNAPSACK_OK);
+    expected += "{\"status\":\"ok\",\"optimal_value\":" + std::to_string(result.optimal_value) +
+                ",\"total_weight\":" + std::to_string(result.total_weight) + "}\n";
+  }
+  EXPECT_EQ(Written(writer), expected);
+  knapsack_writer_release(&writer);
+  EXPECT_EQ(writer.data, nullptr);
+}
+
+TEST(KnapsackJsonWriterTest, EscapesStringsAndNamesCodes) {
+  knapsack_writer_t writer;
+  knapsack_writer_init_growable(&writer, nullptr);
+  ASSERT_EQ(knapsack_json_write_error(&writer, KNAPSACK_ERR_INVALID_CAPACITY,
+                                      "bad \"x\"\\\n\t\b\f\r\x01\x1f end"),
+            KNAPSACK_OK);
+  EXPECT_EQ(Written(writer), "{\"status\":\"error\",\"code\":\"INVALID_CAPACITY\",\"message\":"
+                             "\"bad \\\"x\\\"\\\\\\n\\t\\b\\f\\r\\u0001\\u001f end\"}\n");
+  writer.length = 0U;
+  ASSERT_EQ(knapsack_json_write_error(&writer, KNAPSACK_ERR_IO, nullptr), KNAPSACK_OK);
+  EXPECT_EQ(Written(writer), "{\"status\":\"error\",\"code\":\"IO\",\"message\":\"\"}\n");
+  writer.length = 0U;
+  ASSERT_EQ(knapsack_json_write_string(&writer, "plain"), KNAPSACK_OK);
+  ASSERT_EQ(knapsack_json_write_string(&writer, nullptr), KNAPSACK_OK);
+  EXPECT_EQ(Written(writer), "plain");
+  knapsack_writer_release(&writer);
+  EXPECT_STREQ(knapsack_status_name(KNAPSACK_OK), "OK");
+  EXPECT_STREQ(knapsack_status_name(KNAPSACK_ERR_IO), "IO");
+}
+
+TEST(KnapsackJsonWriterTest, FixedStorageKeepsWholeObjects) {
+  char storage[96];
+  knapsack_writer_t writer;
+  knapsack_writer_init(&writer, storage, sizeof storage, nullptr, nullptr);
+  std::vector<size_t> indices(20U, 12345U);
+  knapsack_result_t result{};
+  result.optimal_value = 5;
+  result.selected_indices = indices.data();
+  result.selected_count = indices.size();
+  ASSERT_EQ(knapsack_json_write_value(&writer, &result), KNAPSACK_OK);
+  const std::string value_line = Written(writer);
+  EXPECT_EQ(knapsack_json_write_result(&writer, &result), KNAPSACK_ERR_INVALID_ARGUMENT);
+  EXPECT_EQ(Written(writer), value_line);
+  EXPECT_EQ(knapsack_json_write_error(&writer, KNAPSACK_ERR_ALLOC, std::string(200, 'm').c_str()),
+            KNAPSACK_ERR_INVALID_ARGUMENT);
+  EXPECT_EQ(knapsack_writer_append(&writer, storage, sizeof storage),
+            KNAPSACK_ERR_INVALID_ARGUMENT);
+  EXPECT_EQ(Written(writer), value_line);
+  // Flushing without a callback leaves the buffer alone.
+  EXPECT_EQ(knapsack_writer_flush(&writer), KNAPSACK_OK);
+  EXPECT_EQ(Written(writer), value_line);
+  knapsack_writer_release(&writer);
+}
+
+TEST(KnapsackJsonWriterTest, CallbackReceivesFullBuffers) {
+  std::vector<std::string> chunks;
+  char storage[KNAPSACK_WRITER_MIN_SIZE];
+  knapsack_writer_t writer;
+  knapsack_writer_init(&writer, storage, sizeof storage, AppendToString, &chunks);
+  std::vector<size_t> indices(1000U);
+  for (size_t i = 0; i < indices.size(); ++i) {
+    indices[i] = i * 37U;
+  }
+  knapsack_result_t result{};
+  result.optimal_value = 42;
+  result.selected_indices = indices.data();
+  result.selected_count = indices.size();
+  ASSERT_EQ(knapsack_json_write_result(&writer, &result), KNAPSACK_OK);
+  ASSERT_EQ(knapsack_json_write_error(&writer, KNAPSACK_ERR_ALLOC, std::string(300, 'm').c_str()),
+            KNAPSACK_OK);
+  ASSERT_EQ(knapsack_writer_append(&writer, std::string(500, 'r').data(), 500U), KNAPSACK_OK);
+  ASSERT_EQ(knapsack_writer_flush(&writer), KNAPSACK_OK);
+  EXPECT_EQ(writer.length, 0U);
+
+  std::string joined;
+  for (const auto &chunk : chunks) {
+    joined += chunk;
+  }
+  EXPECT_EQ(joined, ReferenceResultJson(result) +
+                        "{\"status\":\"error\",\"code\":\"ALLOC\",\"message\":\"" +
+                        std::string(300, 'm') + "\"}\n" + std::string(500, 'r'));
+  // Apart from the final flush, every write is a mostly full buffer (or
+  // the oversized tail of an append that bypasses it).
+  for (size_t i = 0; i + 1U < chunks.size(); ++i) {
+    EXPECT_GE(chunks[i].size(), sizeof storage - 21U) << i;
+  }
+}
+
+TEST(KnapsackJsonWriterTest, CallbackFailureIsReported) {
+  char storage[KNAPSACK_WRITER_MIN_SIZE];
+  knapsack_writer_t writer;
+  knapsack_writer_init(&writer, storage, sizeof storage, FailWrite, nullptr);
+  knapsack_result_t result{};
+  ASSERT_EQ(knapsack_json_write_value(&writer, &result), KNAPSACK_OK);
+  EXPECT_EQ(knapsack_writer_flush(&writer), KNAPSACK_ERR_IO);
+  EXPECT_EQ(knapsack_json_write_error(&writer, KNAPSACK_ERR_ALLOC, std::string(100, 'm').c_str()),
+            KNAPSACK_ERR_IO);
+}
+
+TEST(KnapsackJsonWriterTest, GrowthUsesAllocatorAndSurvivesFailure) {
+  CountingAllocator data{0, 0, 0, -1, -1};
+  knapsack_allocator_t alloc = {CountAlloc, CountCalloc, CountFree, &data};
+  knapsack_writer_t writer;
+  knapsack_writer_init_growable(&writer, &alloc);
+  knapsack_result_t result{};
+  result.optimal_value = 1;
+  ASSERT_EQ(knapsack_json_write_value(&writer, &result), KNAPSACK_OK);
+  const std::string first = Written(writer);
+
+  std::vector<size_t> indices(1000U, 7U);
+  result.selected_indices = indices.data();
+  result.selected_count = indices.size();
+  data.alloc_fail_after = 0;
+  EXPECT_EQ(knapsack_json_write_result(&writer, &result), KNAPSACK_ERR_ALLOC);
+  EXPECT_EQ(Written(writer), first);
+  data.alloc_fail_after = -1;
+  ASSERT_EQ(knapsack_json_write_result(&writer, &result), KNAPSACK_OK);
+  EXPECT_EQ(Written(writer), first + ReferenceResultJson(result));
+  knapsack_writer_release(&writer);
+  EXPECT_EQ(data.alloc_calls, data.free_calls);
+  EXPECT_EQ(knapsack_json_write_result(nullptr, &result), KNAPSACK_ERR_INVALID_ARGUMENT);
+  EXPECT_EQ(knapsack_json_write_result(&writer, nullptr), KNAPSACK_ERR_INVALID_ARGUMENT);
+  knapsack_writer_release(nullptr);
+}
+
+TEST(KnapsackJsonWriterTest, ExVariantsAppendStats) {
+  knapsack_stats_t stats{};
+  stats.engine = KNAPSACK_ENGINE_SPARSE;
+  stats.kernel = KNAPSACK_KERNEL_AUTO;
+  stats.workers = 1U;
+  stats.cells = 12345678901234ULL;
+  stats.engine_bytes = 4096U;
+  stats.arena_bytes = 4160U;
+  stats.instance_bytes = 64U;
+  stats.validate_ns = 10U;
+  stats.dp_ns = 20U;
+  stats.reconstruct_ns = 40U;
+  const std::string member =
+      ",\"stats\":{\"engine\":\"sparse\",\"kernel\":\"auto\",\"workers\":1,"
+      "\"cells\":12345678901234,\"cells_taken\":0,\"bytes\":{\"rows\":0,\"take_bits\":0,"
+      "\"engine\":4096,\"instance\":64,\"arena\":4160},\"ns\":{\"validate\":10,\"dp\":20,"
+      "\"select\":0,\"reconstruct\":40}}";
+
+  size_t indices[] = {2U, 5U};
+  knapsack_result_t result{};
+  result.optimal_value = 9;
+  result.total_weight = 4;
+  result.selected_indices = indices;
+  result.selected_count = 2U;
+  knapsack_writer_t writer;
+  knapsack_writer_init_growable(&writer, nullptr);
+  ASSERT_EQ(knapsack_json_write_result_ex(&writer, &result, &stats), KNAPSACK_OK);
+  ASSERT_EQ(knapsack_json_write_value_ex(&writer, &result, &stats), KNAPSACK_OK);
+  ASSERT_EQ(knapsack_json_write_result_ex(&writer, &result, nullptr), KNAPSACK_OK);
+  EXPECT_EQ(Written(writer),
+            "{\"status\":\"ok\",\"optimal_value\":9,\"selected_indices\":[2,5]" + member +
+                "}\n{\"status\":\"ok\",\"optimal_value\":9,\"total_weight\":4" + member +
+                "}\n" + ReferenceResultJson(result));
+  knapsack_writer_release(&writer);
+
+  // A fixed buffer too small for the stats keeps none of the object.
+  char storage[128];
+  knapsack_writer_init(&writer, storage, sizeof storage, nullptr, nullptr);
+  EXPECT_EQ(knapsack_json_write_result_ex(&writer, &result, &stats),
+            KNAPSACK_ERR_INVALID_ARGUMENT);
+  EXPECT_EQ(writer.length, 0U);
+}
+
+// --- Solver statistics ---------------------------------------------------------
+
+namespace {
+struct CellCount {
+  uint64_t cells;
+  uint64_t taken;
+};
+
+// Cells the dense DP updates and the decisions that take an item, counted
+// one cell at a time with the solver's tie-break.
+CellCount ReferenceCells(const std::vector<knapsack_item_t> &items, int capacity) {
+  const size_t width = static_cast<size_t>(capacity) + 1U;
+  std::vector<long long> value(width, 0);
+  std::vector<long long> weight(width, 0);
+  CellCount count{0U, 0U};
+  for (const auto &item : items) {
+    const auto item_weight = static_cast<size_t>(item.weight);
+    for (size_t cap = width; cap-- > item_weight;) {
+      ++count.cells;
+      const long long candidate = value[cap - item_weight] + item.value;
+      const long long candidate_weight = weight[cap - item_weight] + item.weight;
+      if (candidate > value[cap] || (candidate == value[cap] && candidate_weight < weight[cap])) {
+        value[cap] = candidate;
+        weight[cap] = candidate_weight;
+        ++count.taken;
+      }
+    }
+  }
+  return count;
+}
+
+// An instance preprocessing leaves alone at capacities between max_weight
+// and the total weight: every item fits, they do not all fit together, and
+// a weight of 1 keeps their GCD at 1.
+std::vector<knapsack_item_t> UnreducedItems(std::mt19937 &rng, size_t count,
+                                            int max_weight = 60) {
+  std::uniform_int_distribution<int> weight_dist(1, max_weight);
+  std::uniform_int_distribution<int> value_dist(0, 90);
+  std::vector<knapsack_item_t> items(count);
+  for (auto &item : items) {
+    item = {weight_dist(rng), value_dist(rng)};
+  }
+  items[0].weight = 1;
+  return items;
+}
+
+knapsack_stats_t SolveForStats(const std::vector<knapsack_item_t> &items, int capacity,
+                               knapsack_options_t options) {
+  knapsack_stats_t stats;
+  options.stats = &stats;
+  knapsack_result_t result;
+  EXPECT_EQ(knapsack_solve_opts(items.data(), items.size(), capacity, &options, &result),
+            KNAPSACK_OK);
+  knapsack_result_free(&result);
+  return stats;
+}
+} // namespace
+
+// NOLINTNEXTLINE(readability-function-cognitive-complexity)
+TEST(KnapsackStatsTest, DenseCountsEveryCellAndDecision) {
+  if (!knapsack_stats_available()) {
+    GTEST_SKIP() << "built without statistics";
+  }
+  std::mt19937 rng(4242U);
+  std::uniform_int_distribution<int> capacity_dist(100, 600);
+  knapsack_options_t options;
+  knapsack_options_init(&options);
+  options.engine = KNAPSACK_ENGINE_DENSE;
+  knapsack_workspace_t *ws = knapsack_workspace_create(nullptr);
+  ASSERT_NE(ws, nullptr);
+  for (int trial = 0; trial < 20; ++trial) {
+    const std::vector<knapsack_item_t> items = UnreducedItems(rng, 40U);
+    const int capacity = capacity_dist(rng);
+    const CellCount expected = ReferenceCells(items, capacity);
+
+    knapsack_stats_t stats;
+    options.stats = &stats;
+    knapsack_result_t result;
+    const auto start = std::chrono::steady_clock::now();
+    ASSERT_EQ(knapsack_solve_opts(items.data(), items.size(), capacity, &options, &result),
+              KNAPSACK_OK);
+    const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start);
+    knapsack_result_free(&result);
+    EXPECT_EQ(stats.engine, KNAPSACK_ENGINE_DENSE);
+    EXPECT_EQ(stats.kernel, knapsack_active_kernel());
+    EXPECT_EQ(stats.workers, 1U);
+    EXPECT_EQ(stats.cells, expected.cells);
+    EXPECT_EQ(stats.cells_taken, expected.taken);
+
+    const size_t width = static_cast<size_t>(capacity) + 1U;
+    const size_t row_words = (width + 63U) / 64U;
+    size_t trimmed_words = 0U;
+    for (const auto &item : items) {
+      trimmed_words += row_words - static_cast<size_t>(item.weight) / 64U;
+    }
+    EXPECT_GE(stats.row_bytes, width * (sizeof(int) + sizeof(uint32_t)));
+    EXPECT_GE(stats.take_bits_bytes, trimmed_words * sizeof(uint64_t));
+    EXPECT_EQ(stats.engine_bytes, 0U);
+    EXPECT_EQ(stats.instance_bytes, 0U);
+    EXPECT_EQ(stats.arena_bytes, stats.row_bytes + stats.take_bits_bytes);
+    EXPECT_LE(stats.validate_ns + stats.dp_ns + stats.select_ns + stats.reconstruct_ns,
+              static_cast<uint64_t>(elapsed.count()));
+
+    // A reused workspace reports the same work.
+    knapsack_stats_t again;
+    options.stats = &again;
+    ASSERT_EQ(knapsack_workspace_solve_opts(ws, items.data(), items.size(), capacity, &options,
+                                            &result),
+              KNAPSACK_OK);
+    knapsack_result_free(&result);
+    EXPECT_EQ(again.cells, stats.cells);
+    EXPECT_EQ(again.cells_taken, stats.cells_taken);
+    EXPECT_EQ(again.arena_bytes, stats.arena_bytes);
+  }
+  knapsack_workspace_destroy(ws);
+}
+
+TEST(KnapsackStatsTest, ParallelAndValueOnlyCountTheSameCells) {
+  if (!knapsack_stats_available()) {
+    GTEST_SKIP() << "built without statistics";
+  }
+  std::mt19937 rng(77U);
+  const std::vector<knapsack_item_t> items = UnreducedItems(rng, 100U, 200);
+  const int capacity = 6000; // 94 words: room for three chunks
+  const CellCount expected = ReferenceCells(items, capacity);
+
+  PoolPtr pool(knapsack_thread_pool_create(3U, nullptr));
+  ASSERT_NE(pool, nullptr);
+  const knapsack_stats_t parallel = SolveForStats(items, capacity, ParallelOptions(pool.get()));
+  EXPECT_EQ(parallel.workers, 3U);
+  EXPECT_EQ(parallel.cells, expected.cells);
+  EXPECT_EQ(parallel.cells_taken, expected.taken);
+
+  knapsack_options_t options;
+  knapsack_options_init(&options);
+  options.reconstruct = KNAPSACK_RECONSTRUCT_NONE;
+  options.engine = KNAPSACK_ENGINE_DENSE;
+  const knapsack_stats_t value_only = SolveForStats(items, capacity, options);
+  EXPECT_EQ(value_only.engine, KNAPSACK_ENGINE_DENSE);
+  EXPECT_EQ(value_only.cells, expected.cells);
+  EXPECT_EQ(value_only.cells_taken, 0U);
+  EXPECT_EQ(value_only.take_bits_bytes, 0U);
+  EXPECT_GT(value_only.row_bytes, 0U);
+}
+
+TEST(KnapsackStatsTest, OtherEnginesReportTheirOwnWork) {
+  if (!knapsack_stats_available()) {
+    GTEST_SKIP() << "built without statistics";
+  }
+  std::mt19937 rng(31U);
+  const std::vector<knapsack_item_t> items = UnreducedItems(rng, 30U);
+  const int capacity = 400;
+  knapsack_options_t options;
+  knapsack_options_init(&options);
+
+  for (knapsack_engine_t engine : {KNAPSACK_ENGINE_SPARSE, KNAPSACK_ENGINE_BRANCH_BOUND}) {
+    SCOPED_TRACE(knapsack_engine_name(engine));
+    options.engine = engine;
+    const knapsack_stats_t stats = SolveForStats(items, capacity, options);
+    EXPECT_EQ(stats.engine, engine);
+    EXPECT_EQ(stats.kernel, KNAPSACK_KERNEL_AUTO);
+    EXPECT_EQ(stats.workers, 1U);
+    EXPECT_GT(stats.cells, 0U);
+    EXPECT_EQ(stats.cells_taken, 0U);
+    EXPECT_GT(stats.engine_bytes, 0U);
+    EXPECT_EQ(stats.row_bytes, 0U);
+    EXPECT_EQ(stats.select_ns, 0U);
+  }
+
+  // Hirschberg recomputes rows on every level of its recursion.
+  options.engine = KNAPSACK_ENGINE_AUTO;
+  options.reconstruct = KNAPSACK_RECONSTRUCT_HIRSCHBERG;
+  const knapsack_stats_t stats = SolveForStats(items, capacity, options);
+  EXPECT_EQ(stats.engine, KNAPSACK_ENGINE_DENSE);
+  EXPECT_EQ(stats.kernel, knapsack_active_kernel());
+  EXPECT_GT(stats.cells, ReferenceCells(items, capacity).cells);
+  EXPECT_GE(stats.row_bytes, 2U * (capacity + 1U) * (sizeof(int) + sizeof(uint32_t)));
+  EXPECT_GT(stats.take_bits_bytes, 0U);
+}
+
+TEST(KnapsackStatsTest, TiledCountsTheDenseCells) {
+  if (!knapsack_stats_available()) {
+    GTEST_SKIP() << "built without statistics";
+  }
+  std::mt19937 rng(33U);
+  const std::vector<knapsack_item_t> items = UnreducedItems(rng, 30U);
+  const int capacity = 400;
+  knapsack_options_t options;
+  knapsack_options_init(&options);
+  options.engine = KNAPSACK_ENGINE_TILED;
+  options.tile_cells = 64U;
+  const knapsack_stats_t stats = SolveForStats(items, capacity, options);
+  EXPECT_EQ(stats.engine, KNAPSACK_ENGINE_TILED);
+  EXPECT_EQ(stats.kernel, knapsack_active_kernel());
+  EXPECT_EQ(stats.workers, 1U);
+  // The same cells as the sweep, in a different order.
+  EXPECT_EQ(stats.cells, ReferenceCells(items, capacity).cells);
+  EXPECT_GT(stats.cells_taken, 0U);
+  EXPECT_GE(stats.row_bytes, (capacity + 1U) * (sizeof(int) + sizeof(uint32_t)));
+  EXPECT_GT(stats.take_bits_bytes, 0U);
+  EXPECT_GE(stats.engine_bytes, 2U * 64U * (sizeof(int) + sizeof(uint32_t)));
+  EXPECT_GE(stats.instance_bytes, items.size() * (sizeof(knapsack_item_t) + sizeof(size_t)));
+}
+
+TEST(KnapsackStatsTest, DecisionRowsStartAtTheItemWeight) {
+  if (!knapsack_stats_available()) {
+    GTEST_SKIP() << "built without statistics";
+  }
+  std::mt19937 rng(29U);
+  const int capacity = 1000;
+  const std::vector<knapsack_item_t> items = HeavyItems(rng, 12U, capacity);
+  const size_t row_words = (capacity + 1U + 63U) / 64U;
+  size_t trimmed_words = 0U;
+  for (const auto &item : items) {
+    trimmed_words += row_words - static_cast<size_t>(item.weight) / 64U;
+  }
+  for (knapsack_engine_t engine : {KNAPSACK_ENGINE_DENSE, KNAPSACK_ENGINE_TILED}) {
+    SCOPED_TRACE(static_cast<int>(engine));
+    const knapsack_stats_t stats =
+        SolveForStats(items, capacity, EngineOptions(engine, KNAPSACK_RECONSTRUCT_BITSET));
+    // At most four of the sixteen words of each row, plus the row index.
+    EXPECT_GE(stats.take_bits_bytes, trimmed_words * sizeof(uint64_t));
+    EXPECT_LT(stats.take_bits_bytes, items.size() * row_words * sizeof(uint64_t) / 2U);
+  }
+}
+
+TEST(KnapsackStatsTest, TrivialAndBatchSolvesRunNoEngine) {
+  if (!knapsack_stats_available()) {
+    GTEST_SKIP() << "built without statistics";
+  }
+  const std::vector<knapsack_item_t> items = {{3, 4}, {5, 6}};
+  knapsack_stats_t stats;
+  stats.cells = 99U;
+  stats.engine = KNAPSACK_ENGINE_SPARSE;
+  knapsack_options_t options;
+  knapsack_options_init(&options);
+  options.stats = &stats;
+  knapsack_result_t result;
+  // Everything fits: preprocessing answers without running an engine.
+  ASSERT_EQ(knapsack_solve_opts(items.data(), items.size(), 8, &options, &result), KNAPSACK_OK);
+  knapsack_result_free(&result);
+  EXPECT_EQ(stats.engine, KNAPSACK_ENGINE_AUTO);
+  EXPECT_EQ(stats.workers, 0U);
+  EXPECT_EQ(stats.cells, 0U);
+  EXPECT_EQ(stats.arena_bytes, 0U);
+
+  // Batch instances would race for one struct, so batches leave it alone.
+  stats.cells = 99U;
+  const knapsack_instance_t instance = {items.data(), items.size(), 6};
+  knapsack_status_t status = KNAPSACK_ERR_ALLOC;
+  ASSERT_EQ(knapsack_solve_batch(&instance, 1U, &options, &result, &status), KNAPSACK_OK);
+  EXPECT_EQ(status, KNAPSACK_OK);
+  knapsack_result_free(&result);
+  EXPECT_EQ(stats.cells, 99U);
+}
+
+// --- Bounded and unbounded items ----------------------------------------------
+
+namespace {
+struct BoundedSolution {
+  knapsack_status_t status;
+  int value;
+  int weight;
+  std::vector<size_t> indices;
+  std::vector<int> quantities;
+};
+
+BoundedSolution SolveBounded(const std::vector<knapsack_bounded_item_t> &items, int capacity,
+                             const knapsack_options_t *options = nullptr) {
+  knapsack_bounded_result_t result;
+  BoundedSolution out{
+      knapsack_solve_bounded(items.data(), items.size(), capacity, options, &result), 0, 0, {}, {}};
+  if (out.status == KNAPSACK_OK) {
+    out.value = result.optimal_value;
+    out.weight = result.total_weight;
+    out.indices.assign(result.selected_indices, result.selected_indices + result.selected_count);
+    out.quantities.assign(result.quantities, result.quantities + result.selected_count);
+    knapsack_bounded_result_free_ex(&result, options ? options->allocator : nullptr);
+  }
+  return out;
+}
+
+// Exact-weight DP that tries every copy count of every item: best value, then
+// smallest weight.
+std::pair<int, int> BoundedReference(const std::vector<knapsack_bounded_item_t> &items,
+                                     int capacity) {
+  std::vector<long long> reach{0}; // only the empty selection weighs nothing
+  reach.resize(static_cast<size_t>(capacity) + 1U, -1);
+  for (const knapsack_bounded_item_t &item : items) {
+    std::vector<long long> next = reach;
+    for (int w = 0; w <= capacity; ++w) {
+      if (reach[w] < 0) {
+        continue;
+      }
+      for (long long q = 1; q <= item.count && w + q * item.weight <= capacity; ++q) {
+        const size_t to = static_cast<size_t>(w + q * item.weight);
+        next[to] = std::max(next[to], reach[w] + q * item.value);
+      }
+    }
+    reach = std::move(next);
+  }
+  std::pair<int, int> best{0, 0};
+  for (int w = 0; w <= capacity; ++w) {
+    if (reach[w] > best.first) {
+      best = {static_cast<int>(reach[w]), w};
+    }
+  }
+  return best;
+}
+
+// The selection is ascending, within each count and adds up to the totals.
+void ExpectBoundedConsistent(const std::vector<knapsack_bounded_item_t> &items,
+                             const BoundedSolution &solution) {
+  ASSERT_EQ(solution.indices.size(), solution.quantities.size());
+  long long value = 0;
+  long long weight = 0;
+  for (size_t k = 0; k < solution.indices.size(); ++k) {
+    if (k > 0U) {
+      EXPECT_LT(solution.indices[k - 1U], solution.indices[k]);
+    }
+    const knapsack_bounded_item_t &item = items[solution.indices[k]];
+    EXPECT_GT(solution.quantities[k], 0);
+    EXPECT_LE(solution.quantities[k], item.count);
+    value += static_cast<long long>(item.value) * solution.quantities[k];
+    weight += static_cast<long long>(item.weight) * solution.quantities[k];
+  }
+  EXPECT_EQ(value, solution.value);
+  EXPECT_EQ(weight, solution.weight);
+}
+} // namespace
+
+TEST(KnapsackBoundedTest, SolvesSmallExample) {
+  // Three copies of the 3/5 item beat anything using the 4/6 one.
+  const std::vector<knapsack_bounded_item_t> items = {{3, 5, 3}, {4, 6, 2}, {5, 1, 1}};
+  const BoundedSolution solution = SolveBounded(items, 9);
+  ASSERT_EQ(solution.status, KNAPSACK_OK);
+  EXPECT_EQ(solution.value, 15);
+  EXPECT_EQ(solution.weight, 9);
+  EXPECT_THAT(solution.indices, ElementsAre(0U));
+  EXPECT_THAT(solution.quantities, ElementsAre(3));
+}
+
+TEST(KnapsackBoundedTest, MatchesReferenceForRandomCounts) {
+  std::mt19937 rng(2101);
+  std::uniform_int_distribution<int> count_dist(1, 8);
+  std::uniform_int_distribution<int> weight_dist(1, 15);
+  std::uniform_int_distribution<int> value_dist(0, 30);
+  std::uniform_int_distribution<int> copies_dist(0, 12);
+  std::uniform_int_distribution<int> capacity_dist(0, 80);
+  for (int trial = 0; trial < 300; ++trial) {
+    std::vector<knapsack_bounded_item_t> items(static_cast<size_t>(count_dist(rng)));
+    for (knapsack_bounded_item_t &item : items) {
+      item = {weight_dist(rng), value_dist(rng), copies_dist(rng)};
+      if (trial % 5 == 0 && item.count % 3 == 0) {
+        item.count = KNAPSACK_UNBOUNDED;
+      }
+    }
+    const int capacity = capacity_dist(rng);
+    const BoundedSolution solution = SolveBounded(items, capacity);
+    ASSERT_EQ(solution.status, KNAPSACK_OK) << "trial " << trial;
+    const std::pair<int, int> expected = BoundedReference(items, capacity);
+    EXPECT_EQ(solution.value, expected.first) << "trial " << trial;
+    EXPECT_EQ(solution.weight, expected.second) << "trial " << trial;
+    ExpectBoundedConsistent(items, solution);
+  }
+}
+
+TEST(KnapsackBoundedTest, UnboundedItemsFillTheCapacity) {
+  // Only the 7/10 item is unbounded: 14 copies fit into 100, plus the 2/2.
+  const std::vector<knapsack_bounded_item_t> items = {
+      {7, 10, KNAPSACK_UNBOUNDED}, {2, 2, 1}, {50, 60, 1}};
+  const BoundedSolution solution = SolveBounded(items, 100);
+  ASSERT_EQ(solution.status, KNAPSACK_OK);
+  const std::pair<int, int> expected = BoundedReference(items, 100);
+  EXPECT_EQ(solution.value, expected.first);
+  EXPECT_EQ(solution.weight, expected.second);
+  ExpectBoundedConsistent(items, solution);
+}
+
+TEST(KnapsackBoundedTest, CopiesBeyondTheItemLimit) {
+  // 40000 units as 0/1 items would exceed max_items; split, they are 16 rows.
+  knapsack_options_t options;
+  knapsack_options_init(&options);
+  options.limits.max_items = 2U;
+  const std::vector<knapsack_bounded_item_t> items = {{1, 1, 40000}, {3, 4, KNAPSACK_UNBOUNDED}};
+  const BoundedSolution solution = SolveBounded(items, 30001, &options);
+  ASSERT_EQ(solution.status, KNAPSACK_OK);
+  EXPECT_EQ(solution.value, 40001);
+  EXPECT_EQ(solution.weight, 30001);
+  EXPECT_THAT(solution.indices, ElementsAre(0U, 1U));
+  EXPECT_THAT(solution.quantities, ElementsAre(1, 10000));
+}
+
+TEST(KnapsackBoundedTest, EnginesAndModesAgree) {
+  std::mt19937 rng(2102);
+  std::uniform_int_distribution<int> weight_dist(1, 400);
+  std::uniform_int_distribution<int> value_dist(0, 500);
+  std::uniform_int_distribution<int> copies_dist(0, 40);
+  const knapsack_engine_t engines[] = {KNAPSACK_ENGINE_DENSE, KNAPSACK_ENGINE_SPARSE,
+                                       KNAPSACK_ENGINE_BRANCH_BOUND};
+  for (int trial = 0; trial < 20; ++trial) {
+    std::vector<knapsack_bounded_item_t> items(12U);
+    for (knapsack_bounded_item_t &item : items) {
+      item = {weight_dist(rng), value_dist(rng), copies_dist(rng)};
+    }
+    const int capacity = 2000 + trial * 50;
+    const BoundedSolution reference = SolveBounded(items, capacity);
+    ASSERT_EQ(reference.status, KNAPSACK_OK);
+    ExpectBoundedConsistent(items, reference);
+    for (knapsack_engine_t engine : engines) {
+      const knapsack_options_t options = EngineOptions(engine);
+      const BoundedSolution solution = SolveBounded(items, capacity, &options);
+      ASSERT_EQ(solution.status, KNAPSACK_OK);
+      EXPECT_EQ(solution.value, reference.value);
+      EXPECT_EQ(solution.weight, reference.weight);
+      ExpectBoundedConsistent(items, solution);
+    }
+    const knapsack_options_t hirschberg = HirschbergOptions();
+    const BoundedSolution linear = SolveBounded(items, capacity, &hirschberg);
+    ASSERT_EQ(linear.status, KNAPSACK_OK);
+    EXPECT_EQ(linear.value, reference.value);
+    EXPECT_EQ(linear.weight, reference.weight);
+    ExpectBoundedConsistent(items, linear);
+
+    const knapsack_options_t value_only = ValueOnlyOptions();
+    const BoundedSolution bare = SolveBounded(items, capacity, &value_only);
+    ASSERT_EQ(bare.status, KNAPSACK_OK);
+    EXPECT_EQ(bare.value, reference.value);
+    EXPECT_EQ(bare.weight, reference.weight);
+    EXPECT_TRUE(bare.indices.empty());
+  }
+}
+
+TEST(KnapsackBoundedTest, NothingWorthTakingIsEmpty) {
+  const std::vector<knapsack_bounded_item_t> items = {
+      {5, 0, KNAPSACK_UNBOUNDED}, {20, 9, 3}, {1, 7, 0}};
+  const BoundedSolution solution = SolveBounded(items, 10);
+  ASSERT_EQ(solution.status, KNAPSACK_OK);
+  EXPECT_EQ(solution.value, 0);
+  EXPECT_EQ(solution.weight, 0);
+  EXPECT_TRUE(solution.indices.empty());
+}
+
+TEST(KnapsackBoundedTest, RejectsInvalidArguments) {
+  const std::vector<knapsack_bounded_item_t> items = {{2, 3, 1}};
+  knapsack_bounded_result_t result;
+  EXPECT_EQ(knapsack_solve_bounded(items.data(), 1U, 5, nullptr, nullptr),
+            KNAPSACK_ERR_NULL_RESULT);
+  EXPECT_EQ(knapsack_solve_bounded(nullptr, 1U, 5, nullptr, &result), KNAPSACK_ERR_INVALID_ITEMS);
+  EXPECT_EQ(knapsack_solve_bounded(items.data(), 0U, 5, nullptr, &result),
+            KNAPSACK_ERR_INVALID_ITEMS);
+  EXPECT_EQ(knapsack_solve_bounded(items.data(), 1U, -1, nullptr, &result),
+            KNAPSACK_ERR_INVALID_CAPACITY);
+  EXPECT_EQ(SolveBounded({{0, 3, 1}}, 5).status, KNAPSACK_ERR_INVALID_ITEMS);
+  EXPECT_EQ(SolveBounded({{2, -3, 1}}, 5).status, KNAPSACK_ERR_INVALID_ITEMS);
+  EXPECT_EQ(SolveBounded({{2, 3, -1}}, 5).status, KNAPSACK_ERR_INVALID_ITEMS);
+
+  knapsack_options_t options;
+  knapsack_options_init(&options);
+  options.limits.max_items = 1U;
+  EXPECT_EQ(SolveBounded({{2, 3, 1}, {2, 3, 1}}, 5, &options).status,
+            KNAPSACK_ERR_TOO_MANY_ITEMS);
+  options.limits.max_capacity = 4;
+  EXPECT_EQ(SolveBounded({{2, 3, 1}}, 5, &options).status, KNAPSACK_ERR_INVALID_CAPACITY);
+  options.limits.max_items = 0U;
+  EXPECT_EQ(SolveBounded({{2, 3, 1}}, 4, &options).status, KNAPSACK_ERR_INVALID_ARGUMENT);
+  EXPECT_EQ(result.selected_indices, nullptr);
+  EXPECT_EQ(result.quantities, nullptr);
+}
+
+TEST(KnapsackBoundedTest, DetectsValueOverflow) {
+  // One piece of copies alone is worth more than INT_MAX ...
+  EXPECT_EQ(SolveBounded({{1, INT_MAX / 2 + 1, 2}}, 2).status, KNAPSACK_ERR_INT_OVERFLOW);
+  // ... and so is the sum of two pieces.
+  EXPECT_EQ(SolveBounded({{1, INT_MAX / 3 + 1, 3}}, 3).status, KNAPSACK_ERR_INT_OVERFLOW);
+  // Copies that do not fit are never counted.
+  const BoundedSolution fits = SolveBounded({{2, INT_MAX / 2 + 1, KNAPSACK_UNBOUNDED}}, 3);
+  ASSERT_EQ(fits.status, KNAPSACK_OK);
+  EXPECT_EQ(fits.value, INT_MAX / 2 + 1);
+  EXPECT_THAT(fits.quantities, ElementsAre(1));
+}
+
+TEST(KnapsackBoundedTest, CustomAllocatorIsBalanced) {
+  const std::vector<knapsack_bounded_item_t> items = {{3, 5, 3}, {4, 6, 2}, {1, 1, 9}};
+  for (int fail_after = 0; fail_after < 6; ++fail_after) {
+    CountingAllocator data{0, 0, 0, fail_after, -1};
+    knapsack_allocator_t alloc = {CountAlloc, CountCalloc, CountBlockFree, &data};
+    knapsack_options_t options;
+    knapsack_options_init(&options);
+    options.allocator = &alloc;
+    knapsack_bounded_result_t result;
+    const knapsack_status_t status =
+        knapsack_solve_bounded(items.data(), items.size(), 12, &options, &result);
+    EXPECT_TRUE(status == KNAPSACK_OK || status == KNAPSACK_ERR_ALLOC);
+    if (status == KNAPSACK_OK) {
+      EXPECT_EQ(result.optimal_value, BoundedReference(items, 12).first);
+    } else {
+      EXPECT_EQ(result.selected_indices, nullptr);
+    }
+    knapsack_bounded_result_free_ex(&result, &alloc);
+    EXPECT_EQ(data.alloc_calls + data.calloc_calls, data.free_calls) << "fail_after " << fail_after;
+  }
+  knapsack_bounded_result_free_ex(nullptr, nullptr);
+}
+
+// --- Top-K selections -----------------------------------------------------------
+
+namespace {
+struct TopK {
+  knapsack_status_t status;
+  std::vector<FullSolution> ranks;
+};
+
+TopK SolveTopK(const std::vector<knapsack_item_t> &items, int capacity, size_t k,
+               const knapsack_options_t *options = nullptr) {
+  std::vector<knapsack_result_t> results(k);
+  size_t found = 99U;
+  TopK out{knapsack_solve_top_k(items.data(), items.size(), capacity, k, options, results.data(),
+                                &found),
+           {}};
+  if (out.status != KNAPSACK_OK) {
+    EXPECT_EQ(found, 0U);
+  }
+  EXPECT_LE(found, k);
+  for (size_t rank = 0; rank < k; ++rank) {
+    knapsack_result_t &result = results[rank];
+    if (rank < found) {
+      out.ranks.push_back({KNAPSACK_OK, result.optimal_value, result.total_weight,
+                           std::vector<size_t>(result.selected_indices,
+                                               result.selected_indices + result.selected_count)});
+      EXPECT_EQ(result.upper_bound, result.optimal_value);
+    } else {
+      EXPECT_EQ(result.selected_indices, nullptr);
+      EXPECT_EQ(result.optimal_value, 0);
+    }
+    knapsack_result_free_ex(&result, options ? options->allocator : nullptr);
+  }
+  return out;
+}
+
+// Every feasible subset as (value, weight), best first.
+std::vector<std::pair<int, int>> RankedSubsets(const std::vector<knapsack_item_t> &items,
+                                               int capacity) {
+  std::vector<std::pair<int, int>> ranked;
+  for (size_t mask = 0; mask < (size_t{1} << items.size()); ++mask) {
+    int value = 0;
+    int weight = 0;
+    for (size_t i = 0; i < items.size(); ++i) {
+      if ((mask >> i) & 1U) {
+        value += items[i].value;
+        weight += items[i].weight;
+      }
+    }
+    if (weight <= capacity) {
+      ranked.emplace_back(value, weight);
+    }
+  }
+  std::sort(ranked.begin(), ranked.end(), [](const auto &a, const auto &b) {
+    return a.first != b.first ? a.first > b.first : a.second < b.second;
+  });
+  return ranked;
+}
+} // namespace
+
+// NOLINTNEXTLINE(readability-function-cognitive-complexity)
+TEST(KnapsackTopKTest, MatchesBruteForceRanking) {
+  std::mt19937 rng(2201);
+  std::uniform_int_distribution<int> count_dist(1, 10);
+  std::uniform_int_distribution<int> weight_dist(1, 20);
+  std::uniform_int_distribution<int> value_dist(0, 25);
+  std::uniform_int_distribution<int> capacity_dist(0, 60);
+  std::uniform_int_distribution<int> k_dist(1, 40);
+  for (int trial = 0; trial < 200; ++trial) {
+    std::vector<knapsack_item_t> items(static_cast<size_t>(count_dist(rng)));
+    for (knapsack_item_t &item : items) {
+      item = {weight_dist(rng), value_dist(rng)};
+    }
+    const int capacity = capacity_dist(rng);
+    const auto k = static_cast<size_t>(k_dist(rng));
+    const TopK top = SolveTopK(items, capacity, k);
+    ASSERT_EQ(top.status, KNAPSACK_OK) << "trial " << trial;
+    const std::vector<std::pair<int, int>> ranked = RankedSubsets(items, capacity);
+    ASSERT_EQ(top.ranks.size(), std::min(k, ranked.size())) << "trial " << trial;
+    std::vector<std::vector<size_t>> seen;
+    for (size_t rank = 0; rank < top.ranks.size(); ++rank) {
+      const FullSolution &solution = top.ranks[rank];
+      EXPECT_EQ(solution.value, ranked[rank].first) << "trial " << trial << " rank " << rank;
+      EXPECT_EQ(solution.weight, ranked[rank].second) << "trial " << trial << " rank " << rank;
+      ExpectConsistent(items, solution);
+      EXPECT_TRUE(std::is_sorted(solution.indices.begin(), solution.indices.end()));
+      EXPECT_EQ(std::find(seen.begin(), seen.end(), solution.indices), seen.end());
+      seen.push_back(solution.indices);
+    }
+  }
+}
+
+TEST(KnapsackTopKTest, RankZeroIsTheDenseSelection) {
+  std::mt19937 rng(2202);
+  std::uniform_int_distribution<int> weight_dist(1, 300);
+  std::uniform_int_distribution<int> value_dist(0, 100);
+  const knapsack_options_t dense = EngineOptions(KNAPSACK_ENGINE_DENSE);
+  for (int trial = 0; trial < 20; ++trial) {
+    std::vector<knapsack_item_t> items(40U);
+    for (knapsack_item_t &item : items) {
+      item = {weight_dist(rng), value_dist(rng)};
+    }
+    const int capacity = 1000 + trial * 100;
+    const TopK top = SolveTopK(items, capacity, 8U);
+    ASSERT_EQ(top.status, KNAPSACK_OK);
+    ASSERT_EQ(top.ranks.size(), 8U);
+    EXPECT_EQ(top.ranks[0], SolveFull(items, capacity, dense)) << "trial " << trial;
+  }
+}
+
+TEST(KnapsackTopKTest, FewerSelectionsThanAsked) {
+  // {}, {0}, {1}, {0, 1}, and the item heavier than capacity is in none.
+  const std::vector<knapsack_item_t> items = {{2, 3}, {3, 4}, {9, 100}};
+  const TopK top = SolveTopK(items, 5, 10U);
+  ASSERT_EQ(top.status, KNAPSACK_OK);
+  ASSERT_EQ(top.ranks.size(), 4U);
+  EXPECT_THAT(top.ranks[0].indices, ElementsAre(0U, 1U));
+  EXPECT_THAT(top.ranks[1].indices, ElementsAre(1U));
+  EXPECT_THAT(top.ranks[2].indices, ElementsAre(0U));
+  EXPECT_TRUE(top.ranks[3].indices.empty());
+  EXPECT_EQ(top.ranks[3].value, 0);
+}
+
+TEST(KnapsackTopKTest, TiesEnumerateDistinctSelections) {
+  // 2^16 selections share each value; every popped one must still be new.
+  const std::vector<knapsack_item_t> items(16U, knapsack_item_t{1, 0});
+  const TopK top = SolveTopK(items, 16, KNAPSACK_MAX_TOP_K);
+  ASSERT_EQ(top.status, KNAPSACK_OK);
+  ASSERT_EQ(top.ranks.size(), KNAPSACK_MAX_TOP_K);
+  std::vector<std::vector<size_t>> seen;
+  for (size_t rank = 0; rank < top.ranks.size(); ++rank) {
+    EXPECT_EQ(top.ranks[rank].weight, static_cast<int>(top.ranks[rank].indices.size()));
+    if (rank > 0U) {
+      EXPECT_LE(top.ranks[rank - 1U].weight, top.ranks[rank].weight);
+    }
+    seen.push_back(top.ranks[rank].indices);
+  }
+  std::sort(seen.begin(), seen.end());
+  EXPECT_EQ(std::adjacent_find(seen.begin(), seen.end()), seen.end());
+}
+
+TEST(KnapsackTopKTest, ValueOnlyReportsTheSameRanking) {
+  const std::vector<knapsack_item_t> items = WideItems(12U, 2203U);
+  const TopK full = SolveTopK(items, 20000, 16U);
+  const knapsack_options_t value_only = ValueOnlyOptions();
+  const TopK bare = SolveTopK(items, 20000, 16U, &value_only);
+  ASSERT_EQ(full.status, KNAPSACK_OK);
+  ASSERT_EQ(bare.status, KNAPSACK_OK);
+  ASSERT_EQ(bare.ranks.size(), full.ranks.size());
+  for (size_t rank = 0; rank < full.ranks.size(); ++rank) {
+    EXPECT_EQ(bare.ranks[rank].value, full.ranks[rank].value);
+    EXPECT_EQ(bare.ranks[rank].weight, full.ranks[rank].weight);
+    EXPECT_TRUE(bare.ranks[rank].indices.empty());
+  }
+}
+
+TEST(KnapsackTopKTest, RejectsInvalidArguments) {
+  const std::vector<knapsack_item_t> items = {{2, 3}, {3, 4}};
+  knapsack_result_t results[2];
+  size_t found = 7U;
+  EXPECT_EQ(knapsack_solve_top_k(items.data(), 2U, 5, 2U, nullptr, nullptr, &found),
+            KNAPSACK_ERR_NULL_RESULT);
+  EXPECT_EQ(knapsack_solve_top_k(items.data(), 2U, 5, 2U, nullptr, results, nullptr),
+            KNAPSACK_ERR_NULL_RESULT);
+  EXPECT_EQ(knapsack_solve_top_k(items.data(), 2U, 5, 0U, nullptr, results, &found),
+            KNAPSACK_ERR_INVALID_ARGUMENT);
+  EXPECT_EQ(found, 0U);
+  EXPECT_EQ(SolveTopK(items, 5, KNAPSACK_MAX_TOP_K + 1U).status, KNAPSACK_ERR_INVALID_ARGUMENT);
+  EXPECT_EQ(SolveTopK(items, -1, 2U).status, KNAPSACK_ERR_INVALID_CAPACITY);
+  EXPECT_EQ(SolveTopK({{0, 3}}, 5, 2U).status, KNAPSACK_ERR_INVALID_ITEMS);
+  knapsack_options_t options;
+  knapsack_options_init(&options);
+  options.limits.max_items = 1U;
+  EXPECT_EQ(SolveTopK(items, 5, 2U, &options).status, KNAPSACK_ERR_TOO_MANY_ITEMS);
+  options.limits.max_items = 0U;
+  EXPECT_EQ(SolveTopK(items, 5, 2U, &options).status, KNAPSACK_ERR_INVALID_ARGUMENT);
+}
+
+TEST(KnapsackTopKTest, RefusesTablesOverTheMemoryBudget) {
+  // Value-only solves accept raised limits. 101 rows of 200001 cells at 8
+  // bytes are past the budget, and refused before allocating.
+  std::vector<knapsack_item_t> items(100U, knapsack_item_t{1000, 1});
+  CountingAllocator data{0, 0, 0, -1, -1};
+  knapsack_allocator_t alloc = {CountAlloc, CountCalloc, CountBlockFree, &data};
+  knapsack_options_t options = ValueOnlyOptions();
+  options.allocator = &alloc;
+  options.limits.max_capacity = 200000;
+  EXPECT_EQ(SolveTopK(items, 200000, 2U, &options).status, KNAPSACK_ERR_LIMIT);
+  EXPECT_EQ(data.alloc_calls + data.calloc_calls, 0);
+  // The default limits stay within it, however large k.
+  knapsack_options_init(&options);
+  options.allocator = &alloc;
+  EXPECT_EQ(SolveTopK(items, KNAPSACK_MAX_CAPACITY, KNAPSACK_MAX_TOP_K, &options).status,
+            KNAPSACK_OK);
+}
+
+TEST(KnapsackTopKTest, DetectsValueOverflow) {
+  EXPECT_EQ(SolveTopK({{1, INT_MAX}, {1, 1}}, 2, 3U).status, KNAPSACK_ERR_INT_OVERFLOW);
+  // Apart, both fit: only the pair would overflow, and it does not fit.
+  const TopK apart = SolveTopK({{2, INT_MAX}, {2, 1}}, 3, 3U);
+  ASSERT_EQ(apart.status, KNAPSACK_OK);
+  EXPECT_EQ(apart.ranks.size(), 3U);
+}
+
+TEST(KnapsackTopKTest, CancelledSolveFails) {
+  CancelAfter cancel{2, 0};
+  knapsack_options_t options;
+  knapsack_options_init(&options);
+  options = CancelOptions(options, &cancel, true);
+  EXPECT_EQ(SolveTopK(WideItems(20U, 2204U), kWideCapacity, 2U, &options).status,
+            KNAPSACK_ERR_CANCELLED);
+  EXPECT_EQ(cancel.polls, 2);
+}
+
+TEST(KnapsackTopKTest, AllocationFailuresAreBalanced) {
+  const std::vector<knapsack_item_t> items = {{2, 3}, {3, 4}, {4, 8}, {5, 8}};
+  for (int fail_after = 0; fail_after < 8; ++fail_after) {
+    CountingAllocator data{0, 0, 0, fail_after, -1};
+    knapsack_allocator_t alloc = {CountAlloc, CountCalloc, CountBlockFree, &data};
+    knapsack_options_t options;
+    knapsack_options_init(&options);
+    options.allocator = &alloc;
+    const knapsack_status_t status = SolveTopK(items, 9, 6U, &options).status;
+    EXPECT_TRUE(status == KNAPSACK_OK || status == KNAPSACK_ERR_ALLOC);
+    EXPECT_EQ(data.alloc_calls + data.calloc_calls, data.free_calls) << "fail_after " << fail_after;
+  }
+}
+
+TEST(KnapsackTopKTest, StatsReportTheKeptRows) {
+  if (!knapsack_stats_available()) {
+    GTEST_SKIP() << "built without statistics";
+  }
+  const std::vector<knapsack_item_t> items = {{2, 3}, {3, 4}, {40, 8}};
+  knapsack_stats_t stats;
+  knapsack_options_t options;
+  knapsack_options_init(&options);
+  options.stats = &stats;
+  ASSERT_EQ(SolveTopK(items, 10, 4U, &options).status, KNAPSACK_OK);
+  EXPECT_EQ(stats.engine, KNAPSACK_ENGINE_DENSE);
+  EXPECT_EQ(stats.cells, (11U - 2U) + (11U - 3U));
+  EXPECT_EQ(stats.row_bytes, 3U * 11U * (sizeof(int) + sizeof(uint32_t)));
+  EXPECT_GT(stats.engine_bytes, 0U);
+  EXPECT_EQ(stats.take_bits_bytes, 0U);
+}
+
+namespace {
+struct Solution64 {
+  knapsack_status_t status;
+  int64_t value;
+  int weight;
+  std::vector<size_t> indices;
+};
+
+Solution64 Solve64(const std::vector<knapsack_item64_t> &items, int capacity,
+                   const knapsack_options_t *options = nullptr) {
+  knapsack_result64_t result;
+  Solution64 out{knapsack_solve64(items.data(), items.size(), capacity, options, &result), 0, 0,
+                 {}};
+  if (out.status == KNAPSACK_OK) {
+    out.value = result.optimal_value;
+    out.weight = result.total_weight;
+    out.indices.assign(result.selected_indices, result.selected_indices + result.selected_count);
+    EXPECT_EQ(result.upper_bound, result.optimal_value);
+  } else {
+    EXPECT_EQ(result.selected_indices, nullptr);
+  }
+  knapsack_result64_free_ex(&result, options ? options->allocator : nullptr);
+  return out;
+}
+
+std::vector<knapsack_item64_t> Widen(const std::vector<knapsack_item_t> &items) {
+  std::vector<knapsack_item64_t> wide;
+  for (const knapsack_item_t &item : items) {
+    wide.push_back({item.weight, item.value});
+  }
+  return wide;
+}
+
+// Best (value, then weight) over every subset that fits.
+std::pair<int64_t, int> BruteForce64(const std::vector<knapsack_item64_t> &items, int capacity) {
+  std::pair<int64_t, int> best{0, 0};
+  for (size_t mask = 0; mask < (size_t{1} << items.size()); ++mask) {
+    int64_t value = 0;
+    int weight = 0;
+    for (size_t i = 0; i < items.size(); ++i) {
+      if ((mask >> i) & 1U) {
+        value += items[i].value;
+        weight += items[i].weight;
+      }
+    }
+    if (weight <= capacity &&
+        (value > best.first || (value == best.first && weight < best.second))) {
+      best = {value, weight};
+    }
+  }
+  return best;
+}
+} // namespace
+
+// NOLINTNEXTLINE(readability-function-cognitive-complexity)
+TEST(KnapsackSolve64Test, MatchesDenseSolverWithEveryKernel) {
+  std::mt19937 rng(2301);
+  std::uniform_int_distribution<int> count_dist(1, 30);
+  std::uniform_int_distribution<int> capacity_dist(0, 300);
+  std::uniform_int_distribution<int> value_dist(0, 40);
+  const knapsack_options_t dense = EngineOptions(KNAPSACK_ENGINE_DENSE);
+  std::vector<knapsack_kernel_t> kernels = {KNAPSACK_KERNEL_SCALAR};
+  kernels.insert(kernels.end(), std::begin(kSimdKernels), std::end(kSimdKernels));
+  for (knapsack_kernel_t kernel : kernels) {
+    if (!knapsack_kernel_supported(kernel)) {
+      continue;
+    }
+    SCOPED_TRACE(knapsack_kernel_name(kernel));
+    const KernelOverride guard(kernel);
+    ASSERT_EQ(guard.status(), KNAPSACK_OK);
+    for (int trial = 0; trial < 100; ++trial) {
+      const int capacity = capacity_dist(rng);
+      std::uniform_int_distribution<int> weight_dist(1, trial % 2 == 0 ? 5 : capacity + 2);
+      std::vector<knapsack_item_t> items(static_cast<size_t>(count_dist(rng)));
+      for (knapsack_item_t &item : items) {
+        item = {weight_dist(rng), value_dist(rng)};
+      }
+      const FullSolution expected = SolveFull(items, capacity, dense);
+      const Solution64 observed = Solve64(Widen(items), capacity);
+      ASSERT_EQ(observed.status, KNAPSACK_OK) << "trial " << trial;
+      EXPECT_EQ(observed.value, expected.value) << "trial " << trial;
+      EXPECT_EQ(observed.weight, expected.weight) << "trial " << trial;
+      EXPECT_EQ(observed.indices, expected.indices) << "trial " << trial;
+    }
+  }
+}
+
+TEST(KnapsackSolve64Test, SolvesValuesBeyondInt) {
+  std::mt19937 rng(2302);
+  std::uniform_int_distribution<int> weight_dist(1, 20);
+  std::uniform_int_distribution<int64_t> value_dist(0, int64_t{1} << 40);
+  for (int trial = 0; trial < 100; ++trial) {
+    std::vector<knapsack_item64_t> items(10U);
+    for (knapsack_item64_t &item : items) {
+      item = {weight_dist(rng), value_dist(rng)};
+    }
+    const int capacity = 10 + trial % 50;
+    const Solution64 observed = Solve64(items, capacity);
+    ASSERT_EQ(observed.status, KNAPSACK_OK) << "trial " << trial;
+    const std::pair<int64_t, int> expected = BruteForce64(items, capacity);
+    EXPECT_EQ(observed.value, expected.first) << "trial " << trial;
+    EXPECT_EQ(observed.weight, expected.second) << "trial " << trial;
+    int64_t value = 0;
+    int weight = 0;
+    for (size_t index : observed.indices) {
+      value += items[index].value;
+      weight += items[index].weight;
+    }
+    EXPECT_EQ(value, observed.value);
+    EXPECT_EQ(weight, observed.weight);
+  }
+}
+
+TEST(KnapsackSolve64Test, ValuesTheIntSolverRejects) {
+  const std::vector<knapsack_item_t> narrow = {{1, INT_MAX}, {1, INT_MAX}};
+  EXPECT_EQ(SolveFull(narrow, 2, EngineOptions(KNAPSACK_ENGINE_DENSE)).status,
+            KNAPSACK_ERR_INT_OVERFLOW);
+  const Solution64 wide = Solve64(Widen(narrow), 2);
+  ASSERT_EQ(wide.status, KNAPSACK_OK);
+  EXPECT_EQ(wide.value, 2 * int64_t{INT_MAX});
+  EXPECT_THAT(wide.indices, ElementsAre(0U, 1U));
+}
+
+TEST(KnapsackSolve64Test, DetectsValueOverflowInAnyLane) {
+  for (int lane = 0; lane < 17; ++lane) {
+    // Item 0 fills cells [1, capacity]; item 1 only overflows where it adds
+    // to it, which is cell `lane + 2` onwards.
+    const int capacity = lane + 2;
+    const std::vector<knapsack_item64_t> items = {{1, INT64_MAX}, {capacity - 1, 1}};
+    EXPECT_EQ(Solve64(items, capacity).status, KNAPSACK_ERR_INT_OVERFLOW) << "lane " << lane;
+    EXPECT_EQ(Solve64(items, capacity - 1).status, KNAPSACK_OK) << "lane " << lane;
+  }
+}
+
+TEST(KnapsackSolve64Test, ValueOnlyReportsTheOptimum) {
+  const std::vector<knapsack_item64_t> items = {{2, int64_t{3} << 33}, {3, int64_t{4} << 33},
+                                                {4, int64_t{8} << 33}, {5, int64_t{8} << 33}};
+  const knapsack_options_t value_only = ValueOnlyOptions();
+  const Solution64 full = Solve64(items, 9);
+  const Solution64 bare = Solve64(items, 9, &value_only);
+  ASSERT_EQ(bare.status, KNAPSACK_OK);
+  EXPECT_EQ(bare.value, full.value);
+  EXPECT_EQ(bare.weight, full.weight);
+  EXPECT_TRUE(bare.indices.empty());
+  EXPECT_THAT(full.indices, ElementsAre(2U, 3U));
+}
+
+TEST(KnapsackSolve64Test, RejectsInvalidArguments) {
+  const std::vector<knapsack_item64_t> items = {{2, 3}, {3, 4}};
+  EXPECT_EQ(knapsack_solve64(items.data(), 2U, 5, nullptr, nullptr), KNAPSACK_ERR_NULL_RESULT);
+  EXPECT_EQ(Solve64({}, 5).status, KNAPSACK_ERR_INVALID_ITEMS);
+  EXPECT_EQ(Solve64(items, -1).status, KNAPSACK_ERR_INVALID_CAPACITY);
+  EXPECT_EQ(Solve64({{0, 3}}, 5).status, KNAPSACK_ERR_INVALID_ITEMS);
+  EXPECT_EQ(Solve64({{1, -1}}, 5).status, KNAPSACK_ERR_INVALID_ITEMS);
+  knapsack_options_t options;
+  knapsack_options_init(&options);
+  options.limits.max_items = 1U;
+  EXPECT_EQ(Solve64(items, 5, &options).status, KNAPSACK_ERR_TOO_MANY_ITEMS);
+  options.limits.max_items = 0U;
+  EXPECT_EQ(Solve64(items, 5, &options).status, KNAPSACK_ERR_INVALID_ARGUMENT);
+  knapsack_options_init(&options);
+  options.reconstruct = KNAPSACK_RECONSTRUCT_HIRSCHBERG;
+  EXPECT_EQ(Solve64(items, 5, &options).status, KNAPSACK_ERR_INVALID_ARGUMENT);
+  for (knapsack_engine_t engine : {KNAPSACK_ENGINE_SPARSE, KNAPSACK_ENGINE_BRANCH_BOUND}) {
+    const knapsack_options_t other = EngineOptions(engine);
+    EXPECT_EQ(Solve64(items, 5, &other).status, KNAPSACK_ERR_INVALID_ARGUMENT);
+  }
+}
+
+TEST(KnapsackSolve64Test, CancelledSolveFails) {
+  CancelAfter cancel{2, 0};
+  knapsack_options_t options;
+  knapsack_options_init(&options);
+  options = CancelOptions(options, &cancel, true);
+  EXPECT_EQ(Solve64(Widen(WideItems(20U, 2303U)), kWideCapacity, &options).status,
+            KNAPSACK_ERR_CANCELLED);
+  EXPECT_EQ(cancel.polls, 2);
+}
+
+TEST(KnapsackSolve64Test, AllocationFailuresAreBalanced) {
+  const std::vector<knapsack_item64_t> items = {{2, 3}, {3, 4}, {4, 8}, {5, 8}};
+  // The zeroed arena, then the selected indices.
+  for (const auto &fail : {std::pair<int, int>{-1, 0}, {0, -1}, {-1, -1}}) {
+    CountingAllocator data{0, 0, 0, fail.first, fail.second};
+    knapsack_allocator_t alloc = {CountAlloc, CountCalloc, CountBlockFree, &data};
+    knapsack_options_t options;
+    knapsack_options_init(&options);
+    options.allocator = &alloc;
+    const knapsack_status_t status = Solve64(items, 9, &options).status;
+    EXPECT_EQ(status, fail.first < 0 && fail.second < 0 ? KNAPSACK_OK : KNAPSACK_ERR_ALLOC);
+    EXPECT_EQ(data.alloc_calls + data.calloc_calls, data.free_calls);
+  }
+}
+
+TEST(KnapsackSolve64Test, StatsReportTheWiderRows) {
+  if (!knapsack_stats_available()) {
+    GTEST_SKIP() << "built without statistics";
+  }
+  const std::vector<knapsack_item64_t> items = {{2, 3}, {3, 4}, {40, 8}};
+  knapsack_stats_t stats;
+  knapsack_options_t options;
+  knapsack_options_init(&options);
+  options.stats = &stats;
+  ASSERT_EQ(Solve64(items, 10, &options).status, KNAPSACK_OK);
+  EXPECT_EQ(stats.engine, KNAPSACK_ENGINE_DENSE);
+  EXPECT_EQ(stats.cells, (11U - 2U) + (11U - 3U));
+  EXPECT_EQ(stats.row_bytes, 11U * (sizeof(int64_t) + sizeof(uint32_t)));
+  EXPECT_GT(stats.take_bits_bytes, 0U);
+}
+
+namespace {
+struct MultiSolution {
+  knapsack_status_t status;
+  int value;
+  std::vector<int> weights;
+  std::vector<size_t> indices;
+  size_t pruned;
+};
+
+MultiSolution SolveMulti(const std::vector<knapsack_multi_item_t> &items,
+                         const std::vector<int> &capacities,
+                         const knapsack_options_t *options = nullptr) {
+  knapsack_multi_result_t result;
+  MultiSolution out{knapsack_solve_multi(items.data(), items.size(), capacities.size(),
+                                         capacities.data(), options, &result),
+                    0,
+                    {},
+                    {},
+                    0U};
+  if (out.status == KNAPSACK_OK) {
+    out.value = result.optimal_value;
+    out.weights.assign(result.total_weights, result.total_weights + capacities.size());
+    out.indices.assign(result.selected_indices, result.selected_indices + result.selected_count);
+    out.pruned = result.pruned_count;
+  } else {
+    EXPECT_EQ(result.selected_indices, nullptr);
+  }
+  knapsack_multi_result_free_ex(&result, options ? options->allocator : nullptr);
+  return out;
+}
+
+// Best (value, then weights dimension by dimension) over every subset that fits.
+std::pair<int, std::vector<int>> BruteForceMulti(const std::vector<knapsack_multi_item_t> &items,
+                                                 const std::vector<int> &capacities) {
+  std::pair<int, std::vector<int>> best{0, std::vector<int>(capacities.size(), 0)};
+  for (size_t mask = 0; mask < (size_t{1} << items.size()); ++mask) {
+    int value = 0;
+    std::vector<int> weights(capacities.size(), 0);
+    bool fits = true;
+    for (size_t i = 0; i < items.size(); ++i) {
+      if ((mask >> i) & 1U) {
+        value += items[i].value;
+        for (size_t d = 0; d < capacities.size(); ++d) {
+          weights[d] += items[i].weights[d];
+          fits = fits && weights[d] <= capacities[d];
+        }
+      }
+    }
+    if (fits && (value > best.first || (value == best.first && weights < best.second))) {
+      best = {value, weights};
+    }
+  }
+  return best;
+}
+
+void ExpectMultiConsistent(const std::vector<knapsack_multi_item_t> &items,
+                           const MultiSolution &solution) {
+  EXPECT_TRUE(std::is_sorted(solution.indices.begin(), solution.indices.end()));
+  int value = 0;
+  std::vector<int> weights(solution.weights.size(), 0);
+  for (size_t index : solution.indices) {
+    value += items[index].value;
+    for (size_t d = 0; d < weights.size(); ++d) {
+      weights[d] += items[index].weights[d];
+    }
+  }
+  EXPECT_EQ(value, solution.value);
+  EXPECT_EQ(weights, solution.weights);
+}
+} // namespace
+
+// NOLINTNEXTLINE(readability-function-cognitive-complexity)
+TEST(KnapsackMultiTest, MatchesBruteForce) {
+  std::mt19937 rng(2401);
+  std::uniform_int_distribution<int> count_dist(1, 12);
+  std::uniform_int_distribution<int> weight_dist(0, 8);
+  std::uniform_int_distribution<int> value_dist(0, 12); // small range => ties and dominance
+  std::uniform_int_distribution<int> capacity_dist(0, 20);
+  for (size_t dims = 1; dims <= KNAPSACK_MAX_DIMENSIONS; ++dims) {
+    for (int trial = 0; trial < 100; ++trial) {
+      std::vector<knapsack_multi_item_t> items(static_cast<size_t>(count_dist(rng)));
+      for (knapsack_multi_item_t &item : items) {
+        item = {{0, 0, 0, 0}, value_dist(rng)};
+        for (size_t d = 0; d < dims; ++d) {
+          item.weights[d] = weight_dist(rng);
+        }
+        item.weights[trial % dims] += 1; // never all zero
+      }
+      std::vector<int> capacities(dims);
+      for (int &capacity : capacities) {
+        capacity = capacity_dist(rng);
+      }
+      const MultiSolution observed = SolveMulti(items, capacities);
+      ASSERT_EQ(observed.status, KNAPSACK_OK) << "dims " << dims << " trial " << trial;
+      const auto expected = BruteForceMulti(items, capacities);
+      EXPECT_EQ(observed.value, expected.first) << "dims " << dims << " trial " << trial;
+      EXPECT_EQ(observed.weights, expected.second) << "dims " << dims << " trial " << trial;
+      ExpectMultiConsistent(items, observed);
+    }
+  }
+}
+
+TEST(KnapsackMultiTest, OneDimensionMatchesDenseSolver) {
+  std::mt19937 rng(2402);
+  std::uniform_int_distribution<int> weight_dist(1, 300);
+  std::uniform_int_distribution<int> value_dist(0, 100);
+  const knapsack_options_t dense = EngineOptions(KNAPSACK_ENGINE_DENSE);
+  for (int trial = 0; trial < 20; ++trial) {
+    std::vector<knapsack_item_t> items(40U);
+    std::vector<knapsack_multi_item_t> multi;
+    for (knapsack_item_t &item : items) {
+      item = {weight_dist(rng), value_dist(rng)};
+      multi.push_back({{item.weight, 0, 0, 0}, item.value});
+    }
+    const int capacity = 1000 + trial * 100;
+    const FullSolution expected = SolveFull(items, capacity, dense);
+    const MultiSolution observed = SolveMulti(multi, {capacity});
+    ASSERT_EQ(observed.status, KNAPSACK_OK);
+    EXPECT_EQ(observed.value, expected.value) << "trial " << trial;
+    EXPECT_THAT(observed.weights, ElementsAre(expected.weight)) << "trial " << trial;
+    ExpectMultiConsistent(multi, observed);
+  }
+}
+
+// NOLINTNEXTLINE(readability-function-cognitive-complexity)
+TEST(KnapsackMultiTest, BlockedTableMatchesUnblocked) {
+  std::mt19937 rng(2404);
+  std::uniform_int_distribution<int> weight_dist(0, 6);
+  std::uniform_int_distribution<int> value_dist(1, 40);
+  std::uniform_int_distribution<int> capacity_dist(8, 30);
+  for (size_t dims = 2; dims <= 3; ++dims) {
+    for (int trial = 0; trial < 20; ++trial) {
+      std::vector<knapsack_multi_item_t> items(30U);
+      for (knapsack_multi_item_t &item : items) {
+        item = {{0, 0, 0, 0}, value_dist(rng)};
+        for (size_t d = 0; d < dims; ++d) {
+          item.weights[d] = weight_dist(rng);
+        }
+        item.weights[dims - 1U] += 1; // never all zero
+      }
+      std::vector<int> capacities(dims);
+      for (int &capacity : capacities) {
+        capacity = capacity_dist(rng);
+      }
+      knapsack_options_t whole;
+      knapsack_options_init(&whole);
+      whole.tile_cells = SIZE_MAX;
+      const MultiSolution expected = SolveMulti(items, capacities, &whole);
+      ASSERT_EQ(expected.status, KNAPSACK_OK);
+      size_t plane = 1U; // cells per dimension-0 coordinate
+      for (size_t d = 1; d < dims; ++d) {
+        plane *= static_cast<size_t>(capacities[d]) + 1U;
+      }
+      for (size_t planes : {size_t{1}, size_t{3}, size_t{7}, size_t{16}}) {
+        SCOPED_TRACE(planes);
+        knapsack_options_t blocked;
+        knapsack_options_init(&blocked);
+        blocked.tile_cells = planes * plane;
+        const MultiSolution observed = SolveMulti(items, capacities, &blocked);
+        ASSERT_EQ(observed.status, KNAPSACK_OK) << "dims " << dims << " trial " << trial;
+        EXPECT_EQ(observed.value, expected.value) << "dims " << dims << " trial " << trial;
+        EXPECT_EQ(observed.weights, expected.weights) << "dims " << dims << " trial " << trial;
+        EXPECT_EQ(observed.indices, expected.indices) << "dims " << dims << " trial " << trial;
+      }
+    }
+  }
+}
+
+TEST(KnapsackMultiTest, PrunesUselessAndDominatedItems) {
+  const std::vector<knapsack_multi_item_t> items = {
+      {{5, 5, 0, 0}, 10},
+      {{6, 6, 0, 0}, 9},  // dominated by 0, and both do not fit
+      {{20, 1, 0, 0}, 50}, // too heavy
+      {{1, 1, 0, 0}, 0},  // worthless
+      {{5, 5, 0, 0}, 10}, // equal to 0, and both fit
+  };
+  const MultiSolution solution = SolveMulti(items, {10, 10});
+  ASSERT_EQ(solution.status, KNAPSACK_OK);
+  EXPECT_EQ(solution.pruned, 3U);
+  EXPECT_EQ(solution.value, 20);
+  EXPECT_THAT(solution.weights, ElementsAre(10, 10));
+  EXPECT_THAT(solution.indices, ElementsAre(0U, 4U));
+}
+
+TEST(KnapsackMultiTest, TiesGoToTheLighterFirstDimension) {
+  const std::vector<knapsack_multi_item_t> items = {{{3, 1, 0, 0}, 5}, {{1, 3, 0, 0}, 5}};
+  const MultiSolution solution = SolveMulti(items, {3, 3});
+  ASSERT_EQ(solution.status, KNAPSACK_OK);
+  EXPECT_EQ(solution.value, 5);
+  EXPECT_THAT(solution.indices, ElementsAre(1U));
+  EXPECT_THAT(solution.weights, ElementsAre(1, 3));
+}
+
+TEST(KnapsackMultiTest, ValueOnlyReportsTheOptimum) {
+  const std::vector<knapsack_multi_item_t> items = {
+      {{2, 4, 0, 0}, 3}, {{3, 1, 0, 0}, 4}, {{4, 4, 0, 0}, 8}, {{5, 2, 0, 0}, 8}};
+  const knapsack_options_t value_only = ValueOnlyOptions();
+  const MultiSolution full = SolveMulti(items, {9, 6});
+  const MultiSolution bare = SolveMulti(items, {9, 6}, &value_only);
+  ASSERT_EQ(bare.status, KNAPSACK_OK);
+  EXPECT_EQ(bare.value, full.value);
+  EXPECT_EQ(bare.weights, full.weights);
+  EXPECT_TRUE(bare.indices.empty());
+  EXPECT_THAT(full.indices, ElementsAre(2U, 3U));
+}
+
+TEST(KnapsackMultiTest, RejectsInvalidArguments) {
+  const std::vector<knapsack_multi_item_t> items = {{{2, 1, 0, 0}, 3}, {{3, 1, 0, 0}, 4}};
+  const int capacities[] = {5, 5};
+  knapsack_multi_result_t result;
+  EXPECT_EQ(knapsack_solve_multi(items.data(), 2U, 2U, capacities, nullptr, nullptr),
+            KNAPSACK_ERR_NULL_RESULT);
+  EXPECT_EQ(knapsack_solve_multi(items.data(), 2U, 0U, capacities, nullptr, &result),
+            KNAPSACK_ERR_INVALID_ARGUMENT);
+  EXPECT_EQ(SolveMulti(items, {5, 5, 5, 5, 5}).status, KNAPSACK_ERR_INVALID_ARGUMENT);
+  EXPECT_EQ(knapsack_solve_multi(items.data(), 2U, 2U, nullptr, nullptr, &result),
+            KNAPSACK_ERR_INVALID_CAPACITY);
+  EXPECT_EQ(SolveMulti(items, {5, -1}).status, KNAPSACK_ERR_INVALID_CAPACITY);
+  EXPECT_EQ(SolveMulti(items, {5, KNAPSACK_MAX_CAPACITY + 1}).status,
+            KNAPSACK_ERR_INVALID_CAPACITY);
+  EXPECT_EQ(SolveMulti(items, {2000, 2000}).status, KNAPSACK_ERR_INVALID_CAPACITY);
+  EXPECT_EQ(SolveMulti({}, {5, 5}).status, KNAPSACK_ERR_INVALID_ITEMS);
+  EXPECT_EQ(SolveMulti({{{0, 0, 7, 7}, 3}}, {5, 5}).status, KNAPSACK_ERR_INVALID_ITEMS);
+  EXPECT_EQ(SolveMulti({{{1, -1, 0, 0}, 3}}, {5, 5}).status, KNAPSACK_ERR_INVALID_ITEMS);
+  EXPECT_EQ(SolveMulti({{{1, 1, 0, 0}, -3}}, {5, 5}).status, KNAPSACK_ERR_INVALID_ITEMS);
+  knapsack_options_t options;
+  knapsack_options_init(&options);
+  options.limits.max_items = 1U;
+  EXPECT_EQ(SolveMulti(items, {5, 5}, &options).status, KNAPSACK_ERR_TOO_MANY_ITEMS);
+  knapsack_options_init(&options);
+  options.reconstruct = KNAPSACK_RECONSTRUCT_HIRSCHBERG;
+  EXPECT_EQ(SolveMulti(items, {5, 5}, &options).status, KNAPSACK_ERR_INVALID_ARGUMENT);
+  for (knapsack_engine_t engine : {KNAPSACK_ENGINE_SPARSE, KNAPSACK_ENGINE_BRANCH_BOUND}) {
+    const knapsack_options_t other = EngineOptions(engine);
+    EXPECT_EQ(SolveMulti(items, {5, 5}, &other).status, KNAPSACK_ERR_INVALID_ARGUMENT);
+  }
+}
+
+TEST(KnapsackMultiTest, DetectsValueOverflow) {
+  EXPECT_EQ(SolveMulti({{{1, 1, 0, 0}, INT_MAX}, {{1, 1, 0, 0}, 1}}, {2, 2}).status,
+            KNAPSACK_ERR_INT_OVERFLOW);
+  // Apart, both fit: only the pair would overflow, and its volume does not fit.
+  const MultiSolution apart = SolveMulti({{{1, 2, 0, 0}, INT_MAX}, {{1, 2, 0, 0}, 1}}, {2, 3});
+  ASSERT_EQ(apart.status, KNAPSACK_OK);
+  EXPECT_EQ(apart.value, INT_MAX);
+}
+
+TEST(KnapsackMultiTest, CancelledSolveFails) {
+  std::mt19937 rng(2403);
+  std::uniform_int_distribution<int> weight_dist(1, 100);
+  std::vector<knapsack_multi_item_t> items(20U);
+  for (knapsack_multi_item_t &item : items) {
+    item = {{weight_dist(rng), weight_dist(rng), 0, 0}, weight_dist(rng)};
+  }
+  CancelAfter cancel{2, 0};
+  knapsack_options_t options;
+  knapsack_options_init(&options);
+  options = CancelOptions(options, &cancel, true);
+  EXPECT_EQ(SolveMulti(items, {1000, 1000}, &options).status, KNAPSACK_ERR_CANCELLED);
+  EXPECT_EQ(cancel.polls, 2);
+}
+
+TEST(KnapsackMultiTest, AllocationFailuresAreBalanced) {
+  const std::vector<knapsack_multi_item_t> items = {
+      {{2, 4, 0, 0}, 3}, {{3, 1, 0, 0}, 4}, {{4, 4, 0, 0}, 8}, {{5, 2, 0, 0}, 8}};
+  // The zeroed arena, then the selected indices.
+  for (const auto &fail : {std::pair<int, int>{-1, 0}, {0, -1}, {-1, -1}}) {
+    CountingAllocator data{0, 0, 0, fail.first, fail.second};
+    knapsack_allocator_t alloc = {CountAlloc, CountCalloc, CountBlockFree, &data};
+    knapsack_options_t options;
+    knapsack_options_init(&options);
+    options.allocator = &alloc;
+    const knapsack_status_t status = SolveMulti(items, {9, 6}, &options).status;
+    EXPECT_EQ(status, fail.first < 0 && fail.second < 0 ? KNAPSACK_OK : KNAPSACK_ERR_ALLOC);
+    EXPECT_EQ(data.alloc_calls + data.calloc_calls, data.free_calls);
+  }
+}
+
+TEST(KnapsackMultiTest, StatsCountTheRuns) {
+  if (!knapsack_stats_available()) {
+    GTEST_SKIP() << "built without statistics";
+  }
+  const std::vector<knapsack_multi_item_t> items = {{{2, 3, 0, 0}, 3}, {{4, 0, 0, 0}, 4}};
+  knapsack_stats_t stats;
+  knapsack_options_t options;
+  knapsack_options_init(&options);
+  options.stats = &stats;
+  ASSERT_EQ(SolveMulti(items, {10, 5}, &options).status, KNAPSACK_OK);
+  EXPECT_EQ(stats.engine, KNAPSACK_ENGINE_DENSE);
+  EXPECT_EQ(stats.cells, (11U - 2U) * (6U - 3U) + (11U - 4U) * 6U);
+  EXPECT_EQ(stats.row_bytes, 11U * 6U * (sizeof(int) + sizeof(uint32_t)));
+  EXPECT_GT(stats.cells_taken, 0U);
+  EXPECT_GT(stats.take_bits_bytes, 0U);
+}
+
+namespace {
+struct CacheDeleter {
+  void operator()(knapsack_cache_t *cache) const { knapsack_cache_destroy(cache); }
+};
+using CachePtr = std::unique_ptr<knapsack_cache_t, CacheDeleter>;
+
+FullSolution SolveCached(knapsack_cache_t *cache, const std::vector<knapsack_item_t> &items,
+                         int capacity, const knapsack_allocator_t *allocator = nullptr) {
+  knapsack_result_t result;
+  FullSolution out{
+      knapsack_cache_solve(cache, items.data(), items.size(), capacity, allocator, &result), 0, 0,
+      {}};
+  if (out.status == KNAPSACK_OK) {
+    out.value = result.optimal_value;
+    out.weight = result.total_weight;
+    out.indices.assign(result.selected_indices, result.selected_indices + result.selected_count);
+  }
+  knapsack_result_free_ex(&result, allocator);
+  return out;
+}
+
+FullSolution SolveUncached(const std::vector<knapsack_item_t> &items, int capacity) {
+  knapsack_options_t options;
+  knapsack_options_init(&options);
+  return SolveFull(items, capacity, options);
+}
+
+knapsack_cache_stats_t CacheStats(knapsack_cache_t *cache) {
+  knapsack_cache_stats_t stats;
+  knapsack_cache_get_stats(cache, &stats);
+  return stats;
+}
+} // namespace
+
+TEST(KnapsackCacheTest, RepeatedInstanceIsAHit) {
+  CachePtr cache(knapsack_cache_create(8U, nullptr));
+  ASSERT_NE(cache, nullptr);
+  const std::vector<knapsack_item_t> items = WideItems(20U, 2501U);
+  const FullSolution expected = SolveUncached(items, kWideCapacity);
+  EXPECT_EQ(SolveCached(cache.get(), items, kWideCapacity), expected);
+  EXPECT_EQ(SolveCached(cache.get(), items, kWideCapacity), expected);
+  EXPECT_EQ(SolveCached(cache.get(), items, kWideCapacity), expected);
+  const knapsack_cache_stats_t stats = CacheStats(cache.get());
+  EXPECT_EQ(stats.misses, 1U);
+  EXPECT_EQ(stats.hits, 2U);
+  EXPECT_EQ(stats.entries, 1U);
+}
+
+TEST(KnapsackCacheTest, AnyDifferenceIsAMiss) {
+  CachePtr cache(knapsack_cache_create(8U, nullptr));
+  ASSERT_NE(cache, nullptr);
+  std::vector<knapsack_item_t> items = {{2, 3}, {3, 4}, {4, 8}, {5, 8}};
+  ASSERT_EQ(SolveCached(cache.get(), items, 9).status, KNAPSACK_OK);
+  EXPECT_EQ(SolveCached(cache.get(), items, 10), SolveUncached(items, 10));
+  std::swap(items[0], items[1]); // same multiset, other indices
+  EXPECT_EQ(SolveCached(cache.get(), items, 9), SolveUncached(items, 9));
+  items[3].value = 9;
+  EXPECT_EQ(SolveCached(cache.get(), items, 9), SolveUncached(items, 9));
+  items.pop_back();
+  EXPECT_EQ(SolveCached(cache.get(), items, 9), SolveUncached(items, 9));
+  const knapsack_cache_stats_t stats = CacheStats(cache.get());
+  EXPECT_EQ(stats.hits, 0U);
+  EXPECT_EQ(stats.misses, 5U);
+  EXPECT_EQ(stats.entries, 5U);
+}
+
+TEST(KnapsackCacheTest, EvictsTheLeastRecentlyUsed) {
+  CachePtr cache(knapsack_cache_create(2U, nullptr));
+  ASSERT_NE(cache, nullptr);
+  const std::vector<knapsack_item_t> items = {{2, 3}, {3, 4}, {4, 8}, {5, 8}};
+  SolveCached(cache.get(), items, 7);  // miss: {7}
+  SolveCached(cache.get(), items, 8);  // miss: {8, 7}
+  SolveCached(cache.get(), items, 7);  // hit:  {7, 8}
+  SolveCached(cache.get(), items, 9);  // miss: {9, 7}, 8 evicted
+  SolveCached(cache.get(), items, 7);  // hit
+  SolveCached(cache.get(), items, 8);  // miss: {8, 7}, 9 evicted
+  const knapsack_cache_stats_t stats = CacheStats(cache.get());
+  EXPECT_EQ(stats.hits, 2U);
+  EXPECT_EQ(stats.misses, 4U);
+  EXPECT_EQ(stats.evictions, 2U);
+  EXPECT_EQ(stats.entries, 2U);
+}
+
+TEST(KnapsackCacheTest, ManyInstancesThroughASmallCache) {
+  CachePtr cache(knapsack_cache_create(5U, nullptr));
+  ASSERT_NE(cache, nullptr);
+  std::mt19937 rng(2502);
+  std::uniform_int_distribution<int> pick(0, 11);
+  std::vector<std::vector<knapsack_item_t>> instances;
+  for (unsigned seed = 0; seed < 12U; ++seed) {
+    instances.push_back(WideItems(10U + seed, 2510U + seed));
+  }
+  for (int round = 0; round < 200; ++round) {
+    const auto &items = instances[static_cast<size_t>(pick(rng))];
+    ASSERT_EQ(SolveCached(cache.get(), items, kWideCapacity), SolveUncached(items, kWideCapacity))
+        << "round " << round;
+  }
+  const knapsack_cache_stats_t stats = CacheStats(cache.get());
+  EXPECT_EQ(stats.hits + stats.misses, 200U);
+  EXPECT_EQ(stats.misses - stats.evictions, stats.entries);
+  EXPECT_EQ(stats.entries, 5U);
+}
+
+TEST(KnapsackCacheTest, ClearInvalidatesEntries) {
+  CachePtr cache(knapsack_cache_create(4U, nullptr));
+  ASSERT_NE(cache, nullptr);
+  const std::vector<knapsack_item_t> items = {{2, 3}, {3, 4}};
+  SolveCached(cache.get(), items, 5);
+  SolveCached(cache.get(), items, 5);
+  knapsack_cache_clear(cache.get());
+  EXPECT_EQ(CacheStats(cache.get()).entries, 0U);
+  EXPECT_EQ(SolveCached(cache.get(), items, 5), SolveUncached(items, 5));
+  const knapsack_cache_stats_t stats = CacheStats(cache.get());
+  EXPECT_EQ(stats.hits, 1U);
+  EXPECT_EQ(stats.misses, 2U);
+  EXPECT_EQ(stats.entries, 1U);
+}
+
+TEST(KnapsackCacheTest, FailuresAreNotCached) {
+  CachePtr cache(knapsack_cache_create(4U, nullptr));
+  ASSERT_NE(cache, nullptr);
+  const std::vector<knapsack_item_t> overflow = {{1, INT_MAX}, {1, 1}};
+  EXPECT_EQ(SolveCached(cache.get(), overflow, 2).status, KNAPSACK_ERR_INT_OVERFLOW);
+  EXPECT_EQ(SolveCached(cache.get(), overflow, 2).status, KNAPSACK_ERR_INT_OVERFLOW);
+  EXPECT_EQ(SolveCached(cache.get(), {{0, 1}}, 2).status, KNAPSACK_ERR_INVALID_ITEMS);
+  EXPECT_EQ(SolveCached(cache.get(), {}, 2).status, KNAPSACK_ERR_INVALID_ITEMS);
+  EXPECT_EQ(CacheStats(cache.get()).entries, 0U);
+}
+
+TEST(KnapsackCacheTest, RejectsInvalidArguments) {
+  EXPECT_EQ(knapsack_cache_create(0U, nullptr), nullptr);
+  const knapsack_item_t item = {1, 1};
+  knapsack_result_t result;
+  EXPECT_EQ(knapsack_cache_solve(nullptr, &item, 1U, 1, nullptr, &result),
+            KNAPSACK_ERR_INVALID_ARGUMENT);
+  CachePtr cache(knapsack_cache_create(1U, nullptr));
+  ASSERT_NE(cache, nullptr);
+  EXPECT_EQ(knapsack_cache_solve(cache.get(), &item, 1U, 1, nullptr, nullptr),
+            KNAPSACK_ERR_NULL_RESULT);
+  knapsack_cache_stats_t stats;
+  knapsack_cache_get_stats(nullptr, &stats);
+  EXPECT_EQ(stats.hits + stats.misses + stats.entries, 0U);
+  knapsack_cache_get_stats(cache.get(), nullptr);
+  knapsack_cache_clear(nullptr);
+  knapsack_cache_destroy(nullptr);
+}
+
+TEST(KnapsackCacheTest, HitsCopyWithTheCallersAllocator) {
+  CountingAllocator cache_data{0, 0, 0, -1, -1};
+  knapsack_allocator_t cache_alloc = {CountAlloc, CountCalloc, CountBlockFree, &cache_data};
+  CountingAllocator caller_data{0, 0, 0, -1, -1};
+  knapsack_allocator_t caller_alloc = {CountAlloc, CountCalloc, CountBlockFree, &caller_data};
+  const std::vector<knapsack_item_t> items = {{2, 3}, {3, 4}, {4, 8}, {5, 8}};
+  {
+    CachePtr cache(knapsack_cache_create(4U, &cache_alloc));
+    ASSERT_NE(cache, nullptr);
+    const FullSolution expected = SolveUncached(items, 9);
+    EXPECT_EQ(SolveCached(cache.get(), items, 9, &caller_alloc), expected);
+    const int solve_calls = caller_data.alloc_calls + caller_data.calloc_calls;
+    EXPECT_EQ(SolveCached(cache.get(), items, 9, &caller_alloc), expected);
+    // The hit allocated exactly the indices, from the caller's allocator.
+    EXPECT_EQ(caller_data.alloc_calls + caller_data.calloc_calls, solve_calls + 1);
+    EXPECT_EQ(caller_data.alloc_calls + caller_data.calloc_calls, caller_data.free_calls);
+    // A failed copy reports the failure and leaves the entry in place.
+    caller_data.alloc_fail_after = 0;
+    EXPECT_EQ(SolveCached(cache.get(), items, 9, &caller_alloc).status, KNAPSACK_ERR_ALLOC);
+    caller_data.alloc_fail_after = -1;
+    EXPECT_EQ(SolveCached(cache.get(), items, 9, &caller_alloc), expected);
+    // Out of cache memory, results are still returned, just not kept.
+    cache_data.alloc_fail_after = 0;
+    EXPECT_EQ(SolveCached(cache.get(), items, 10, &caller_alloc), SolveUncached(items, 10));
+    EXPECT_EQ(CacheStats(cache.get()).entries, 1U);
+    cache_data.alloc_fail_after = -1;
+  }
+  EXPECT_EQ(cache_data.alloc_calls + cache_data.calloc_calls, cache_data.free_calls);
+  EXPECT_EQ(caller_data.alloc_calls + caller_data.calloc_calls, caller_data.free_calls);
+}
+
+TEST(KnapsackCacheTest, ConcurrentCallersAgree) {
+  CachePtr cache(knapsack_cache_create(3U, nullptr));
+  ASSERT_NE(cache, nullptr);
+  std::vector<std::vector<knapsack_item_t>> instances;
+  std::vector<FullSolution> expected;
+  for (unsigned seed = 0; seed < 6U; ++seed) {
+    instances.push_back(WideItems(12U + seed, 2520U + seed));
+    expected.push_back(SolveUncached(instances.back(), kWideCapacity));
+  }
+  std::vector<int> mismatches(4, 0);
+  std::vector<std::thread> callers;
+  for (size_t t = 0; t < mismatches.size(); ++t) {
+    callers.emplace_back([&, t] {
+      for (size_t round = 0; round < 50U; ++round) {
+        const size_t pick = (round * 7U + t) % instances.size();
+        if (!(SolveCached(cache.get(), instances[pick], kWideCapacity) == expected[pick])) {
+          ++mismatches[t];
+        }
+      }
+    });
+  }
+  for (auto &caller : callers) {
+    caller.join();
+  }
+  EXPECT_THAT(mismatches, ::testing::Each(0));
+  const knapsack_cache_stats_t stats = CacheStats(cache.get());
+  EXPECT_EQ(stats.hits + stats.misses, 200U);
+  EXPECT_LE(stats.entries, 3U);
+}
+
+namespace {
+struct ExecutorDeleter {
+  void operator()(knapsack_executor_t *executor) const { knapsack_executor_destroy(executor); }
+};
+using ExecutorPtr = std::unique_ptr<knapsack_executor_t, ExecutorDeleter>;
+
+ExecutorPtr MakeExecutor(size_t threads,
+                         size_t queue_capacity = KNAPSACK_EXECUTOR_QUEUE_CAPACITY) {
+  knapsack_executor_config_t config;
+  knapsack_executor_config_init(&config);
+  config.threads = threads;
+  config.queue_capacity = queue_capacity;
+  return ExecutorPtr(knapsack_executor_create(&config));
+}
+
+knapsack_job_t *Submit(knapsack_executor_t *executor, const std::vector<knapsack_item_t> &items,
+                       int capacity, knapsack_priority_t priority = KNAPSACK_PRIORITY_NORMAL,
+                       knapsack_job_done_fn on_done = nullptr, void *user_data = nullptr,
+                       const knapsack_options_t *options = nullptr) {
+  knapsack_job_t *job = nullptr;
+  EXPECT_EQ(knapsack_executor_submit(executor, items.data(), items.size(), capacity, options,
+                                     priority, on_done, user_data, &job),
+            KNAPSACK_OK);
+  return job;
+}
+
+// Wait for the job, then release it.
+FullSolution WaitJob(knapsack_job_t *job) {
+  knapsack_result_t result;
+  FullSolution out{knapsack_job_wait(job, &result), 0, 0, {}};
+  if (out.status == KNAPSACK_OK) {
+    out.value = result.optimal_value;
+    out.weight = result.total_weight;
+    out.indices.assign(result.selected_indices, result.selected_indices + result.selected_count);
+  }
+  knapsack_result_free(&result);
+  knapsack_job_release(job);
+  return out;
+}
+
+knapsack_executor_stats_t ExecutorStats(knapsack_executor_t *executor) {
+  knapsack_executor_stats_t stats;
+  knapsack_executor_get_stats(executor, &stats);
+  return stats;
+}
+
+// Keeps a worker inside a completion callback until opened.
+struct Gate {
+  std::atomic<bool> open{false};
+
+  static void Hold(knapsack_status_t /*status*/, knapsack_result_t *result, void *user_data) {
+    knapsack_result_free(result);
+    while (!static_cast<Gate *>(user_data)->open.load()) {
+      std::this_thread::yield();
+    }
+  }
+};
+
+// Submit a job that holds one worker at @p gate, and wait until it does.
+knapsack_job_t *HoldWorker(knapsack_executor_t *executor, Gate *gate) {
+  knapsack_job_t *job = Submit(executor, {{1, 1}}, 1, KNAPSACK_PRIORITY_HIGH, Gate::Hold, gate);
+  while (ExecutorStats(executor).running == 0U) {
+    std::this_thread::yield();
+  }
+  return job;
+}
+
+struct StartOrder {
+  std::mutex lock;
+  std::vector<int> tags;
+};
+
+struct Tagged {
+  StartOrder *order;
+  int tag;
+
+  static void Record(knapsack_status_t /*status*/, knapsack_result_t *result, void *user_data) {
+    knapsack_result_free(result);
+    const auto *self = static_cast<const Tagged *>(user_data);
+    const std::lock_guard<std::mutex> guard(self->order->lock);
+    self->order->tags.push_back(self->tag);
+  }
+};
+} // namespace
+
+TEST(KnapsackExecutorTest, JobsMatchSynchronousSolves) {
+  ExecutorPtr executor = MakeExecutor(3U);
+  ASSERT_NE(executor, nullptr);
+  std::vector<std::vector<knapsack_item_t>> instances;
+  std::vector<knapsack_job_t *> jobs;
+  for (unsigned seed = 0; seed < 24U; ++seed) {
+    instances.push_back(WideItems(10U + seed % 8U, 3000U + seed));
+    jobs.push_back(Submit(executor.get(), instances.back(), kWideCapacity));
+  }
+  for (size_t i = 0; i < jobs.size(); ++i) {
+    ASSERT_NE(jobs[i], nullptr);
+    EXPECT_EQ(WaitJob(jobs[i]), SolveUncached(instances[i], kWideCapacity)) << "job " << i;
+  }
+  const knapsack_executor_stats_t stats = ExecutorStats(executor.get());
+  EXPECT_EQ(stats.submitted, 24U);
+  EXPECT_EQ(stats.completed, 24U);
+  EXPECT_EQ(stats.rejected + stats.cancelled + stats.running, 0U);
+  EXPECT_GE(stats.max_queued, 1U);
+  EXPECT_GE(stats.run_ns, stats.max_run_ns);
+  EXPECT_GE(stats.queue_ns, stats.max_queue_ns);
+}
+
+TEST(KnapsackExecutorTest, CallbacksReceiveTheResults) {
+  struct Outcome {
+    knapsack_status_t status = KNAPSACK_ERR_IO;
+    int value = -1;
+  };
+  const auto record = [](knapsack_status_t status, knapsack_result_t *result, void *user_data) {
+    auto *outcome = static_cast<Outcome *>(user_data);
+    outcome->status = status;
+    outcome->value = result->optimal_value;
+    knapsack_result_free(result);
+  };
+  std::vector<std::vector<knapsack_item_t>> instances;
+  std::vector<Outcome> outcomes(16);
+  {
+    ExecutorPtr executor = MakeExecutor(2U);
+    ASSERT_NE(executor, nullptr);
+    for (unsigned seed = 0; seed < 16U; ++seed) {
+      instances.push_back(WideItems(12U, 3100U + seed));
+      const knapsack_item_t *items = instances.back().data();
+      ASSERT_EQ(knapsack_executor_submit(executor.get(), items, 12U, kWideCapacity, nullptr,
+                                         KNAPSACK_PRIORITY_NORMAL, record, &outcomes[seed],
+                                         nullptr),
+                KNAPSACK_OK);
+    }
+    // Destroying the executor would cancel whatever is still waiting.
+    while (ExecutorStats(executor.get()).completed < 16U) {
+      std::this_thread::yield();
+    }
+  }
+  for (size_t i = 0; i < outcomes.size(); ++i) {
+    EXPECT_EQ(outcomes[i].status, KNAPSACK_OK) << "job " << i;
+    EXPECT_EQ(outcomes[i].value, SolveUncached(instances[i], kWideCapacity).value) << "job " << i;
+  }
+}
+
+TEST(KnapsackExecutorTest, HigherPrioritiesStartFirst) {
+  ExecutorPtr executor = MakeExecutor(1U);
+  ASSERT_NE(executor, nullptr);
+  Gate gate;
+  knapsack_job_t *held = HoldWorker(executor.get(), &gate);
+  StartOrder order;
+  const knapsack_priority_t priorities[] = {KNAPSACK_PRIORITY_LOW,  KNAPSACK_PRIORITY_NORMAL,
+                                            KNAPSACK_PRIORITY_HIGH, KNAPSACK_PRIORITY_LOW,
+                                            KNAPSACK_PRIORITY_NORMAL, KNAPSACK_PRIORITY_HIGH};
+  std::vector<Tagged> tags;
+  tags.reserve(6U);
+  std::vector<knapsack_job_t *> jobs;
+  for (int i = 0; i < 6; ++i) {
+    tags.push_back({&order, i});
+    jobs.push_back(
+        Submit(executor.get(), {{2, 3}, {3, 4}}, 4, priorities[i], Tagged::Record, &tags.back()));
+  }
+  const knapsack_executor_stats_t stats = ExecutorStats(executor.get());
+  EXPECT_EQ(stats.queued[KNAPSACK_PRIORITY_HIGH], 2U);
+  EXPECT_EQ(stats.queued[KNAPSACK_PRIORITY_NORMAL], 2U);
+  EXPECT_EQ(stats.queued[KNAPSACK_PRIORITY_LOW], 2U);
+  EXPECT_EQ(stats.running, 1U);
+  gate.open = true;
+  for (knapsack_job_t *job : jobs) {
+    // The callback took the result; the handle still reports the status.
+    EXPECT_EQ(WaitJob(job), (FullSolution{KNAPSACK_OK, 0, 0, {}}));
+  }
+  WaitJob(held);
+  EXPECT_THAT(order.tags, ElementsAre(2, 5, 1, 4, 0, 3));
+}
+
+TEST(KnapsackExecutorTest, FullQueueRefusesJobs) {
+  ExecutorPtr executor = MakeExecutor(1U, 2U);
+  ASSERT_NE(executor, nullptr);
+  Gate gate;
+  knapsack_job_t *held = HoldWorker(executor.get(), &gate);
+  const std::vector<knapsack_item_t> items = {{2, 3}, {3, 4}, {4, 8}};
+  knapsack_job_t *first = Submit(executor.get(), items, 5, KNAPSACK_PRIORITY_LOW);
+  knapsack_job_t *second = Submit(executor.get(), items, 6);
+  knapsack_job_t *refused = held;
+  EXPECT_EQ(knapsack_executor_submit(executor.get(), items.data(), items.size(), 7, nullptr,
+                                     KNAPSACK_PRIORITY_HIGH, nullptr, nullptr, &refused),
+            KNAPSACK_ERR_QUEUE_FULL);
+  EXPECT_EQ(refused, nullptr);
+  knapsack_executor_stats_t stats = ExecutorStats(executor.get());
+  EXPECT_EQ(stats.rejected, 1U);
+  EXPECT_EQ(stats.max_queued, 2U);
+  gate.open = true;
+  EXPECT_EQ(WaitJob(first), SolveUncached(items, 5));
+  EXPECT_EQ(WaitJob(second), SolveUncached(items, 6));
+  WaitJob(held);
+  // Room again.
+  EXPECT_EQ(WaitJob(Submit(executor.get(), items, 7)), SolveUncached(items, 7));
+  stats = ExecutorStats(executor.get());
+  EXPECT_EQ(stats.submitted, 4U);
+  EXPECT_EQ(stats.completed, 4U);
+  EXPECT_EQ(stats.rejected, 1U);
+}
+
+TEST(KnapsackExecutorTest, CancelledJobsStop) {
+  ExecutorPtr executor = MakeExecutor(1U);
+  ASSERT_NE(executor, nullptr);
+  std::mt19937 rng(3200);
+  std::uniform_int_distribution<int> weight(100, 200);
+  std::vector<knapsack_item_t> items(100);
+  for (auto &item : items) {
+    item = {weight(rng), weight(rng)};
+  }
+  // The caller's callback reports the first poll, then holds the solve
+  // until the job has been cancelled.
+  struct Poll {
+    std::atomic<bool> polled{false};
+    std::atomic<bool> cancelled{false};
+  } poll;
+  knapsack_options_t options;
+  knapsack_options_init(&options);
+  options.engine = KNAPSACK_ENGINE_DENSE;
+  options.cancel = [](void *user_data) {
+    auto *p = static_cast<Poll *>(user_data);
+    p->polled = true;
+    while (!p->cancelled.load()) {
+      std::this_thread::yield();
+    }
+    return false;
+  };
+  options.cancel_user_data = &poll;
+  knapsack_job_t *running =
+      Submit(executor.get(), items, 5000, KNAPSACK_PRIORITY_NORMAL, nullptr, nullptr, &options);
+  knapsack_job_t *waiting = Submit(executor.get(), items, 5000);
+  ASSERT_NE(running, nullptr);
+  ASSERT_NE(waiting, nullptr);
+  while (!poll.polled.load()) {
+    std::this_thread::yield();
+  }
+  EXPECT_FALSE(knapsack_job_done(running));
+  knapsack_job_cancel(running);
+  knapsack_job_cancel(waiting);
+  poll.cancelled = true;
+  EXPECT_EQ(WaitJob(running).status, KNAPSACK_ERR_CANCELLED);
+  EXPECT_EQ(WaitJob(waiting).status, KNAPSACK_ERR_CANCELLED);
+  const knapsack_executor_stats_t stats = ExecutorStats(executor.get());
+  EXPECT_EQ(stats.completed, 2U);
+  EXPECT_EQ(stats.cancelled, 2U);
+}
+
+TEST(KnapsackExecutorTest, DestroyFinishesEveryJob) {
+  const std::vector<knapsack_item_t> items = WideItems(16U, 3300U);
+  const FullSolution expected = SolveUncached(items, kWideCapacity);
+  std::atomic<int> callbacks{0};
+  const knapsack_job_done_fn count = [](knapsack_status_t /*status*/, knapsack_result_t *result,
+                                        void *user_data) {
+    knapsack_result_free(result);
+    ++*static_cast<std::atomic<int> *>(user_data);
+  };
+  std::vector<knapsack_job_t *> jobs;
+  {
+    ExecutorPtr executor = MakeExecutor(1U);
+    ASSERT_NE(executor, nullptr);
+    for (int i = 0; i < 32; ++i) {
+      jobs.push_back(Submit(executor.get(), items, kWideCapacity, KNAPSACK_PRIORITY_NORMAL,
+                            i % 2 == 0 ? count : nullptr, &callbacks));
+    }
+  }
+  EXPECT_EQ(callbacks.load(), 16);
+  for (knapsack_job_t *job : jobs) {
+    // Waiting jobs were cancelled; the handles outlive the executor.
+    EXPECT_TRUE(knapsack_job_done(job));
+    const FullSolution solution = WaitJob(job);
+    if (solution.status != KNAPSACK_ERR_CANCELLED) {
+      EXPECT_EQ(solution.status, KNAPSACK_OK);
+    }
+  }
+}
+
+TEST(KnapsackExecutorTest, SolveErrorsAreTheJobsStatus) {
+  ExecutorPtr executor = MakeExecutor(2U);
+  ASSERT_NE(executor, nullptr);
+  const std::vector<knapsack_item_t> overflow = {{1, INT_MAX}, {1, 1}};
+  EXPECT_EQ(WaitJob(Submit(executor.get(), overflow, 2)).status, KNAPSACK_ERR_INT_OVERFLOW);
+  EXPECT_EQ(WaitJob(Submit(executor.get(), {{0, 1}}, 2)).status, KNAPSACK_ERR_INVALID_ITEMS);
+  EXPECT_EQ(WaitJob(Submit(executor.get(), {{1, 1}}, -1)).status, KNAPSACK_ERR_INVALID_CAPACITY);
+  // The result is handed out once.
+  knapsack_job_t *job = Submit(executor.get(), {{2, 3}, {3, 4}}, 5);
+  knapsack_result_t result;
+  ASSERT_EQ(knapsack_job_wait(job, &result), KNAPSACK_OK);
+  EXPECT_EQ(result.optimal_value, 7);
+  knapsack_result_free(&result);
+  EXPECT_EQ(knapsack_job_wait(job, &result), KNAPSACK_OK);
+  EXPECT_EQ(result.selected_indices, nullptr);
+  knapsack_job_release(job);
+  EXPECT_EQ(ExecutorStats(executor.get()).completed, 4U);
+}
+
+TEST(KnapsackExecutorTest, RequestedStatsAreFilled) {
+  if (!knapsack_stats_available()) {
+    GTEST_SKIP() << "built without statistics";
+  }
+  ExecutorPtr executor = MakeExecutor(1U);
+  ASSERT_NE(executor, nullptr);
+  knapsack_stats_t stats;
+  knapsack_options_t options;
+  knapsack_options_init(&options);
+  options.engine = KNAPSACK_ENGINE_DENSE;
+  options.stats = &stats;
+  const std::vector<knapsack_item_t> items = {{2, 3}, {3, 4}, {4, 8}, {5, 8}};
+  EXPECT_EQ(WaitJob(Submit(executor.get(), items, 9, KNAPSACK_PRIORITY_NORMAL, nullptr, nullptr,
+                           &options)),
+            SolveUncached(items, 9));
+  EXPECT_EQ(stats.engine, KNAPSACK_ENGINE_DENSE);
+  EXPECT_GT(stats.cells, 0U);
+}
+
+TEST(KnapsackExecutorTest, RejectsInvalidArguments) {
+  knapsack_executor_config_t config;
+  knapsack_executor_config_init(&config);
+  EXPECT_EQ(config.threads, 0U);
+  EXPECT_EQ(config.queue_capacity, KNAPSACK_EXECUTOR_QUEUE_CAPACITY);
+  config.queue_capacity = 0U;
+  EXPECT_EQ(knapsack_executor_create(&config), nullptr);
+  knapsack_executor_config_init(nullptr);
+
+  ExecutorPtr executor(knapsack_executor_create(nullptr));
+  ASSERT_NE(executor, nullptr);
+  const knapsack_item_t item = {1, 1};
+  knapsack_job_t *job = nullptr;
+  const auto submit = [&](knapsack_executor_t *target, const knapsack_item_t *items, size_t count,
+                          const knapsack_options_t *options, int priority,
+                          knapsack_job_t **out_job) {
+    return knapsack_executor_submit(target, items, count, 1, options,
+                                    static_cast<knapsack_priority_t>(priority), nullptr, nullptr,
+                                    out_job);
+  };
+  EXPECT_EQ(submit(nullptr, &item, 1U, nullptr, 0, &job), KNAPSACK_ERR_INVALID_ARGUMENT);
+  EXPECT_EQ(submit(executor.get(), &item, 1U, nullptr, 3, &job), KNAPSACK_ERR_INVALID_ARGUMENT);
+  EXPECT_EQ(submit(executor.get(), &item, 1U, nullptr, -1, &job), KNAPSACK_ERR_INVALID_ARGUMENT);
+  EXPECT_EQ(submit(executor.get(), &item, 1U, nullptr, 0, nullptr),
+            KNAPSACK_ERR_INVALID_ARGUMENT);
+  knapsack_options_t options;
+  knapsack_options_init(&options);
+  options.limits.max_items = 0U;
+  EXPECT_EQ(submit(executor.get(), &item, 1U, &options, 0, &job), KNAPSACK_ERR_INVALID_ARGUMENT);
+  options.limits.max_items = 1U;
+  const knapsack_item_t two[] = {{1, 1}, {1, 1}};
+  EXPECT_EQ(submit(executor.get(), two, 2U, &options, 0, &job), KNAPSACK_ERR_TOO_MANY_ITEMS);
+  EXPECT_EQ(submit(executor.get(), nullptr, 1U, nullptr, 0, &job), KNAPSACK_ERR_INVALID_ITEMS);
+  EXPECT_EQ(submit(executor.get(), &item, 0U, nullptr, 0, &job), KNAPSACK_ERR_INVALID_ITEMS);
+  EXPECT_EQ(job, nullptr);
+  EXPECT_EQ(ExecutorStats(executor.get()).submitted, 0U);
+
+  knapsack_executor_stats_t stats;
+  knapsack_executor_get_stats(nullptr, &stats);
+  EXPECT_EQ(stats.submitted + stats.completed + stats.max_queued, 0U);
+  knapsack_executor_get_stats(executor.get(), nullptr);
+  knapsack_result_t result;
+  EXPECT_EQ(knapsack_job_wait(nullptr, &result), KNAPSACK_ERR_INVALID_ARGUMENT);
+  EXPECT_FALSE(knapsack_job_done(nullptr));
+  knapsack_job_cancel(nullptr);
+  knapsack_job_release(nullptr);
+  knapsack_executor_destroy(nullptr);
+  EXPECT_STREQ(knapsack_status_name(KNAPSACK_ERR_QUEUE_FULL), "QUEUE_FULL");
+  EXPECT_STREQ(knapsack_status_name(KNAPSACK_ERR_LIMIT), "LIMIT");
+}
+
 TEST(KnapsackResultFree, NullResultIsNoOp) {
   // Both null result and null allocator must be safe.
   knapsack_result_free(nullptr);
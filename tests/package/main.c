@@ -0,0 +1,21 @@
+#include "knapsack/knapsack.h"
+
+#include <stdio.h>
+
+int main(void) {
+  const knapsack_item_t items[] = {{1, 1}, {3, 4}, {4, 5}, {5, 7}};
+  knapsack_result_t result;
+  const knapsack_status_t status = knapsack_solve_status(items, 4U, 7, &result);
+  if (status != KNAPSACK_OK) {
+    fprintf(stderr, "knapsack_solve_status failed: %d\n", (int)status);
+    return 1;
+  }
+  const int value = result.optimal_value;
+  knapsack_result_free(&result);
+  if (value != 9) {
+    fprintf(stderr, "expected optimal value 9, got %d\n", value);
+    return 1;
+  }
+  printf("optimal value %d\n", value);
+  return 0;
+}